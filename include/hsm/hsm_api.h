@@ -38,9 +38,23 @@ typedef struct {
 #define HSM_OPEN_SESSION_EXCLUSIVE_MASK     (1u << 1) //!< No other HSM session will be authorized on the same security enclave.
 #define HSM_OPEN_SESSION_LOW_LATENCY_MASK   (1u << 3) //!< Use a low latency HSM implementation
 #define HSM_OPEN_SESSION_NO_KEY_STORE_MASK  (1u << 4) //!< No key store will be attached to this session. May provide better performances on some operation depending on the implementation. Usage of the session will be restricted to operations that doesn't involve secret keys (e.g. hash, signature verification, random generation).
-#define HSM_OPEN_SESSION_RESERVED_MASK      ((1u << 2) | (1u << 5) | (1u << 6) | (1u << 7)) //!< Bits reserved for future use. Should be set to 0.
+#define HSM_OPEN_SESSION_CHANNEL_GROUP_MASK (1u << 5) //!< Open the session on all the MUs serving this kind of session and dispatch the operations to the least loaded one, see hsm_open_session().
+#define HSM_OPEN_SESSION_RESERVED_MASK      ((1u << 2) | (1u << 6) | (1u << 7)) //!< Bits reserved for future use. Should be set to 0.
 
 /**
+ *
+ * With \ref HSM_OPEN_SESSION_CHANNEL_GROUP_MASK, a low latency session
+ * without key store is opened on both V2X verification MUs (SV0 and SV1).
+ * The signature verification services opened on it are opened on both,
+ * and each verification (or batch of verifications) is sent to the MU
+ * expected to serve it first, from the operations in flight on each MU and
+ * their rolling service time. The operations of a high priority session only go to the
+ * low priority MU when nothing is in flight on it. Verifications with
+ * HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL, and batches holding one, stay on
+ * the MU of the session priority, where hsm_import_public_key() imports the
+ * keys. The other services use the MU of the session priority. The flag is
+ * ignored for the other sessions, a key store being only reachable from
+ * one MU.
  *
  * \param args pointer to the structure containing the function arguments.
 
@@ -68,6 +82,7 @@ hsm_err_t hsm_close_session(hsm_hdl_t session_hdl);
  * - \ref HSM_OPEN_SESSION_EXCLUSIVE_MASK not supported and ignored
  * - session_priority field of \ref open_session_args_t is ignored.
  * - \ref HSM_OPEN_SESSION_LOW_LATENCY_MASK not supported and ignored.
+ * - The MU holds one command at a time: the operations submitted with hsm_submit(), hsm_generate_signature_batch() or hsm_verify_signature_batch() are processed one after the other.
  *
  */
 
@@ -81,6 +96,7 @@ hsm_err_t hsm_close_session(hsm_hdl_t session_hdl);
  * - If \ref HSM_OPEN_SESSION_LOW_LATENCY_MASK is unset then SECO implementation will be used.
  * In this case session_priority field of \ref open_session_args_t is ignored.
  * - If \ref HSM_OPEN_SESSION_LOW_LATENCY_MASK is set then V2X implementation is used. session_priority field of \ref open_session_args_t and \ref HSM_OPEN_SESSION_NO_KEY_STORE_MASK are considered.
+ * - Each MU holds one command at a time: the operations submitted with hsm_submit(), hsm_generate_signature_batch() or hsm_verify_signature_batch() on a session are processed one after the other.
  *
  */
 /** @} end of session group */
@@ -177,6 +193,14 @@ hsm_err_t hsm_open_key_management_service(hsm_hdl_t key_store_hdl, open_svc_key_
 
 #include "internal/hsm_debug_dump.h"
 
+#include "internal/hsm_async.h"
+
+#include "internal/hsm_buf.h"
+
+#include "internal/hsm_perf.h"
+
+#include "internal/hsm_pub_key_cache.h"
+
 typedef uint8_t hsm_op_manage_key_group_flags_t;
 typedef struct {
     hsm_key_group_t key_group;                  //!< it must be a value in the range 0-1023. Keys belonging to the same group can be cached in the HSM local memory through the hsm_manage_key_group API.
@@ -253,6 +277,40 @@ hsm_err_t hsm_butterfly_key_expansion(hsm_hdl_t key_management_hdl, op_butt_key_
 #define HSM_OP_BUTTERFLY_KEY_FLAGS_EXPLICIT_CERTIF       ((hsm_op_but_key_exp_flags_t)(1u << 2))   //!< butterfly key expansion using explicit certificate.
 #define HSM_OP_BUTTERFLY_KEY_FLAGS_STRICT_OPERATION      ((hsm_op_but_key_exp_flags_t)(1u << 7))   //!< The request is completed only when the new key has been written in the NVM.
 
+typedef struct {
+    uint32_t key_identifier;                //!< identifier of the key to be expanded, common to all the expansions.
+    uint8_t *expansion_function_values;     //!< pointer to the expansion function values, expansion_function_value_size bytes each.
+    uint8_t *hash_values;                   //!< pointer to the hash values, hash_value_size bytes each.\n In case of explicit certificate, it must be set to 0.
+    uint8_t *pr_reconstruction_values;      //!< pointer to the private reconstruction values, pr_reconstruction_value_size bytes each.\n In case of explicit certificate, it must be set to 0.
+    uint8_t expansion_function_value_size;  //!< length in bytes of one expansion function value.
+    uint8_t hash_value_size;                //!< length in bytes of one hash value.
+    uint8_t pr_reconstruction_value_size;   //!< length in bytes of one private reconstruction value.
+    hsm_op_but_key_exp_flags_t flags;       //!< bitmap specifying the properties of all the operations.
+    uint32_t *dest_key_identifiers;         //!< pointer to the identifiers of the derived keys, one per expansion.\n In case of create operation the new identifiers are stored there.
+    uint8_t *output;                        //!< pointer to the output area where the public keys must be written one after the other.
+    uint16_t output_size;                   //!< length in bytes of one public key, if the size is 0, no key is copied in the output.
+    hsm_key_type_t key_type;                //!< indicates the type of the keys to be derived.
+    uint8_t reserved;
+    hsm_key_group_t key_group;              //!< group of the derived keys, it must have room for all of them.
+    hsm_key_info_t key_info;                //!< bitmap specifying the properties of the derived keys.
+} op_butt_key_exp_batch_args_t;
+
+/**
+ * Perform several butterfly key expansions of the same key.\n
+ * Same as calling hsm_butterfly_key_expansion for each set of values, but
+ * the commands are built and sent to the HSM while the previous ones are
+ * processed, and the values are passed to the HSM through buffers mapped
+ * once instead of per command where the platform allows it.
+ *
+ * \param key_management_hdl handle identifying the key store management service flow.
+ * \param args pointer to the structure containing the arguments common to all the expansions and their arrays of values.
+ * \param nb_ops number of expansions.
+ * \param results optional array of nb_ops error codes, where the error code of each expansion must be written.
+ *
+ * \return HSM_NO_ERROR if all the expansions succeeded, otherwise the error code of one that failed.
+ */
+hsm_err_t hsm_butterfly_key_expansion_batch(hsm_hdl_t key_management_hdl, op_butt_key_exp_batch_args_t *args, uint32_t nb_ops, hsm_err_t *results);
+
 /**
  * Terminate a previously opened key management service flow
  *
@@ -480,7 +538,7 @@ hsm_err_t hsm_get_random(hsm_hdl_t rng_hdl, op_get_random_args_t *args);
  * @{
  */
 typedef uint8_t hsm_op_pub_key_rec_flags_t;
-typedef struct {
+typedef struct op_pub_key_rec_args_s {
     uint8_t *pub_rec;                       //!< pointer to the public reconstruction value extracted from the implicit certificate.
     uint8_t *hash;                          //!< pointer to the input hash value. In the butterfly scheme it corresponds to the hash value calculated over PCA certificate and, concatenated, the implicit certificat.
     uint8_t *ca_key;                        //!< pointer to the CA public key
@@ -529,7 +587,7 @@ hsm_err_t hsm_pub_key_reconstruction(hsm_hdl_t session_hdl,  op_pub_key_rec_args
  * @{
  */
 typedef uint8_t hsm_op_pub_key_dec_flags_t;
-typedef struct {
+typedef struct op_pub_key_dec_args_s {
     uint8_t *key;                           //!< pointer to the compressed ECC public key. The expected key format is x||lsb_y where lsb_y is 1 byte having value 1 if the least-significant bit of the original (uncompressed) y coordinate is set, and 0 otherwise.
     uint8_t *out_key;                       //!< pointer to the output area where the decompressed public key must be written.
     uint16_t key_size;                      //!< length in bytes of the input compressed public key
@@ -1147,6 +1205,38 @@ hsm_err_t hsm_standalone_butterfly_key_expansion(hsm_hdl_t key_management_hdl, o
 #define HSM_OP_ST_BUTTERFLY_KEY_FLAGS_EXPLICIT_CERTIF       ((hsm_op_st_but_key_exp_flags_t)(1u << 2))   //!< standalone butterfly key expansion using explicit certificate.
 #define HSM_OP_ST_BUTTERFLY_KEY_FLAGS_STRICT_OPERATION      ((hsm_op_st_but_key_exp_flags_t)(1u << 7))   //!< The request is completed only when the new key has been written in the NVM.
 
+typedef struct {
+    uint32_t key_identifier;                //!< identifier of the key to be expanded, common to all the expansions.
+    uint32_t expansion_fct_key_identifier;  //!< identifier of the key to be use for the expansion function computation.
+    uint8_t *expansion_fct_inputs;          //!< pointer to the inputs of the expansion function, expansion_fct_input_size bytes each.
+    uint8_t *hash_values;                   //!< pointer to the hash values, hash_value_size bytes each.\n In case of explicit certificate, it must be set to 0.
+    uint8_t *pr_reconstruction_values;      //!< pointer to the private reconstruction values, pr_reconstruction_value_size bytes each.\n In case of explicit certificate, it must be set to 0.
+    uint8_t expansion_fct_input_size;       //!< length in bytes of one expansion function input. \n It must be 16 bytes.
+    uint8_t hash_value_size;                //!< length in bytes of one hash value.
+    uint8_t pr_reconstruction_value_size;   //!< length in bytes of one private reconstruction value.
+    hsm_op_st_but_key_exp_flags_t flags;    //!< bitmap specifying the properties of all the operations.
+    uint32_t *dest_key_identifiers;         //!< pointer to the identifiers of the derived keys, one per expansion.\n In case of create operation the new identifiers are stored there.
+    uint8_t *output;                        //!< pointer to the output area where the public keys must be written one after the other.
+    uint16_t output_size;                   //!< length in bytes of one public key, if the size is 0, no key is copied in the output.
+    hsm_key_type_t key_type;                //!< indicates the type of the keys to be derived.
+    uint8_t expansion_fct_algo;             //!< cipher algorithm to be used for the expansion function computation.
+    hsm_key_group_t key_group;              //!< group of the derived keys, it must have room for all of them.
+    hsm_key_info_t key_info;                //!< bitmap specifying the properties of the derived keys.
+} op_st_butt_key_exp_batch_args_t;
+
+/**
+ * Perform several standalone butterfly key expansions of the same key,
+ * see hsm_butterfly_key_expansion_batch.
+ *
+ * \param key_management_hdl handle identifying the key store management service flow.
+ * \param args pointer to the structure containing the arguments common to all the expansions and their arrays of values.
+ * \param nb_ops number of expansions.
+ * \param results optional array of nb_ops error codes, where the error code of each expansion must be written.
+ *
+ * \return HSM_NO_ERROR if all the expansions succeeded, otherwise the error code of one that failed.
+ */
+hsm_err_t hsm_standalone_butterfly_key_expansion_batch(hsm_hdl_t key_management_hdl, op_st_butt_key_exp_batch_args_t *args, uint32_t nb_ops, hsm_err_t *results);
+
 /**
  *\addtogroup qxp_specific
  * \ref group21
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef HSM_ASYNC_H
+#define HSM_ASYNC_H
+
+#include <stdint.h>
+
+#include "internal/hsm_handle.h"
+#include "internal/hsm_utils.h"
+
+/**
+ *  @defgroup group23 Asynchronous operations
+ * The operations are only overlapped in the HSM where the MU holds several
+ * commands (simulator). The ELE and SECO MUs hold one command at a time:
+ * there the asynchronous mode frees the caller while an operation is
+ * processed, but does not increase the number of operations per second.
+ * @{
+ */
+
+/**
+ * Identifier of a submitted operation, unique within its session.
+ */
+typedef uint32_t hsm_ticket_t;
+#define HSM_TICKET_NONE		((hsm_ticket_t)0u)
+
+/* Max number of operations submitted and not yet collected per session. */
+#define HSM_ASYNC_MAX_PENDING	(8u)
+
+typedef enum {
+	//!< args is an op_generate_sign_args_t
+	HSM_ASYNC_OP_GENERATE_SIGN,
+	//!< args is an op_prepare_sign_args_t
+	HSM_ASYNC_OP_PREPARE_SIGN,
+	//!< args is an op_verify_sign_args_t
+	HSM_ASYNC_OP_VERIFY_SIGN,
+	//!< args is an op_hash_one_go_args_t
+	HSM_ASYNC_OP_HASH_ONE_GO,
+	//!< args is an op_cipher_one_go_args_t
+	HSM_ASYNC_OP_CIPHER_ONE_GO,
+	//!< args is an op_mac_one_go_args_t
+	HSM_ASYNC_OP_MAC_ONE_GO,
+} hsm_async_op_type_t;
+
+/**
+ * Completion callback, called from the completion thread of the session.
+ * op_err is the error code the synchronous API would have returned.
+ * The callback must not call a synchronous API on the same session.
+ */
+typedef void (*hsm_async_cb_t)(hsm_ticket_t ticket,
+			       hsm_err_t op_err,
+			       void *cb_arg);
+
+typedef struct {
+	//!< handle of the service flow performing the operation
+	hsm_hdl_t service_hdl;
+	//!< operation to be performed
+	hsm_async_op_type_t op_type;
+	//!< arguments of the operation, they must stay valid until completion
+	void *args;
+	//!< optional completion callback
+	hsm_async_cb_t callback;
+	//!< opaque argument given back to the callback
+	void *cb_arg;
+} hsm_async_op_t;
+
+/**
+ * Switch a session in asynchronous mode.\n
+ * A completion thread is started to read the responses of the enclave.
+ * The next commands are built and written meanwhile only on channels
+ * holding several commands (simulator): the ELE and SECO MUs hold one, so
+ * there a command is built once the response of the previous one is read.
+ * The synchronous APIs remain usable on the session, they wait for their
+ * own completion.
+ *
+ * \param session_hdl handle identifying the session.
+ * \param event_fd optional pointer to where an eventfd, incremented on each
+ *        completion, must be written. It is closed by hsm_async_disable.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_async_enable(hsm_hdl_t session_hdl, int32_t *event_fd);
+
+/**
+ * Wait for all the submitted operations and switch the session back in
+ * synchronous mode. Results not collected are lost.\n
+ * Also done by hsm_close_session.
+ *
+ * \param session_hdl handle identifying the session.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_async_disable(hsm_hdl_t session_hdl);
+
+/**
+ * Submit an operation on a session in asynchronous mode.\n
+ * The call returns as soon as the command is sent to the enclave, which
+ * waits for the previous command if the MU cannot hold another one. If all
+ * the slots of the session are in use it waits for a completion, or
+ * returns HSM_NOT_READY_RATING if only uncollected results remain.\n
+ * Operations with a callback are collected by the library once the callback
+ * returns, the others must be collected with hsm_wait or hsm_poll.
+ * Output values (e.g. verification_status) are written in op->args.
+ *
+ * \param op pointer to the operation description.
+ * \param ticket pointer to where the ticket of the operation must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_submit(hsm_async_op_t *op, hsm_ticket_t *ticket);
+
+/**
+ * Wait for the completion of an operation submitted without callback.
+ *
+ * \param session_hdl handle identifying the session.
+ * \param ticket ticket returned by hsm_submit.
+ * \param op_err pointer to where the error code of the operation
+ *        must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_wait(hsm_hdl_t session_hdl, hsm_ticket_t ticket,
+		   hsm_err_t *op_err);
+
+/**
+ * Same as hsm_wait without blocking: return HSM_NOT_READY_RATING if the
+ * operation is still in progress.
+ *
+ * \param session_hdl handle identifying the session.
+ * \param ticket ticket returned by hsm_submit.
+ * \param op_err pointer to where the error code of the operation
+ *        must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_poll(hsm_hdl_t session_hdl, hsm_ticket_t ticket,
+		   hsm_err_t *op_err);
+
+/** @} end of asynchronous operations */
+#endif
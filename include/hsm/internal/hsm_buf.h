@@ -0,0 +1,57 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef HSM_BUF_H
+#define HSM_BUF_H
+
+#include <stdint.h>
+
+#include "internal/hsm_handle.h"
+
+/**
+ *  @defgroup group24 Data buffers
+ * Buffers allocated with hsm_buf_alloc() are located in memory the enclave
+ * accesses directly, when the platform provides it: operations using them
+ * as input or output skip the data buffer setup done on each call
+ * (one ioctl and one copy per buffer on Linux).
+ * Only the simulator provides such memory for now. The ELE and SECO
+ * drivers have no interface to map it, so there the buffers are regular
+ * memory and the saving does not apply.
+ * Any other buffer can still be used, and a buffer of a session can be
+ * given to the services of this session only.
+ * @{
+ */
+
+/**
+ * Allocate a data buffer for the operations of a session.
+ * On platforms that cannot map memory for the enclave, the buffer is
+ * regular memory and is set up on each call as any other.
+ *
+ * \param session_hdl handle identifying the session.
+ * \param size size in bytes of the buffer.
+ *
+ * \return pointer to the buffer, NULL in case of error.
+ */
+void *hsm_buf_alloc(hsm_hdl_t session_hdl, uint32_t size);
+
+/**
+ * Free a buffer allocated with hsm_buf_alloc(). The buffers not freed are
+ * released when the session is closed, they must no longer be used then.
+ *
+ * \param session_hdl handle identifying the session.
+ * \param buf pointer to the buffer.
+ */
+void hsm_buf_free(hsm_hdl_t session_hdl, void *buf);
+
+/** @} end of data buffers */
+#endif
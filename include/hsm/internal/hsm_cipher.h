@@ -131,6 +131,81 @@ typedef struct {
 hsm_err_t hsm_cipher_one_go(hsm_hdl_t cipher_hdl,
 			    op_cipher_one_go_args_t *args);
 
+/**
+ * Largest input ciphered by the enclave in one message.
+ */
+#define HSM_CIPHER_ONE_GO_MAX_SZ	1024u
+
+/**
+ * Context of a ciphering operation over several calls, see
+ * hsm_cipher_init().
+ */
+typedef struct hsm_cipher_ctx_s hsm_cipher_ctx_t;
+
+/**
+ * Start a ciphering operation whose input is given in several parts, of
+ * any size.\n
+ * User can call this function only after having opened a cipher service
+ * flow.
+ *
+ * The input is split in messages of \ref HSM_CIPHER_ONE_GO_MAX_SZ bytes,
+ * the IV of each message (last cipher text block for CBC, counter for CTR)
+ * being computed by the library. Several messages are in flight at a time,
+ * except for CBC encryption where the IV of a message is the output of the
+ * previous one. Where the platform maps memory for the enclave (see
+ * hsm_buf_alloc()), the messages are ciphered in a buffer of the session
+ * taken at init, so that their data buffers need no setup.
+ *
+ * Only ECB, CBC and CTR (PSA) algorithms are supported.
+ *
+ * \param cipher_hdl handle identifying the cipher service flow.
+ * \param args key_identifier, iv, iv_size, flags and cipher_algo of the
+ *             operation, the other fields are not used.
+ * \param ctx pointer to where the context must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_cipher_init(hsm_hdl_t cipher_hdl,
+			  op_cipher_one_go_args_t *args,
+			  hsm_cipher_ctx_t **ctx);
+
+/**
+ * Cipher a part of the input of an operation started with
+ * hsm_cipher_init(). Only whole blocks are ciphered, the rest of the input
+ * is kept for the next call.
+ * Input and output can overlap, e.g. a buffer ciphered in place part by
+ * part: the output of the input kept by the previous call comes first, the
+ * output area must then also hold these bytes.
+ *
+ * \param ctx context of the operation.
+ * \param input pointer to the part of the input.
+ * \param output pointer to the output area.
+ * \param input_size length in bytes of the part of the input.
+ * \param output_size length in bytes of the output area, it must be at
+ *                    least input_size + 15. Set to the length written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_cipher_update(hsm_cipher_ctx_t *ctx, uint8_t *input,
+			    uint8_t *output, uint32_t input_size,
+			    uint32_t *output_size);
+
+/**
+ * Cipher the input kept by the last hsm_cipher_update() and free the
+ * context, also in case of error. ECB and CBC inputs must be a multiple
+ * of the block size, CTR ones can end with a partial block.
+ * When output is NULL, the context is freed without ciphering.
+ *
+ * \param ctx context of the operation.
+ * \param output pointer to the output area.
+ * \param output_size length in bytes of the output area, it must be at
+ *                    least 15. Set to the length written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_cipher_final(hsm_cipher_ctx_t *ctx, uint8_t *output,
+			   uint32_t *output_size);
+
 /**
  * Terminate a previously opened cipher service flow
  *
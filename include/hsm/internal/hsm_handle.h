@@ -24,20 +24,42 @@ struct hsm_session_hdl_s {
 	struct plat_os_abs_hdl *phdl;
 	uint32_t session_hdl;
 	uint32_t mu_type;
+	/* Priority of the MU, HSM_OPEN_SESSION_PRIORITY_*. */
+	uint8_t mu_priority;
+	/* Next session of a channel group, not registered. */
+	struct hsm_session_hdl_s *member;
+	/* Keys imported or deleted on the session, see session_keys_changed(). */
+	uint32_t key_gen;
 };
 
 struct hsm_service_hdl_s {
 	struct hsm_session_hdl_s *session;
 	uint32_t service_hdl;
+	/* Same service flow on the next session of a channel group. */
+	struct hsm_service_hdl_s *member;
+	/* Imported public keys of a signature verification service flow. */
+	struct key_ref_cache *key_refs;
 };
 
-#define HSM_MAX_SESSIONS	(8u)
-#define HSM_MAX_SERVICES	(32u)
-
 struct hsm_session_hdl_s *session_hdl_to_ptr(uint32_t hdl);
 struct hsm_service_hdl_s *service_hdl_to_ptr(uint32_t hdl);
+/* Delete a session and the services still open on it. */
 void delete_session(struct hsm_session_hdl_s *s_ptr);
 void delete_service(struct hsm_service_hdl_s *s_ptr);
-struct hsm_session_hdl_s *add_session(void);
+struct hsm_session_hdl_s *add_session(struct plat_os_abs_hdl *phdl,
+				       uint32_t mu_type);
 struct hsm_service_hdl_s *add_service(struct hsm_session_hdl_s *session);
+/* Make an added session/service reachable by the handle set by the enclave. */
+void register_session(struct hsm_session_hdl_s *s_ptr);
+void register_service(struct hsm_service_hdl_s *s_ptr);
+/*
+ * Service of the channel group of s_ptr expected to serve a command first,
+ * s_ptr itself outside channel groups.
+ */
+struct hsm_service_hdl_s *service_dispatch(struct hsm_service_hdl_s *s_ptr);
+/*
+ * Count a key imported or deleted on a session: the key references kept
+ * for its signature verification services are dropped.
+ */
+void session_keys_changed(struct hsm_session_hdl_s *s_ptr);
 #endif
@@ -106,6 +106,69 @@ typedef struct {
  */
 hsm_err_t hsm_hash_one_go(hsm_hdl_t hash_hdl, op_hash_one_go_args_t *args);
 
+/**
+ * Largest input hashed by the enclave in one message: the data buffers
+ * given to the MU drivers are limited to this size.
+ */
+#define HSM_HASH_ONE_GO_MAX_SZ		(64u * 1024u)
+
+/**
+ * Context of a hash computed over several calls, see hsm_hash_init().
+ */
+typedef struct hsm_hash_ctx_s hsm_hash_ctx_t;
+
+/**
+ * Start a hash whose input is given in several parts.\n
+ * User can call this function only after having opened a hash service flow.
+ *
+ * The hash messages of the enclave carry no intermediate state, so the
+ * context works in one of two modes:
+ * - up to \ref HSM_HASH_ONE_GO_MAX_SZ bytes, the input is gathered and
+ *   hashed by the enclave with one hsm_hash_one_go() at hsm_hash_final().
+ * - beyond, the hash is computed on the host by the library. Only the
+ *   SHA-2 algorithms are available in this mode, updates beyond the limit
+ *   fail with HSM_FEATURE_NOT_SUPPORTED for the others.
+ *
+ * The buffer gathering the input is taken by the first update. When none
+ * is left, SHA-2 hashes are computed on the host and the others fail with
+ * HSM_OUT_OF_MEMORY.
+ *
+ * \param hash_hdl handle identifying the hash service flow.
+ * \param algo hash algorithm to be used for the operation.
+ * \param ctx pointer to where the context must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_hash_init(hsm_hdl_t hash_hdl, hsm_hash_algo_t algo,
+			hsm_hash_ctx_t **ctx);
+
+/**
+ * Add a part of the input of a hash started with hsm_hash_init().
+ * The input can be reused as soon as the function returns.
+ *
+ * \param ctx context of the hash.
+ * \param input pointer to the part of the input.
+ * \param input_size length in bytes of the part of the input.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_hash_update(hsm_hash_ctx_t *ctx, uint8_t *input,
+			  uint32_t input_size);
+
+/**
+ * Get the digest of a hash started with hsm_hash_init() and free its
+ * context, also in case of error. When output is NULL, the context is
+ * freed without computing the digest.
+ *
+ * \param ctx context of the hash.
+ * \param output pointer to the output area where the digest must be written.
+ * \param output_size length in bytes of the output.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_hash_final(hsm_hash_ctx_t *ctx, uint8_t *output,
+			 uint32_t output_size);
+
 /**
  *\addtogroup qxp_specific
  * \ref group5
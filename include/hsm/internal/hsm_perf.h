@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef HSM_PERF_H
+#define HSM_PERF_H
+
+#include <stdint.h>
+
+#include "internal/hsm_utils.h"
+
+/**
+ *  @defgroup group25 Performance statistics
+ * Counters and latency histograms of the messages exchanged with the
+ * enclave, per message ID. They are only collected when the library is
+ * built with PERF_STATS=1, the functions below report
+ * HSM_FEATURE_NOT_SUPPORTED otherwise.
+ * @{
+ */
+
+/**
+ * Phases of a message, their latencies are measured separately.
+ */
+typedef enum {
+	//!< Build of the command, data buffer setup included.
+	HSM_PERF_PHASE_PREPARE,
+	//!< Wait for a MU slot and write of the command.
+	HSM_PERF_PHASE_SEND,
+	//!< From the write of the command to the read of its response.
+	HSM_PERF_PHASE_WAIT,
+	//!< Decoding of the response.
+	HSM_PERF_PHASE_POST,
+	HSM_PERF_NB_PHASES,
+} hsm_perf_phase_t;
+
+/**
+ * Number of buckets of the latency histograms. Bucket 0 counts the
+ * latencies of 0 ns, bucket i the ones in [2^(i-1), 2^i) ns, the last one
+ * all the longer ones.
+ */
+#define HSM_PERF_NB_BUCKETS	32u
+
+typedef struct {
+	//!< commands built.
+	uint64_t calls;
+	//!< commands not sent, not answered or rejected by the enclave.
+	uint64_t errors;
+	//!< bytes of the data buffers set up for the commands.
+	uint64_t bytes;
+	//!< sum of the latencies of each phase, in ns.
+	uint64_t total_ns[HSM_PERF_NB_PHASES];
+	//!< latency histograms of each phase.
+	uint64_t hist[HSM_PERF_NB_PHASES][HSM_PERF_NB_BUCKETS];
+} hsm_perf_stats_t;
+
+/**
+ * Get the statistics of a message ID, collected on all the sessions since
+ * the start or the last hsm_reset_perf_stats().
+ *
+ * \param msg_id message ID (SAB_*_REQ).
+ * \param stats pointer to where the statistics must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_get_perf_stats(uint8_t msg_id, hsm_perf_stats_t *stats);
+
+/**
+ * Clear the statistics of all the message IDs.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_reset_perf_stats(void);
+
+/** @} end of performance statistics */
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef HSM_PUB_KEY_CACHE_H
+#define HSM_PUB_KEY_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "internal/hsm_utils.h"
+
+/**
+ *  @defgroup group26 Public key cache
+ * Cache of the public keys computed by hsm_pub_key_decompression() and
+ * hsm_pub_key_reconstruction(), shared by all the sessions of the process.
+ * Once enabled, a call whose inputs were already seen gets the key from the
+ * cache, without any message to the enclave. Only successful results are
+ * cached, the inputs are compared byte for byte.\n
+ * The cache is a hash table of fixed size: entries are looked up without
+ * lock, and an entry not used since the clock hand last went past it is
+ * evicted when a new key must be stored.
+ * @{
+ */
+
+//!< Largest public key stored in the cache, in bytes.
+#define HSM_PUB_KEY_CACHE_KEY_MAX	96u
+//!< Largest total size of the inputs of a cached operation, in bytes.
+#define HSM_PUB_KEY_CACHE_IN_MAX	256u
+
+typedef struct {
+	//!< hsm_pub_key_decompression() calls served by the cache.
+	uint64_t dec_hits;
+	//!< hsm_pub_key_decompression() calls sent to the enclave.
+	uint64_t dec_misses;
+	//!< hsm_pub_key_reconstruction() calls served by the cache.
+	uint64_t rec_hits;
+	//!< hsm_pub_key_reconstruction() calls sent to the enclave.
+	uint64_t rec_misses;
+	//!< keys stored in the cache.
+	uint64_t insertions;
+	//!< keys evicted to store another one.
+	uint64_t evictions;
+	//!< number of entries of the cache.
+	uint32_t entries;
+	//!< number of entries holding a key.
+	uint32_t used;
+} hsm_pub_key_cache_stats_t;
+
+/**
+ * Enable or disable the public key cache.\n
+ * The number of entries is rounded up to a multiple of 4 and set by the
+ * first call enabling the cache, the memory is kept until the process
+ * exits: a later call can only enable it again with the same number of
+ * entries. Disabling the cache drops all its keys, its counters restart
+ * when it is enabled again.
+ * Operations whose output is larger than HSM_PUB_KEY_CACHE_KEY_MAX or
+ * inputs larger than HSM_PUB_KEY_CACHE_IN_MAX are never cached.
+ *
+ * \param nb_entries number of entries of the cache, 0 to disable it.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_set_pub_key_cache(uint32_t nb_entries);
+
+/**
+ * Get the counters of the public key cache, since it was last enabled.
+ *
+ * \param stats pointer to where the counters must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_get_pub_key_cache_stats(hsm_pub_key_cache_stats_t *stats);
+
+/** @} end of public key cache */
+
+/*
+ * Used by hsm_pub_key_decompression() and hsm_pub_key_reconstruction():
+ * the get functions write the cached key of the arguments to their output
+ * and return true on a hit, the put functions store the output of a
+ * successful call. They do nothing while the cache is disabled.
+ */
+struct op_pub_key_dec_args_s;
+struct op_pub_key_rec_args_s;
+
+bool pub_key_cache_dec_get(struct op_pub_key_dec_args_s *args);
+void pub_key_cache_dec_put(struct op_pub_key_dec_args_s *args);
+bool pub_key_cache_rec_get(struct op_pub_key_rec_args_s *args);
+void pub_key_cache_rec_put(struct op_pub_key_rec_args_s *args);
+#endif
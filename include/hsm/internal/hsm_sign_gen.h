@@ -189,6 +189,30 @@ typedef struct {
 hsm_err_t hsm_generate_signature(hsm_hdl_t signature_gen_hdl,
 				 op_generate_sign_args_t *args);
 
+/**
+ * Generate several digital signatures on the same service flow.\n
+ * Same as calling hsm_generate_signature for each element of ops, but
+ * the commands are built and sent to the HSM while the previous ones are
+ * processed, as many as the MU holds. The ELE and SECO MUs hold one
+ * command: there the signatures are generated one after the other and
+ * the batch only saves the per-call overhead of the library.
+ *
+ * \param signature_gen_hdl: handle identifying the signature generation
+ *                           service flow.
+ * \param ops: array of nb_ops structures containing the arguments of
+ *             each signature.
+ * \param nb_ops: number of signatures to generate.
+ * \param results: optional array of nb_ops error codes, where the error
+ *                 code of each signature must be written.
+ *
+ * \return HSM_NO_ERROR if all the signatures succeeded, otherwise the
+ *         error code of one that failed.
+ */
+hsm_err_t hsm_generate_signature_batch(hsm_hdl_t signature_gen_hdl,
+				       op_generate_sign_args_t *ops,
+				       uint32_t nb_ops,
+				       hsm_err_t *results);
+
 typedef uint8_t hsm_op_prepare_signature_flags_t;
 typedef struct {
 	//!< identifier of the digital signature scheme to be used
@@ -230,6 +254,75 @@ hsm_err_t hsm_prepare_signature(hsm_hdl_t signature_gen_hdl,
 #define HSM_OP_PREPARE_SIGN_COMPRESSED_POINT \
 				((hsm_op_prepare_signature_flags_t)(1u << 1))
 
+#ifndef PSA_COMPLIANT
+/**
+ * Number of pre-calculated values the HSM stores per signature generation
+ * service flow.
+ */
+#define HSM_PREPARED_SIGN_MAX		(20u)
+
+typedef struct {
+	//!< signatures generated with a pre-calculated value of the pool.
+	uint64_t hits;
+	//!< signatures generated without, none being ready.
+	uint64_t misses;
+	//!< pre-calculated values made by the pool.
+	uint64_t prepared;
+	//!< pre-calculated values ready.
+	uint32_t ready;
+	//!< depth of the pool.
+	uint32_t depth;
+} hsm_sign_pool_stats_t;
+
+/**
+ * Set the depth of the pool of pre-calculated values kept by the library
+ * for a signature scheme of a signature generation service flow.\n
+ * A worker thread of low priority calls hsm_prepare_signature() to keep
+ * depth values ready, when no signature is being generated. Then
+ * hsm_generate_signature() sets HSM_OP_GENERATE_SIGN_FLAGS_LOW_LATENCY_SIGNATURE
+ * by itself when a value of the scheme is ready, and the input and
+ * compressed point flags of the call match flags. Calls already setting
+ * HSM_OP_GENERATE_SIGN_FLAGS_LOW_LATENCY_SIGNATURE are not served by the
+ * pool.
+ *
+ * The pools of a service flow are dropped when it or its session is
+ * closed. Values made by the application with hsm_prepare_signature() are
+ * not counted.
+ *
+ * \param signature_gen_hdl: handle identifying the signature generation
+ *                           service flow.
+ * \param scheme_id: signature scheme of the pre-calculated values.
+ * \param flags: flags of the preparation, see hsm_prepare_signature().
+ * \param depth: number of values to keep ready, 0 to drop the pool. The
+ *               depths of the pools of a service flow add up to at most
+ *               \ref HSM_PREPARED_SIGN_MAX.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_set_sign_pool(hsm_hdl_t signature_gen_hdl,
+			    hsm_signature_scheme_id_t scheme_id,
+			    hsm_op_prepare_signature_flags_t flags,
+			    uint32_t depth);
+
+/**
+ * Get the counters of the pool of a signature scheme of a signature
+ * generation service flow, see hsm_set_sign_pool().
+ *
+ * \param signature_gen_hdl: handle identifying the signature generation
+ *                           service flow.
+ * \param scheme_id: signature scheme of the pool.
+ * \param stats: pointer to where the counters must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_get_sign_pool_stats(hsm_hdl_t signature_gen_hdl,
+				  hsm_signature_scheme_id_t scheme_id,
+				  hsm_sign_pool_stats_t *stats);
+
+/* Library internal: drop the pools of the services of a session being closed. */
+void sign_pool_close_session(hsm_hdl_t session_hdl);
+#endif
+
 /**
  *\addtogroup qxp_specific
  * \ref group5
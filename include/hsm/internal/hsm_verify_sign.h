@@ -121,6 +121,100 @@ hsm_err_t hsm_verify_signature(hsm_hdl_t signature_ver_hdl,
 			       op_verify_sign_args_t *args,
 			       hsm_verification_status_t *status);
 
+/**
+ * Verify several digital signatures with one call, for instance all the
+ * messages received in a time window. Each element of ops is handled as by
+ * hsm_verify_signature(), but the commands are built and sent to the HSM
+ * while the previous ones are processed, as many as the MU holds, and the
+ * inputs of each one are copied in a single data buffer. The ELE and SECO
+ * MUs hold one command: there the signatures are verified one after the
+ * other and the batch only saves the per-call overhead of the library.
+ *
+ * \param signature_ver_hdl: handle identifying the signature
+ *                           verification service flow.
+ * \param ops: array of nb_ops structures containing the function arguments.
+ * \param nb_ops: number of signatures to verify.
+ * \param status: array of nb_ops verification status, the value
+ *                HSM_VERIFICATION_STATUS_SUCCESS is stored for each
+ *                signature that is valid.
+ *
+ * \return HSM_NO_ERROR if all the verifications were performed, otherwise
+ *         the error code of one that failed.
+ */
+hsm_err_t hsm_verify_signature_batch(hsm_hdl_t signature_ver_hdl,
+				     op_verify_sign_args_t *ops,
+				     uint32_t nb_ops,
+				     hsm_verification_status_t *status);
+
+//!< Largest public key whose reference is kept by the key reference cache.
+#define HSM_KEY_REF_CACHE_KEY_MAX	132u
+
+typedef struct {
+	//!< verifications sent with the reference of an imported key.
+	uint64_t hits;
+	//!< keys imported for a verification.
+	uint64_t misses;
+	//!< references dropped to import other keys.
+	uint64_t evictions;
+	//!< times the imported keys were released to free slots.
+	uint64_t recycles;
+	//!< times all the references were dropped after a key import or
+	//   deletion on the session.
+	uint64_t invalidations;
+	//!< number of keys the cache imports at most.
+	uint32_t slots;
+	//!< number of keys currently imported.
+	uint32_t used;
+} hsm_key_ref_cache_stats_t;
+
+/**
+ * Keep the public keys used by the verifications of a service flow
+ * imported in the enclave.\n
+ * Once enabled, hsm_verify_signature() looks up the public key of each call
+ * not setting HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL: a key seen before is
+ * replaced by the reference returned by hsm_import_public_key(), a new one
+ * is imported first. The keys are imported on a signature verification
+ * service flow of the cache, opened on the session of the service: on a
+ * channel group, the verifications served by the cache stay on the MU of
+ * the session priority.\n
+ * Imported keys cannot be released one by one: when nb_slots keys are
+ * imported, or the enclave has no slot left, the cache closes its service
+ * flow once the verifications using it are done and imports again the most
+ * recently used half of the keys in a new one, the other half is evicted.
+ * All the references are dropped the same way after a key is imported or
+ * deleted on the session of the service.\n
+ * The number of slots is set by the first call enabling the cache: a later
+ * call can only enable it again with the same number. Disabling the cache
+ * releases its keys, its counters restart when it is enabled again. The
+ * memory of the cache is released with the service flow or its session.
+ * Keys larger than HSM_KEY_REF_CACHE_KEY_MAX and hsm_verify_signature_batch()
+ * are not served by the cache.
+ *
+ * \param signature_ver_hdl: handle identifying the signature
+ *                           verification service flow.
+ * \param nb_slots: number of keys imported at most, 0 to disable the cache.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_set_key_ref_cache(hsm_hdl_t signature_ver_hdl,
+				uint32_t nb_slots);
+
+/**
+ * Get the counters of the key reference cache of a service flow, see
+ * hsm_set_key_ref_cache().
+ *
+ * \param signature_ver_hdl: handle identifying the signature
+ *                           verification service flow.
+ * \param stats: pointer to where the counters must be written.
+ *
+ * \return error code
+ */
+hsm_err_t hsm_get_key_ref_cache_stats(hsm_hdl_t signature_ver_hdl,
+				      hsm_key_ref_cache_stats_t *stats);
+
+/* Library internal: drop the caches of the services of a session being closed. */
+void key_ref_close_session(hsm_hdl_t session_hdl);
+
 #define HSM_OP_VERIFY_SIGN_FLAGS_INPUT_DIGEST \
 				((hsm_op_verify_sign_flags_t)(0u << 0))
 
@@ -29,12 +29,58 @@ void nvm_close_session(void);
 #define NVM_FLAGS_V2X    (0x02u)
 #define NVM_FLAGS_SHE    (0x01u)
 #define NVM_FLAGS_HSM    (0x00u)
+/**
+ * Fast start up, combined with the flags above: the master blob is read
+ * with one mapping of the storage and the chunks, the most recently written
+ * first, are read in the chunk cache by a thread of the library while the
+ * master is imported and the enclave served.
+ */
+#define NVM_FLAGS_PREFETCH  (0x80u)
 
 #define NVM_STATUS_UNDEF    (0x00u)
 #define NVM_STATUS_STARTING (0x01u)
 #define NVM_STATUS_RUNNING  (0x02u)
 #define NVM_STATUS_STOPPED  (0x03u)
 
+/**
+ * Serve the storage of several NVM channels from the calling thread, one
+ * channel per entry of flags (NVM_FLAGS_* combination, each at most once).
+ * The channels are polled in one event loop and share the chunk cache.
+ * The platform must be able to poll its MU channels, see
+ * plat_os_abs_mu_poll_fd().
+ *
+ * nvm_service() and nvm_manager() must not run at the same time.
+ *
+ * \param flags NVM flags of each channel.
+ * \param nb number of channels, up to 4.
+ *
+ * Return once stopped by nvm_service_stop(), or if a channel cannot be
+ * opened at start up.
+ */
+void nvm_service(const uint8_t *flags, uint32_t nb);
+
+/**
+ * Wait until nvm_manager() or nvm_service() serves the enclave, its master
+ * blobs imported, or has stopped. Replaces the polling of the status word
+ * of nvm_manager().
+ *
+ * \param timeout_ms maximum time to wait in milliseconds.
+ *
+ * \return NVM_STATUS_RUNNING when ready, NVM_STATUS_STOPPED if it failed to
+ *         start (or was stopped), NVM_STATUS_UNDEF or NVM_STATUS_STARTING
+ *         on timeout.
+ */
+uint32_t nvm_wait_ready(uint32_t timeout_ms);
+
+/**
+ * Make a starting or running nvm_service() close its channels and wait
+ * until it is done, the calling thread can then be joined.
+ * It must also be called after a failed start, before starting again.
+ * nvm_manager() is stopped by cancelling its thread then calling
+ * nvm_close_session().
+ */
+void nvm_service_stop(void);
+
 /**
  * \}
  */
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "crc32.h"
+
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1u << 7)
+#endif
+#elif defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * The CRC of the NVM blobs is checked at each import and computed at each
+ * export, over the whole master blob at boot. Slice-by-8 tables are the
+ * fallback, the CRC32 instructions of ARMv8 or carry-less multiplication
+ * folding on x86 are used when the CPU has them.
+ * Note the SSE4.2 crc32 instruction is of no use: its polynomial is
+ * Castagnoli, not the IEEE one of the blobs.
+ */
+
+#define CRC32_POLY  0xEDB88320u
+
+typedef uint32_t (*crc32_fn_t)(uint32_t crc, const uint8_t *data, uint32_t size);
+
+static uint32_t crc32_table[8][256];
+static crc32_fn_t crc32_impl;
+static const char *crc32_name;
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static void crc32_table_init(void)
+{
+    uint32_t i, k, c;
+
+    for (i = 0u; i < 256u; i++) {
+        c = i;
+        for (k = 0u; k < 8u; k++) {
+            c = ((c & 1u) != 0u) ? ((c >> 1) ^ CRC32_POLY) : (c >> 1);
+        }
+        crc32_table[0][i] = c;
+    }
+    for (i = 0u; i < 256u; i++) {
+        for (k = 1u; k < 8u; k++) {
+            crc32_table[k][i] = (crc32_table[k - 1u][i] >> 8)
+                                ^ crc32_table[0][crc32_table[k - 1u][i] & 0xFFu];
+        }
+    }
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    uint32_t lo, hi;
+
+    while (size >= 8u) {
+        lo = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8)
+                    | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+        hi = (uint32_t)data[4] | ((uint32_t)data[5] << 8)
+             | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+        crc = crc32_table[7][lo & 0xFFu] ^ crc32_table[6][(lo >> 8) & 0xFFu]
+              ^ crc32_table[5][(lo >> 16) & 0xFFu] ^ crc32_table[4][lo >> 24]
+              ^ crc32_table[3][hi & 0xFFu] ^ crc32_table[2][(hi >> 8) & 0xFFu]
+              ^ crc32_table[1][(hi >> 16) & 0xFFu] ^ crc32_table[0][hi >> 24];
+        data += 8;
+        size -= 8u;
+    }
+    while (size > 0u) {
+        crc = crc32_table[0][(crc ^ *data) & 0xFFu] ^ (crc >> 8);
+        data++;
+        size--;
+    }
+
+    return crc;
+}
+
+#if defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    uint64_t v;
+
+    while ((size > 0u) && (((uintptr_t)data & 7u) != 0u)) {
+        crc = __crc32b(crc, *data);
+        data++;
+        size--;
+    }
+    while (size >= 8u) {
+        memcpy(&v, data, sizeof(v));
+        crc = __crc32d(crc, v);
+        data += 8;
+        size -= 8u;
+    }
+    while (size > 0u) {
+        crc = __crc32b(crc, *data);
+        data++;
+        size--;
+    }
+
+    return crc;
+}
+#elif defined(__x86_64__)
+/*
+ * Fold 64 then 16 bytes at a time with carry-less multiplications and
+ * Barrett reduce the last 128 bits, as in "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (Intel), bit reflected constants.
+ * size must be a multiple of 16, at least 64.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_clmul_blocks(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    data += 64;
+    size -= 64u;
+
+    /* Four lanes of 128 bits. */
+    while (size >= 64u) {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((const __m128i *)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                           _mm_loadu_si128((const __m128i *)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                           _mm_loadu_si128((const __m128i *)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                           _mm_loadu_si128((const __m128i *)(data + 0x30)));
+        data += 64;
+        size -= 64u;
+    }
+
+    /* Fold the lanes into one. */
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (size >= 16u) {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((const __m128i *)data));
+        data += 16;
+        size -= 16u;
+    }
+
+    /* 128 to 64 bits. */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits. */
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    uint32_t n = size & ~15u;
+
+    if (n >= 64u) {
+        crc = crc32_clmul_blocks(crc, data, n);
+        data += n;
+        size -= n;
+    }
+
+    return crc32_slice8(crc, data, size);
+}
+#endif
+
+static void crc32_select(void)
+{
+    crc32_table_init();
+    crc32_impl = crc32_slice8;
+    crc32_name = "slice-by-8";
+
+#if defined(__aarch64__)
+    if ((getauxval(AT_HWCAP) & HWCAP_CRC32) != 0u) {
+        crc32_impl = crc32_armv8;
+        crc32_name = "armv8-crc32";
+    }
+#elif defined(__x86_64__)
+    __builtin_cpu_init();
+    if ((__builtin_cpu_supports("pclmul") != 0)
+        && (__builtin_cpu_supports("sse4.1") != 0)) {
+        crc32_impl = crc32_clmul;
+        crc32_name = "pclmul";
+    }
+#endif
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    (void)pthread_once(&crc32_once, crc32_select);
+
+    return crc32_impl(crc, data, size);
+}
+
+uint32_t crc32_update_sw(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    (void)pthread_once(&crc32_once, crc32_select);
+
+    return crc32_slice8(crc, data, size);
+}
+
+const char *crc32_impl_name(void)
+{
+    (void)pthread_once(&crc32_once, crc32_select);
+
+    return crc32_name;
+}
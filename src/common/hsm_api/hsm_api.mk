@@ -14,6 +14,10 @@ HSM_API_SRC	+= \
 		$(PLAT_COMMON_PATH)/hsm_api/hsm_handle.o \
 		$(PLAT_COMMON_PATH)/hsm_api/hsm_utils.o \
 		$(PLAT_COMMON_PATH)/hsm_api/hsm_key.o \
+		$(PLAT_COMMON_PATH)/hsm_api/hsm_async.o \
+		$(PLAT_COMMON_PATH)/hsm_api/hsm_buf.o \
+		$(PLAT_COMMON_PATH)/hsm_api/hsm_perf.o \
+		$(PLAT_COMMON_PATH)/hsm_api/hsm_pub_key_cache.o \
 
 ifneq (${MT_SAB_CIPHER},0x0)
 DEFINES		+=	-DHSM_CIPHER
@@ -75,6 +79,12 @@ HSM_API_SRC	+= \
 		$(PLAT_COMMON_PATH)/hsm_api/hsm_managekey.o
 endif
 
+ifneq (${MT_SAB_BUTTERFLY},0x0)
+DEFINES		+=	-DHSM_BUTTERFLY
+HSM_API_SRC	+= \
+		$(PLAT_COMMON_PATH)/hsm_api/hsm_butterfly.o
+endif
+
 ifneq (${MT_SAB_DEBUG_DUMP},0x0)
 DEFINES		+=	-DHSM_DEBUG_DUMP
 HSM_API_SRC	+= \
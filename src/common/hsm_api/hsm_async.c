@@ -0,0 +1,270 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "internal/hsm_handle.h"
+#include "internal/hsm_utils.h"
+#include "internal/hsm_key.h"
+#include "internal/hsm_async.h"
+#include "internal/hsm_verify_sign.h"
+
+#include "sab_process_msg.h"
+#include "sab_queue.h"
+
+#include "plat_utils.h"
+#include "plat_os_abs.h"
+
+struct hsm_async_cb_ctx {
+	hsm_async_cb_t callback;
+	void *cb_arg;
+};
+
+static hsm_err_t op_err_from_sab(uint32_t error, uint32_t rsp_code)
+{
+	return (error != 0u) ? HSM_GENERAL_ERROR
+			     : sab_rating_to_hsm_err(rsp_code);
+}
+
+static void hsm_async_completion(uint32_t ticket, uint32_t error,
+				 uint32_t rsp_code, void *cb_arg)
+{
+	struct hsm_async_cb_ctx *cb_ctx = (struct hsm_async_cb_ctx *)cb_arg;
+
+	cb_ctx->callback((hsm_ticket_t)ticket,
+			 op_err_from_sab(error, rsp_code),
+			 cb_ctx->cb_arg);
+	free(cb_ctx);
+}
+
+/* Get the message ID and type of an operation. Return 0 on success. */
+static int32_t get_op_msg(hsm_async_op_t *op, uint8_t *msg_id,
+			  msg_type_t *msg_type)
+{
+	int32_t ret = 0;
+
+	switch (op->op_type) {
+#ifdef HSM_SIGN_GEN
+	case HSM_ASYNC_OP_GENERATE_SIGN:
+		*msg_id = SAB_SIGNATURE_GENERATE_REQ;
+		*msg_type = MT_SAB_SIGN_GEN;
+		break;
+	case HSM_ASYNC_OP_PREPARE_SIGN:
+		*msg_id = SAB_SIGNATURE_PREPARE_REQ;
+		*msg_type = MT_SAB_SIGN_GEN;
+		break;
+#endif
+#ifdef HSM_VERIFY_SIGN
+	case HSM_ASYNC_OP_VERIFY_SIGN:
+		*msg_id = SAB_SIGNATURE_VERIFY_REQ;
+		*msg_type = MT_SAB_VERIFY_SIGN;
+		break;
+#endif
+#ifdef HSM_HASH_GEN
+	case HSM_ASYNC_OP_HASH_ONE_GO:
+		*msg_id = SAB_HASH_ONE_GO_REQ;
+		*msg_type = MT_SAB_HASH_GEN;
+		break;
+#endif
+#ifdef HSM_CIPHER
+	case HSM_ASYNC_OP_CIPHER_ONE_GO:
+		*msg_id = SAB_CIPHER_ONE_GO_REQ;
+		*msg_type = MT_SAB_CIPHER;
+		break;
+#endif
+#ifdef HSM_MAC
+	case HSM_ASYNC_OP_MAC_ONE_GO:
+		*msg_id = SAB_MAC_ONE_GO_REQ;
+		*msg_type = MT_SAB_MAC;
+		break;
+#endif
+	default:
+		ret = -1;
+		break;
+	}
+
+	return ret;
+}
+
+hsm_err_t hsm_async_enable(hsm_hdl_t session_hdl, int32_t *event_fd)
+{
+	struct hsm_session_hdl_s *sess_ptr;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+
+	do {
+		sess_ptr = session_hdl_to_ptr(session_hdl);
+		if (sess_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		if (sab_queue_async_start(sess_ptr->phdl, event_fd) != 0u) {
+			printf("HSM Error: cannot enable async mode on session [0x%x].\n",
+				session_hdl);
+			break;
+		}
+		err = HSM_NO_ERROR;
+	} while (false);
+
+	return err;
+}
+
+hsm_err_t hsm_async_disable(hsm_hdl_t session_hdl)
+{
+	struct hsm_session_hdl_s *sess_ptr;
+	hsm_err_t err = HSM_UNKNOWN_HANDLE;
+
+	sess_ptr = session_hdl_to_ptr(session_hdl);
+	if (sess_ptr != NULL) {
+		sab_queue_async_stop(sess_ptr->phdl);
+		err = HSM_NO_ERROR;
+	}
+
+	return err;
+}
+
+hsm_err_t hsm_submit(hsm_async_op_t *op, hsm_ticket_t *ticket)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct hsm_async_cb_ctx *cb_ctx = NULL;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	uint32_t error;
+	uint8_t msg_id;
+	msg_type_t msg_type;
+
+	do {
+		if ((op == NULL) || (op->args == NULL) || (ticket == NULL)) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+
+		serv_ptr = service_hdl_to_ptr(op->service_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		if (get_op_msg(op, &msg_id, &msg_type) != 0) {
+			err = HSM_FEATURE_NOT_SUPPORTED;
+			break;
+		}
+
+#if defined(PSA_COMPLIANT) && defined(HSM_VERIFY_SIGN)
+		if (op->op_type == HSM_ASYNC_OP_VERIFY_SIGN) {
+			op_verify_sign_args_t *args = op->args;
+
+			if (set_key_type_n_sz(args->key_type,
+					      &args->key_sz,
+					      &args->psa_key_type,
+					      NULL)) {
+				printf("HSM Error: Invalid Key Type is given [0x%x].\n",
+					args->key_type);
+				err = HSM_INVALID_PARAM;
+				break;
+			}
+		}
+#endif
+
+		if (op->callback != NULL) {
+			cb_ctx = malloc(sizeof(struct hsm_async_cb_ctx));
+			if (cb_ctx == NULL) {
+				err = HSM_OUT_OF_MEMORY;
+				break;
+			}
+			cb_ctx->callback = op->callback;
+			cb_ctx->cb_arg = op->cb_arg;
+		}
+
+		error = sab_queue_submit(serv_ptr->session->phdl,
+					 serv_ptr->session->mu_type,
+					 msg_id,
+					 msg_type,
+					 (uint32_t)op->service_hdl,
+					 op->args,
+					 (cb_ctx != NULL) ? hsm_async_completion
+							  : NULL,
+					 cb_ctx,
+					 ticket);
+		if (error == SAB_NOT_READY_RATING) {
+			err = HSM_NOT_READY_RATING;
+		} else if (error == SAB_INVALID_MESSAGE_RATING) {
+			/* Session not in asynchronous mode. */
+			err = HSM_INVALID_PARAM;
+		} else if (error != 0u) {
+			printf("SAB Send Err[0x%x]: async msg id [0x%x].\n",
+				error, msg_id);
+		} else {
+			err = HSM_NO_ERROR;
+		}
+	} while (false);
+
+	if ((err != HSM_NO_ERROR) && (cb_ctx != NULL)) {
+		free(cb_ctx);
+	}
+
+	return err;
+}
+
+static hsm_err_t hsm_collect(hsm_hdl_t session_hdl, hsm_ticket_t ticket,
+			     bool block, hsm_err_t *op_err)
+{
+	struct hsm_session_hdl_s *sess_ptr;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	uint32_t error = 0u;
+	uint32_t rsp_code = 0u;
+	uint32_t ret;
+
+	do {
+		if (op_err == NULL) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+
+		sess_ptr = session_hdl_to_ptr(session_hdl);
+		if (sess_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		ret = sab_queue_wait(sess_ptr->phdl, (uint32_t)ticket, block,
+				     &error, &rsp_code);
+		if (ret == SAB_NOT_READY_RATING) {
+			err = HSM_NOT_READY_RATING;
+			break;
+		}
+		if (ret != 0u) {
+			/* Unknown ticket or session not in asynchronous mode. */
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+
+		*op_err = op_err_from_sab(error, rsp_code);
+		err = HSM_NO_ERROR;
+	} while (false);
+
+	return err;
+}
+
+hsm_err_t hsm_wait(hsm_hdl_t session_hdl, hsm_ticket_t ticket,
+		   hsm_err_t *op_err)
+{
+	return hsm_collect(session_hdl, ticket, true, op_err);
+}
+
+hsm_err_t hsm_poll(hsm_hdl_t session_hdl, hsm_ticket_t ticket,
+		   hsm_err_t *op_err)
+{
+	return hsm_collect(session_hdl, ticket, false, op_err);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdint.h>
+
+#include "internal/hsm_handle.h"
+#include "internal/hsm_buf.h"
+
+#include "sab_buf.h"
+
+void *hsm_buf_alloc(hsm_hdl_t session_hdl, uint32_t size)
+{
+	struct hsm_session_hdl_s *sess_ptr;
+	void *buf = NULL;
+
+	sess_ptr = session_hdl_to_ptr(session_hdl);
+	if (sess_ptr != NULL) {
+		buf = sab_buf_alloc(sess_ptr->phdl, size);
+	}
+
+	return buf;
+}
+
+void hsm_buf_free(hsm_hdl_t session_hdl, void *buf)
+{
+	struct hsm_session_hdl_s *sess_ptr;
+
+	/* Buffers of a closed session are already released. */
+	sess_ptr = session_hdl_to_ptr(session_hdl);
+	if ((sess_ptr != NULL) && (buf != NULL)) {
+		(void)sab_buf_free(sess_ptr->phdl, buf);
+	}
+}
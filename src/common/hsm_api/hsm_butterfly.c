@@ -0,0 +1,363 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hsm_api.h"
+
+#include "sab_buf.h"
+#include "sab_process_msg.h"
+#include "sab_queue.h"
+
+/*
+ * Batches of butterfly key expansions. The expansions are sent in parts of
+ * up to BUTT_BATCH_MAX through sab_queue_send_batch(). The values of a part
+ * are staged in one buffer of the pool of the channel, which the enclave
+ * reaches without a data buffer per value when the platform maps it.
+ */
+#define BUTT_BATCH_MAX		256u
+
+struct butt_batch {
+	struct plat_os_abs_hdl *phdl;
+	/* Name of the message, for the error traces. */
+	const char *msg;
+	/* Buffer of the pool staging the values of a part, NULL if none. */
+	uint8_t *stage;
+	uint8_t *pos;
+	hsm_err_t *results;
+	/* Index of the first expansion of the part sent. */
+	uint32_t base;
+	hsm_err_t err;
+};
+
+static void butt_batch_init(struct butt_batch *b,
+			    struct plat_os_abs_hdl *phdl,
+			    const char *msg,
+			    hsm_err_t *results,
+			    uint32_t stage_sz)
+{
+	uint64_t addr;
+
+	b->phdl = phdl;
+	b->msg = msg;
+	b->stage = NULL;
+	b->results = results;
+	b->base = 0u;
+	b->err = HSM_NO_ERROR;
+
+	if (stage_sz > 0u) {
+		b->stage = sab_buf_alloc(phdl, stage_sz);
+	}
+	/* Staging is a plain copy when the pool is not mapped. */
+	if ((b->stage != NULL)
+		&& (sab_buf_addr(phdl, b->stage, stage_sz, &addr) != 0u)) {
+		(void)sab_buf_free(phdl, b->stage);
+		b->stage = NULL;
+	}
+	b->pos = b->stage;
+}
+
+static void butt_batch_end(struct butt_batch *b)
+{
+	if (b->stage != NULL) {
+		(void)sab_buf_free(b->phdl, b->stage);
+		b->stage = NULL;
+	}
+}
+
+/* Element idx of an array of values of size bytes, NULL if none. */
+static uint8_t *butt_elem(uint8_t *values, uint32_t idx, uint32_t size)
+{
+	return (values != NULL) ? (values + (idx * size)) : NULL;
+}
+
+/* Where the enclave reads size bytes at src: their copy in the stage. */
+static uint8_t *butt_stage_in(struct butt_batch *b, uint8_t *src,
+			      uint32_t size)
+{
+	uint8_t *dst = b->pos;
+
+	if ((dst == NULL) || (src == NULL) || (size == 0u)) {
+		return src;
+	}
+	memcpy(dst, src, size);
+	b->pos += size;
+
+	return dst;
+}
+
+/* Where the enclave writes size bytes for dst: a place in the stage. */
+static uint8_t *butt_stage_out(struct butt_batch *b, uint8_t *dst,
+			       uint32_t size)
+{
+	uint8_t *out = b->pos;
+
+	if ((out == NULL) || (dst == NULL) || (size == 0u)) {
+		return dst;
+	}
+	b->pos += size;
+
+	return out;
+}
+
+static void butt_batch_done(uint32_t idx, uint32_t error, uint32_t rsp_code,
+			    void *cb_arg)
+{
+	struct butt_batch *b = (struct butt_batch *)cb_arg;
+	hsm_err_t err;
+
+	if (rsp_code || (error != 0))
+		printf("%s[%u]: SAB FW Error[0x%x]:"\
+			"SAB Engine Error[0x%x]\n", b->msg, b->base + idx,
+			rsp_code, error);
+
+	err = (error != 0u) ? HSM_GENERAL_ERROR
+			    : sab_rating_to_hsm_err(rsp_code);
+	if (b->results != NULL) {
+		b->results[b->base + idx] = err;
+	}
+	if ((b->err == HSM_NO_ERROR) && (err != HSM_NO_ERROR)) {
+		b->err = err;
+	}
+}
+
+hsm_err_t hsm_butterfly_key_expansion_batch(hsm_hdl_t key_management_hdl,
+					    op_butt_key_exp_batch_args_t *args,
+					    uint32_t nb_ops,
+					    hsm_err_t *results)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	op_butt_key_exp_args_t *ops = NULL;
+	struct butt_batch b;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	uint32_t nb, i, j;
+	uint32_t error;
+
+	b.stage = NULL;
+	do {
+		if ((args == NULL) || (args->dest_key_identifiers == NULL)
+			|| (nb_ops == 0u)
+			|| ((args->output == NULL) && (args->output_size != 0u))) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		serv_ptr = service_hdl_to_ptr(key_management_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		nb = (nb_ops < BUTT_BATCH_MAX) ? nb_ops : BUTT_BATCH_MAX;
+		ops = malloc(nb * sizeof(op_butt_key_exp_args_t));
+		if (ops == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
+		butt_batch_init(&b, serv_ptr->session->phdl,
+				"SAB_BUT_KEY_EXP_REQ", results,
+				nb * ((uint32_t)args->expansion_function_value_size
+				      + args->hash_value_size
+				      + args->pr_reconstruction_value_size
+				      + args->output_size));
+
+		for (; b.base < nb_ops; b.base += nb) {
+			if (nb > (nb_ops - b.base)) {
+				nb = nb_ops - b.base;
+			}
+			b.pos = b.stage;
+			for (i = 0u; i < nb; i++) {
+				j = b.base + i;
+				ops[i].key_identifier = args->key_identifier;
+				ops[i].expansion_function_value = butt_stage_in(&b,
+					butt_elem(args->expansion_function_values, j,
+						  args->expansion_function_value_size),
+					args->expansion_function_value_size);
+				ops[i].hash_value = butt_stage_in(&b,
+					butt_elem(args->hash_values, j,
+						  args->hash_value_size),
+					args->hash_value_size);
+				ops[i].pr_reconstruction_value = butt_stage_in(&b,
+					butt_elem(args->pr_reconstruction_values, j,
+						  args->pr_reconstruction_value_size),
+					args->pr_reconstruction_value_size);
+				ops[i].expansion_function_value_size =
+					args->expansion_function_value_size;
+				ops[i].hash_value_size = args->hash_value_size;
+				ops[i].pr_reconstruction_value_size =
+					args->pr_reconstruction_value_size;
+				ops[i].flags = args->flags;
+				ops[i].dest_key_identifier =
+					&args->dest_key_identifiers[j];
+				ops[i].output = butt_stage_out(&b,
+					butt_elem(args->output, j,
+						  args->output_size),
+					args->output_size);
+				ops[i].output_size = args->output_size;
+				ops[i].key_type = args->key_type;
+				ops[i].reserved = 0u;
+				ops[i].key_group = args->key_group;
+				ops[i].key_info = args->key_info;
+			}
+
+			error = sab_queue_send_batch(serv_ptr->session->phdl,
+						     serv_ptr->session->mu_type,
+						     SAB_BUT_KEY_EXP_REQ,
+						     MT_SAB_BUTTERFLY,
+						     (uint32_t)key_management_hdl,
+						     ops,
+						     (uint32_t)sizeof(op_butt_key_exp_args_t),
+						     nb,
+						     butt_batch_done,
+						     &b);
+			if (error != 0u) {
+				b.err = sab_rating_to_hsm_err(error);
+				break;
+			}
+
+			for (i = 0u; (b.stage != NULL) && (i < nb); i++) {
+				j = b.base + i;
+				if (ops[i].output != butt_elem(args->output, j,
+							       args->output_size)) {
+					memcpy(butt_elem(args->output, j,
+							 args->output_size),
+					       ops[i].output, args->output_size);
+				}
+			}
+		}
+		err = b.err;
+	} while (false);
+
+	butt_batch_end(&b);
+	free(ops);
+
+	return err;
+}
+
+hsm_err_t hsm_standalone_butterfly_key_expansion_batch(hsm_hdl_t key_management_hdl,
+						       op_st_butt_key_exp_batch_args_t *args,
+						       uint32_t nb_ops,
+						       hsm_err_t *results)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	op_st_butt_key_exp_args_t *ops = NULL;
+	struct butt_batch b;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	uint32_t nb, i, j;
+	uint32_t error;
+
+	b.stage = NULL;
+	do {
+		if ((args == NULL) || (args->dest_key_identifiers == NULL)
+			|| (nb_ops == 0u)
+			|| ((args->output == NULL) && (args->output_size != 0u))) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		serv_ptr = service_hdl_to_ptr(key_management_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		nb = (nb_ops < BUTT_BATCH_MAX) ? nb_ops : BUTT_BATCH_MAX;
+		ops = malloc(nb * sizeof(op_st_butt_key_exp_args_t));
+		if (ops == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
+		butt_batch_init(&b, serv_ptr->session->phdl,
+				"SAB_ST_BUT_KEY_EXP_REQ", results,
+				nb * ((uint32_t)args->expansion_fct_input_size
+				      + args->hash_value_size
+				      + args->pr_reconstruction_value_size
+				      + args->output_size));
+
+		for (; b.base < nb_ops; b.base += nb) {
+			if (nb > (nb_ops - b.base)) {
+				nb = nb_ops - b.base;
+			}
+			b.pos = b.stage;
+			for (i = 0u; i < nb; i++) {
+				j = b.base + i;
+				ops[i].key_identifier = args->key_identifier;
+				ops[i].expansion_fct_key_identifier =
+					args->expansion_fct_key_identifier;
+				ops[i].expansion_fct_input = butt_stage_in(&b,
+					butt_elem(args->expansion_fct_inputs, j,
+						  args->expansion_fct_input_size),
+					args->expansion_fct_input_size);
+				ops[i].hash_value = butt_stage_in(&b,
+					butt_elem(args->hash_values, j,
+						  args->hash_value_size),
+					args->hash_value_size);
+				ops[i].pr_reconstruction_value = butt_stage_in(&b,
+					butt_elem(args->pr_reconstruction_values, j,
+						  args->pr_reconstruction_value_size),
+					args->pr_reconstruction_value_size);
+				ops[i].expansion_fct_input_size =
+					args->expansion_fct_input_size;
+				ops[i].hash_value_size = args->hash_value_size;
+				ops[i].pr_reconstruction_value_size =
+					args->pr_reconstruction_value_size;
+				ops[i].flags = args->flags;
+				ops[i].dest_key_identifier =
+					&args->dest_key_identifiers[j];
+				ops[i].output = butt_stage_out(&b,
+					butt_elem(args->output, j,
+						  args->output_size),
+					args->output_size);
+				ops[i].output_size = args->output_size;
+				ops[i].key_type = args->key_type;
+				ops[i].expansion_fct_algo = args->expansion_fct_algo;
+				ops[i].key_group = args->key_group;
+				ops[i].key_info = args->key_info;
+			}
+
+			error = sab_queue_send_batch(serv_ptr->session->phdl,
+						     serv_ptr->session->mu_type,
+						     SAB_ST_BUT_KEY_EXP_REQ,
+						     MT_SAB_BUTTERFLY,
+						     (uint32_t)key_management_hdl,
+						     ops,
+						     (uint32_t)sizeof(op_st_butt_key_exp_args_t),
+						     nb,
+						     butt_batch_done,
+						     &b);
+			if (error != 0u) {
+				b.err = sab_rating_to_hsm_err(error);
+				break;
+			}
+
+			for (i = 0u; (b.stage != NULL) && (i < nb); i++) {
+				j = b.base + i;
+				if (ops[i].output != butt_elem(args->output, j,
+							       args->output_size)) {
+					memcpy(butt_elem(args->output, j,
+							 args->output_size),
+					       ops[i].output, args->output_size);
+				}
+			}
+		}
+		err = b.err;
+	} while (false);
+
+	butt_batch_end(&b);
+	free(ops);
+
+	return err;
+}
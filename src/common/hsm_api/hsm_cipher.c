@@ -13,12 +13,16 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "internal/hsm_handle.h"
 #include "internal/hsm_utils.h"
 #include "internal/hsm_cipher.h"
 
+#include "sab_buf.h"
 #include "sab_process_msg.h"
+#include "sab_queue.h"
 
 hsm_err_t hsm_open_cipher_service(hsm_hdl_t key_store_hdl,
 				  open_svc_cipher_args_t *args,
@@ -58,6 +62,7 @@ hsm_err_t hsm_open_cipher_service(hsm_hdl_t key_store_hdl,
 			break;
 		}
 		cipher_serv_ptr->service_hdl = args->cipher_hdl;
+		register_service(cipher_serv_ptr);
 		*cipher_hdl = cipher_serv_ptr->service_hdl;
 	} while (false);
 
@@ -124,3 +129,401 @@ hsm_err_t hsm_cipher_one_go(hsm_hdl_t cipher_hdl, op_cipher_one_go_args_t *args)
 
 	return err;
 }
+
+#define CIPHER_BLOCK_SZ		16u
+/* Messages built at a time by hsm_cipher_update(). */
+#define CIPHER_STREAM_NB_MSG	16u
+/* Data of the messages built at a time, followed by their IVs. */
+#define CIPHER_STAGE_DATA_SZ	(CIPHER_STREAM_NB_MSG * HSM_CIPHER_ONE_GO_MAX_SZ)
+#define CIPHER_STAGE_SZ		(CIPHER_STAGE_DATA_SZ \
+				 + (CIPHER_STREAM_NB_MSG * CIPHER_BLOCK_SZ))
+
+enum cipher_stream_mode {
+	CIPHER_STREAM_ECB,
+	CIPHER_STREAM_CBC,
+	CIPHER_STREAM_CTR,
+	CIPHER_STREAM_NONE,
+};
+
+struct hsm_cipher_ctx_s {
+	hsm_hdl_t cipher_hdl;
+	uint32_t key_identifier;
+	hsm_op_cipher_one_go_algo_t algo;
+	hsm_op_cipher_one_go_flags_t flags;
+	enum cipher_stream_mode mode;
+	/* IV of the next message: last cipher text block or counter. */
+	uint8_t chain[CIPHER_BLOCK_SZ];
+	/* Input kept for the next call, less than a block. */
+	uint8_t part[CIPHER_BLOCK_SZ];
+	uint32_t part_len;
+	op_cipher_one_go_args_t msgs[CIPHER_STREAM_NB_MSG];
+	uint8_t ivs[CIPHER_STREAM_NB_MSG][CIPHER_BLOCK_SZ];
+	/*
+	 * Buffer of the session mapped for the enclave, NULL if the platform
+	 * maps none. The messages are ciphered there in place, so that their
+	 * data buffers need no setup.
+	 */
+	uint8_t *stage;
+	/* First error, returned by the next calls. */
+	hsm_err_t err;
+};
+
+static enum cipher_stream_mode cipher_stream_mode(hsm_op_cipher_one_go_algo_t algo)
+{
+	enum cipher_stream_mode mode;
+
+	switch (algo) {
+#ifdef PSA_COMPLIANT
+	case HSM_CIPHER_ONE_GO_ALGO_ECB:
+		mode = CIPHER_STREAM_ECB;
+		break;
+	case HSM_CIPHER_ONE_GO_ALGO_CBC:
+		mode = CIPHER_STREAM_CBC;
+		break;
+	case HSM_CIPHER_ONE_GO_ALGO_CTR:
+		mode = CIPHER_STREAM_CTR;
+		break;
+#else
+	case HSM_CIPHER_ONE_GO_ALGO_AES_ECB:
+	case HSM_CIPHER_ONE_GO_ALGO_SM4_ECB:
+		mode = CIPHER_STREAM_ECB;
+		break;
+	case HSM_CIPHER_ONE_GO_ALGO_AES_CBC:
+	case HSM_CIPHER_ONE_GO_ALGO_SM4_CBC:
+		mode = CIPHER_STREAM_CBC;
+		break;
+#endif
+	default:
+		mode = CIPHER_STREAM_NONE;
+		break;
+	}
+
+	return mode;
+}
+
+/* Big endian addition to the full counter block. */
+static void cipher_ctr_add(uint8_t *ctr, uint32_t nb_blocks)
+{
+	uint32_t carry = nb_blocks;
+	uint32_t i;
+
+	for (i = CIPHER_BLOCK_SZ; (i > 0u) && (carry != 0u); i--) {
+		carry += ctr[i - 1u];
+		ctr[i - 1u] = (uint8_t)carry;
+		carry >>= 8;
+	}
+}
+
+static void cipher_stream_done(uint32_t idx, uint32_t error,
+			       uint32_t rsp_code, void *cb_arg)
+{
+	struct hsm_cipher_ctx_s *ctx = (struct hsm_cipher_ctx_s *)cb_arg;
+	hsm_err_t err;
+
+	if (rsp_code || (error != 0))
+		printf("SAB_ONE_GO_CIPHER[%u]: SAB FW Error[0x%x]:"\
+			"SAB Engine Error[0x%x]\n", idx, rsp_code, error);
+
+	err = (error != 0u) ? HSM_GENERAL_ERROR
+			    : sab_rating_to_hsm_err(rsp_code);
+	if ((ctx->err == HSM_NO_ERROR) && (err != HSM_NO_ERROR)) {
+		ctx->err = err;
+	}
+}
+
+/*
+ * Cipher size bytes, a multiple of the block size except at the end of a
+ * CTR operation, in messages of HSM_CIPHER_ONE_GO_MAX_SZ bytes.
+ */
+static hsm_err_t cipher_stream(struct hsm_cipher_ctx_s *ctx,
+			       uint8_t *input, uint8_t *output, uint32_t size)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	op_cipher_one_go_args_t *msg;
+	bool cbc_enc = (ctx->mode == CIPHER_STREAM_CBC)
+		       && ((ctx->flags & HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT) != 0u);
+	uint8_t *stage = ctx->stage;
+	uint8_t *batch_out = output;
+	uint32_t nb, sz, off, error;
+	uint64_t addr;
+
+	serv_ptr = service_hdl_to_ptr(ctx->cipher_hdl);
+	if (serv_ptr == NULL) {
+		return HSM_UNKNOWN_HANDLE;
+	}
+
+	/* Buffers of the pool given by the caller need no copy. */
+	if ((stage != NULL)
+	    && (sab_buf_addr(serv_ptr->session->phdl, input, size, &addr) == 0u)
+	    && (sab_buf_addr(serv_ptr->session->phdl, output, size, &addr) == 0u)) {
+		stage = NULL;
+	}
+
+	while ((size > 0u) && (ctx->err == HSM_NO_ERROR)) {
+		batch_out = output;
+		off = 0u;
+		/* The IV of a CBC encryption comes from the previous output. */
+		for (nb = 0u; (nb < CIPHER_STREAM_NB_MSG) && (size > 0u)
+			      && (!cbc_enc || (nb == 0u)); nb++) {
+			sz = (size < HSM_CIPHER_ONE_GO_MAX_SZ)
+			     ? size : HSM_CIPHER_ONE_GO_MAX_SZ;
+			msg = &ctx->msgs[nb];
+			memset(msg, 0, sizeof(*msg));
+			msg->key_identifier = ctx->key_identifier;
+			msg->flags = ctx->flags;
+			msg->cipher_algo = ctx->algo;
+			msg->input = input;
+			msg->output = output;
+			msg->input_size = sz;
+			msg->output_size = sz;
+			if (stage != NULL) {
+				memcpy(stage + off, input, sz);
+				msg->input = stage + off;
+				msg->output = stage + off;
+			}
+			if (ctx->mode != CIPHER_STREAM_ECB) {
+				msg->iv = (stage != NULL)
+					  ? stage + CIPHER_STAGE_DATA_SZ
+					    + (nb * CIPHER_BLOCK_SZ)
+					  : ctx->ivs[nb];
+				memcpy(msg->iv, ctx->chain, CIPHER_BLOCK_SZ);
+				msg->iv_size = CIPHER_BLOCK_SZ;
+			}
+
+			/* Taken before an in place decryption overwrites it. */
+			if (ctx->mode == CIPHER_STREAM_CTR) {
+				cipher_ctr_add(ctx->chain, sz / CIPHER_BLOCK_SZ);
+			} else if ((ctx->mode == CIPHER_STREAM_CBC) && !cbc_enc) {
+				memcpy(ctx->chain, input + sz - CIPHER_BLOCK_SZ,
+				       CIPHER_BLOCK_SZ);
+			}
+
+			input += sz;
+			output += sz;
+			off += sz;
+			size -= sz;
+		}
+
+		error = sab_queue_send_batch(serv_ptr->session->phdl,
+					     serv_ptr->session->mu_type,
+					     SAB_CIPHER_ONE_GO_REQ,
+					     MT_SAB_CIPHER,
+					     (uint32_t)ctx->cipher_hdl,
+					     ctx->msgs,
+					     (uint32_t)sizeof(op_cipher_one_go_args_t),
+					     nb,
+					     cipher_stream_done,
+					     ctx);
+		if ((error != 0u) && (ctx->err == HSM_NO_ERROR)) {
+			ctx->err = sab_rating_to_hsm_err(error);
+		}
+		if (stage != NULL) {
+			memcpy(batch_out, stage, off);
+		}
+
+		if (cbc_enc) {
+			memcpy(ctx->chain, output - CIPHER_BLOCK_SZ,
+			       CIPHER_BLOCK_SZ);
+		}
+	}
+
+	return ctx->err;
+}
+
+/* Buffer of the session to stage the messages in, NULL if not mapped. */
+static uint8_t *cipher_stage_alloc(hsm_hdl_t cipher_hdl)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	uint8_t *stage = NULL;
+	uint64_t addr;
+
+	serv_ptr = service_hdl_to_ptr(cipher_hdl);
+	if (serv_ptr != NULL) {
+		stage = sab_buf_alloc(serv_ptr->session->phdl, CIPHER_STAGE_SZ);
+	}
+	/* Plain memory would only add copies to the data buffer setup. */
+	if ((stage != NULL)
+	    && (sab_buf_addr(serv_ptr->session->phdl, stage, CIPHER_STAGE_SZ,
+			     &addr) != 0u)) {
+		(void)sab_buf_free(serv_ptr->session->phdl, stage);
+		stage = NULL;
+	}
+
+	return stage;
+}
+
+static void cipher_stage_free(struct hsm_cipher_ctx_s *ctx)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+
+	/* Buffers of a closed session are already released. */
+	serv_ptr = service_hdl_to_ptr(ctx->cipher_hdl);
+	if ((serv_ptr != NULL) && (ctx->stage != NULL)) {
+		(void)sab_buf_free(serv_ptr->session->phdl, ctx->stage);
+	}
+}
+
+hsm_err_t hsm_cipher_init(hsm_hdl_t cipher_hdl,
+			  op_cipher_one_go_args_t *args,
+			  hsm_cipher_ctx_t **ctx)
+{
+	struct hsm_cipher_ctx_s *c;
+	enum cipher_stream_mode mode;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+
+	do {
+		if ((args == NULL) || (ctx == NULL)) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		if (service_hdl_to_ptr(cipher_hdl) == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		mode = cipher_stream_mode(args->cipher_algo);
+		if (mode == CIPHER_STREAM_NONE) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		if ((mode != CIPHER_STREAM_ECB)
+		    && ((args->iv == NULL)
+			|| (args->iv_size != CIPHER_BLOCK_SZ))) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+
+		c = calloc(1u, sizeof(struct hsm_cipher_ctx_s));
+		if (c == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
+		c->cipher_hdl = cipher_hdl;
+		c->stage = cipher_stage_alloc(cipher_hdl);
+		c->key_identifier = args->key_identifier;
+		c->algo = args->cipher_algo;
+		c->flags = args->flags;
+		c->mode = mode;
+		if (mode != CIPHER_STREAM_ECB) {
+			memcpy(c->chain, args->iv, CIPHER_BLOCK_SZ);
+		}
+		c->err = HSM_NO_ERROR;
+
+		*ctx = c;
+		err = HSM_NO_ERROR;
+	} while (false);
+
+	return err;
+}
+
+hsm_err_t hsm_cipher_update(hsm_cipher_ctx_t *ctx, uint8_t *input,
+			    uint8_t *output, uint32_t input_size,
+			    uint32_t *output_size)
+{
+	uint8_t tail[CIPHER_BLOCK_SZ];
+	uint32_t fill = 0u, len, rem, done = 0u;
+	uintptr_t in, out;
+	hsm_err_t err;
+
+	if ((ctx == NULL) || (output_size == NULL)
+	    || ((input == NULL) && (input_size != 0u))) {
+		return HSM_INVALID_PARAM;
+	}
+	if (ctx->err != HSM_NO_ERROR) {
+		return ctx->err;
+	}
+	if ((input_size > UINT32_MAX - ctx->part_len)
+	    || (*output_size < ((ctx->part_len + input_size)
+				& ~(CIPHER_BLOCK_SZ - 1u)))) {
+		return HSM_INVALID_PARAM;
+	}
+
+	/* Complete the block kept by the previous call. */
+	if (ctx->part_len != 0u) {
+		fill = CIPHER_BLOCK_SZ - ctx->part_len;
+		if (fill > input_size) {
+			fill = input_size;
+		}
+		memcpy(ctx->part + ctx->part_len, input, fill);
+		ctx->part_len += fill;
+		if (ctx->part_len == CIPHER_BLOCK_SZ) {
+			done = CIPHER_BLOCK_SZ;
+		}
+	}
+	input += fill;
+	len = (input_size - fill) & ~(CIPHER_BLOCK_SZ - 1u);
+	rem = input_size - fill - len;
+	/* Kept before the output overwrites it. */
+	memcpy(tail, input + len, rem);
+
+	/*
+	 * The output of the kept block shifts the one of the whole blocks.
+	 * When it then overlaps their input without being the same area (an
+	 * update in place), move the input to where the output goes and
+	 * cipher it in place.
+	 */
+	in = (uintptr_t)input;
+	out = (uintptr_t)output;
+	if ((len != 0u) && (out + done != in)
+	    && (out < in + len) && (in < out + done + len)) {
+		memmove(output + done, input, len);
+		input = output + done;
+	}
+
+	if (done != 0u) {
+		err = cipher_stream(ctx, ctx->part, output, CIPHER_BLOCK_SZ);
+		if (err != HSM_NO_ERROR) {
+			return err;
+		}
+		ctx->part_len = 0u;
+	}
+
+	if (len != 0u) {
+		err = cipher_stream(ctx, input, output + done, len);
+		if (err != HSM_NO_ERROR) {
+			return err;
+		}
+		done += len;
+	}
+
+	memcpy(ctx->part + ctx->part_len, tail, rem);
+	ctx->part_len += rem;
+	*output_size = done;
+
+	return HSM_NO_ERROR;
+}
+
+hsm_err_t hsm_cipher_final(hsm_cipher_ctx_t *ctx, uint8_t *output,
+			   uint32_t *output_size)
+{
+	hsm_err_t err;
+
+	if (ctx == NULL) {
+		return HSM_INVALID_PARAM;
+	}
+
+	if (output == NULL) {
+		/* Only release the context. */
+		err = HSM_NO_ERROR;
+	} else if (output_size == NULL) {
+		err = HSM_INVALID_PARAM;
+	} else if (ctx->err != HSM_NO_ERROR) {
+		err = ctx->err;
+	} else if (ctx->part_len == 0u) {
+		*output_size = 0u;
+		err = HSM_NO_ERROR;
+	} else if ((ctx->mode != CIPHER_STREAM_CTR)
+		   || (*output_size < ctx->part_len)) {
+		err = HSM_INVALID_PARAM;
+	} else {
+		err = cipher_stream(ctx, ctx->part, output, ctx->part_len);
+		if (err == HSM_NO_ERROR) {
+			*output_size = ctx->part_len;
+		}
+	}
+
+	cipher_stage_free(ctx);
+	free(ctx);
+
+	return err;
+}
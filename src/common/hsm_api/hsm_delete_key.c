@@ -53,6 +53,9 @@ hsm_err_t hsm_delete_key(hsm_hdl_t key_management_hdl,
 		if (error != SAB_SUCCESS_STATUS && err != HSM_NO_ERROR) {
 			printf("HSM Error: HSM_DELETE_KEY_REQ [0x%x].\n", err);
 		}
+		if (err == HSM_NO_ERROR) {
+			session_keys_changed(serv_ptr->session);
+		}
 
 	} while (false);
 
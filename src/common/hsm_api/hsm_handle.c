@@ -13,91 +13,450 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "internal/hsm_handle.h"
 
-static struct hsm_session_hdl_s hsm_sessions[HSM_MAX_SESSIONS] = {};
-static struct hsm_service_hdl_s hsm_services[HSM_MAX_SERVICES] = {};
+#include "sab_queue.h"
 
-struct hsm_session_hdl_s *session_hdl_to_ptr(uint32_t hdl)
+/*
+ * Handles are allocated by the enclave, they are indexed in open addressing
+ * tables (linear probing, backward shift deletion) keyed by the handle.
+ * Room for an entry is reserved when the session or service is added, so
+ * that registering its handle once known cannot fail.
+ *
+ * Up to HDL_TABLE_LINEAR_SIZE entries, the usual case, a table is instead
+ * an array embedded in the table, packed and scanned linearly. Those small
+ * tables are looked up without the lock: the writers, serialized by the
+ * lock, make the sequence number odd while they update them and readers
+ * retry if it changed under them. A small array is never freed, so a reader
+ * racing with the switch to a hashed table still reads valid memory.
+ */
+struct hdl_entry {
+	uint32_t hdl;
+	void *ptr;
+};
+
+/* Number of entries of a small table. */
+#define HDL_TABLE_LINEAR_SIZE	(8u)
+/* Number of entries of a table once hashed. */
+#define HDL_TABLE_INIT_SIZE	(32u)
+
+struct hdl_table {
+	struct hdl_entry *entries;	/* small while linear, else hashed */
+	uint32_t size;		/* power of 2 */
+	uint32_t nb_reserved;	/* registered + added not yet registered */
+	uint32_t nb_entries;	/* registered */
+	uint32_t seq;		/* odd while a small table is updated */
+	struct hdl_entry small[HDL_TABLE_LINEAR_SIZE];
+};
+
+static struct hdl_table hsm_sessions = {
+	.entries = hsm_sessions.small,
+	.size = HDL_TABLE_LINEAR_SIZE,
+};
+static struct hdl_table hsm_services = {
+	.entries = hsm_services.small,
+	.size = HDL_TABLE_LINEAR_SIZE,
+};
+/* Sessions and services are opened and closed from any thread. */
+static pthread_mutex_t hsm_hdl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hdl_hash(uint32_t hdl, uint32_t size)
+{
+	/* Fibonacci hashing, handles of the enclave are often sequential. */
+	return (hdl * 0x9E3779B1u) & (size - 1u);
+}
+
+static void hdl_write_begin(struct hdl_table *t)
+{
+	__atomic_store_n(&t->seq, t->seq + 1u, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void hdl_write_end(struct hdl_table *t)
+{
+	__atomic_store_n(&t->seq, t->seq + 1u, __ATOMIC_RELEASE);
+}
+
+static void hdl_entry_set(struct hdl_entry *e, uint32_t hdl, void *ptr)
+{
+	__atomic_store_n(&e->hdl, hdl, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->ptr, ptr, __ATOMIC_RELAXED);
+}
+
+/* Lookup with the lock held. */
+static void *hdl_table_find(struct hdl_table *t, uint32_t hdl)
 {
 	uint32_t i;
-	struct hsm_session_hdl_s *ret;
 
-	ret = NULL;
-	for (i = 0u; i < HSM_MAX_SESSIONS; i++) {
-		if (hdl == hsm_sessions[i].session_hdl) {
-			if (hsm_sessions[i].phdl != NULL) {
-				ret = &hsm_sessions[i];
+	if (hdl == 0u) {
+		return NULL;
+	}
+
+	if (t->entries == t->small) {
+		for (i = 0u; i < t->nb_entries; i++) {
+			if (t->entries[i].hdl == hdl) {
+				return t->entries[i].ptr;
 			}
-			break;
 		}
+		return NULL;
 	}
-	return ret;
+
+	for (i = hdl_hash(hdl, t->size);
+	     t->entries[i].ptr != NULL;
+	     i = (i + 1u) & (t->size - 1u)) {
+		if (t->entries[i].hdl == hdl) {
+			return t->entries[i].ptr;
+		}
+	}
+
+	return NULL;
 }
 
-struct hsm_service_hdl_s *service_hdl_to_ptr(uint32_t hdl)
+/* Lookup without the lock while the table is small. */
+static void *hdl_table_lookup(struct hdl_table *t, uint32_t hdl)
+{
+	void *ptr = NULL;
+	uintptr_t found, match;
+	uint32_t seq, i;
+
+	if (hdl == 0u) {
+		return NULL;
+	}
+
+	seq = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+	if (((seq & 1u) == 0u)
+		&& (__atomic_load_n(&t->entries, __ATOMIC_RELAXED) == t->small)) {
+		/*
+		 * Scan all the entries without branching on them: the unused
+		 * ones have a null handle and the handles looked up one after
+		 * the other are hardly predictable.
+		 */
+		found = 0u;
+		for (i = 0u; i < HDL_TABLE_LINEAR_SIZE; i++) {
+			match = (uintptr_t)0u - (uintptr_t)(__atomic_load_n(
+				&t->small[i].hdl, __ATOMIC_RELAXED) == hdl);
+			found |= match & (uintptr_t)__atomic_load_n(
+				&t->small[i].ptr, __ATOMIC_RELAXED);
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&t->seq, __ATOMIC_RELAXED) == seq) {
+			return (void *)found;
+		}
+	}
+
+	/* Hashed table, or updated meanwhile: wait for the writer. */
+	(void)pthread_mutex_lock(&hsm_hdl_lock);
+	ptr = hdl_table_find(t, hdl);
+	(void)pthread_mutex_unlock(&hsm_hdl_lock);
+
+	return ptr;
+}
+
+static void hdl_table_insert(struct hdl_table *t, uint32_t hdl, void *ptr)
 {
 	uint32_t i;
-	struct hsm_service_hdl_s *ret;
 
-	ret = NULL;
-	for (i = 0u; i < HSM_MAX_SERVICES; i++) {
-		if (hdl == hsm_services[i].service_hdl) {
-			if (hsm_services[i].session != NULL) {
-				ret = &hsm_services[i];
+	if (t->entries == t->small) {
+		hdl_write_begin(t);
+		hdl_entry_set(&t->small[t->nb_entries], hdl, ptr);
+		__atomic_store_n(&t->nb_entries, t->nb_entries + 1u,
+				 __ATOMIC_RELAXED);
+		hdl_write_end(t);
+		return;
+	}
+
+	i = hdl_hash(hdl, t->size);
+	while (t->entries[i].ptr != NULL) {
+		i = (i + 1u) & (t->size - 1u);
+	}
+	t->entries[i].hdl = hdl;
+	t->entries[i].ptr = ptr;
+	t->nb_entries++;
+}
+
+static void hdl_table_remove(struct hdl_table *t, uint32_t hdl, void *ptr)
+{
+	uint32_t i, j, k, last;
+
+	if (hdl == 0u) {
+		return;
+	}
+
+	if (t->entries == t->small) {
+		for (i = 0u; i < t->nb_entries; i++) {
+			if (t->small[i].ptr == ptr) {
+				/* Keep the entries packed. */
+				last = t->nb_entries - 1u;
+				hdl_write_begin(t);
+				hdl_entry_set(&t->small[i], t->small[last].hdl,
+					      t->small[last].ptr);
+				hdl_entry_set(&t->small[last], 0u, NULL);
+				__atomic_store_n(&t->nb_entries, last,
+						 __ATOMIC_RELAXED);
+				hdl_write_end(t);
 				break;
 			}
 		}
+		return;
+	}
+
+	for (i = hdl_hash(hdl, t->size);
+	     t->entries[i].ptr != ptr;
+	     i = (i + 1u) & (t->size - 1u)) {
+		if (t->entries[i].ptr == NULL) {
+			/* Not registered. */
+			return;
+		}
+	}
+
+	t->nb_entries--;
+	/* Move back the following entries of the cluster that can be. */
+	j = i;
+	for (;;) {
+		t->entries[i].ptr = NULL;
+		do {
+			j = (j + 1u) & (t->size - 1u);
+			if (t->entries[j].ptr == NULL) {
+				return;
+			}
+			k = hdl_hash(t->entries[j].hdl, t->size);
+		} while ((i <= j) ? ((i < k) && (k <= j))
+				  : ((i < k) || (k <= j)));
+		t->entries[i] = t->entries[j];
+		i = j;
 	}
-	return ret;
 }
 
-struct hsm_session_hdl_s *add_session(void)
+/* Make room for one more entry. Return 0 on success. */
+static int32_t hdl_table_reserve(struct hdl_table *t)
 {
+	struct hdl_entry *old = t->entries;
+	struct hdl_entry *entries;
+	uint32_t old_size = t->size;
+	uint32_t size;
 	uint32_t i;
-	struct hsm_session_hdl_s *s_ptr = NULL;
-
-	for (i = 0u; i < HSM_MAX_SESSIONS; i++) {
-		if ((hsm_sessions[i].phdl == NULL)
-				&& (hsm_sessions[i].session_hdl == 0u)) {
-			/* Found an empty slot. */
-			s_ptr = &hsm_sessions[i];
-			break;
+
+	/* Fill the small tables, keep the hashed ones below half full. */
+	if ((old == t->small) ? (t->nb_reserved + 1u > old_size)
+			      : (2u * (t->nb_reserved + 1u) > old_size)) {
+		size = (old == t->small) ? HDL_TABLE_INIT_SIZE : 2u * old_size;
+		entries = calloc(size, sizeof(struct hdl_entry));
+		if (entries == NULL) {
+			return -1;
+		}
+		if (old == t->small) {
+			hdl_write_begin(t);
 		}
+		__atomic_store_n(&t->entries, entries, __ATOMIC_RELAXED);
+		t->size = size;
+		t->nb_entries = 0u;
+		for (i = 0u; i < old_size; i++) {
+			if (old[i].ptr != NULL) {
+				hdl_table_insert(t, old[i].hdl, old[i].ptr);
+			}
+		}
+		if (old == t->small) {
+			/* Readers now take the lock. */
+			hdl_write_end(t);
+		} else {
+			free(old);
+		}
+	}
+	t->nb_reserved++;
+
+	return 0;
+}
+
+struct hsm_session_hdl_s *session_hdl_to_ptr(uint32_t hdl)
+{
+	return hdl_table_lookup(&hsm_sessions, hdl);
+}
+
+struct hsm_service_hdl_s *service_hdl_to_ptr(uint32_t hdl)
+{
+	return hdl_table_lookup(&hsm_services, hdl);
+}
+
+struct hsm_session_hdl_s *add_session(struct plat_os_abs_hdl *phdl,
+				       uint32_t mu_type)
+{
+	struct hsm_session_hdl_s *s_ptr;
+
+	s_ptr = calloc(1, sizeof(struct hsm_session_hdl_s));
+	if (s_ptr == NULL) {
+		return NULL;
+	}
+
+	(void)pthread_mutex_lock(&hsm_hdl_lock);
+	if (hdl_table_reserve(&hsm_sessions) != 0) {
+		free(s_ptr);
+		s_ptr = NULL;
+	} else {
+		s_ptr->phdl = phdl;
+		s_ptr->mu_type = mu_type;
 	}
+	(void)pthread_mutex_unlock(&hsm_hdl_lock);
+
 	return s_ptr;
 }
 
 struct hsm_service_hdl_s *add_service(struct hsm_session_hdl_s *session)
 {
-	uint32_t i;
-	struct hsm_service_hdl_s *s_ptr = NULL;
-
-	for (i = 0u; i < HSM_MAX_SERVICES; i++) {
-		if ((hsm_services[i].session == NULL)
-				&& (hsm_services[i].service_hdl == 0u)) {
-			/* Found an empty slot. */
-			s_ptr = &hsm_services[i];
-			s_ptr->session = session;
-			break;
-		}
+	struct hsm_service_hdl_s *s_ptr;
+
+	s_ptr = calloc(1, sizeof(struct hsm_service_hdl_s));
+	if (s_ptr == NULL) {
+		return NULL;
 	}
+
+	(void)pthread_mutex_lock(&hsm_hdl_lock);
+	if (hdl_table_reserve(&hsm_services) != 0) {
+		free(s_ptr);
+		s_ptr = NULL;
+	} else {
+		s_ptr->session = session;
+	}
+	(void)pthread_mutex_unlock(&hsm_hdl_lock);
+
 	return s_ptr;
 }
 
+void register_session(struct hsm_session_hdl_s *s_ptr)
+{
+	if ((s_ptr != NULL) && (s_ptr->session_hdl != 0u)) {
+		(void)pthread_mutex_lock(&hsm_hdl_lock);
+		hdl_table_insert(&hsm_sessions, s_ptr->session_hdl, s_ptr);
+		(void)pthread_mutex_unlock(&hsm_hdl_lock);
+	}
+}
+
+void register_service(struct hsm_service_hdl_s *s_ptr)
+{
+	if ((s_ptr != NULL) && (s_ptr->service_hdl != 0u)) {
+		(void)pthread_mutex_lock(&hsm_hdl_lock);
+		hdl_table_insert(&hsm_services, s_ptr->service_hdl, s_ptr);
+		(void)pthread_mutex_unlock(&hsm_hdl_lock);
+	}
+}
+
+/* Free a service and its copies on the other sessions of its group. */
+static void free_service(struct hsm_service_hdl_s *s_ptr)
+{
+	struct hsm_service_hdl_s *member;
+
+	while (s_ptr != NULL) {
+		member = s_ptr->member;
+		free(s_ptr);
+		s_ptr = member;
+	}
+}
+
 void delete_session(struct hsm_session_hdl_s *s_ptr)
 {
+	struct hsm_session_hdl_s *member;
+	struct hsm_service_hdl_s *serv_ptr;
+	uint32_t i = 0u;
+
 	if (s_ptr != NULL) {
-		s_ptr->phdl = NULL;
-		s_ptr->session_hdl = 0u;
+		(void)pthread_mutex_lock(&hsm_hdl_lock);
+		hdl_table_remove(&hsm_sessions, s_ptr->session_hdl, s_ptr);
+		hsm_sessions.nb_reserved--;
+
+		/* Services left open are gone with their session. */
+		while (i < hsm_services.size) {
+			serv_ptr = hsm_services.entries[i].ptr;
+			if ((serv_ptr != NULL) && (serv_ptr->session == s_ptr)) {
+				/* Entry i is refilled by the shift or packing. */
+				hdl_table_remove(&hsm_services,
+						 serv_ptr->service_hdl,
+						 serv_ptr);
+				hsm_services.nb_reserved--;
+				free_service(serv_ptr);
+			} else {
+				i++;
+			}
+		}
+		(void)pthread_mutex_unlock(&hsm_hdl_lock);
+		while (s_ptr != NULL) {
+			member = s_ptr->member;
+			free(s_ptr);
+			s_ptr = member;
+		}
 	}
 }
 
 void delete_service(struct hsm_service_hdl_s *s_ptr)
 {
 	if (s_ptr != NULL) {
-		s_ptr->session = NULL;
-		s_ptr->service_hdl = 0u;
+		(void)pthread_mutex_lock(&hsm_hdl_lock);
+		hdl_table_remove(&hsm_services, s_ptr->service_hdl, s_ptr);
+		hsm_services.nb_reserved--;
+		(void)pthread_mutex_unlock(&hsm_hdl_lock);
+		free_service(s_ptr);
+	}
+}
+
+/*
+ * Time before a channel would serve one more command, from its commands in
+ * flight and their rolling service time. Channels not measured yet take
+ * the service time given.
+ */
+static uint64_t service_wait(struct hsm_service_hdl_s *s_ptr,
+			     uint64_t default_ns, uint32_t *in_flight)
+{
+	uint64_t service_ns = 0u;
+
+	*in_flight = 0u;
+	if (sab_queue_load(s_ptr->session->phdl, in_flight, &service_ns) != 0u) {
+		return UINT64_MAX;
+	}
+	if (service_ns == 0u) {
+		service_ns = default_ns;
+	}
+
+	return (uint64_t)(*in_flight + 1u) * service_ns;
+}
+
+struct hsm_service_hdl_s *service_dispatch(struct hsm_service_hdl_s *s_ptr)
+{
+	struct hsm_service_hdl_s *best = s_ptr;
+	struct hsm_service_hdl_s *member;
+	uint64_t wait, best_wait, home_ns = 0u;
+	uint32_t in_flight;
+
+	if ((s_ptr == NULL) || (s_ptr->member == NULL)) {
+		return s_ptr;
+	}
+
+	(void)sab_queue_load(s_ptr->session->phdl, &in_flight, &home_ns);
+	if (home_ns == 0u) {
+		home_ns = 1u;
+	}
+	best_wait = service_wait(s_ptr, home_ns, &in_flight);
+	for (member = s_ptr->member; member != NULL; member = member->member) {
+		wait = service_wait(member, home_ns, &in_flight);
+		/*
+		 * High priority commands never queue behind the commands of a
+		 * lower priority channel: they only go there when it is idle.
+		 */
+		if ((member->session->mu_priority < s_ptr->session->mu_priority)
+			&& (in_flight != 0u)) {
+			continue;
+		}
+		if (wait < best_wait) {
+			best = member;
+			best_wait = wait;
+		}
+	}
+
+	return best;
+}
+
+void session_keys_changed(struct hsm_session_hdl_s *s_ptr)
+{
+	if (s_ptr != NULL) {
+		(void)__atomic_add_fetch(&s_ptr->key_gen, 1u, __ATOMIC_RELEASE);
 	}
 }
@@ -14,12 +14,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "internal/hsm_handle.h"
 #include "internal/hsm_utils.h"
 #include "internal/hsm_hash.h"
 
 #include "sab_process_msg.h"
+#include "sab_buf.h"
+#include "sha2.h"
 
 #include "plat_utils.h"
 #include "plat_os_abs.h"
@@ -61,6 +64,173 @@ hsm_err_t hsm_hash_one_go(hsm_hdl_t hash_hdl,
 	return err;
 }
 
+struct hsm_hash_ctx_s {
+	hsm_hdl_t hash_hdl;
+	hsm_hash_algo_t algo;
+	struct plat_os_abs_hdl *phdl;
+	/* Input gathered for the enclave, allocated by the first update. */
+	uint8_t *buf;
+	uint32_t buf_len;
+	/* Digest size on the host, 0 if the algorithm is not available. */
+	uint32_t digest_size;
+	/* true once the input is hashed on the host. */
+	bool host;
+	struct sha2_ctx sha;
+	/* First error of the updates, returned by the next calls. */
+	hsm_err_t err;
+};
+
+static uint32_t hash_host_digest_size(hsm_hash_algo_t algo)
+{
+	uint32_t size;
+
+	switch (algo) {
+	case HSM_HASH_ALGO_SHA_224:
+		size = 28u;
+		break;
+	case HSM_HASH_ALGO_SHA_256:
+		size = 32u;
+		break;
+	case HSM_HASH_ALGO_SHA_384:
+		size = 48u;
+		break;
+	case HSM_HASH_ALGO_SHA_512:
+		size = 64u;
+		break;
+	default:
+		size = 0u;
+		break;
+	}
+
+	return size;
+}
+
+hsm_err_t hsm_hash_init(hsm_hdl_t hash_hdl, hsm_hash_algo_t algo,
+			hsm_hash_ctx_t **ctx)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct hsm_hash_ctx_s *c = NULL;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+
+	do {
+		if (ctx == NULL) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+
+		serv_ptr = service_hdl_to_ptr(hash_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		c = calloc(1u, sizeof(struct hsm_hash_ctx_s));
+		if (c == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
+		c->hash_hdl = hash_hdl;
+		c->algo = algo;
+		c->phdl = serv_ptr->session->phdl;
+		c->digest_size = hash_host_digest_size(algo);
+		c->err = HSM_NO_ERROR;
+
+		*ctx = c;
+		err = HSM_NO_ERROR;
+	} while (false);
+
+	return err;
+}
+
+hsm_err_t hsm_hash_update(hsm_hash_ctx_t *ctx, uint8_t *input,
+			  uint32_t input_size)
+{
+	if ((ctx == NULL) || ((input == NULL) && (input_size != 0u))) {
+		return HSM_INVALID_PARAM;
+	}
+	if (ctx->err != HSM_NO_ERROR) {
+		return ctx->err;
+	}
+
+	if ((ctx->host == false) && (input_size != 0u)) {
+		if ((ctx->buf == NULL)
+			&& (input_size <= HSM_HASH_ONE_GO_MAX_SZ)) {
+			/* Taken in the buffer pool: hashed in place by the enclave. */
+			ctx->buf = sab_buf_alloc(ctx->phdl, HSM_HASH_ONE_GO_MAX_SZ);
+		}
+		if ((ctx->buf != NULL)
+			&& (input_size <= HSM_HASH_ONE_GO_MAX_SZ - ctx->buf_len)) {
+			memcpy(ctx->buf + ctx->buf_len, input, input_size);
+			ctx->buf_len += input_size;
+			return HSM_NO_ERROR;
+		}
+
+		/* Too big for the enclave, or no buffer: continue on the host. */
+		if (ctx->digest_size == 0u) {
+			if (input_size <= HSM_HASH_ONE_GO_MAX_SZ - ctx->buf_len) {
+				ctx->err = HSM_OUT_OF_MEMORY;
+			} else {
+				printf("HSM Error: hash algo [0x%x] limited to %u bytes.\n",
+					ctx->algo, HSM_HASH_ONE_GO_MAX_SZ);
+				ctx->err = HSM_FEATURE_NOT_SUPPORTED;
+			}
+			return ctx->err;
+		}
+		sha2_init(&ctx->sha, ctx->digest_size);
+		if (ctx->buf != NULL) {
+			sha2_update(&ctx->sha, ctx->buf, ctx->buf_len);
+			(void)sab_buf_free(ctx->phdl, ctx->buf);
+			ctx->buf = NULL;
+		}
+		ctx->host = true;
+	}
+
+	if (ctx->host == true) {
+		sha2_update(&ctx->sha, input, input_size);
+	}
+
+	return HSM_NO_ERROR;
+}
+
+hsm_err_t hsm_hash_final(hsm_hash_ctx_t *ctx, uint8_t *output,
+			 uint32_t output_size)
+{
+	op_hash_one_go_args_t args;
+	uint8_t empty = 0u;
+	hsm_err_t err;
+
+	if (ctx == NULL) {
+		return HSM_INVALID_PARAM;
+	}
+
+	if (output == NULL) {
+		/* Only release the context. */
+		err = HSM_NO_ERROR;
+	} else if (ctx->err != HSM_NO_ERROR) {
+		err = ctx->err;
+	} else if (ctx->host == false) {
+		memset(&args, 0, sizeof(args));
+		args.input = (ctx->buf != NULL) ? ctx->buf : &empty;
+		args.input_size = ctx->buf_len;
+		args.output = output;
+		args.output_size = output_size;
+		args.algo = ctx->algo;
+		err = hsm_hash_one_go(ctx->hash_hdl, &args);
+	} else if (output_size < ctx->digest_size) {
+		err = HSM_INVALID_PARAM;
+	} else {
+		sha2_final(&ctx->sha, output);
+		err = HSM_NO_ERROR;
+	}
+
+	if (ctx->buf != NULL) {
+		(void)sab_buf_free(ctx->phdl, ctx->buf);
+	}
+	free(ctx);
+
+	return err;
+}
+
 hsm_err_t hsm_open_hash_service(hsm_hdl_t session_hdl,
 				open_svc_hash_args_t *args,
 				hsm_hdl_t *hash_hdl)
@@ -102,6 +272,7 @@ hsm_err_t hsm_open_hash_service(hsm_hdl_t session_hdl,
 		}
 
 		serv_ptr->service_hdl = args->hash_hdl;
+		register_service(serv_ptr);
 		*hash_hdl = args->hash_hdl;
 	} while (false);
 
@@ -77,6 +77,9 @@ hsm_err_t hsm_import_key(hsm_hdl_t key_management_hdl,
 		if (!error && err != HSM_NO_ERROR) {
 			printf("HSM Error: HSM_IMPORT_KEY_REQ [0x%x].\n", err);
 		}
+		if (err == HSM_NO_ERROR) {
+			session_keys_changed(serv_ptr->session);
+		}
 
 	} while (false);
 
@@ -100,6 +100,7 @@ hsm_err_t hsm_open_mac_service(hsm_hdl_t key_store_hdl,
 			break;
 		}
 		mac_serv_ptr->service_hdl = args->mac_serv_hdl;
+		register_service(mac_serv_ptr);
 		*mac_hdl = mac_serv_ptr->service_hdl;
 	} while (false);
 
@@ -54,6 +54,10 @@ hsm_err_t hsm_manage_key(hsm_hdl_t key_management_hdl,
 		if (!error && err != HSM_NO_ERROR) {
 			printf("HSM Error: HSM_MANAGE_KEY_REQ [0x%x].\n", err);
 		}
+		/* Keys are imported or deleted by the manage key commands. */
+		if (err == HSM_NO_ERROR) {
+			session_keys_changed(serv_ptr->session);
+		}
 
 	} while (false);
 
@@ -90,6 +94,10 @@ hsm_err_t hsm_manage_key_ext(hsm_hdl_t key_management_hdl,
 		if (!error && err != HSM_NO_ERROR) {
 			printf("HSM Error: HSM_MANAGE_KEY_REQ [0x%x].\n", err);
 		}
+		/* Keys are imported or deleted by the manage key commands. */
+		if (err == HSM_NO_ERROR) {
+			session_keys_changed(serv_ptr->session);
+		}
 
 	} while (false);
 
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stddef.h>
+
+#include "internal/hsm_perf.h"
+
+#include "sab_perf.h"
+
+hsm_err_t hsm_get_perf_stats(uint8_t msg_id, hsm_perf_stats_t *stats)
+{
+#ifdef HSM_PERF_STATS
+	if (stats == NULL) {
+		return HSM_INVALID_PARAM;
+	}
+	sab_perf_get(msg_id, stats);
+
+	return HSM_NO_ERROR;
+#else
+	return HSM_FEATURE_NOT_SUPPORTED;
+#endif
+}
+
+hsm_err_t hsm_reset_perf_stats(void)
+{
+#ifdef HSM_PERF_STATS
+	sab_perf_reset();
+
+	return HSM_NO_ERROR;
+#else
+	return HSM_FEATURE_NOT_SUPPORTED;
+#endif
+}
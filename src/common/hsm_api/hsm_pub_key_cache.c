@@ -0,0 +1,389 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hsm_api.h"
+
+/*
+ * Entries are grouped in sets of PKC_WAYS, a key is stored in the set of
+ * its hash. Each entry is protected by a sequence number, odd while the
+ * entry is written: readers copy the entry without lock and drop the copy
+ * if the sequence number changed meanwhile. Writers are serialized by the
+ * cache mutex, they only run after a call to the enclave.
+ * Eviction is CLOCK within a set: a hit marks the entry referenced, the
+ * hand of the set skips and clears referenced entries to find a victim.
+ */
+#define PKC_WAYS	4u
+
+#define PKC_OP_NONE	0u
+#define PKC_OP_DEC	1u
+#define PKC_OP_REC	2u
+
+#define PKC_MAX_IN	3u
+
+#define PKC_ADD(var, val)	__atomic_fetch_add(&(var), (val), __ATOMIC_RELAXED)
+
+struct pkc_entry {
+	uint32_t seq;
+	uint8_t ref;
+	uint8_t op;
+	hsm_key_type_t key_type;
+	uint8_t flags;
+	uint16_t in_size[PKC_MAX_IN];
+	uint16_t out_size;
+	uint64_t hash;
+	uint8_t in[HSM_PUB_KEY_CACHE_IN_MAX];
+	uint8_t out[HSM_PUB_KEY_CACHE_KEY_MAX];
+};
+
+/* Inputs of an operation, as looked up in the cache. */
+struct pkc_op {
+	uint8_t op;
+	hsm_key_type_t key_type;
+	uint8_t flags;
+	uint8_t *in[PKC_MAX_IN];
+	uint16_t in_size[PKC_MAX_IN];
+	uint8_t *out;
+	uint16_t out_size;
+	uint64_t hash;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	bool enabled;
+	struct pkc_entry *entries;
+	uint8_t *hands;
+	uint32_t nb_sets;
+	hsm_pub_key_cache_stats_t stats;
+} pkc = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* FNV-1a of the inputs of an operation. */
+static uint64_t pkc_hash_bytes(uint64_t h, const uint8_t *p, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0u; i < size; i++) {
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	}
+
+	return h;
+}
+
+/* Fill the hash of op, return false if op cannot be cached. */
+static bool pkc_prepare(struct pkc_op *op)
+{
+	uint8_t hdr[2 + (2 * PKC_MAX_IN) + 2];
+	uint32_t i, total = 0u;
+	uint64_t h = 0xcbf29ce484222325ull;
+
+	if ((op->out == NULL) || (op->out_size == 0u)
+		|| (op->out_size > HSM_PUB_KEY_CACHE_KEY_MAX)) {
+		return false;
+	}
+	hdr[0] = op->op;
+	hdr[1] = op->key_type;
+	for (i = 0u; i < PKC_MAX_IN; i++) {
+		if ((op->in[i] == NULL) && (op->in_size[i] != 0u)) {
+			return false;
+		}
+		total += op->in_size[i];
+		hdr[2 + (2 * i)] = (uint8_t)op->in_size[i];
+		hdr[3 + (2 * i)] = (uint8_t)(op->in_size[i] >> 8);
+		h = pkc_hash_bytes(h, op->in[i], op->in_size[i]);
+	}
+	if (total > HSM_PUB_KEY_CACHE_IN_MAX) {
+		return false;
+	}
+	hdr[2 + (2 * PKC_MAX_IN)] = op->flags;
+	hdr[3 + (2 * PKC_MAX_IN)] = (uint8_t)op->out_size;
+	h = pkc_hash_bytes(h, hdr, sizeof(hdr));
+	/* The low bits select the set, fold the better mixed high bits. */
+	op->hash = h ^ (h >> 32);
+
+	return true;
+}
+
+/* Compare an entry, read or locked, with op. */
+static bool pkc_match(struct pkc_entry *e, struct pkc_op *op)
+{
+	uint32_t i, off = 0u;
+
+	if ((e->op != op->op) || (e->hash != op->hash)
+		|| (e->key_type != op->key_type) || (e->flags != op->flags)
+		|| (e->out_size != op->out_size)) {
+		return false;
+	}
+	for (i = 0u; i < PKC_MAX_IN; i++) {
+		if (e->in_size[i] != op->in_size[i]) {
+			return false;
+		}
+		if (memcmp(&e->in[off], op->in[i], op->in_size[i]) != 0) {
+			return false;
+		}
+		off += op->in_size[i];
+	}
+
+	return true;
+}
+
+static bool pkc_get(struct pkc_op *op)
+{
+	struct pkc_entry *e;
+	uint8_t out[HSM_PUB_KEY_CACHE_KEY_MAX];
+	uint64_t *counter;
+	uint32_t i, seq;
+	bool hit = false;
+
+	if (!__atomic_load_n(&pkc.enabled, __ATOMIC_ACQUIRE) || !pkc_prepare(op)) {
+		return false;
+	}
+
+	e = &pkc.entries[(op->hash % pkc.nb_sets) * PKC_WAYS];
+	for (i = 0u; (i < PKC_WAYS) && !hit; i++, e++) {
+		seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+		if (((seq & 1u) != 0u) || !pkc_match(e, op)) {
+			continue;
+		}
+		(void)memcpy(out, e->out, op->out_size);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq) {
+			continue;
+		}
+		if (e->ref == 0u) {
+			__atomic_store_n(&e->ref, 1u, __ATOMIC_RELAXED);
+		}
+		(void)memcpy(op->out, out, op->out_size);
+		hit = true;
+	}
+
+	if (op->op == PKC_OP_DEC) {
+		counter = hit ? &pkc.stats.dec_hits : &pkc.stats.dec_misses;
+	} else {
+		counter = hit ? &pkc.stats.rec_hits : &pkc.stats.rec_misses;
+	}
+	(void)PKC_ADD(*counter, 1u);
+
+	return hit;
+}
+
+/* Start or end the update of an entry, cache locked. */
+static void pkc_write_begin(struct pkc_entry *e)
+{
+	__atomic_store_n(&e->seq, e->seq + 1u, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void pkc_write_end(struct pkc_entry *e)
+{
+	__atomic_store_n(&e->seq, e->seq + 1u, __ATOMIC_RELEASE);
+}
+
+static void pkc_put(struct pkc_op *op)
+{
+	struct pkc_entry *set, *e = NULL;
+	uint32_t set_idx, i, off = 0u;
+	uint8_t *hand;
+
+	if (!__atomic_load_n(&pkc.enabled, __ATOMIC_ACQUIRE) || !pkc_prepare(op)) {
+		return;
+	}
+
+	(void)pthread_mutex_lock(&pkc.lock);
+	do {
+		if (!pkc.enabled) {
+			break;
+		}
+		set_idx = (uint32_t)(op->hash % pkc.nb_sets);
+		set = &pkc.entries[set_idx * PKC_WAYS];
+		hand = &pkc.hands[set_idx];
+
+		/* Stored by another thread meanwhile. */
+		for (i = 0u; i < PKC_WAYS; i++) {
+			if (pkc_match(&set[i], op)) {
+				break;
+			}
+		}
+		if (i < PKC_WAYS) {
+			break;
+		}
+
+		for (i = 0u; (i < PKC_WAYS) && (e == NULL); i++) {
+			if (set[i].op == PKC_OP_NONE) {
+				e = &set[i];
+			}
+		}
+		if (e == NULL) {
+			/* At most one turn clearing the referenced entries. */
+			while (set[*hand].ref != 0u) {
+				__atomic_store_n(&set[*hand].ref, 0u, __ATOMIC_RELAXED);
+				*hand = (uint8_t)((*hand + 1u) % PKC_WAYS);
+			}
+			e = &set[*hand];
+			*hand = (uint8_t)((*hand + 1u) % PKC_WAYS);
+			pkc.stats.evictions++;
+		} else {
+			pkc.stats.used++;
+		}
+
+		pkc_write_begin(e);
+		e->op = op->op;
+		e->key_type = op->key_type;
+		e->flags = op->flags;
+		e->out_size = op->out_size;
+		e->hash = op->hash;
+		for (i = 0u; i < PKC_MAX_IN; i++) {
+			e->in_size[i] = op->in_size[i];
+			if (op->in_size[i] != 0u) {
+				(void)memcpy(&e->in[off], op->in[i], op->in_size[i]);
+			}
+			off += op->in_size[i];
+		}
+		(void)memcpy(e->out, op->out, op->out_size);
+		e->ref = 0u;
+		pkc_write_end(e);
+		pkc.stats.insertions++;
+	} while (false);
+	(void)pthread_mutex_unlock(&pkc.lock);
+}
+
+static void pkc_dec_op(struct pkc_op *op, op_pub_key_dec_args_t *args)
+{
+	(void)memset(op, 0, sizeof(*op));
+	op->op = PKC_OP_DEC;
+	op->key_type = args->key_type;
+	op->flags = args->flags;
+	op->in[0] = args->key;
+	op->in_size[0] = args->key_size;
+	op->out = args->out_key;
+	op->out_size = args->out_key_size;
+}
+
+static void pkc_rec_op(struct pkc_op *op, op_pub_key_rec_args_t *args)
+{
+	(void)memset(op, 0, sizeof(*op));
+	op->op = PKC_OP_REC;
+	op->key_type = args->key_type;
+	op->flags = args->flags;
+	op->in[0] = args->pub_rec;
+	op->in_size[0] = args->pub_rec_size;
+	op->in[1] = args->hash;
+	op->in_size[1] = args->hash_size;
+	op->in[2] = args->ca_key;
+	op->in_size[2] = args->ca_key_size;
+	op->out = args->out_key;
+	op->out_size = args->out_key_size;
+}
+
+bool pub_key_cache_dec_get(op_pub_key_dec_args_t *args)
+{
+	struct pkc_op op;
+
+	pkc_dec_op(&op, args);
+
+	return pkc_get(&op);
+}
+
+void pub_key_cache_dec_put(op_pub_key_dec_args_t *args)
+{
+	struct pkc_op op;
+
+	pkc_dec_op(&op, args);
+	pkc_put(&op);
+}
+
+bool pub_key_cache_rec_get(op_pub_key_rec_args_t *args)
+{
+	struct pkc_op op;
+
+	pkc_rec_op(&op, args);
+
+	return pkc_get(&op);
+}
+
+void pub_key_cache_rec_put(op_pub_key_rec_args_t *args)
+{
+	struct pkc_op op;
+
+	pkc_rec_op(&op, args);
+	pkc_put(&op);
+}
+
+hsm_err_t hsm_set_pub_key_cache(uint32_t nb_entries)
+{
+	hsm_err_t err = HSM_NO_ERROR;
+	uint32_t nb_sets, i;
+
+	nb_sets = (nb_entries + PKC_WAYS - 1u) / PKC_WAYS;
+
+	(void)pthread_mutex_lock(&pkc.lock);
+	do {
+		if (nb_sets == 0u) {
+			if (!pkc.enabled) {
+				break;
+			}
+			__atomic_store_n(&pkc.enabled, false, __ATOMIC_RELEASE);
+			/* Lookups still running miss the dropped keys. */
+			for (i = 0u; i < pkc.nb_sets * PKC_WAYS; i++) {
+				pkc_write_begin(&pkc.entries[i]);
+				pkc.entries[i].op = PKC_OP_NONE;
+				pkc.entries[i].ref = 0u;
+				pkc_write_end(&pkc.entries[i]);
+			}
+			(void)memset(pkc.hands, 0, pkc.nb_sets);
+			pkc.stats.used = 0u;
+			break;
+		}
+		if (pkc.entries == NULL) {
+			pkc.entries = calloc((size_t)nb_sets * PKC_WAYS, sizeof(struct pkc_entry));
+			pkc.hands = calloc(nb_sets, sizeof(uint8_t));
+			if ((pkc.entries == NULL) || (pkc.hands == NULL)) {
+				free(pkc.entries);
+				free(pkc.hands);
+				pkc.entries = NULL;
+				pkc.hands = NULL;
+				err = HSM_OUT_OF_MEMORY;
+				break;
+			}
+			pkc.nb_sets = nb_sets;
+		} else if (nb_sets != pkc.nb_sets) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		if (!pkc.enabled) {
+			(void)memset(&pkc.stats, 0, sizeof(pkc.stats));
+			pkc.stats.entries = nb_sets * PKC_WAYS;
+			__atomic_store_n(&pkc.enabled, true, __ATOMIC_RELEASE);
+		}
+	} while (false);
+	(void)pthread_mutex_unlock(&pkc.lock);
+
+	return err;
+}
+
+hsm_err_t hsm_get_pub_key_cache_stats(hsm_pub_key_cache_stats_t *stats)
+{
+	if (stats == NULL) {
+		return HSM_INVALID_PARAM;
+	}
+
+	(void)pthread_mutex_lock(&pkc.lock);
+	*stats = pkc.stats;
+	(void)pthread_mutex_unlock(&pkc.lock);
+
+	return HSM_NO_ERROR;
+}
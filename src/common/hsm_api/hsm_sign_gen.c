@@ -11,15 +11,237 @@
  * activate or otherwise use the software.
  */
 
+/* SCHED_IDLE */
+#define _GNU_SOURCE
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
 
 #include "internal/hsm_handle.h"
 #include "internal/hsm_utils.h"
 #include "internal/hsm_sign_gen.h"
 
 #include "sab_process_msg.h"
+#include "sab_queue.h"
+
+#ifndef PSA_COMPLIANT
+/*
+ * Pools of pre-calculated signature values, see hsm_set_sign_pool().
+ * The pools only count the values the HSM holds for them: a worker thread
+ * of low priority prepares the missing ones when no signature was generated
+ * for as long as a preparation takes, so that a preparation seldom delays a
+ * signature. hsm_generate_signature() uses one when it can.
+ * Not built with PSA_COMPLIANT: hsm_sign_pool_bench is their test, on the
+ * simulator built with SIM_NO_PSA=1.
+ */
+#define SIGN_POOL_MAX		8u
+/* Flags of the generation matching the ones of the preparation. */
+#define SIGN_POOL_FLAGS_MASK	(HSM_OP_PREPARE_SIGN_INPUT_MESSAGE \
+				 | HSM_OP_PREPARE_SIGN_COMPRESSED_POINT)
+
+struct sign_pool {
+	/* HSM_HANDLE_NONE when the entry is free. */
+	hsm_hdl_t hdl;
+	/* Session of the service flow. */
+	hsm_hdl_t session_hdl;
+	hsm_signature_scheme_id_t scheme_id;
+	hsm_op_prepare_signature_flags_t flags;
+	/* Last preparation failed, retried after the next signature. */
+	bool stalled;
+	uint32_t depth;
+	uint32_t ready;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t prepared;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	/* Signalled when a pool may need a preparation. */
+	pthread_cond_t work;
+	/* Signalled when the worker is done with a service. */
+	pthread_cond_t idle;
+	bool started;
+	/* Signatures being generated on the services having a pool. */
+	uint32_t generating;
+	/* End of the last signature and duration of the last preparation. */
+	uint64_t last_gen_ns;
+	uint64_t prep_ns;
+	/* Service the worker is preparing a value on, and its session. */
+	hsm_hdl_t busy_hdl;
+	hsm_hdl_t busy_session_hdl;
+	struct sign_pool pools[SIGN_POOL_MAX];
+} sign_pools = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t sign_pools_once = PTHREAD_ONCE_INIT;
+
+static uint64_t sign_pool_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* Called with the lock held. */
+static struct sign_pool *sign_pool_find(hsm_hdl_t hdl,
+					hsm_signature_scheme_id_t scheme_id)
+{
+	uint32_t i;
+
+	for (i = 0u; (hdl != HSM_HANDLE_NONE) && (i < SIGN_POOL_MAX); i++) {
+		if ((sign_pools.pools[i].hdl == hdl)
+			&& (sign_pools.pools[i].scheme_id == scheme_id)) {
+			return &sign_pools.pools[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Pool having the fewest values ready, NULL if none misses any. */
+static struct sign_pool *sign_pool_next(void)
+{
+	struct sign_pool *p, *next = NULL;
+	uint32_t i;
+
+	if (sign_pools.generating != 0u) {
+		return NULL;
+	}
+	for (i = 0u; i < SIGN_POOL_MAX; i++) {
+		p = &sign_pools.pools[i];
+		if ((p->hdl == HSM_HANDLE_NONE) || p->stalled
+			|| (p->ready >= p->depth)) {
+			continue;
+		}
+		if ((next == NULL) || (p->ready < next->ready)) {
+			next = p;
+		}
+	}
+
+	return next;
+}
+
+static void *sign_pool_thread(void *arg)
+{
+	struct sched_param param = {0};
+	op_prepare_sign_args_t prep;
+	struct sign_pool *p;
+	struct timespec ts;
+	uint64_t start, quiet_end;
+	hsm_hdl_t hdl;
+	hsm_err_t err;
+
+	/* Only run when the other threads leave the CPU idle. */
+	(void)pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+	(void)pthread_mutex_lock(&sign_pools.lock);
+	for (;;) {
+		p = sign_pool_next();
+		if (p == NULL) {
+			(void)pthread_cond_wait(&sign_pools.work,
+						&sign_pools.lock);
+			continue;
+		}
+		start = sign_pool_now_ns();
+		quiet_end = sign_pools.last_gen_ns + sign_pools.prep_ns;
+		if (start < quiet_end) {
+			ts.tv_sec = (time_t)(quiet_end / 1000000000u);
+			ts.tv_nsec = (long)(quiet_end % 1000000000u);
+			(void)pthread_cond_timedwait(&sign_pools.work,
+						     &sign_pools.lock, &ts);
+			continue;
+		}
+		hdl = p->hdl;
+		prep.scheme_id = p->scheme_id;
+		prep.flags = p->flags;
+		prep.reserved = 0u;
+		sign_pools.busy_hdl = hdl;
+		sign_pools.busy_session_hdl = p->session_hdl;
+		(void)pthread_mutex_unlock(&sign_pools.lock);
+
+		err = hsm_prepare_signature(hdl, &prep);
+
+		(void)pthread_mutex_lock(&sign_pools.lock);
+		sign_pools.busy_hdl = HSM_HANDLE_NONE;
+		sign_pools.busy_session_hdl = HSM_HANDLE_NONE;
+		(void)pthread_cond_broadcast(&sign_pools.idle);
+		p = sign_pool_find(hdl, prep.scheme_id);
+		if (p == NULL) {
+			continue;
+		}
+		if (err == HSM_NO_ERROR) {
+			sign_pools.prep_ns = sign_pool_now_ns() - start;
+			p->ready++;
+			p->prepared++;
+		} else {
+			p->stalled = true;
+		}
+	}
+
+	return NULL;
+}
+
+static void sign_pool_init(void)
+{
+	pthread_condattr_t cond_attr;
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	(void)pthread_condattr_init(&cond_attr);
+	(void)pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	(void)pthread_cond_init(&sign_pools.work, &cond_attr);
+	(void)pthread_condattr_destroy(&cond_attr);
+
+	(void)pthread_attr_init(&attr);
+	(void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attr, sign_pool_thread, NULL) == 0) {
+		sign_pools.started = true;
+	}
+	(void)pthread_attr_destroy(&attr);
+}
+
+/*
+ * Drop the pools of a service or of all the services of a session being
+ * closed, the other handle being HSM_HANDLE_NONE. Wait for the worker to be
+ * done with them.
+ */
+static void sign_pool_drop(hsm_hdl_t hdl, hsm_hdl_t session_hdl)
+{
+	struct sign_pool *p;
+	uint32_t i;
+
+	(void)pthread_mutex_lock(&sign_pools.lock);
+	for (i = 0u; i < SIGN_POOL_MAX; i++) {
+		p = &sign_pools.pools[i];
+		if ((p->hdl != HSM_HANDLE_NONE) && ((p->hdl == hdl)
+			|| (p->session_hdl == session_hdl))) {
+			memset(p, 0, sizeof(*p));
+		}
+	}
+	while (((hdl != HSM_HANDLE_NONE) && (sign_pools.busy_hdl == hdl))
+		|| ((session_hdl != HSM_HANDLE_NONE)
+		    && (sign_pools.busy_session_hdl == session_hdl))) {
+		(void)pthread_cond_wait(&sign_pools.idle, &sign_pools.lock);
+	}
+	(void)pthread_mutex_unlock(&sign_pools.lock);
+}
+
+void sign_pool_close_session(hsm_hdl_t session_hdl)
+{
+	if (session_hdl != HSM_HANDLE_NONE) {
+		sign_pool_drop(HSM_HANDLE_NONE, session_hdl);
+	}
+}
+#endif
 
 hsm_err_t hsm_open_signature_generation_service(hsm_hdl_t key_store_hdl,
 						open_svc_sign_gen_args_t *args,
@@ -60,6 +282,7 @@ hsm_err_t hsm_open_signature_generation_service(hsm_hdl_t key_store_hdl,
 		}
 
 		sig_gen_serv_ptr->service_hdl = args->signature_gen_hdl;
+		register_service(sig_gen_serv_ptr);
 		*signature_gen_hdl = args->signature_gen_hdl;
 	} while (false);
 
@@ -80,6 +303,9 @@ hsm_err_t hsm_close_signature_generation_service(hsm_hdl_t signature_gen_hdl)
 			break;
 		}
 
+#ifndef PSA_COMPLIANT
+		sign_pool_drop(signature_gen_hdl, HSM_HANDLE_NONE);
+#endif
 		error = process_sab_msg(serv_ptr->session->phdl,
 					serv_ptr->session->mu_type,
 					SAB_SIGNATURE_GENERATION_CLOSE_REQ,
@@ -96,13 +322,96 @@ hsm_err_t hsm_close_signature_generation_service(hsm_hdl_t signature_gen_hdl)
 	return err;
 }
 
+static hsm_err_t sign_generate(struct hsm_service_hdl_s *serv_ptr,
+			       hsm_hdl_t signature_gen_hdl,
+			       op_generate_sign_args_t *args)
+{
+	int32_t error;
+	uint32_t rsp_code;
+
+	error = process_sab_msg(serv_ptr->session->phdl,
+				serv_ptr->session->mu_type,
+				SAB_SIGNATURE_GENERATE_REQ,
+				MT_SAB_SIGN_GEN,
+				(uint32_t)signature_gen_hdl,
+				args, &rsp_code);
+
+	if (rsp_code || (error != 0))
+		printf("SAB_GEN_SIG_REQ: SAB FW Error[0x%x]:"\
+			"SAB Engine Error[0x%x]\n", rsp_code, error);
+
+	return sab_rating_to_hsm_err(rsp_code);
+}
+
+#ifndef PSA_COMPLIANT
+/* Generate a signature with a value of the pool of its scheme if ready. */
+static hsm_err_t sign_pool_generate(struct hsm_service_hdl_s *serv_ptr,
+				    hsm_hdl_t signature_gen_hdl,
+				    op_generate_sign_args_t *args)
+{
+	op_generate_sign_args_t op;
+	struct sign_pool *p;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	bool hit = false;
+
+	if (((args->flags & HSM_OP_GENERATE_SIGN_FLAGS_LOW_LATENCY_SIGNATURE) != 0u)
+		|| !sign_pools.started) {
+		return sign_generate(serv_ptr, signature_gen_hdl, args);
+	}
+
+	(void)pthread_mutex_lock(&sign_pools.lock);
+	p = sign_pool_find(signature_gen_hdl, args->scheme_id);
+	if ((p != NULL) && (p->flags == (args->flags & SIGN_POOL_FLAGS_MASK))) {
+		if (p->ready > 0u) {
+			p->ready--;
+			p->hits++;
+			hit = true;
+		} else {
+			p->misses++;
+		}
+		p->stalled = false;
+	}
+	sign_pools.generating++;
+	(void)pthread_mutex_unlock(&sign_pools.lock);
+
+	if (hit) {
+		op = *args;
+		op.flags |= HSM_OP_GENERATE_SIGN_FLAGS_LOW_LATENCY_SIGNATURE;
+		err = sign_generate(serv_ptr, signature_gen_hdl, &op);
+	}
+	if (hit && (err != HSM_NO_ERROR)) {
+		/* The values counted were used by the application. */
+		(void)pthread_mutex_lock(&sign_pools.lock);
+		p = sign_pool_find(signature_gen_hdl, args->scheme_id);
+		if (p != NULL) {
+			p->ready = 0u;
+			p->hits--;
+			p->misses++;
+		}
+		(void)pthread_mutex_unlock(&sign_pools.lock);
+		hit = false;
+	}
+	if (!hit) {
+		err = sign_generate(serv_ptr, signature_gen_hdl, args);
+	}
+
+	(void)pthread_mutex_lock(&sign_pools.lock);
+	sign_pools.generating--;
+	sign_pools.last_gen_ns = sign_pool_now_ns();
+	if (sign_pools.generating == 0u) {
+		(void)pthread_cond_signal(&sign_pools.work);
+	}
+	(void)pthread_mutex_unlock(&sign_pools.lock);
+
+	return err;
+}
+#endif
+
 hsm_err_t hsm_generate_signature(hsm_hdl_t signature_gen_hdl,
 					op_generate_sign_args_t *args)
 {
-	int32_t error = 1;
 	struct hsm_service_hdl_s *serv_ptr;
 	hsm_err_t err = HSM_GENERAL_ERROR;
-	uint32_t rsp_code;
 
 	do {
 		if (args == NULL) {
@@ -114,18 +423,79 @@ hsm_err_t hsm_generate_signature(hsm_hdl_t signature_gen_hdl,
 			break;
 		}
 
-		error = process_sab_msg(serv_ptr->session->phdl,
-					serv_ptr->session->mu_type,
-					SAB_SIGNATURE_GENERATE_REQ,
-					MT_SAB_SIGN_GEN,
-					(uint32_t)signature_gen_hdl,
-					args, &rsp_code);
+#ifndef PSA_COMPLIANT
+		err = sign_pool_generate(serv_ptr, signature_gen_hdl, args);
+#else
+		err = sign_generate(serv_ptr, signature_gen_hdl, args);
+#endif
+	} while (false);
 
-		if (rsp_code || (error != 0))
-			printf("SAB_GEN_SIG_REQ: SAB FW Error[0x%x]:"\
-				"SAB Engine Error[0x%x]\n", rsp_code, error);
+	return err;
+}
 
-		err = sab_rating_to_hsm_err(rsp_code);
+struct sign_batch_ctx {
+	hsm_err_t *results;
+	hsm_err_t err;
+};
+
+static void sign_batch_done(uint32_t idx, uint32_t error, uint32_t rsp_code,
+			    void *cb_arg)
+{
+	struct sign_batch_ctx *ctx = (struct sign_batch_ctx *)cb_arg;
+	hsm_err_t err;
+
+	if (rsp_code || (error != 0))
+		printf("SAB_GEN_SIG_REQ[%u]: SAB FW Error[0x%x]:"\
+			"SAB Engine Error[0x%x]\n", idx, rsp_code, error);
+
+	err = (error != 0u) ? HSM_GENERAL_ERROR
+			    : sab_rating_to_hsm_err(rsp_code);
+	if (ctx->results != NULL) {
+		ctx->results[idx] = err;
+	}
+	if ((ctx->err == HSM_NO_ERROR) && (err != HSM_NO_ERROR)) {
+		ctx->err = err;
+	}
+}
+
+hsm_err_t hsm_generate_signature_batch(hsm_hdl_t signature_gen_hdl,
+				       op_generate_sign_args_t *ops,
+				       uint32_t nb_ops,
+				       hsm_err_t *results)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct sign_batch_ctx ctx;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	uint32_t error;
+
+	do {
+		if ((ops == NULL) || (nb_ops == 0u)) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		serv_ptr = service_hdl_to_ptr(signature_gen_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		ctx.results = results;
+		ctx.err = HSM_NO_ERROR;
+		error = sab_queue_send_batch(serv_ptr->session->phdl,
+					     serv_ptr->session->mu_type,
+					     SAB_SIGNATURE_GENERATE_REQ,
+					     MT_SAB_SIGN_GEN,
+					     (uint32_t)signature_gen_hdl,
+					     ops,
+					     (uint32_t)sizeof(op_generate_sign_args_t),
+					     nb_ops,
+					     sign_batch_done,
+					     &ctx);
+		if (error != 0u) {
+			err = sab_rating_to_hsm_err(error);
+			break;
+		}
+		err = ctx.err;
 	} while (false);
 
 	return err;
@@ -164,3 +534,104 @@ hsm_err_t hsm_prepare_signature(hsm_hdl_t signature_gen_hdl,
 
 	return err;
 }
+
+#ifndef PSA_COMPLIANT
+hsm_err_t hsm_set_sign_pool(hsm_hdl_t signature_gen_hdl,
+			    hsm_signature_scheme_id_t scheme_id,
+			    hsm_op_prepare_signature_flags_t flags,
+			    uint32_t depth)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct sign_pool *p;
+	hsm_err_t err = HSM_NO_ERROR;
+	uint32_t total = depth;
+	uint32_t i;
+
+	if ((flags & ~SIGN_POOL_FLAGS_MASK) != 0u) {
+		return HSM_INVALID_PARAM;
+	}
+	serv_ptr = service_hdl_to_ptr(signature_gen_hdl);
+	if (serv_ptr == NULL) {
+		return HSM_UNKNOWN_HANDLE;
+	}
+	if (depth != 0u) {
+		(void)pthread_once(&sign_pools_once, sign_pool_init);
+		if (!sign_pools.started) {
+			return HSM_GENERAL_ERROR;
+		}
+	}
+
+	(void)pthread_mutex_lock(&sign_pools.lock);
+	do {
+		p = sign_pool_find(signature_gen_hdl, scheme_id);
+		for (i = 0u; i < SIGN_POOL_MAX; i++) {
+			if ((sign_pools.pools[i].hdl == signature_gen_hdl)
+				&& (&sign_pools.pools[i] != p)) {
+				total += sign_pools.pools[i].depth;
+			}
+		}
+		if (total > HSM_PREPARED_SIGN_MAX) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		if (depth == 0u) {
+			if (p != NULL) {
+				memset(p, 0, sizeof(*p));
+			}
+			break;
+		}
+
+		for (i = 0u; (p == NULL) && (i < SIGN_POOL_MAX); i++) {
+			if (sign_pools.pools[i].hdl == HSM_HANDLE_NONE) {
+				p = &sign_pools.pools[i];
+				memset(p, 0, sizeof(*p));
+				p->hdl = signature_gen_hdl;
+				p->session_hdl = serv_ptr->session->session_hdl;
+				p->scheme_id = scheme_id;
+				p->flags = flags;
+			}
+		}
+		if (p == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
+		if (p->flags != flags) {
+			/* The values ready were prepared for other flags. */
+			p->flags = flags;
+			p->ready = 0u;
+		}
+		p->depth = depth;
+		p->stalled = false;
+		(void)pthread_cond_signal(&sign_pools.work);
+	} while (false);
+	(void)pthread_mutex_unlock(&sign_pools.lock);
+
+	return err;
+}
+
+hsm_err_t hsm_get_sign_pool_stats(hsm_hdl_t signature_gen_hdl,
+				  hsm_signature_scheme_id_t scheme_id,
+				  hsm_sign_pool_stats_t *stats)
+{
+	struct sign_pool *p;
+	hsm_err_t err = HSM_UNKNOWN_ID;
+
+	if (stats == NULL) {
+		return HSM_INVALID_PARAM;
+	}
+
+	(void)pthread_mutex_lock(&sign_pools.lock);
+	p = sign_pool_find(signature_gen_hdl, scheme_id);
+	if (p != NULL) {
+		stats->hits = p->hits;
+		stats->misses = p->misses;
+		stats->prepared = p->prepared;
+		stats->ready = p->ready;
+		stats->depth = p->depth;
+		err = HSM_NO_ERROR;
+	}
+	(void)pthread_mutex_unlock(&sign_pools.lock);
+
+	return err;
+}
+#endif
@@ -11,25 +11,587 @@
  * activate or otherwise use the software.
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "hsm_api.h"
 #include "internal/hsm_handle.h"
 #include "internal/hsm_utils.h"
 #include "internal/hsm_verify_sign.h"
 
 #include "sab_process_msg.h"
+#include "sab_queue.h"
+#include "sab_verify_sign.h"
+
+/* Open the service on a session, in s_ptr allocated by the caller. */
+static hsm_err_t open_sign_ver(struct hsm_session_hdl_s *sess_ptr,
+			       struct hsm_service_hdl_s *s_ptr,
+			       open_svc_sign_ver_args_t *args)
+{
+	hsm_err_t err;
+	int32_t error;
+	uint32_t rsp_code;
+
+	error = process_sab_msg(sess_ptr->phdl,
+				sess_ptr->mu_type,
+				SAB_SIGNATURE_VERIFICATION_OPEN_REQ,
+				MT_SAB_VERIFY_SIGN,
+				sess_ptr->session_hdl,
+				args, &rsp_code);
+	if (error != 0) {
+		return HSM_GENERAL_ERROR;
+	}
+
+	err = sab_rating_to_hsm_err(rsp_code);
+	if (err == HSM_NO_ERROR) {
+		s_ptr->service_hdl = args->sig_ver_hdl;
+	}
+
+	return err;
+}
+
+static void close_sign_ver(struct hsm_service_hdl_s *s_ptr)
+{
+	uint32_t rsp_code;
+
+	(void)process_sab_msg(s_ptr->session->phdl,
+			      s_ptr->session->mu_type,
+			      SAB_SIGNATURE_VERIFICATION_CLOSE_REQ,
+			      MT_SAB_VERIFY_SIGN,
+			      s_ptr->service_hdl,
+			      NULL, &rsp_code);
+}
+
+/*
+ * Key reference cache: public keys imported on a service flow of the
+ * cache, most recently used first after each recycle. Verifications look
+ * the keys up under the read lock and hold the flow while they use one of
+ * its references, the enclave round trip is made without the lock.
+ * Imports, recycles and invalidations take the write lock.
+ */
+struct key_ref {
+	uint64_t hash;
+	uint64_t last_use;
+	uint32_t ref;
+	hsm_key_type_t key_type;
+	uint16_t key_size;
+	uint8_t key[HSM_KEY_REF_CACHE_KEY_MAX];
+};
+
+/* Closed when the cache and the verifications in flight are done with it. */
+struct key_ref_flow {
+	struct hsm_service_hdl_s *serv;
+	uint32_t users;
+};
+
+struct key_ref_cache {
+	pthread_rwlock_t lock;
+	hsm_hdl_t session_hdl;
+	struct hsm_session_hdl_s *session;
+	/* NULL while disabled, invalidated or if it could not be opened. */
+	struct key_ref_flow *flow;
+	/* key_gen of the session when the references were imported. */
+	uint32_t key_gen;
+	bool enabled;
+	struct key_ref *slots;
+	uint32_t nb_slots;
+	uint32_t used;
+	uint64_t tick;
+	hsm_key_ref_cache_stats_t stats;
+	struct key_ref_cache *next;
+};
+
+/* All the caches, to drop them with their session. */
+static struct {
+	pthread_mutex_t lock;
+	struct key_ref_cache *list;
+} key_ref_caches = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define KEY_REF_ADD(var, val)	__atomic_add_fetch(&(var), (val), __ATOMIC_RELAXED)
+
+/* Verification on an opened service, shared by all the callers. */
+static hsm_err_t verify_send(struct hsm_service_hdl_s *serv_ptr,
+			     op_verify_sign_args_t *args)
+{
+	int32_t error;
+	uint32_t rsp_code;
+
+	error = process_sab_msg(serv_ptr->session->phdl,
+				serv_ptr->session->mu_type,
+				SAB_SIGNATURE_VERIFY_REQ,
+				MT_SAB_VERIFY_SIGN,
+				serv_ptr->service_hdl,
+				args, &rsp_code);
+	if (error != 0) {
+		printf("SAB Send/Receive Err[0x%x]:SAB_VER_SIG_REQ.\n",
+							rsp_code);
+		return HSM_GENERAL_ERROR;
+	}
+
+	if (rsp_code)
+		printf("SAB FW Error[0x%x]: SAB_VER_SIG_REQ.\n",
+							rsp_code);
+
+	return sab_rating_to_hsm_err(rsp_code);
+}
+
+/* Type given to the import of the key of a verification. */
+static hsm_key_type_t key_ref_key_type(op_verify_sign_args_t *args)
+{
+#ifdef PSA_COMPLIANT
+	return args->key_type;
+#else
+	/* The ECDSA scheme IDs are the ones of the curves key types. */
+	if (args->scheme_id == HSM_SIGNATURE_SCHEME_DSA_SM2_FP_256_SM3) {
+		return HSM_KEY_TYPE_DSA_SM2_FP_256;
+	}
+
+	return (hsm_key_type_t)args->scheme_id;
+#endif
+}
+
+static uint64_t key_ref_hash(op_verify_sign_args_t *args)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	uint32_t i;
+
+	for (i = 0u; i < args->key_size; i++) {
+		h = (h ^ args->key[i]) * 0x100000001b3ull;
+	}
+
+	return h ^ key_ref_key_type(args);
+}
+
+static struct key_ref *key_ref_find(struct key_ref_cache *c,
+				    op_verify_sign_args_t *args,
+				    uint64_t hash)
+{
+	struct key_ref *e;
+	uint32_t i;
+
+	for (i = 0u; i < c->used; i++) {
+		e = &c->slots[i];
+		if ((e->hash == hash) && (e->key_size == args->key_size)
+		    && (e->key_type == key_ref_key_type(args))
+		    && (memcmp(e->key, args->key, e->key_size) == 0)) {
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+static hsm_err_t key_ref_import(struct key_ref_cache *c, struct key_ref *e)
+{
+	op_import_public_key_args_t import_args = {0};
+
+	import_args.key = e->key;
+	import_args.key_size = e->key_size;
+	import_args.key_type = e->key_type;
+
+	return hsm_import_public_key(c->flow->serv->service_hdl, &import_args,
+				     &e->ref);
+}
+
+static hsm_err_t key_ref_open_flow(struct key_ref_cache *c)
+{
+	open_svc_sign_ver_args_t args = {0};
+	struct hsm_service_hdl_s *serv_ptr;
+	struct key_ref_flow *flow;
+	hsm_err_t err;
+
+	flow = calloc(1, sizeof(struct key_ref_flow));
+	if (flow == NULL) {
+		return HSM_OUT_OF_MEMORY;
+	}
+	serv_ptr = add_service(c->session);
+	if (serv_ptr == NULL) {
+		free(flow);
+		return HSM_GENERAL_ERROR;
+	}
+	err = open_sign_ver(c->session, serv_ptr, &args);
+	if (err != HSM_NO_ERROR) {
+		delete_service(serv_ptr);
+		free(flow);
+		return err;
+	}
+	register_service(serv_ptr);
+	flow->serv = serv_ptr;
+	flow->users = 1u;
+	c->flow = flow;
+
+	return HSM_NO_ERROR;
+}
+
+static void key_ref_put_flow(struct key_ref_flow *flow)
+{
+	if (__atomic_sub_fetch(&flow->users, 1u, __ATOMIC_ACQ_REL) == 0u) {
+		close_sign_ver(flow->serv);
+		delete_service(flow->serv);
+		free(flow);
+	}
+}
+
+/* Drop the service flow of the cache and the keys imported on it. */
+static void key_ref_close_flow(struct key_ref_cache *c)
+{
+	if (c->flow != NULL) {
+		key_ref_put_flow(c->flow);
+		c->flow = NULL;
+	}
+}
+
+static int key_ref_cmp(const void *a, const void *b)
+{
+	const struct key_ref *ea = (const struct key_ref *)a;
+	const struct key_ref *eb = (const struct key_ref *)b;
+
+	return (ea->last_use < eb->last_use) - (ea->last_use > eb->last_use);
+}
+
+/*
+ * Release all the imported keys with the service flow of the cache, then
+ * import again the most recently used half. Write lock held.
+ */
+static void key_ref_recycle(struct key_ref_cache *c)
+{
+	uint32_t i, keep, kept = 0u;
+
+	qsort(c->slots, c->used, sizeof(struct key_ref), key_ref_cmp);
+	keep = c->used / 2u;
+	c->stats.evictions += c->used - keep;
+	c->stats.recycles++;
+
+	key_ref_close_flow(c);
+	if (key_ref_open_flow(c) != HSM_NO_ERROR) {
+		c->stats.evictions += keep;
+		c->used = 0u;
+		return;
+	}
+	for (i = 0u; i < keep; i++) {
+		if (key_ref_import(c, &c->slots[i]) != HSM_NO_ERROR) {
+			c->stats.evictions++;
+			continue;
+		}
+		if (kept != i) {
+			c->slots[kept] = c->slots[i];
+		}
+		kept++;
+	}
+	c->used = kept;
+}
+
+/*
+ * Import the key of a verification, write lock held. The flow dropped by an
+ * invalidation is opened again here, on the first key imported after it.
+ */
+static bool key_ref_add(struct key_ref_cache *c, op_verify_sign_args_t *args,
+			uint64_t hash)
+{
+	struct key_ref *e;
+	hsm_err_t err;
+
+	if (c->used == c->nb_slots) {
+		key_ref_recycle(c);
+	}
+	if ((c->flow == NULL) && (key_ref_open_flow(c) != HSM_NO_ERROR)) {
+		return false;
+	}
+
+	e = &c->slots[c->used];
+	e->hash = hash;
+	e->key_type = key_ref_key_type(args);
+	e->key_size = args->key_size;
+	(void)memcpy(e->key, args->key, args->key_size);
+	e->last_use = KEY_REF_ADD(c->tick, 1u);
+
+	err = key_ref_import(c, e);
+	if ((err == HSM_OUT_OF_MEMORY) && (c->used > 0u)) {
+		/* Fewer slots in the enclave than in the cache. */
+		key_ref_recycle(c);
+		if (c->flow == NULL) {
+			return false;
+		}
+		c->slots[c->used] = *e;
+		e = &c->slots[c->used];
+		err = key_ref_import(c, e);
+	}
+	if (err != HSM_NO_ERROR) {
+		return false;
+	}
+	c->used++;
+	c->stats.misses++;
+
+	return true;
+}
+
+/* References imported before the last key import or deletion on the session. */
+static bool key_ref_stale(struct key_ref_cache *c)
+{
+	return c->key_gen != __atomic_load_n(&c->session->key_gen,
+					     __ATOMIC_ACQUIRE);
+}
+
+/* Drop all the references, write lock held. */
+static void key_ref_invalidate(struct key_ref_cache *c)
+{
+	c->key_gen = __atomic_load_n(&c->session->key_gen, __ATOMIC_ACQUIRE);
+	if (c->used > 0u) {
+		c->stats.invalidations++;
+		c->stats.evictions += c->used;
+		c->used = 0u;
+	}
+	key_ref_close_flow(c);
+}
+
+/*
+ * Verify with the reference of the key imported by the cache, importing it
+ * if needed. Return false if the verification must be sent as is.
+ */
+static bool key_ref_verify(struct key_ref_cache *c,
+			   op_verify_sign_args_t *args, hsm_err_t *err)
+{
+	op_verify_sign_args_t ref_args;
+	struct key_ref_flow *flow = NULL;
+	struct key_ref *e;
+	uint64_t hash;
+	uint32_t ref = 0u, attempt;
+	bool imported = false;
+
+	if ((args->key == NULL) || (args->key_size == 0u)
+	    || (args->key_size > HSM_KEY_REF_CACHE_KEY_MAX)
+	    || ((args->flags & HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL) != 0u)) {
+		return false;
+	}
+
+	hash = key_ref_hash(args);
+	for (attempt = 0u; (attempt < 2u) && (flow == NULL); attempt++) {
+		(void)pthread_rwlock_rdlock(&c->lock);
+		e = NULL;
+		if (c->enabled && (c->flow != NULL) && !key_ref_stale(c)) {
+			e = key_ref_find(c, args, hash);
+		}
+		if (e != NULL) {
+			__atomic_store_n(&e->last_use, KEY_REF_ADD(c->tick, 1u),
+					 __ATOMIC_RELAXED);
+			if (!imported) {
+				(void)KEY_REF_ADD(c->stats.hits, 1u);
+			}
+			ref = e->ref;
+			flow = c->flow;
+			(void)KEY_REF_ADD(flow->users, 1u);
+		}
+		(void)pthread_rwlock_unlock(&c->lock);
+
+		if ((flow == NULL) && (attempt == 0u)) {
+			(void)pthread_rwlock_wrlock(&c->lock);
+			if (c->enabled) {
+				if (key_ref_stale(c)) {
+					key_ref_invalidate(c);
+				}
+				if (key_ref_find(c, args, hash) == NULL) {
+					imported = key_ref_add(c, args, hash);
+				}
+			}
+			(void)pthread_rwlock_unlock(&c->lock);
+		}
+	}
+	if (flow == NULL) {
+		return false;
+	}
+
+	ref_args = *args;
+	ref_args.key = (uint8_t *)&ref;
+	ref_args.key_size = (uint16_t)sizeof(ref);
+	ref_args.flags |= HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL;
+	*err = verify_send(flow->serv, &ref_args);
+	args->verification_status = ref_args.verification_status;
+	key_ref_put_flow(flow);
+
+	return true;
+}
+
+static void key_ref_free(struct key_ref_cache *c)
+{
+	key_ref_close_flow(c);
+	(void)pthread_rwlock_destroy(&c->lock);
+	free(c->slots);
+	free(c);
+}
+
+/* Release the cache of a service flow being closed. */
+static void key_ref_drop(struct hsm_service_hdl_s *serv_ptr)
+{
+	struct key_ref_cache *c = serv_ptr->key_refs;
+	struct key_ref_cache **prev;
+
+	if (c == NULL) {
+		return;
+	}
+	(void)pthread_mutex_lock(&key_ref_caches.lock);
+	for (prev = &key_ref_caches.list; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == c) {
+			*prev = c->next;
+			break;
+		}
+	}
+	(void)pthread_mutex_unlock(&key_ref_caches.lock);
+	serv_ptr->key_refs = NULL;
+	key_ref_free(c);
+}
+
+void key_ref_close_session(hsm_hdl_t session_hdl)
+{
+	struct key_ref_cache *c, **prev, *dropped = NULL;
+
+	(void)pthread_mutex_lock(&key_ref_caches.lock);
+	prev = &key_ref_caches.list;
+	while (*prev != NULL) {
+		c = *prev;
+		if (c->session_hdl == session_hdl) {
+			*prev = c->next;
+			c->next = dropped;
+			dropped = c;
+		} else {
+			prev = &c->next;
+		}
+	}
+	(void)pthread_mutex_unlock(&key_ref_caches.lock);
+
+	/* Their services are freed with the session. */
+	while (dropped != NULL) {
+		c = dropped;
+		dropped = c->next;
+		key_ref_free(c);
+	}
+}
+
+/* Get the cache of a service flow, created with nb_slots slots if needed. */
+static struct key_ref_cache *key_ref_get(struct hsm_service_hdl_s *serv_ptr,
+					 uint32_t nb_slots)
+{
+	struct key_ref_cache *c;
+
+	(void)pthread_mutex_lock(&key_ref_caches.lock);
+	c = serv_ptr->key_refs;
+	if (c == NULL) {
+		c = calloc(1, sizeof(struct key_ref_cache));
+	}
+	if ((c != NULL) && (c->slots == NULL)) {
+		c->slots = calloc(nb_slots, sizeof(struct key_ref));
+		if (c->slots == NULL) {
+			free(c);
+			c = NULL;
+		}
+	}
+	if ((c != NULL) && (serv_ptr->key_refs == NULL)) {
+		(void)pthread_rwlock_init(&c->lock, NULL);
+		c->session_hdl = serv_ptr->session->session_hdl;
+		c->session = serv_ptr->session;
+		c->nb_slots = nb_slots;
+		c->next = key_ref_caches.list;
+		key_ref_caches.list = c;
+		__atomic_store_n(&serv_ptr->key_refs, c, __ATOMIC_RELEASE);
+	}
+	(void)pthread_mutex_unlock(&key_ref_caches.lock);
+
+	return c;
+}
+
+hsm_err_t hsm_set_key_ref_cache(hsm_hdl_t signature_ver_hdl,
+				uint32_t nb_slots)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct key_ref_cache *c;
+	hsm_err_t err = HSM_NO_ERROR;
+
+	do {
+		serv_ptr = service_hdl_to_ptr(signature_ver_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+		c = __atomic_load_n(&serv_ptr->key_refs, __ATOMIC_ACQUIRE);
+		if ((c == NULL) && (nb_slots == 0u)) {
+			break;
+		}
+		if (c == NULL) {
+			c = key_ref_get(serv_ptr, nb_slots);
+		}
+		if (c == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
+		if ((nb_slots != 0u) && (nb_slots != c->nb_slots)) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+
+		(void)pthread_rwlock_wrlock(&c->lock);
+		if (nb_slots == 0u) {
+			c->enabled = false;
+			c->used = 0u;
+			key_ref_close_flow(c);
+		} else if (!c->enabled) {
+			(void)memset(&c->stats, 0, sizeof(c->stats));
+			c->stats.slots = nb_slots;
+			c->key_gen = __atomic_load_n(&c->session->key_gen,
+						     __ATOMIC_ACQUIRE);
+			err = key_ref_open_flow(c);
+			c->enabled = (err == HSM_NO_ERROR);
+		}
+		(void)pthread_rwlock_unlock(&c->lock);
+	} while (false);
+
+	return err;
+}
+
+hsm_err_t hsm_get_key_ref_cache_stats(hsm_hdl_t signature_ver_hdl,
+				      hsm_key_ref_cache_stats_t *stats)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct key_ref_cache *c;
+	hsm_err_t err = HSM_NO_ERROR;
+
+	do {
+		if (stats == NULL) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		serv_ptr = service_hdl_to_ptr(signature_ver_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+		c = __atomic_load_n(&serv_ptr->key_refs, __ATOMIC_ACQUIRE);
+		if (c == NULL) {
+			(void)memset(stats, 0, sizeof(*stats));
+			break;
+		}
+
+		(void)pthread_rwlock_rdlock(&c->lock);
+		*stats = c->stats;
+		stats->used = c->used;
+		(void)pthread_rwlock_unlock(&c->lock);
+	} while (false);
+
+	return err;
+}
 
 hsm_err_t hsm_open_signature_verification_service(hsm_hdl_t session_hdl,
 						open_svc_sign_ver_args_t *args,
 						hsm_hdl_t *signature_ver_hdl)
 {
-	struct hsm_session_hdl_s *sess_ptr;
-	struct hsm_service_hdl_s *serv_ptr;
-	int32_t error = 1;
+	struct hsm_session_hdl_s *sess_ptr, *m_ptr;
+	struct hsm_service_hdl_s *serv_ptr, *member;
+	open_svc_sign_ver_args_t m_args;
 	hsm_err_t err = HSM_GENERAL_ERROR;
-	uint32_t rsp_code;
 
 	do {
 		if ((args == NULL) || (signature_ver_hdl == NULL)) {
@@ -46,25 +608,34 @@ hsm_err_t hsm_open_signature_verification_service(hsm_hdl_t session_hdl,
 			break;
 		}
 
-		error = process_sab_msg(serv_ptr->session->phdl,
-					serv_ptr->session->mu_type,
-					SAB_SIGNATURE_VERIFICATION_OPEN_REQ,
-					MT_SAB_VERIFY_SIGN,
-					(uint32_t)session_hdl,
-					args, &rsp_code);
-
-
-		if (error != 0) {
-			delete_service(serv_ptr);
-			break;
+		err = open_sign_ver(sess_ptr, serv_ptr, args);
+		/* Same service on the other sessions of a channel group. */
+		for (m_ptr = sess_ptr->member;
+		     (err == HSM_NO_ERROR) && (m_ptr != NULL);
+		     m_ptr = m_ptr->member) {
+			member = calloc(1, sizeof(struct hsm_service_hdl_s));
+			if (member == NULL) {
+				err = HSM_OUT_OF_MEMORY;
+				break;
+			}
+			member->session = m_ptr;
+			member->member = serv_ptr->member;
+			serv_ptr->member = member;
+			m_args = *args;
+			err = open_sign_ver(m_ptr, member, &m_args);
 		}
-
-		err = sab_rating_to_hsm_err(rsp_code);
 		if (err != HSM_NO_ERROR) {
+			for (member = serv_ptr; member != NULL;
+			     member = member->member) {
+				if (member->service_hdl != 0u) {
+					close_sign_ver(member);
+				}
+			}
+			serv_ptr->service_hdl = 0u;
 			delete_service(serv_ptr);
 			break;
 		}
-		serv_ptr->service_hdl = args->sig_ver_hdl;
+		register_service(serv_ptr);
 		*signature_ver_hdl = args->sig_ver_hdl;
 	} while (false);
 
@@ -73,7 +644,7 @@ hsm_err_t hsm_open_signature_verification_service(hsm_hdl_t session_hdl,
 
 hsm_err_t hsm_close_signature_verification_service(hsm_hdl_t signature_ver_hdl)
 {
-	struct hsm_service_hdl_s *serv_ptr;
+	struct hsm_service_hdl_s *serv_ptr, *member;
 	int32_t error = 1;
 	hsm_err_t err = HSM_GENERAL_ERROR;
 	uint32_t rsp_code;
@@ -85,6 +656,11 @@ hsm_err_t hsm_close_signature_verification_service(hsm_hdl_t signature_ver_hdl)
 			break;
 		}
 
+		key_ref_drop(serv_ptr);
+		for (member = serv_ptr->member; member != NULL;
+		     member = member->member) {
+			close_sign_ver(member);
+		}
 		error = process_sab_msg(serv_ptr->session->phdl,
 					serv_ptr->session->mu_type,
 					SAB_SIGNATURE_VERIFICATION_CLOSE_REQ,
@@ -105,15 +681,21 @@ hsm_err_t hsm_verify_signature(hsm_hdl_t signature_ver_hdl,
 				op_verify_sign_args_t *args,
 				hsm_verification_status_t *status)
 {
-	int32_t error = 1;
+#ifdef PSA_COMPLIANT
+	int32_t error;
+#endif
 	struct hsm_service_hdl_s *serv_ptr;
+	struct key_ref_cache *c;
 	hsm_err_t err = HSM_GENERAL_ERROR;
-	uint32_t rsp_code;
 
 	do {
 		if ((args == NULL) || (status == NULL)) {
 			break;
 		}
+		if ((args->flags & SAB_VERIFY_SIGN_FLAGS_PACKED) != 0u) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
 		serv_ptr = service_hdl_to_ptr(signature_ver_hdl);
 		if (serv_ptr == NULL) {
 			err = HSM_UNKNOWN_HANDLE;
@@ -133,25 +715,180 @@ hsm_err_t hsm_verify_signature(hsm_hdl_t signature_ver_hdl,
 		}
 #endif
 
-		error = process_sab_msg(serv_ptr->session->phdl,
-					serv_ptr->session->mu_type,
-					SAB_SIGNATURE_VERIFY_REQ,
-					MT_SAB_VERIFY_SIGN,
-					(uint32_t)signature_ver_hdl,
-					args, &rsp_code);
-		if (error != 0) {
-			printf("SAB Send/Receive Err[0x%x]:SAB_VER_SIG_REQ.\n",
-								rsp_code);
+		c = __atomic_load_n(&serv_ptr->key_refs, __ATOMIC_ACQUIRE);
+		if ((c == NULL) || !key_ref_verify(c, args, &err)) {
+			/*
+			 * Keys imported by hsm_import_public_key() are only
+			 * known to the service of the session they were
+			 * imported on.
+			 */
+			if ((args->flags & HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL) == 0u) {
+				serv_ptr = service_dispatch(serv_ptr);
+			}
+			err = verify_send(serv_ptr, args);
+		}
+		*status = args->verification_status;
+	} while (false);
+
+	return err;
+}
+
+struct verify_batch_ctx {
+	op_verify_sign_args_t *ops;
+	op_verify_sign_args_t *staged;
+	hsm_verification_status_t *status;
+	hsm_err_t err;
+};
+
+static void verify_batch_done(uint32_t idx, uint32_t error, uint32_t rsp_code,
+			      void *cb_arg)
+{
+	struct verify_batch_ctx *ctx = (struct verify_batch_ctx *)cb_arg;
+	hsm_err_t err;
+
+	if (rsp_code || (error != 0))
+		printf("SAB_VER_SIG_REQ[%u]: SAB FW Error[0x%x]:"\
+			"SAB Engine Error[0x%x]\n", idx, rsp_code, error);
+
+	err = (error != 0u) ? HSM_GENERAL_ERROR
+			    : sab_rating_to_hsm_err(rsp_code);
+	if (err == HSM_NO_ERROR) {
+		ctx->ops[idx].verification_status =
+				ctx->staged[idx].verification_status;
+		ctx->status[idx] = ctx->staged[idx].verification_status;
+	}
+	if ((ctx->err == HSM_NO_ERROR) && (err != HSM_NO_ERROR)) {
+		ctx->err = err;
+	}
+}
+
+/*
+ * Copy the inputs of the verifications in one region, key, message and
+ * signature of each one packed so that a single data buffer is set up per
+ * command. Return the copies of the arguments pointing to the region.
+ */
+static op_verify_sign_args_t *verify_batch_stage(op_verify_sign_args_t *ops,
+						 uint32_t nb_ops)
+{
+	op_verify_sign_args_t *staged;
+	uint8_t *region;
+	size_t region_sz = 0u;
+	uint32_t i;
+
+	for (i = 0u; i < nb_ops; i++) {
+		region_sz += SAB_VERIFY_SIGN_IN_SZ(ops[i].key_size)
+			     + SAB_VERIFY_SIGN_IN_SZ(ops[i].message_size)
+			     + SAB_VERIFY_SIGN_IN_SZ(ops[i].signature_size);
+	}
+
+	staged = malloc((nb_ops * sizeof(op_verify_sign_args_t)) + region_sz);
+	if (staged == NULL) {
+		return NULL;
+	}
+	region = (uint8_t *)&staged[nb_ops];
+
+	for (i = 0u; i < nb_ops; i++) {
+		staged[i] = ops[i];
+		staged[i].verification_status = 0u;
+		staged[i].flags |= SAB_VERIFY_SIGN_FLAGS_PACKED;
+
+		staged[i].key = region;
+		memcpy(region, ops[i].key, ops[i].key_size);
+		region += SAB_VERIFY_SIGN_IN_SZ(ops[i].key_size);
+
+		staged[i].message = region;
+		memcpy(region, ops[i].message, ops[i].message_size);
+		region += SAB_VERIFY_SIGN_IN_SZ(ops[i].message_size);
+
+		staged[i].signature = region;
+		memcpy(region, ops[i].signature, ops[i].signature_size);
+		region += SAB_VERIFY_SIGN_IN_SZ(ops[i].signature_size);
+	}
+
+	return staged;
+}
+
+hsm_err_t hsm_verify_signature_batch(hsm_hdl_t signature_ver_hdl,
+				     op_verify_sign_args_t *ops,
+				     uint32_t nb_ops,
+				     hsm_verification_status_t *status)
+{
+	struct hsm_service_hdl_s *serv_ptr;
+	struct verify_batch_ctx ctx;
+	op_verify_sign_args_t *staged = NULL;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	bool key_internal = false;
+	uint32_t error;
+	uint32_t i;
+
+	do {
+		if ((ops == NULL) || (status == NULL) || (nb_ops == 0u)) {
+			err = HSM_INVALID_PARAM;
 			break;
 		}
+		serv_ptr = service_hdl_to_ptr(signature_ver_hdl);
+		if (serv_ptr == NULL) {
+			err = HSM_UNKNOWN_HANDLE;
+			break;
+		}
+
+		for (i = 0u; i < nb_ops; i++) {
+			if ((ops[i].key == NULL) || (ops[i].message == NULL)
+			    || (ops[i].signature == NULL)) {
+				break;
+			}
+			if ((ops[i].flags & HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL) != 0u) {
+				key_internal = true;
+			}
+#ifdef PSA_COMPLIANT
+			if (set_key_type_n_sz(ops[i].key_type,
+					      &ops[i].key_sz,
+					      &ops[i].psa_key_type,
+					      NULL)) {
+				printf("HSM Error: Invalid Key Type is given [0x%x].\n",
+					ops[i].key_type);
+				break;
+			}
+#endif
+			status[i] = 0u;
+		}
+		if (i != nb_ops) {
+			err = HSM_INVALID_PARAM;
+			break;
+		}
+		/* All on the session the imported keys are known to. */
+		if (!key_internal) {
+			serv_ptr = service_dispatch(serv_ptr);
+		}
 
-		if (rsp_code)
-			printf("SAB FW Error[0x%x]: SAB_VER_SIG_REQ.\n",
-								rsp_code);
+		staged = verify_batch_stage(ops, nb_ops);
+		if (staged == NULL) {
+			err = HSM_OUT_OF_MEMORY;
+			break;
+		}
 
-		err = sab_rating_to_hsm_err(rsp_code);
-		*status = args->verification_status;
+		ctx.ops = ops;
+		ctx.staged = staged;
+		ctx.status = status;
+		ctx.err = HSM_NO_ERROR;
+		error = sab_queue_send_batch(serv_ptr->session->phdl,
+					     serv_ptr->session->mu_type,
+					     SAB_SIGNATURE_VERIFY_REQ,
+					     MT_SAB_VERIFY_SIGN,
+					     serv_ptr->service_hdl,
+					     staged,
+					     (uint32_t)sizeof(op_verify_sign_args_t),
+					     nb_ops,
+					     verify_batch_done,
+					     &ctx);
+		if (error != 0u) {
+			err = sab_rating_to_hsm_err(error);
+			break;
+		}
+		err = ctx.err;
 	} while (false);
 
+	free(staged);
+
 	return err;
 }
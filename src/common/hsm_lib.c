@@ -11,6 +11,7 @@
  * activate or otherwise use the software.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "hsm_api.h"
@@ -20,13 +21,27 @@
 
 #include "sab_msg_def.h"
 #include "sab_messaging.h"
+#include "sab_queue.h"
+#include "sab_buf.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
 
-static struct hsm_session_hdl_s hsm_sessions[HSM_MAX_SESSIONS] = {};
-static struct hsm_service_hdl_s hsm_services[HSM_MAX_SERVICES] = {};
 
+/* Close the other sessions of a channel group, freed with the group. */
+static void close_group_members(struct hsm_session_hdl_s *s_ptr)
+{
+	struct hsm_session_hdl_s *m_ptr;
+
+	for (m_ptr = s_ptr->member; m_ptr != NULL; m_ptr = m_ptr->member) {
+		(void)sab_close_session_command(m_ptr->phdl,
+						m_ptr->session_hdl,
+						m_ptr->mu_type);
+		sab_queue_close(m_ptr->phdl);
+		sab_buf_release(m_ptr->phdl);
+		plat_os_abs_close_session(m_ptr->phdl);
+	}
+}
 
 hsm_err_t hsm_close_session(hsm_hdl_t session_hdl)
 {
@@ -41,11 +56,24 @@ hsm_err_t hsm_close_session(hsm_hdl_t session_hdl)
 			break;
 		}
 
+#ifndef PSA_COMPLIANT
+		/* No more signature preparation on its services. */
+		sign_pool_close_session(session_hdl);
+#endif
+		/* Close the service flows of the key reference caches. */
+		key_ref_close_session(session_hdl);
+		/* Complete the pending asynchronous requests first. */
+		sab_queue_async_stop(s_ptr->phdl);
+
+		close_group_members(s_ptr);
+
 		sab_err = sab_close_session_command(s_ptr->phdl,
 						session_hdl,
 						s_ptr->mu_type);
 		err = sab_rating_to_hsm_err(sab_err);
 
+		sab_queue_close(s_ptr->phdl);
+		sab_buf_release(s_ptr->phdl);
 		plat_os_abs_close_session(s_ptr->phdl);
 
 		delete_session(s_ptr);
@@ -74,13 +102,76 @@ static const uint32_t mu_table[MU_CONFIG_NB] = {
 	MU_CHANNEL_V2X_SV0,       // low latency, high prio, no key store
 };
 
+/*
+ * Open the session of a channel group on one more MU. It is only reached
+ * through the session of the group, from its list of members.
+ */
+static hsm_err_t open_group_member(struct hsm_session_hdl_s *s_ptr,
+				   uint8_t mu_priority,
+				   uint8_t session_priority,
+				   uint8_t operating_mode)
+{
+	struct hsm_session_hdl_s *m_ptr;
+	struct plat_mu_params mu_params;
+	hsm_err_t err = HSM_GENERAL_ERROR;
+	uint32_t sab_err;
+
+	m_ptr = calloc(1, sizeof(struct hsm_session_hdl_s));
+	if (m_ptr == NULL) {
+		return HSM_OUT_OF_MEMORY;
+	}
+
+	do {
+		m_ptr->mu_type = mu_table[MU_CONFIG(mu_priority, operating_mode)];
+		m_ptr->mu_priority = mu_priority;
+		m_ptr->phdl = plat_os_abs_open_mu_channel(m_ptr->mu_type,
+							  &mu_params);
+		if (m_ptr->phdl == NULL) {
+			break;
+		}
+		if (sab_queue_open(m_ptr->phdl) != 0u) {
+			break;
+		}
+
+		/* The operations keep the priority of the group. */
+		sab_err = sab_open_session_command(m_ptr->phdl,
+						&m_ptr->session_hdl,
+						m_ptr->mu_type,
+						mu_params.mu_id,
+						mu_params.interrupt_idx,
+						mu_params.tz,
+						mu_params.did,
+						session_priority,
+						operating_mode);
+		err = sab_rating_to_hsm_err(sab_err);
+	} while (false);
+
+	if (err != HSM_NO_ERROR) {
+		if (m_ptr->phdl != NULL) {
+			sab_queue_close(m_ptr->phdl);
+			plat_os_abs_close_session(m_ptr->phdl);
+		}
+		free(m_ptr);
+		return err;
+	}
+
+	sab_queue_track_load(m_ptr->phdl);
+	m_ptr->member = s_ptr->member;
+	s_ptr->member = m_ptr;
+
+	return HSM_NO_ERROR;
+}
+
 hsm_err_t hsm_open_session(open_session_args_t *args, hsm_hdl_t *session_hdl)
 {
 	struct hsm_session_hdl_s *s_ptr = NULL;
+	struct plat_os_abs_hdl *phdl;
 	struct plat_mu_params mu_params;
+	uint32_t mu_type;
 	hsm_err_t err = HSM_GENERAL_ERROR;
 	uint32_t sab_err;
 	uint8_t session_priority, operating_mode;
+	bool group;
 
 	do {
 		if ((args == NULL) || (session_hdl == NULL)) {
@@ -98,20 +189,33 @@ hsm_err_t hsm_open_session(open_session_args_t *args, hsm_hdl_t *session_hdl)
 			break;
 		}
 
-		s_ptr = add_session();
-		if (s_ptr == NULL) {
-			break;
-		}
-
 		if (plat_os_abs_has_v2x_hw() == 0U) {
 			/* SECO only HW: low latency and high priority not supported. */
 			operating_mode &= ~(uint8_t)HSM_OPEN_SESSION_LOW_LATENCY_MASK;
 			session_priority = HSM_OPEN_SESSION_PRIORITY_LOW;
 		}
 
-		s_ptr->mu_type = mu_table[MU_CONFIG((session_priority), (operating_mode))];
-		s_ptr->phdl = plat_os_abs_open_mu_channel(s_ptr->mu_type, &mu_params);
-		if (s_ptr->phdl == NULL) {
+		/* Only the V2X MUs without key store are grouped. */
+		group = ((operating_mode & HSM_OPEN_SESSION_CHANNEL_GROUP_MASK) != 0U)
+			&& ((operating_mode & HSM_OPEN_SESSION_LOW_LATENCY_MASK) != 0U)
+			&& ((operating_mode & HSM_OPEN_SESSION_NO_KEY_STORE_MASK) != 0U);
+		operating_mode &= ~(uint8_t)HSM_OPEN_SESSION_CHANNEL_GROUP_MASK;
+
+		mu_type = mu_table[MU_CONFIG((session_priority), (operating_mode))];
+		phdl = plat_os_abs_open_mu_channel(mu_type, &mu_params);
+		if (phdl == NULL) {
+			break;
+		}
+
+		/* Reserve the slot with the channel, other threads may open too. */
+		s_ptr = add_session(phdl, mu_type);
+		if (s_ptr == NULL) {
+			plat_os_abs_close_session(phdl);
+			break;
+		}
+		s_ptr->mu_priority = session_priority;
+
+		if (sab_queue_open(phdl) != 0u) {
 			break;
 		}
 
@@ -129,19 +233,33 @@ hsm_err_t hsm_open_session(open_session_args_t *args, hsm_hdl_t *session_hdl)
 			break;
 		}
 
+		if (group) {
+			sab_queue_track_load(phdl);
+			err = open_group_member(s_ptr,
+					(session_priority == HSM_OPEN_SESSION_PRIORITY_HIGH)
+						? HSM_OPEN_SESSION_PRIORITY_LOW
+						: HSM_OPEN_SESSION_PRIORITY_HIGH,
+					session_priority,
+					operating_mode);
+			if (err != HSM_NO_ERROR) {
+				break;
+			}
+		}
+
+		register_session(s_ptr);
 		*session_hdl = s_ptr->session_hdl;
 	} while (false);
 
 	if (err != HSM_NO_ERROR) {
 		if (s_ptr != NULL) {
 			if (s_ptr->session_hdl != 0u) {
-				(void)hsm_close_session(s_ptr->session_hdl);
-			} else if (s_ptr->phdl != NULL) {
-				plat_os_abs_close_session(s_ptr->phdl);
-				delete_session(s_ptr);
-			} else {
-				delete_session(s_ptr);
+				(void)sab_close_session_command(s_ptr->phdl,
+								s_ptr->session_hdl,
+								s_ptr->mu_type);
 			}
+			sab_queue_close(s_ptr->phdl);
+			plat_os_abs_close_session(s_ptr->phdl);
+			delete_session(s_ptr);
 		}
 		if (session_hdl != NULL) {
 			*session_hdl = 0u; /* force an invalid value.*/
@@ -196,6 +314,7 @@ hsm_err_t hsm_open_key_store_service(hsm_hdl_t session_hdl,
 			break;
 		}
 
+		register_service(serv_ptr);
 		*key_store_hdl = serv_ptr->service_hdl;
 	} while (false);
 
@@ -269,7 +388,7 @@ hsm_err_t hsm_open_key_management_service(hsm_hdl_t key_store_hdl,
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(key_mgt_serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(key_mgt_serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_key_management_open_msg),
 			(uint32_t *)&rsp,
@@ -286,6 +405,7 @@ hsm_err_t hsm_open_key_management_service(hsm_hdl_t key_store_hdl,
 		}
 
 		key_mgt_serv_ptr->service_hdl = rsp.key_management_handle;
+		register_service(key_mgt_serv_ptr);
 		*key_management_hdl = rsp.key_management_handle;
 	} while (false);
 
@@ -322,7 +442,7 @@ hsm_err_t hsm_manage_key_group(hsm_hdl_t key_management_hdl,
 		cmd.rsv = 0;
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_manage_key_group_msg),
 			(uint32_t *)&rsp,
@@ -365,15 +485,15 @@ hsm_err_t hsm_butterfly_key_expansion(hsm_hdl_t key_management_hdl,
 			serv_ptr->session->mu_type);
 		cmd.key_management_handle = key_management_hdl;
 		cmd.key_identifier = args->key_identifier;
-		cmd.expansion_function_value_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.expansion_function_value_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->expansion_function_value,
 				args->expansion_function_value_size,
 				DATA_BUF_IS_INPUT);
-		cmd.hash_value_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.hash_value_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->hash_value,
 				args->hash_value_size,
 				DATA_BUF_IS_INPUT);
-		cmd.pr_reconstruction_value_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.pr_reconstruction_value_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->pr_reconstruction_value,
 				args->pr_reconstruction_value_size,
 				DATA_BUF_IS_INPUT);
@@ -382,7 +502,7 @@ hsm_err_t hsm_butterfly_key_expansion(hsm_hdl_t key_management_hdl,
 		cmd.pr_reconstruction_value_size = args->pr_reconstruction_value_size;
 		cmd.flags = args->flags;
 		cmd.dest_key_identifier = *(args->dest_key_identifier);
-		cmd.output_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.output_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->output,
 				args->output_size,
 				0u);
@@ -396,7 +516,7 @@ hsm_err_t hsm_butterfly_key_expansion(hsm_hdl_t key_management_hdl,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_butterfly_key_exp_msg),
 			(uint32_t *)&rsp,
@@ -440,7 +560,7 @@ hsm_err_t hsm_close_key_management_service(hsm_hdl_t key_management_hdl)
 		cmd.key_management_handle = key_management_hdl;
 
 
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_key_management_close_msg),
 			(uint32_t *)&rsp,
@@ -479,19 +599,19 @@ hsm_err_t hsm_ecies_decryption(hsm_hdl_t cipher_hdl, op_ecies_dec_args_t *args)
 			serv_ptr->session->mu_type);
 		cmd.cipher_handle = cipher_hdl;
 		cmd.key_id = args->key_identifier;
-		cmd.input_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.input_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->input,
 				args->input_size,
 				DATA_BUF_IS_INPUT);
-		cmd.p1_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.p1_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->p1,
 				args->p1_size,
 				DATA_BUF_IS_INPUT);
-		cmd.p2_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.p2_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->p2,
 				args->p2_size,
 				DATA_BUF_IS_INPUT);
-		cmd.output_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.output_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->output,
 				args->output_size,
 				0u);
@@ -507,7 +627,7 @@ hsm_err_t hsm_ecies_decryption(hsm_hdl_t cipher_hdl, op_ecies_dec_args_t *args)
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_ecies_decrypt_msg),
 			(uint32_t *)&rsp,
@@ -550,7 +670,7 @@ hsm_err_t hsm_import_public_key(hsm_hdl_t signature_ver_hdl,
 			(uint32_t)sizeof(struct sab_import_pub_key_msg),
 			serv_ptr->session->mu_type);
 		cmd.sig_ver_hdl = signature_ver_hdl;
-		cmd.key_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.key_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 					args->key,
 					args->key_size,
 					DATA_BUF_IS_INPUT);
@@ -559,7 +679,7 @@ hsm_err_t hsm_import_public_key(hsm_hdl_t signature_ver_hdl,
 		cmd.flags = args->flags;
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_import_pub_key_msg),
 			(uint32_t *)&rsp,
@@ -609,6 +729,7 @@ hsm_err_t hsm_open_rng_service(hsm_hdl_t session_hdl,
 			delete_service(serv_ptr);
 			break;
 		}
+		register_service(serv_ptr);
 		*rng_hdl = serv_ptr->service_hdl;
 	} while (false);
 
@@ -663,14 +784,14 @@ hsm_err_t hsm_get_random(hsm_hdl_t rng_hdl, op_get_random_args_t *args)
 			(uint32_t)sizeof(struct sab_cmd_get_rnd_msg),
 			serv_ptr->session->mu_type);
 		cmd.rng_handle = rng_hdl;
-		cmd.rnd_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.rnd_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 					args->output,
 					args->random_size,
 					0u);
 		cmd.rnd_size = args->random_size;
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_get_rnd_msg),
 			(uint32_t *)&rsp,
@@ -700,6 +821,10 @@ hsm_err_t hsm_pub_key_reconstruction(hsm_hdl_t session_hdl,
 			err = HSM_UNKNOWN_HANDLE;
 			break;
 		}
+		if (pub_key_cache_rec_get(args)) {
+			err = HSM_NO_ERROR;
+			break;
+		}
 
 		/* Send the keys store open command to platform. */
 		plat_fill_cmd_msg_hdr(&cmd.hdr,
@@ -708,22 +833,22 @@ hsm_err_t hsm_pub_key_reconstruction(hsm_hdl_t session_hdl,
 			sess_ptr->mu_type);
 		cmd.sesssion_handle = session_hdl;
 		cmd.pu_address_ext = 0u;
-		cmd.pu_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.pu_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->pub_rec,
 					args->pub_rec_size,
 					DATA_BUF_IS_INPUT);
 		cmd.hash_address_ext = 0u;
-		cmd.hash_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.hash_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->hash,
 					args->hash_size,
 					DATA_BUF_IS_INPUT);
 		cmd.ca_key_address_ext = 0u;
-		cmd.ca_key_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.ca_key_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->ca_key,
 					args->ca_key_size,
 					DATA_BUF_IS_INPUT);
 		cmd.out_key_address_ext = 0u;
-		cmd.out_key_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.out_key_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->out_key,
 					args->out_key_size,
 					0u);
@@ -739,7 +864,7 @@ hsm_err_t hsm_pub_key_reconstruction(hsm_hdl_t session_hdl,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_public_key_reconstruct_msg),
 			(uint32_t *)&rsp,
@@ -749,6 +874,9 @@ hsm_err_t hsm_pub_key_reconstruction(hsm_hdl_t session_hdl,
 		}
 
 		err = sab_rating_to_hsm_err(rsp.rsp_code);
+		if (err == HSM_NO_ERROR) {
+			pub_key_cache_rec_put(args);
+		}
 	} while(false);
 
 	return err;
@@ -769,6 +897,10 @@ hsm_err_t hsm_pub_key_decompression(hsm_hdl_t session_hdl,
 			err = HSM_UNKNOWN_HANDLE;
 			break;
 		}
+		if (pub_key_cache_dec_get(args)) {
+			err = HSM_NO_ERROR;
+			break;
+		}
 
 		/* Send the keys store open command to platform. */
 		plat_fill_cmd_msg_hdr(&cmd.hdr,
@@ -777,12 +909,12 @@ hsm_err_t hsm_pub_key_decompression(hsm_hdl_t session_hdl,
 			sess_ptr->mu_type);
 		cmd.sesssion_handle = session_hdl;
 		cmd.input_address_ext = 0u;
-		cmd.input_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.input_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->key,
 					args->key_size,
 					DATA_BUF_IS_INPUT);
 		cmd.output_address_ext = 0u;
-		cmd.output_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.output_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->out_key,
 					args->out_key_size,
 					0u);
@@ -796,7 +928,7 @@ hsm_err_t hsm_pub_key_decompression(hsm_hdl_t session_hdl,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_public_key_decompression_msg),
 			(uint32_t *)&rsp,
@@ -806,6 +938,9 @@ hsm_err_t hsm_pub_key_decompression(hsm_hdl_t session_hdl,
 		}
 
 		err = sab_rating_to_hsm_err(rsp.rsp_code);
+		if (err == HSM_NO_ERROR) {
+			pub_key_cache_dec_put(args);
+		}
 	} while(false);
 
 	return err;
@@ -833,27 +968,27 @@ hsm_err_t hsm_ecies_encryption(hsm_hdl_t session_hdl, op_ecies_enc_args_t *args)
 			sess_ptr->mu_type);
 		cmd.sesssion_handle = session_hdl;
 		cmd.input_addr_ext = 0u;
-		cmd.input_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.input_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->input,
 					args->input_size,
 					DATA_BUF_IS_INPUT);
 		cmd.key_addr_ext = 0u;
-		cmd.key_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.key_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->pub_key,
 					args->pub_key_size,
 					DATA_BUF_IS_INPUT);
 		cmd.p1_addr_ext = 0u;
-		cmd.p1_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.p1_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->p1,
 					args->p1_size,
 					DATA_BUF_IS_INPUT);
 		cmd.p2_addr_ext = 0u;
-		cmd.p2_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.p2_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->p2,
 					args->p2_size,
 					DATA_BUF_IS_INPUT);
 		cmd.output_addr_ext = 0u;
-		cmd.output_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.output_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 					args->output,
 					args->out_size,
 					0u);
@@ -871,7 +1006,7 @@ hsm_err_t hsm_ecies_encryption(hsm_hdl_t session_hdl, op_ecies_enc_args_t *args)
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_ecies_encrypt_msg),
 			(uint32_t *)&rsp,
@@ -908,7 +1043,7 @@ hsm_err_t hsm_pub_key_recovery(hsm_hdl_t key_store_hdl, op_pub_key_recovery_args
 		cmd.key_store_handle = key_store_hdl;
 		cmd.key_identifier = args->key_identifier;
 		cmd.out_key_addr_ext = 0u;
-		cmd.out_key_addr = (uint32_t)plat_os_abs_data_buf(key_store_serv_ptr->session->phdl,
+		cmd.out_key_addr = (uint32_t)sab_queue_data_buf(key_store_serv_ptr->session->phdl,
 					args->out_key,
 					args->out_key_size,
 					0u);
@@ -920,7 +1055,7 @@ hsm_err_t hsm_pub_key_recovery(hsm_hdl_t key_store_hdl, op_pub_key_recovery_args
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(key_store_serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(key_store_serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_pub_key_recovery_msg),
 			(uint32_t *)&rsp,
@@ -976,7 +1111,7 @@ hsm_err_t hsm_open_data_storage_service(hsm_hdl_t key_store_hdl,
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(data_storage_serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(data_storage_serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_data_storage_open_msg),
 			(uint32_t *)&rsp,
@@ -993,6 +1128,7 @@ hsm_err_t hsm_open_data_storage_service(hsm_hdl_t key_store_hdl,
 		}
 
 		data_storage_serv_ptr->service_hdl = rsp.data_storage_handle;
+		register_service(data_storage_serv_ptr);
 		*data_storage_hdl = rsp.data_storage_handle;
 	} while (false);
 
@@ -1021,7 +1157,7 @@ hsm_err_t hsm_close_data_storage_service(hsm_hdl_t data_storage_hdl)
 		cmd.data_storage_handle = data_storage_hdl;
 
 
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_data_storage_close_msg),
 			(uint32_t *)&rsp,
@@ -1063,7 +1199,7 @@ hsm_err_t hsm_data_storage(hsm_hdl_t data_storage_hdl,
 			(uint32_t)sizeof(struct sab_cmd_data_storage_msg),
 			serv_ptr->session->mu_type);
 		cmd.data_storage_handle = data_storage_hdl;
-		cmd.data_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.data_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 					args->data,
 					args->data_size,
 					(((args->flags & HSM_OP_DATA_STORAGE_FLAGS_STORE)==HSM_OP_DATA_STORAGE_FLAGS_STORE)? DATA_BUF_IS_INPUT : 0u));
@@ -1076,7 +1212,7 @@ hsm_err_t hsm_data_storage(hsm_hdl_t data_storage_hdl,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_data_storage_msg),
 			(uint32_t *)&rsp,
@@ -1120,14 +1256,14 @@ hsm_err_t hsm_auth_enc(hsm_hdl_t cipher_hdl, op_auth_enc_args_t* args)
 		cmd.cipher_handle = cipher_hdl;
 		cmd.key_id = args->key_identifier;
 		if (args->iv_size != 0) {
-			cmd.iv_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+			cmd.iv_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 									args->iv, args->iv_size, DATA_BUF_IS_INPUT);
 		}
 		else {
 			cmd.iv_address = 0;
 		}
 		cmd.iv_size = args->iv_size;
-		cmd.aad_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.aad_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 							args->aad,
 							args->aad_size,
 							DATA_BUF_IS_INPUT);
@@ -1135,11 +1271,11 @@ hsm_err_t hsm_auth_enc(hsm_hdl_t cipher_hdl, op_auth_enc_args_t* args)
 		cmd.rsv = 0;
 		cmd.ae_algo = args->ae_algo;
 		cmd.flags = args->flags;
-		cmd.input_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.input_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 							args->input,
 							args->input_size,
 							DATA_BUF_IS_INPUT);
-		cmd.output_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.output_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 							args->output,
 							args->output_size,
 							0u);
@@ -1150,7 +1286,7 @@ hsm_err_t hsm_auth_enc(hsm_hdl_t cipher_hdl, op_auth_enc_args_t* args)
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_auth_enc_msg),
 			(uint32_t *)&rsp,
@@ -1196,7 +1332,7 @@ hsm_err_t hsm_export_root_key_encryption_key (hsm_hdl_t session_hdl,
 			sess_ptr->mu_type);
 		cmd.session_handle = session_hdl;
 		cmd.root_kek_address_ext = 0;
-		cmd.root_kek_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.root_kek_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 							args->out_root_kek,
 							args->root_kek_size,
 							0u);
@@ -1207,7 +1343,7 @@ hsm_err_t hsm_export_root_key_encryption_key (hsm_hdl_t session_hdl,
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_root_kek_export_msg),
 			(uint32_t *)&rsp,
@@ -1271,16 +1407,16 @@ hsm_err_t hsm_sm2_get_z(hsm_hdl_t session_hdl, op_sm2_get_z_args_t *args)
 			sess_ptr->mu_type);
 		cmd.session_handle = session_hdl;
 		cmd.input_address_ext = 0u;
-		cmd.public_key_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.public_key_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 								args->public_key,
 								args->public_key_size,
 								DATA_BUF_IS_INPUT);
-		cmd.id_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.id_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 							args->identifier,
 							args->id_size,
 							DATA_BUF_IS_INPUT);
 		cmd.output_address_ext = 0U;
-	    cmd.z_value_address = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+	    cmd.z_value_address = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 								args->z_value,
 								args->z_size,
 								0u);
@@ -1294,7 +1430,7 @@ hsm_err_t hsm_sm2_get_z(hsm_hdl_t session_hdl, op_sm2_get_z_args_t *args)
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_sm2_get_z_msg),
 			(uint32_t *)&rsp,
@@ -1331,18 +1467,18 @@ hsm_err_t hsm_sm2_eces_encryption(hsm_hdl_t session_hdl, op_sm2_eces_enc_args_t
 
 		cmd.session_handle = session_hdl;
 		cmd.input_addr_ext = 0u;
-		cmd.input_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.input_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 								args->input,
 								args->input_size,
 								DATA_BUF_IS_INPUT);
 		cmd.key_addr_ext = 0U;
-		cmd.key_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+		cmd.key_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 							args->pub_key,
 							args->pub_key_size,
 							DATA_BUF_IS_INPUT);
 
 		cmd.output_addr_ext = 0U;
-	    cmd.output_addr = (uint32_t)plat_os_abs_data_buf(sess_ptr->phdl,
+	    cmd.output_addr = (uint32_t)sab_queue_data_buf(sess_ptr->phdl,
 								args->output,
 								args->output_size,
 								0u);
@@ -1356,7 +1492,7 @@ hsm_err_t hsm_sm2_eces_encryption(hsm_hdl_t session_hdl, op_sm2_eces_enc_args_t
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_sm2_eces_enc_msg),
 			(uint32_t *)&rsp,
@@ -1404,6 +1540,7 @@ hsm_err_t hsm_open_sm2_eces_service(hsm_hdl_t key_store_hdl, open_svc_sm2_eces_a
 			delete_service(sm2_eces_serv_ptr);
 			break;
 		}
+		register_service(sm2_eces_serv_ptr);
 		*sm2_eces_hdl = sm2_eces_serv_ptr->service_hdl;
 	} while (false);
 
@@ -1457,12 +1594,12 @@ hsm_err_t hsm_sm2_eces_decryption(hsm_hdl_t sm2_eces_hdl, op_sm2_eces_dec_args_t
 		cmd.key_id = args->key_identifier;
 
 
-		cmd.input_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.input_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 								args->input,
 								args->input_size,
 								DATA_BUF_IS_INPUT);
 
-	    cmd.output_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+	    cmd.output_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 								args->output,
 								args->output_size,
 								0u);
@@ -1475,7 +1612,7 @@ hsm_err_t hsm_sm2_eces_decryption(hsm_hdl_t sm2_eces_hdl, op_sm2_eces_dec_args_t
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_sm2_eces_dec_msg),
 			(uint32_t *)&rsp,
@@ -1521,23 +1658,23 @@ hsm_err_t hsm_key_exchange(hsm_hdl_t key_management_hdl, op_key_exchange_args_t
 
 		cmd.key_management_handle = key_management_hdl;
 		cmd.key_identifier = args->key_identifier;
-		cmd.shared_key_identifier_array = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.shared_key_identifier_array = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->shared_key_identifier_array,
 				args->shared_key_identifier_array_size,
 				(((args->flags & HSM_OP_KEY_EXCHANGE_FLAGS_UPDATE)==HSM_OP_KEY_EXCHANGE_FLAGS_UPDATE)? DATA_BUF_IS_INPUT : 0u));
-		cmd.ke_input_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.ke_input_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->ke_input,
 				args->ke_input_size,
 				DATA_BUF_IS_INPUT);
-		cmd.ke_output_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.ke_output_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->ke_output,
 				args->ke_output_size,
 				0u);
-		cmd.kdf_input_data = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.kdf_input_data = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->kdf_input,
 				args->kdf_input_size,
 				DATA_BUF_IS_INPUT);
-		cmd.kdf_output_data = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.kdf_output_data = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->kdf_output,
 				args->kdf_output_size,
 				0u);
@@ -1558,7 +1695,7 @@ hsm_err_t hsm_key_exchange(hsm_hdl_t key_management_hdl, op_key_exchange_args_t
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_key_exchange_msg),
 			(uint32_t *)&rsp,
@@ -1600,11 +1737,11 @@ hsm_err_t hsm_tls_finish(hsm_hdl_t key_management_hdl, op_tls_finish_args_t *arg
 
 		cmd.key_management_handle = key_management_hdl;
 		cmd.key_identifier = args->key_identifier;
-		cmd.handshake_hash_input_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.handshake_hash_input_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->handshake_hash_input,
 				args->handshake_hash_input_size,
 				DATA_BUF_IS_INPUT);
-		cmd.verify_data_output_addr = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.verify_data_output_addr = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->verify_data_output,
 				args->verify_data_output_size,
 				0u);
@@ -1618,7 +1755,7 @@ hsm_err_t hsm_tls_finish(hsm_hdl_t key_management_hdl, op_tls_finish_args_t *arg
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_tls_finish_msg),
 			(uint32_t *)&rsp,
@@ -1661,15 +1798,15 @@ hsm_err_t hsm_standalone_butterfly_key_expansion(hsm_hdl_t key_management_hdl,
 		cmd.key_management_handle = key_management_hdl;
 		cmd.key_identifier = args->key_identifier;
 		cmd.exp_fct_key_identifier = args->expansion_fct_key_identifier;
-		cmd.exp_fct_input_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.exp_fct_input_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->expansion_fct_input,
 				args->expansion_fct_input_size,
 				DATA_BUF_IS_INPUT);
-		cmd.hash_value_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.hash_value_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->hash_value,
 				args->hash_value_size,
 				DATA_BUF_IS_INPUT);
-		cmd.pr_reconst_value_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.pr_reconst_value_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->pr_reconstruction_value,
 				args->pr_reconstruction_value_size,
 				DATA_BUF_IS_INPUT);
@@ -1678,7 +1815,7 @@ hsm_err_t hsm_standalone_butterfly_key_expansion(hsm_hdl_t key_management_hdl,
 		cmd.pr_reconst_value_size = args->pr_reconstruction_value_size;
 		cmd.flags = args->flags;
 		cmd.dest_key_identifier = *(args->dest_key_identifier);
-		cmd.output_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.output_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 				args->output,
 				args->output_size,
 				0u);
@@ -1692,7 +1829,7 @@ hsm_err_t hsm_standalone_butterfly_key_expansion(hsm_hdl_t key_management_hdl,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_cmd_st_butterfly_key_exp_msg),
 			(uint32_t *)&rsp,
@@ -1755,7 +1892,7 @@ hsm_err_t hsm_open_key_generic_crypto_service(hsm_hdl_t session_hdl,
 		cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd,
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-		error = plat_send_msg_and_get_resp(sess_ptr->phdl,
+		error = sab_queue_send_msg_and_get_resp(sess_ptr->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_key_generic_crypto_srv_open_msg),
 			(uint32_t *)&rsp,
@@ -1771,6 +1908,7 @@ hsm_err_t hsm_open_key_generic_crypto_service(hsm_hdl_t session_hdl,
 			break;
 		}
 		serv_ptr->service_hdl = rsp.key_generic_crypto_srv_handle;
+		register_service(serv_ptr);
 		*key_generic_crypto_hdl = rsp.key_generic_crypto_srv_handle;
 	} while (false);
 
@@ -1799,7 +1937,7 @@ hsm_err_t hsm_close_key_generic_crypto_service(hsm_hdl_t key_generic_crypto_hdl)
 		cmd.key_generic_crypto_srv_handle = key_generic_crypto_hdl;
 
 
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_key_generic_crypto_srv_close_msg),
 			(uint32_t *)&rsp,
@@ -1840,17 +1978,17 @@ hsm_err_t hsm_key_generic_crypto(hsm_hdl_t key_generic_crypto_hdl, op_key_generi
 
 		cmd.key_generic_crypto_srv_handle = key_generic_crypto_hdl;
 		cmd.key_size = args->key_size;
-		cmd.key_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.key_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 									args->key, args->key_size, DATA_BUF_IS_INPUT);
 		if (args->iv_size != 0) {
-			cmd.iv_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+			cmd.iv_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 									args->iv, args->iv_size, DATA_BUF_IS_INPUT);
 		}
 		else {
 			cmd.iv_address = 0;
 		}
 		cmd.iv_size = args->iv_size;
-		cmd.aad_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.aad_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 							args->aad,
 							args->aad_size,
 							DATA_BUF_IS_INPUT);
@@ -1859,11 +1997,11 @@ hsm_err_t hsm_key_generic_crypto(hsm_hdl_t key_generic_crypto_hdl, op_key_generi
 		cmd.crypto_algo = args->crypto_algo;
 		cmd.flags = args->flags;
 		cmd.tag_size = args->tag_size;
-		cmd.input_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.input_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 							args->input,
 							args->input_size,
 							DATA_BUF_IS_INPUT);
-		cmd.output_address = (uint32_t)plat_os_abs_data_buf(serv_ptr->session->phdl,
+		cmd.output_address = (uint32_t)sab_queue_data_buf(serv_ptr->session->phdl,
 							args->output,
 							args->output_size,
 							0u);
@@ -1875,7 +2013,7 @@ hsm_err_t hsm_key_generic_crypto(hsm_hdl_t key_generic_crypto_hdl, op_key_generi
 				(uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
 		/* Send the message to platform. */
-		error = plat_send_msg_and_get_resp(serv_ptr->session->phdl,
+		error = sab_queue_send_msg_and_get_resp(serv_ptr->session->phdl,
 			(uint32_t *)&cmd,
 			(uint32_t)sizeof(struct sab_key_generic_crypto_srv_msg),
 			(uint32_t *)&rsp,
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+/*
+ * CRC-32 (IEEE 802.3 polynomial, bit reflected) of the NVM blobs, with the
+ * fastest implementation the CPU supports, selected at the first call.
+ * The CRC is the raw register: no initial or final inversion is applied by
+ * these functions, pass 0 to start a CRC of the blobs.
+ */
+
+/* Continue the CRC crc over size bytes at data. */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t size);
+
+/* Same as crc32_update() with the table-driven implementation only. */
+uint32_t crc32_update_sw(uint32_t crc, const uint8_t *data, uint32_t size);
+
+/* Name of the implementation used by crc32_update(). */
+const char *crc32_impl_name(void);
+
+#endif
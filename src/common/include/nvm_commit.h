@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#ifndef NVM_COMMIT_H
+#define NVM_COMMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Crash-safe writes of the NVM blob files, committed in groups by a thread.
+ *
+ * A file is replaced atomically: its new content is written in a temporary
+ * file of the same directory, synchronized with fdatasync(), then renamed
+ * over it and the directory is synchronized. Where the file system supports
+ * it the rename is an exchange, the temporary file left with the previous
+ * content is overwritten in place by the next write. This is done for the
+ * writes waited for and for the last 16 files written without waiting, so
+ * that the temporary files of the chunks take little room. The writes
+ * queued while the thread synchronizes, or within NVM_COMMIT_WINDOW_MS of
+ * the first one, are committed together, a file written several times only
+ * once.
+ */
+
+/*
+ * Longest time a write not waited for stays uncommitted, unless a write
+ * waited for or a flush commits it earlier. A crash within it loses the
+ * write.
+ */
+#define NVM_COMMIT_WINDOW_MS    5u
+
+/*
+ * Replace the content of the file at path with size bytes at src, the data
+ * are copied.
+ * With wait, return once this write and all the ones queued before it are
+ * committed, size on success. Files of the writes queued before are renamed
+ * first and their directories synchronized, so that a crash cannot leave
+ * this file updated and not them.
+ * Without wait, return size once the write is queued.
+ * Return -1 on failure, also when the last write of this file not waited for
+ * failed and was not reported yet.
+ */
+int32_t nvm_commit_write(const char *path, const uint8_t *src, uint32_t size, bool wait);
+
+/* Return once all the writes queued are committed. */
+void nvm_commit_flush(void);
+
+#endif
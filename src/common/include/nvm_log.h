@@ -0,0 +1,63 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#ifndef NVM_LOG_H
+#define NVM_LOG_H
+
+#include <stdint.h>
+
+/*
+ * Chunk store of a directory, used in place of one file per chunk when the
+ * library is built with NVM_CHUNK_LOG.
+ *
+ * Chunks are appended as records to one log file, chunks.log, and found
+ * through an index kept in memory. The index is saved from time to time
+ * in chunks.idx, replaced atomically, so that opening the store only scans
+ * the records appended after it. A thread of the store saves the index and
+ * compacts the log once it holds more outdated records than current ones.
+ * Chunk files of the one-file-per-chunk layout found in the directory when
+ * the store is opened are moved to the log.
+ */
+
+struct nvm_log;
+
+/* Store of the directory dir, opened at the first call. NULL on failure. */
+struct nvm_log *nvm_log_get(const char *dir);
+
+/*
+ * Append a chunk to the store, the data are copied. Return size on success,
+ * -1 on failure. The chunk is durable once nvm_log_sync_all() returned.
+ */
+int32_t nvm_log_write(struct nvm_log *log, uint64_t blob_id, const uint8_t *src, uint32_t size);
+
+/*
+ * Read up to size bytes of the last content written of a chunk. Return the
+ * number of bytes read, 0 if the chunk is not in the store, -1 on failure.
+ */
+int32_t nvm_log_read(struct nvm_log *log, uint64_t blob_id, uint8_t *dst, uint32_t size);
+
+/*
+ * List the chunks of a directory, the most recently written first: those
+ * of its store (log may be NULL), then the chunk files not moved to it.
+ * Write up to max blob ids in ids and return their number.
+ */
+uint32_t nvm_log_list_chunks(struct nvm_log *log, const char *dir, uint64_t *ids, uint32_t max);
+
+/* Make the chunks appended to all the stores durable. Return 0 on success. */
+int32_t nvm_log_sync_all(void);
+
+/* Close a store. The next nvm_log_get() of its directory opens it again. */
+void nvm_log_close(struct nvm_log *log);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#ifndef NVM_STORAGE_H
+#define NVM_STORAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Backends of the non volatile storage of the NVM manager, behind the
+ * plat_os_abs_storage_*() functions of the platforms. A storage holds the
+ * master blob and the chunk blobs of one NVM channel, each replaced
+ * atomically:
+ * - file: the master in a file, the chunks in one file each in a directory,
+ *   or in its log store when the library is built with NVM_CHUNK_LOG.
+ * - raw: a block device or partition, see nvm_storage_raw.c.
+ * - ram: process memory, for tests.
+ * The functions of a storage can be called from several threads.
+ */
+
+/* Blob id of the master blob, chunk ids are below. */
+#define NVM_STORAGE_MASTER_ID   UINT64_MAX
+
+/* Largest blob, the protocol limit. */
+#define NVM_STORAGE_MAX_BLOB_SZ (16u * 1024u)
+
+struct nvm_storage_cfg {
+    /* file: path of the master blob and directory of the chunks, NULL if none. */
+    const char *master_path;
+    const char *chunk_dir;
+    /* raw: path of the device, or of a file standing for it. */
+    const char *dev_path;
+    /* file: one file per chunk, also when built with NVM_CHUNK_LOG. */
+    bool chunk_files;
+};
+
+struct nvm_storage;
+
+struct nvm_storage_ops {
+    const char *name;
+    /* Open the storage described by cfg. NULL on failure. */
+    struct nvm_storage *(*open)(const struct nvm_storage_cfg *cfg);
+    /*
+     * Read up to size bytes of the last content written of a blob. Return
+     * the number of bytes read, 0 if there is no such blob, -1 on failure.
+     */
+    int32_t (*read_blob)(struct nvm_storage *st, uint64_t blob_id, uint8_t *dst, uint32_t size);
+    /*
+     * Replace a blob, the data are copied. Return size on success, -1 on
+     * failure, also when a chunk write not flushed failed.
+     * The master is durable on return, after the chunks written before it.
+     * A chunk is durable once the next master is written or the storage
+     * flushed, or NVM_COMMIT_WINDOW_MS after the write for the chunk files.
+     */
+    int32_t (*write_blob)(struct nvm_storage *st, uint64_t blob_id, const uint8_t *src, uint32_t size);
+    /* Make the blobs written durable. Return 0 on success. */
+    int32_t (*flush)(struct nvm_storage *st);
+    /*
+     * List the chunks, the most recently written first. Write up to max
+     * blob ids in ids and return their number.
+     */
+    uint32_t (*enumerate)(struct nvm_storage *st, uint64_t *ids, uint32_t max);
+    /*
+     * Optional, NULL if the backend cannot map: map the master blob read
+     * only. Return NULL if not possible. The mapping is released with
+     * munmap().
+     */
+    uint8_t *(*map_master)(struct nvm_storage *st, uint32_t *size);
+    /* Close the storage, after a flush. */
+    void (*close)(struct nvm_storage *st);
+};
+
+/* Common part of the storages of all the backends. */
+struct nvm_storage {
+    const struct nvm_storage_ops *ops;
+};
+
+extern const struct nvm_storage_ops nvm_storage_file_ops;
+extern const struct nvm_storage_ops nvm_storage_raw_ops;
+extern const struct nvm_storage_ops nvm_storage_ram_ops;
+
+/* Backend of the given name: "file", "raw" or "ram". NULL if unknown. */
+const struct nvm_storage_ops *nvm_storage_backend(const char *name);
+
+/*
+ * For the enumerate of the backends: rank a chunk written at seq, a write
+ * counter, in the max most recent ones listed in ids, by decreasing seq.
+ * seqs holds the seq of each id listed, nb their number, counting the
+ * chunks that did not fit.
+ */
+void nvm_storage_rank(uint64_t *ids, uint64_t *seqs, uint32_t *nb, uint32_t max,
+                      uint64_t blob_id, uint64_t seq);
+
+#endif
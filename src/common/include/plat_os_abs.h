@@ -73,6 +73,16 @@ struct plat_os_abs_hdl *plat_os_abs_open_mu_channel(uint32_t type, struct plat_m
  */
 uint32_t plat_os_abs_has_v2x_hw(void);
 
+/**
+ * Get the number of commands that can be written on a MU channel before
+ * reading the response of the first one.
+ *
+ *\param phdl pointer to the MU channel handle.
+ *
+ *\return max number of commands waiting for their response, at least 1.
+ */
+uint32_t plat_os_abs_mu_max_in_flight(struct plat_os_abs_hdl *phdl);
+
 
 /**
  * Close a previously opened session.
@@ -132,6 +142,18 @@ int32_t plat_os_abs_send_mu_message(struct plat_os_abs_hdl *phdl, uint32_t *mess
  */
 int32_t plat_os_abs_read_mu_message(struct plat_os_abs_hdl *phdl, uint32_t *message, uint32_t size);
 
+/**
+ * Get a file descriptor telling when a message can be read on a messaging unit.
+ *
+ * The descriptor is readable (poll(), epoll) as long as plat_os_abs_read_mu_message() would not block.
+ * It belongs to the channel and must not be read, written or closed by the caller.
+ *
+ * \param phdl pointer to handle identifying the session.
+ *
+ * \return file descriptor or negative value if the channel cannot be polled.
+ */
+int32_t plat_os_abs_mu_poll_fd(struct plat_os_abs_hdl *phdl);
+
 /**
  * Configure the use of shared buffer in secure memory
  *
@@ -182,6 +204,31 @@ int32_t plat_os_abs_configure_shared_buf(struct plat_os_abs_hdl *phdl, uint32_t
  * \return the address to be inserted in the message to Secure-Enclave Platform, to indicate him this buffer.
  */
 uint64_t plat_os_abs_data_buf(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint32_t flags);
+
+/**
+ * Allocate memory the Secure-Enclave Platform can access without a data buffer setup per command
+ *
+ * Buffers located in such memory are given to Secure-Enclave Platform by their address in the region, so that
+ * commands using them do not need plat_os_abs_data_buf(): neither the copy nor the cache management is done per
+ * command. The caller must not access a buffer between sending a command using it and receiving the response.
+ *
+ * \param phdl pointer to the session handle the region is used with.
+ * \param size size in bytes of the region.
+ * \param addr pointer to where the address of the region for Secure-Enclave Platform is written.
+ *
+ * \return pointer to the region, NULL if the platform cannot provide such memory (ELE and SECO drivers).
+ */
+uint8_t *plat_os_abs_buf_map(struct plat_os_abs_hdl *phdl, uint32_t size, uint64_t *addr);
+
+/**
+ * Release a region allocated with plat_os_abs_buf_map().
+ *
+ * \param phdl pointer to the session handle the region was allocated for.
+ * \param ptr pointer to the region.
+ * \param size size in bytes of the region.
+ */
+void plat_os_abs_buf_unmap(struct plat_os_abs_hdl *phdl, uint8_t *ptr, uint32_t size);
+
 #define DATA_BUF_IS_OUTPUT        0x00u
 #define DATA_BUF_IS_INPUT         0x01u
 #define DATA_BUF_USE_SEC_MEM      0x02u
@@ -244,6 +291,9 @@ void plat_os_abs_free(void *ptr);
 /**
  * Write data to the non volatile storage.
  *
+ * The previous data are replaced atomically. Once returned the data, and the
+ * chunks written before, are durable.
+ *
  * \param phdl pointer to the session handle for which this data buffer is used.
  * \param src pointer to the data to be written to storage.
  * \param size number of bytes to be written.
@@ -263,6 +313,35 @@ int32_t plat_os_abs_storage_write(struct plat_os_abs_hdl *phdl, uint8_t *src, ui
  */
 int32_t plat_os_abs_storage_read(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size);
 
+/**
+ * Map the data of the non volatile storage read only, opening it once.
+ *
+ * \param phdl pointer to the session handle for which this data buffer is used.
+ * \param size pointer to where the number of bytes mapped must be written.
+ *
+ * \return pointer to the data, NULL if there are none or they cannot be mapped.
+ */
+uint8_t *plat_os_abs_storage_map(struct plat_os_abs_hdl *phdl, uint32_t *size);
+
+/**
+ * Unmap data mapped by plat_os_abs_storage_map().
+ *
+ * \param ptr pointer to the data.
+ * \param size number of bytes mapped.
+ */
+void plat_os_abs_storage_unmap(uint8_t *ptr, uint32_t size);
+
+/**
+ * List the chunks of the non volatile storage, the most recently written first.
+ *
+ * \param phdl pointer to the session handle for which the chunks are listed.
+ * \param ids pointer to where the unique identifiers of the chunks must be written.
+ * \param max maximum number of identifiers written.
+ *
+ * \return number of identifiers written.
+ */
+uint32_t plat_os_abs_storage_list_chunks(struct plat_os_abs_hdl *phdl, uint64_t *ids, uint32_t max);
+
 /**
  * Write a subset of data to the non volatile storage.
  *
@@ -271,6 +350,11 @@ int32_t plat_os_abs_storage_read(struct plat_os_abs_hdl *phdl, uint8_t *dst, uin
  * A unique identifier within the system allow the storage manager to store and read it without
  * ambiguity.
  *
+ * The previous chunk is replaced atomically. The chunk is not durable on return, a crash before
+ * it is committed loses it: it is committed with the next plat_os_abs_storage_write() at the
+ * latest, within NVM_COMMIT_WINDOW_MS (5 ms) when each chunk has its own file. The master written
+ * next never refers to a lost chunk. A failure may be reported by a later write.
+ *
  * \param phdl pointer to the session handle for which this data buffer is used.
  * \param src pointer to the data to be written to storage.
  * \param size number of bytes to be written.
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef SHA2_H
+#define SHA2_H
+
+#include <stdint.h>
+
+struct sha2_ctx {
+    uint64_t state[8];
+    uint64_t count;
+    uint32_t block_size;
+    uint32_t digest_size;
+    uint32_t buf_len;
+    uint8_t buf[128];
+};
+
+void sha2_init(struct sha2_ctx *ctx, uint32_t digest_size);
+void sha2_update(struct sha2_ctx *ctx, const uint8_t *data, uint32_t len);
+void sha2_final(struct sha2_ctx *ctx, uint8_t *out);
+
+#endif
@@ -0,0 +1,677 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/* syscall() */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <linux/magic.h>
+
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE         (1u << 1)
+#endif
+#ifndef XFS_SUPER_MAGIC
+#define XFS_SUPER_MAGIC         0x58465342
+#endif
+
+#include "nvm_commit.h"
+
+/* Directories synchronized by a commit, others are synchronized at once. */
+#define NVM_COMMIT_MAX_DIRS     8u
+
+/* Requests kept for reuse once committed. */
+#define NVM_COMMIT_MAX_SPARE    16u
+/* Files not waited for whose temporary file is kept, the last written. */
+#define NVM_COMMIT_MAX_KEPT     16u
+/* Data buffers are allocated by multiples of this, blobs grow a little at a time. */
+#define NVM_COMMIT_DATA_UNIT    4096u
+
+struct nvm_commit_req {
+    struct nvm_commit_req *next;
+    char *path;
+    uint8_t *data;
+    uint32_t size;
+    /* Allocated sizes of path and data, kept when the request is reused. */
+    size_t path_cap;
+    uint32_t data_cap;
+    uint64_t seq;
+    /* A writer waits for this one. */
+    bool barrier;
+    bool failed;
+};
+
+struct nvm_commit_dirs {
+    char *path[NVM_COMMIT_MAX_DIRS];
+    /* File system of the directory, its updates are committed in order. */
+    dev_t dev[NVM_COMMIT_MAX_DIRS];
+    bool ordered[NVM_COMMIT_MAX_DIRS];
+    bool synced[NVM_COMMIT_MAX_DIRS];
+    uint32_t nb;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    /* Signaled to the thread on new writes and flushes. */
+    pthread_cond_t work;
+    /* Broadcast to the writers on commits. */
+    pthread_cond_t done;
+    /* Writes queued and not yet taken by the thread, in order. */
+    struct nvm_commit_req *queue;
+    struct nvm_commit_req **queue_tail;
+    /* Committed requests, reused by the next writes. */
+    struct nvm_commit_req *spare;
+    uint32_t nb_spare;
+    /* Sequence number of the last write queued. */
+    uint64_t next_seq;
+    /* All the writes up to this one are committed. */
+    uint64_t done_seq;
+    /* The writes up to this one are committed without waiting. */
+    uint64_t flush_seq;
+    /* Last write of each file that failed, not yet reported. */
+    struct nvm_commit_req *failed;
+    bool started;
+} nvm_commit = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queue_tail = &nvm_commit.queue,
+};
+
+static pthread_once_t nvm_commit_once = PTHREAD_ONCE_INIT;
+
+/* Files of kept_tmp(), the last written first. Used by the thread only. */
+static char *nvm_commit_kept[NVM_COMMIT_MAX_KEPT];
+static uint32_t nvm_commit_nb_kept;
+
+static void req_free(struct nvm_commit_req *req)
+{
+    free(req->path);
+    free(req->data);
+    free(req);
+}
+
+/*
+ * Get a request for a write, a spare one if any so that steady writes of
+ * blobs of the same sizes make no heap calls. NULL if out of memory.
+ */
+static struct nvm_commit_req *req_get(const char *path, uint32_t size)
+{
+    struct nvm_commit_req *req;
+    size_t len = strlen(path) + 1u;
+    uint32_t cap;
+
+    pthread_mutex_lock(&nvm_commit.lock);
+    req = nvm_commit.spare;
+    if (req != NULL) {
+        nvm_commit.spare = req->next;
+        nvm_commit.nb_spare--;
+    }
+    pthread_mutex_unlock(&nvm_commit.lock);
+
+    if (req == NULL) {
+        req = calloc(1u, sizeof(struct nvm_commit_req));
+        if (req == NULL) {
+            return NULL;
+        }
+    }
+    if (req->path_cap < len) {
+        free(req->path);
+        req->path = malloc(len);
+        req->path_cap = (req->path != NULL) ? len : 0u;
+    }
+    if ((req->data_cap < size) || (req->data == NULL)) {
+        cap = ((size / NVM_COMMIT_DATA_UNIT) + 1u) * NVM_COMMIT_DATA_UNIT;
+        free(req->data);
+        req->data = malloc(cap);
+        req->data_cap = (req->data != NULL) ? cap : 0u;
+    }
+    if ((req->path == NULL) || (req->data == NULL)) {
+        req_free(req);
+        return NULL;
+    }
+    (void)memcpy(req->path, path, len);
+    req->next = NULL;
+    req->seq = 0u;
+    req->failed = false;
+
+    return req;
+}
+
+/* Keep a request no longer used for reuse, or free it. */
+static void req_put(struct nvm_commit_req *req)
+{
+    pthread_mutex_lock(&nvm_commit.lock);
+    if (nvm_commit.nb_spare < NVM_COMMIT_MAX_SPARE) {
+        req->next = nvm_commit.spare;
+        nvm_commit.spare = req;
+        nvm_commit.nb_spare++;
+        req = NULL;
+    }
+    pthread_mutex_unlock(&nvm_commit.lock);
+
+    if (req != NULL) {
+        req_free(req);
+    }
+}
+
+/* Name of the temporary file of a request. NULL if out of memory. */
+static char *tmp_path(const char *path)
+{
+    size_t len = strlen(path);
+    char *tmp = malloc(len + sizeof(".tmp"));
+
+    if (tmp != NULL) {
+        (void)memcpy(tmp, path, len);
+        (void)memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+    }
+
+    return tmp;
+}
+
+/*
+ * Replace the target by the temporary file. With keep, they are exchanged
+ * when the file system can, the temporary file keeping the previous
+ * content for the next write.
+ */
+static int replace(const char *tmp, const char *path, bool keep)
+{
+#ifdef SYS_renameat2
+    if ((keep == true)
+        && (syscall(SYS_renameat2, AT_FDCWD, tmp, AT_FDCWD, path, RENAME_EXCHANGE) == 0)) {
+        return 0;
+    }
+#endif
+    /* No target yet, or no exchange. */
+    return rename(tmp, path);
+}
+
+static void dir_sync(const char *dir)
+{
+    int fd = open(dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+    if (fd >= 0) {
+        (void)fsync(fd);
+        (void)close(fd);
+    }
+}
+
+/* Directory of a file, NULL if out of memory. */
+static char *dir_of(const char *path)
+{
+    const char *end = strrchr(path, '/');
+
+    if (end == NULL) {
+        return strdup(".");
+    }
+    if (end == path) {
+        return strdup("/");
+    }
+
+    return strndup(path, (size_t)(end - path));
+}
+
+/*
+ * Get the file system of a directory. Ext4 and XFS commit the metadata
+ * updates in order in one journal: synchronizing a directory also commits
+ * the renames done before in the others of the file system. Ext2 shares the
+ * magic number of ext4: the NVM must not be on a file system without
+ * journal mounted as ext2 or ext4.
+ */
+static bool dir_fs(const char *dir, dev_t *dev)
+{
+    struct statfs sfs;
+    struct stat st;
+
+    if ((stat(dir, &st) != 0) || (statfs(dir, &sfs) != 0)) {
+        return false;
+    }
+    *dev = st.st_dev;
+
+    return (sfs.f_type == EXT4_SUPER_MAGIC) || (sfs.f_type == XFS_SUPER_MAGIC);
+}
+
+/*
+ * Write the temporary file of a request and synchronize it with
+ * fdatasync(). The file is overwritten in place, not truncated: when it
+ * holds the previous content of the target its blocks are reused and there
+ * is no allocation to commit.
+ */
+static void stage(struct nvm_commit_req *req)
+{
+    char *tmp = tmp_path(req->path);
+    struct stat st;
+    uint32_t off = 0u;
+    ssize_t l;
+    int fd = -1;
+
+    req->failed = true;
+    if (tmp != NULL) {
+        fd = open(tmp, O_CREAT|O_WRONLY|O_CLOEXEC, S_IRUSR|S_IWUSR);
+    }
+    if (fd >= 0) {
+        while (off < req->size) {
+            l = write(fd, req->data + off, req->size - off);
+            if (l > 0) {
+                off += (uint32_t)l;
+            } else if ((l < 0) && (errno == EINTR)) {
+                continue;
+            } else {
+                break;
+            }
+        }
+        if ((off == req->size) && (fstat(fd, &st) == 0)
+            && ((st.st_size <= (off_t)req->size) || (ftruncate(fd, (off_t)req->size) == 0))
+            && (fdatasync(fd) == 0)) {
+            req->failed = false;
+        }
+        (void)close(fd);
+    }
+    free(tmp);
+}
+
+/* Note a rename in the directory of path, to be synchronized later. */
+static void dir_add(struct nvm_commit_dirs *dirs, const char *path)
+{
+    char *dir = dir_of(path);
+    uint32_t i;
+
+    if (dir == NULL) {
+        return;
+    }
+    for (i = 0u; i < dirs->nb; i++) {
+        if (strcmp(dirs->path[i], dir) == 0) {
+            dirs->synced[i] = false;
+            free(dir);
+            return;
+        }
+    }
+    if (dirs->nb == NVM_COMMIT_MAX_DIRS) {
+        dir_sync(dir);
+        free(dir);
+        return;
+    }
+    dirs->path[dirs->nb] = dir;
+    dirs->ordered[dirs->nb] = dir_fs(dir, &dirs->dev[dirs->nb]);
+    dirs->synced[dirs->nb] = false;
+    dirs->nb++;
+}
+
+/*
+ * Synchronize the directories not synchronized yet, except the ones whose
+ * renames are committed in order with the ones of the directory of path.
+ */
+static void dirs_sync(struct nvm_commit_dirs *dirs, const char *path)
+{
+    char *skip = (path != NULL) ? dir_of(path) : NULL;
+    bool ordered = false;
+    dev_t dev = 0;
+    uint32_t i;
+
+    if (skip != NULL) {
+        ordered = dir_fs(skip, &dev);
+    }
+    for (i = 0u; i < dirs->nb; i++) {
+        if ((dirs->synced[i] == true)
+            || ((skip != NULL) && (strcmp(dirs->path[i], skip) == 0))
+            || (ordered && dirs->ordered[i] && (dirs->dev[i] == dev))) {
+            continue;
+        }
+        dir_sync(dirs->path[i]);
+        dirs->synced[i] = true;
+    }
+    free(skip);
+}
+
+/*
+ * Tell if the temporary file of a file not waited for is kept. Only the ones
+ * of the last NVM_COMMIT_MAX_KEPT files written are: the chunks written
+ * often are rewritten in place, the others do not take twice their size.
+ * The temporary files of the pending requests, staged and not yet renamed,
+ * are not removed.
+ */
+static bool kept_tmp(const char *path, const struct nvm_commit_req *pending)
+{
+    const struct nvm_commit_req *req;
+    char *tmp, *last = NULL;
+    uint32_t i;
+
+    for (i = 0u; i < nvm_commit_nb_kept; i++) {
+        if (strcmp(nvm_commit_kept[i], path) == 0) {
+            last = nvm_commit_kept[i];
+            break;
+        }
+    }
+    if (last == NULL) {
+        last = strdup(path);
+        if (last == NULL) {
+            return false;
+        }
+        if (nvm_commit_nb_kept == NVM_COMMIT_MAX_KEPT) {
+            /* Remove the temporary file of the least recently written. */
+            i = NVM_COMMIT_MAX_KEPT - 1u;
+            for (req = pending; req != NULL; req = req->next) {
+                if (strcmp(req->path, nvm_commit_kept[i]) == 0) {
+                    break;
+                }
+            }
+            tmp = (req == NULL) ? tmp_path(nvm_commit_kept[i]) : NULL;
+            if (tmp != NULL) {
+                (void)unlink(tmp);
+                free(tmp);
+            }
+            free(nvm_commit_kept[i]);
+        } else {
+            i = nvm_commit_nb_kept++;
+        }
+    }
+    for (; i > 0u; i--) {
+        nvm_commit_kept[i] = nvm_commit_kept[i - 1u];
+    }
+    nvm_commit_kept[0] = last;
+
+    return true;
+}
+
+/*
+ * Rename the staged files over their targets, in order, and synchronize
+ * their directories. Before the rename of a file waited for, the
+ * directories of the files renamed before are synchronized, unless the
+ * file system journal keeps their renames in order with its own.
+ * The temporary files of the writes waited for are kept, see kept_tmp()
+ * for the others.
+ */
+static void publish(struct nvm_commit_req *staged)
+{
+    struct nvm_commit_dirs dirs = {0};
+    struct nvm_commit_req *req;
+    char *tmp;
+    bool keep;
+    uint32_t i;
+
+    for (req = staged; req != NULL; req = req->next) {
+        if (req->failed == false) {
+            tmp = tmp_path(req->path);
+            if (req->barrier == true) {
+                dirs_sync(&dirs, req->path);
+            }
+            keep = (req->barrier == true) || kept_tmp(req->path, req->next);
+            if ((tmp == NULL) || (replace(tmp, req->path, keep) != 0)) {
+                req->failed = true;
+            } else {
+                dir_add(&dirs, req->path);
+            }
+            free(tmp);
+        }
+    }
+    dirs_sync(&dirs, NULL);
+
+    for (i = 0u; i < dirs.nb; i++) {
+        free(dirs.path[i]);
+    }
+}
+
+/* Take the failed write of a file not yet reported, NULL if none. */
+static struct nvm_commit_req *failed_take(const char *path)
+{
+    struct nvm_commit_req *req, **prev;
+
+    for (prev = &nvm_commit.failed; *prev != NULL; prev = &(*prev)->next) {
+        if (strcmp((*prev)->path, path) == 0) {
+            req = *prev;
+            *prev = req->next;
+            req->next = NULL;
+            return req;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Keep the committed requests that failed until their writer or the next
+ * writer of their file is told, called with the lock held. A write that
+ * succeeded clears the failure of a previous one of its file: the file
+ * holds the last content. Return the requests no longer used.
+ */
+static struct nvm_commit_req *failed_update(struct nvm_commit_req *staged)
+{
+    struct nvm_commit_req *put = NULL;
+    struct nvm_commit_req *req, *old;
+
+    while (staged != NULL) {
+        req = staged;
+        staged = req->next;
+        old = failed_take(req->path);
+        if (old != NULL) {
+            old->next = put;
+            put = old;
+        }
+        if (req->failed == true) {
+            req->next = nvm_commit.failed;
+            nvm_commit.failed = req;
+        } else {
+            req->next = put;
+            put = req;
+        }
+    }
+
+    return put;
+}
+
+/*
+ * Stage the writes taken from the queue, appended to the staged list. A
+ * write replaces a staged one of the same file, its temporary file being
+ * written again.
+ */
+static void stage_list(struct nvm_commit_req *list, struct nvm_commit_req **staged)
+{
+    struct nvm_commit_req *req, *old, **prev;
+
+    while (list != NULL) {
+        req = list;
+        list = req->next;
+        req->next = NULL;
+
+        for (prev = staged; *prev != NULL; prev = &(*prev)->next) {
+            if (strcmp((*prev)->path, req->path) == 0) {
+                break;
+            }
+        }
+        if (*prev != NULL) {
+            /* Superseded: the writers of both wait for the last one. */
+            req->barrier = req->barrier || (*prev)->barrier;
+            old = *prev;
+            *prev = old->next;
+            req_put(old);
+        }
+        stage(req);
+
+        for (prev = staged; *prev != NULL; prev = &(*prev)->next) {
+        }
+        *prev = req;
+    }
+}
+
+static void deadline_after_window(struct timespec *ts)
+{
+    (void)clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_nsec += (long)NVM_COMMIT_WINDOW_MS * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static bool deadline_passed(const struct timespec *ts)
+{
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec > ts->tv_sec)
+           || ((now.tv_sec == ts->tv_sec) && (now.tv_nsec >= ts->tv_nsec));
+}
+
+static void *nvm_commit_thread(void *arg)
+{
+    struct nvm_commit_req *staged = NULL;
+    struct nvm_commit_req *list, *req;
+    struct timespec deadline;
+    uint64_t last_seq = 0u;
+    bool barrier = false;
+
+    pthread_mutex_lock(&nvm_commit.lock);
+    for (;;) {
+        if (nvm_commit.queue != NULL) {
+            /* Stage everything queued before committing. */
+            list = nvm_commit.queue;
+            nvm_commit.queue = NULL;
+            nvm_commit.queue_tail = &nvm_commit.queue;
+            if (staged == NULL) {
+                deadline_after_window(&deadline);
+            }
+            for (req = list; req != NULL; req = req->next) {
+                last_seq = req->seq;
+                barrier = barrier || req->barrier;
+            }
+            pthread_mutex_unlock(&nvm_commit.lock);
+            stage_list(list, &staged);
+            pthread_mutex_lock(&nvm_commit.lock);
+        } else if (staged == NULL) {
+            pthread_cond_wait(&nvm_commit.work, &nvm_commit.lock);
+        } else if ((barrier == true) || (nvm_commit.flush_seq > nvm_commit.done_seq)
+                   || deadline_passed(&deadline)) {
+            pthread_mutex_unlock(&nvm_commit.lock);
+            publish(staged);
+            pthread_mutex_lock(&nvm_commit.lock);
+            list = failed_update(staged);
+            staged = NULL;
+            nvm_commit.done_seq = last_seq;
+            barrier = false;
+            pthread_cond_broadcast(&nvm_commit.done);
+            pthread_mutex_unlock(&nvm_commit.lock);
+            while (list != NULL) {
+                req = list;
+                list = req->next;
+                req_put(req);
+            }
+            pthread_mutex_lock(&nvm_commit.lock);
+        } else {
+            (void)pthread_cond_timedwait(&nvm_commit.work, &nvm_commit.lock, &deadline);
+        }
+    }
+
+    return NULL;
+}
+
+static void nvm_commit_init(void)
+{
+    pthread_condattr_t attr;
+    pthread_attr_t thread_attr;
+    pthread_t thread;
+
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(&nvm_commit.work, &attr);
+    (void)pthread_condattr_destroy(&attr);
+    (void)pthread_cond_init(&nvm_commit.done, NULL);
+
+    (void)pthread_attr_init(&thread_attr);
+    (void)pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &thread_attr, nvm_commit_thread, NULL) == 0) {
+        nvm_commit.started = true;
+        /* Writes not waited for are committed before the process exits. */
+        (void)atexit(nvm_commit_flush);
+    }
+    (void)pthread_attr_destroy(&thread_attr);
+}
+
+int32_t nvm_commit_write(const char *path, const uint8_t *src, uint32_t size, bool wait)
+{
+    struct nvm_commit_req *req, *failed;
+    uint64_t seq;
+    int32_t ret = -1;
+    int state;
+
+    (void)pthread_once(&nvm_commit_once, nvm_commit_init);
+    if ((nvm_commit.started == false) || (path == NULL) || ((src == NULL) && (size != 0u))) {
+        return -1;
+    }
+
+    req = req_get(path, size);
+    if (req == NULL) {
+        return -1;
+    }
+    if (size != 0u) {
+        (void)memcpy(req->data, src, size);
+    }
+    req->size = size;
+    req->barrier = wait;
+
+    /* The request is shared with the thread: no cancellation meanwhile. */
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock(&nvm_commit.lock);
+    seq = ++nvm_commit.next_seq;
+    req->seq = seq;
+    *nvm_commit.queue_tail = req;
+    nvm_commit.queue_tail = &req->next;
+    pthread_cond_signal(&nvm_commit.work);
+
+    while ((wait == true) && (nvm_commit.done_seq < seq)) {
+        pthread_cond_wait(&nvm_commit.done, &nvm_commit.lock);
+    }
+    failed = failed_take(path);
+    if (failed == NULL) {
+        ret = (int32_t)size;
+    }
+    pthread_mutex_unlock(&nvm_commit.lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    if (failed != NULL) {
+        req_put(failed);
+    }
+
+    return ret;
+}
+
+void nvm_commit_flush(void)
+{
+    uint64_t seq;
+    int state;
+
+    if (nvm_commit.started == false) {
+        return;
+    }
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock(&nvm_commit.lock);
+    seq = nvm_commit.next_seq;
+    if (nvm_commit.done_seq < seq) {
+        nvm_commit.flush_seq = seq;
+        pthread_cond_signal(&nvm_commit.work);
+        while (nvm_commit.done_seq < seq) {
+            pthread_cond_wait(&nvm_commit.done, &nvm_commit.lock);
+        }
+    }
+    pthread_mutex_unlock(&nvm_commit.lock);
+    (void)pthread_setcancelstate(state, NULL);
+}
@@ -0,0 +1,997 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "crc32.h"
+#include "nvm_commit.h"
+#include "nvm_log.h"
+
+#define NVM_LOG_FILE            "chunks.log"
+#define NVM_LOG_INDEX_FILE      "chunks.idx"
+
+#define NVM_LOG_MAGIC           0x474f4c4eu     /* "NLOG" */
+#define NVM_LOG_REC_MAGIC       0x4345524eu     /* "NREC" */
+#define NVM_LOG_INDEX_MAGIC     0x5844494eu     /* "NIDX" */
+#define NVM_LOG_VERSION         1u
+
+/* Largest chunk, the protocol limit. */
+#define NVM_LOG_MAX_CHUNK_SZ    (16u * 1024u)
+/* Records are aligned on it in the log. */
+#define NVM_LOG_ALIGN           8u
+/* The log is not compacted below this size. */
+#define NVM_LOG_COMPACT_MIN_SZ  (256u * 1024u)
+/* The index is saved after this number of records appended. */
+#define NVM_LOG_CHECKPOINT_NB   64u
+/* Initial number of entries of the index. */
+#define NVM_LOG_INDEX_INIT_SZ   64u
+
+struct nvm_log_file_hdr {
+    uint32_t magic;
+    uint32_t version;
+    /* Changed each time the log is created or compacted. */
+    uint64_t gen;
+};
+
+struct nvm_log_rec_hdr {
+    uint32_t magic;
+    uint32_t size;
+    uint64_t blob_id;
+    /* CRC of the chunk. */
+    uint32_t crc;
+    /* CRC of the fields above. */
+    uint32_t hdr_crc;
+};
+
+/* Saved index: this header followed by the entries in use. */
+struct nvm_log_index_hdr {
+    uint32_t magic;
+    uint32_t version;
+    /* Generation of the log indexed. */
+    uint64_t gen;
+    /* Records past this offset are not indexed. */
+    uint64_t end;
+    uint32_t nb;
+    /* CRC of the entries. */
+    uint32_t crc;
+};
+
+struct nvm_log_entry {
+    uint64_t blob_id;
+    /* Offset of the last record of the chunk, 0 if the entry is free. */
+    uint64_t off;
+    uint32_t size;
+    uint32_t crc;
+};
+
+struct nvm_log {
+    struct nvm_log *next;
+    char *dir;
+    char *path;
+    char *index_path;
+    int fd;
+    uint64_t gen;
+    /* End of the last record. */
+    uint64_t end;
+    /* Size of the records indexed, the others are outdated. */
+    uint64_t live;
+    uint32_t since_checkpoint;
+    /* No compaction before the log reaches this size, after a failed one. */
+    uint64_t retry_end;
+    /* Records appended and not synchronized. */
+    bool dirty;
+    bool stop;
+    /* Index, open addressing (linear probing) keyed by blob_id. */
+    struct nvm_log_entry *entries;
+    uint32_t size;
+    uint32_t nb;
+    pthread_mutex_t lock;
+    /* Signaled to the thread when there is an index to save or a log to compact. */
+    pthread_cond_t work;
+    pthread_t thread;
+};
+
+/* Open stores. */
+static struct nvm_log *nvm_log_list;
+static pthread_mutex_t nvm_log_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t rec_size(uint32_t size)
+{
+    return (uint64_t)sizeof(struct nvm_log_rec_hdr)
+           + (((uint64_t)size + NVM_LOG_ALIGN - 1u) & ~((uint64_t)NVM_LOG_ALIGN - 1u));
+}
+
+static uint32_t rec_hdr_crc(const struct nvm_log_rec_hdr *hdr)
+{
+    return crc32_update(0u, (const uint8_t *)hdr, (uint32_t)offsetof(struct nvm_log_rec_hdr, hdr_crc));
+}
+
+/* Path of a file of the directory, NULL if out of memory. */
+static char *path_in(const char *dir, const char *name)
+{
+    size_t len = strlen(dir);
+    bool slash = (len > 0u) && (dir[len - 1u] == '/');
+    char *path = malloc(len + 1u + strlen(name) + 1u);
+
+    if (path != NULL) {
+        (void)sprintf(path, slash ? "%s%s" : "%s/%s", dir, name);
+    }
+
+    return path;
+}
+
+static int full_pread(int fd, void *buf, size_t size, uint64_t off)
+{
+    size_t done = 0u;
+    ssize_t l;
+
+    while (done < size) {
+        l = pread(fd, (uint8_t *)buf + done, size - done, (off_t)(off + done));
+        if (l > 0) {
+            done += (size_t)l;
+        } else if ((l < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int full_pwritev(int fd, struct iovec *iov, int nb, uint64_t off)
+{
+    ssize_t l;
+
+    while (nb > 0) {
+        l = pwritev(fd, iov, nb, (off_t)off);
+        if (l < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        off += (uint64_t)l;
+        while ((nb > 0) && ((size_t)l >= iov->iov_len)) {
+            l -= (ssize_t)iov->iov_len;
+            iov++;
+            nb--;
+        }
+        if (nb > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + l;
+            iov->iov_len -= (size_t)l;
+        }
+    }
+
+    return 0;
+}
+
+static void dir_sync(const char *dir)
+{
+    int fd = open(dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+    if (fd >= 0) {
+        (void)fsync(fd);
+        (void)close(fd);
+    }
+}
+
+static uint32_t index_hash(uint64_t blob_id, uint32_t size)
+{
+    /* Blob ids are the key store id and a small group number. */
+    return (uint32_t)(((blob_id ^ (blob_id >> 32u)) * 0x9E3779B97F4A7C15u) >> 32u) & (size - 1u);
+}
+
+static struct nvm_log_entry *index_find(struct nvm_log *log, uint64_t blob_id)
+{
+    uint32_t i;
+
+    if (log->size == 0u) {
+        return NULL;
+    }
+
+    for (i = index_hash(blob_id, log->size);
+         log->entries[i].off != 0u;
+         i = (i + 1u) & (log->size - 1u)) {
+        if (log->entries[i].blob_id == blob_id) {
+            return &log->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void index_insert(struct nvm_log_entry *entries, uint32_t size, const struct nvm_log_entry *e)
+{
+    uint32_t i = index_hash(e->blob_id, size);
+
+    while (entries[i].off != 0u) {
+        i = (i + 1u) & (size - 1u);
+    }
+    entries[i] = *e;
+}
+
+/* Index the record of a chunk at off. Return 0 on success. */
+static int32_t index_set(struct nvm_log *log, uint64_t blob_id, uint64_t off, uint32_t size, uint32_t crc)
+{
+    struct nvm_log_entry *e = index_find(log, blob_id);
+    struct nvm_log_entry *entries;
+    struct nvm_log_entry new_e = {blob_id, off, size, crc};
+    uint32_t new_size, i;
+
+    if (e != NULL) {
+        log->live -= rec_size(e->size);
+        *e = new_e;
+        log->live += rec_size(size);
+        return 0;
+    }
+
+    /* Keep the load factor below 1/2. Entries are never removed. */
+    if (2u * (log->nb + 1u) > log->size) {
+        new_size = (log->size == 0u) ? NVM_LOG_INDEX_INIT_SZ : 2u * log->size;
+        entries = calloc(new_size, sizeof(struct nvm_log_entry));
+        if (entries == NULL) {
+            return -1;
+        }
+        for (i = 0u; i < log->size; i++) {
+            if (log->entries[i].off != 0u) {
+                index_insert(entries, new_size, &log->entries[i]);
+            }
+        }
+        free(log->entries);
+        log->entries = entries;
+        log->size = new_size;
+    }
+    index_insert(log->entries, log->size, &new_e);
+    log->nb++;
+    log->live += rec_size(size);
+
+    return 0;
+}
+
+/* Write a record at the end of the log. Return 0 on success. */
+static int32_t log_append(struct nvm_log *log, uint64_t blob_id, const uint8_t *src, uint32_t size, uint32_t crc)
+{
+    static const uint8_t pad[NVM_LOG_ALIGN] = {0};
+    struct nvm_log_rec_hdr hdr;
+    struct iovec iov[3];
+
+    hdr.magic = NVM_LOG_REC_MAGIC;
+    hdr.size = size;
+    hdr.blob_id = blob_id;
+    hdr.crc = crc;
+    hdr.hdr_crc = rec_hdr_crc(&hdr);
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (void *)src;
+    iov[1].iov_len = size;
+    iov[2].iov_base = (void *)pad;
+    iov[2].iov_len = (size_t)(rec_size(size) - sizeof(hdr) - size);
+
+    if (full_pwritev(log->fd, iov, 3, log->end) != 0) {
+        return -1;
+    }
+    log->end += rec_size(size);
+
+    return 0;
+}
+
+/*
+ * Index the records of the log from off. The scan stops at the first
+ * record incomplete or corrupted, written last before a crash: the log is
+ * truncated there, so that no record past it is found by a later scan.
+ */
+static void log_scan(struct nvm_log *log, uint64_t off)
+{
+    struct nvm_log_rec_hdr hdr;
+    uint8_t *buf = malloc(NVM_LOG_MAX_CHUNK_SZ);
+
+    if (buf == NULL) {
+        log->end = off;
+        return;
+    }
+    while ((full_pread(log->fd, &hdr, sizeof(hdr), off) == 0)
+           && (hdr.magic == NVM_LOG_REC_MAGIC) && (hdr.hdr_crc == rec_hdr_crc(&hdr))
+           && (hdr.size <= NVM_LOG_MAX_CHUNK_SZ)
+           && (full_pread(log->fd, buf, hdr.size, off + sizeof(hdr)) == 0)
+           && (crc32_update(0u, buf, hdr.size) == hdr.crc)
+           && (index_set(log, hdr.blob_id, off, hdr.size, hdr.crc) == 0)) {
+        off += rec_size(hdr.size);
+    }
+    free(buf);
+
+    log->end = off;
+    (void)ftruncate(log->fd, (off_t)off);
+}
+
+/* Load the saved index if it matches the log. Return where to scan from. */
+static uint64_t index_load(struct nvm_log *log, uint64_t log_size)
+{
+    struct nvm_log_index_hdr hdr;
+    struct nvm_log_entry *saved = NULL;
+    uint64_t from = sizeof(struct nvm_log_file_hdr);
+    uint32_t i;
+    int fd;
+
+    nvm_commit_flush();
+    fd = open(log->index_path, O_RDONLY|O_CLOEXEC);
+    if (fd < 0) {
+        return from;
+    }
+    do {
+        if ((full_pread(fd, &hdr, sizeof(hdr), 0u) != 0) || (hdr.magic != NVM_LOG_INDEX_MAGIC)
+            || (hdr.version != NVM_LOG_VERSION) || (hdr.gen != log->gen) || (hdr.end > log_size)
+            || (hdr.nb > (uint32_t)(hdr.end / sizeof(struct nvm_log_rec_hdr)))) {
+            break;
+        }
+        saved = malloc((size_t)hdr.nb * sizeof(struct nvm_log_entry) + 1u);
+        if ((saved == NULL)
+            || (full_pread(fd, saved, (size_t)hdr.nb * sizeof(struct nvm_log_entry), sizeof(hdr)) != 0)
+            || (crc32_update(0u, (uint8_t *)saved, hdr.nb * (uint32_t)sizeof(struct nvm_log_entry)) != hdr.crc)) {
+            break;
+        }
+        for (i = 0u; i < hdr.nb; i++) {
+            if ((saved[i].off < from) || (saved[i].off + rec_size(saved[i].size) > hdr.end)
+                || (index_set(log, saved[i].blob_id, saved[i].off, saved[i].size, saved[i].crc) != 0)) {
+                break;
+            }
+        }
+        if (i == hdr.nb) {
+            from = hdr.end;
+        } else {
+            /* Inconsistent, the whole log is scanned. */
+            free(log->entries);
+            log->entries = NULL;
+            log->size = 0u;
+            log->nb = 0u;
+            log->live = 0u;
+        }
+    } while (false);
+    free(saved);
+    (void)close(fd);
+
+    return from;
+}
+
+/*
+ * Save the index of the records synchronized. Called by the thread of the
+ * store, the only one that replaces the log. Return 0 on success.
+ */
+static int32_t checkpoint(struct nvm_log *log)
+{
+    struct nvm_log_index_hdr *hdr;
+    struct nvm_log_entry *saved;
+    uint8_t *buf;
+    uint32_t len, i, n = 0u;
+    int32_t ret = -1;
+
+    pthread_mutex_lock(&log->lock);
+    len = (uint32_t)sizeof(*hdr) + (log->nb * (uint32_t)sizeof(struct nvm_log_entry));
+    buf = malloc(len);
+    if (buf != NULL) {
+        hdr = (struct nvm_log_index_hdr *)buf;
+        saved = (struct nvm_log_entry *)(buf + sizeof(*hdr));
+        for (i = 0u; i < log->size; i++) {
+            if (log->entries[i].off != 0u) {
+                saved[n++] = log->entries[i];
+            }
+        }
+        hdr->magic = NVM_LOG_INDEX_MAGIC;
+        hdr->version = NVM_LOG_VERSION;
+        hdr->gen = log->gen;
+        hdr->end = log->end;
+        hdr->nb = n;
+        hdr->crc = crc32_update(0u, (uint8_t *)saved, n * (uint32_t)sizeof(struct nvm_log_entry));
+    }
+    log->since_checkpoint = 0u;
+    pthread_mutex_unlock(&log->lock);
+
+    /* The records indexed are written before the index. */
+    if ((buf != NULL) && (fdatasync(log->fd) == 0)
+        && (nvm_commit_write(log->index_path, buf, len, true) == (int32_t)len)) {
+        ret = 0;
+    }
+    free(buf);
+
+    return ret;
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint64_t x = ((const struct nvm_log_entry *)a)->blob_id;
+    uint64_t y = ((const struct nvm_log_entry *)b)->blob_id;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/* Copy a record from the log to fd at *end. Return 0 on success. */
+static int32_t rec_copy(struct nvm_log *log, uint8_t *buf, const struct nvm_log_entry *e, int fd, uint64_t *end)
+{
+    uint64_t len = rec_size(e->size);
+    struct iovec iov = {buf, (size_t)len};
+
+    if ((full_pread(log->fd, buf, (size_t)len, e->off) != 0)
+        || (full_pwritev(fd, &iov, 1, *end) != 0)) {
+        return -1;
+    }
+    *end += len;
+
+    return 0;
+}
+
+/*
+ * Write the current records to a new log and replace the log by it. The
+ * records indexed when the compaction starts are copied without the lock,
+ * the ones appended meanwhile with it before the logs are switched.
+ * Return 0 on success.
+ */
+static int32_t compact(struct nvm_log *log)
+{
+    struct nvm_log_file_hdr file_hdr;
+    struct nvm_log_entry *snap = NULL;
+    struct nvm_log_entry *found;
+    uint64_t *new_off = NULL;
+    uint64_t snap_end, end;
+    uint8_t *buf = malloc(rec_size(NVM_LOG_MAX_CHUNK_SZ));
+    char *tmp = path_in(log->dir, NVM_LOG_FILE ".tmp");
+    uint32_t nb = 0u, i;
+    int32_t ret = -1;
+    struct iovec iov = {&file_hdr, sizeof(file_hdr)};
+    int fd = -1;
+
+    pthread_mutex_lock(&log->lock);
+    snap = malloc(((size_t)log->nb + 1u) * sizeof(struct nvm_log_entry));
+    if (snap != NULL) {
+        for (i = 0u; i < log->size; i++) {
+            if (log->entries[i].off != 0u) {
+                snap[nb++] = log->entries[i];
+            }
+        }
+    }
+    snap_end = log->end;
+    file_hdr.magic = NVM_LOG_MAGIC;
+    file_hdr.version = NVM_LOG_VERSION;
+    file_hdr.gen = log->gen + 1u;
+    pthread_mutex_unlock(&log->lock);
+
+    do {
+        if ((snap == NULL) || (buf == NULL) || (tmp == NULL)) {
+            break;
+        }
+        qsort(snap, nb, sizeof(struct nvm_log_entry), cmp_entry);
+        fd = open(tmp, O_CREAT|O_TRUNC|O_RDWR|O_CLOEXEC, S_IRUSR|S_IWUSR);
+        end = 0u;
+        if ((fd < 0) || (full_pwritev(fd, &iov, 1, end) != 0)) {
+            break;
+        }
+        end = sizeof(file_hdr);
+        /* Appended records do not change the ones before snap_end. */
+        for (i = 0u; i < nb; i++) {
+            if (rec_copy(log, buf, &snap[i], fd, &end) != 0) {
+                break;
+            }
+            /* Offset in the new log, from now on. */
+            snap[i].off = end - rec_size(snap[i].size);
+        }
+        if (i != nb) {
+            break;
+        }
+
+        pthread_mutex_lock(&log->lock);
+        new_off = malloc(((size_t)log->size + 1u) * sizeof(uint64_t));
+        for (i = 0u; (new_off != NULL) && (i < log->size); i++) {
+            new_off[i] = 0u;
+            if (log->entries[i].off == 0u) {
+                continue;
+            }
+            if (log->entries[i].off < snap_end) {
+                /* Indexed before the compaction, copied. */
+                found = bsearch(&log->entries[i], snap, nb, sizeof(struct nvm_log_entry), cmp_entry);
+                if (found == NULL) {
+                    break;
+                }
+                new_off[i] = found->off;
+            } else if (rec_copy(log, buf, &log->entries[i], fd, &end) == 0) {
+                new_off[i] = end - rec_size(log->entries[i].size);
+            } else {
+                break;
+            }
+        }
+        if ((new_off != NULL) && (i == log->size) && (fdatasync(fd) == 0)
+            && (rename(tmp, log->path) == 0)) {
+            /* The new log must stay in place once appended to. */
+            dir_sync(log->dir);
+            for (i = 0u; i < log->size; i++) {
+                log->entries[i].off = new_off[i];
+            }
+            (void)close(log->fd);
+            log->fd = fd;
+            fd = -1;
+            log->gen = file_hdr.gen;
+            log->end = end;
+            log->dirty = false;
+            ret = 0;
+        }
+        pthread_mutex_unlock(&log->lock);
+    } while (false);
+
+    if (fd >= 0) {
+        (void)close(fd);
+        (void)unlink(tmp);
+    }
+    free(new_off);
+    free(snap);
+    free(tmp);
+    free(buf);
+
+    return ret;
+}
+
+static bool need_compaction(const struct nvm_log *log)
+{
+    uint64_t used = log->end - sizeof(struct nvm_log_file_hdr);
+
+    return (log->end >= NVM_LOG_COMPACT_MIN_SZ) && (log->end >= log->retry_end)
+           && (used - log->live > log->live);
+}
+
+static void *nvm_log_thread(void *arg)
+{
+    struct nvm_log *log = arg;
+    bool compacted;
+
+    pthread_mutex_lock(&log->lock);
+    while (log->stop == false) {
+        if (need_compaction(log)) {
+            pthread_mutex_unlock(&log->lock);
+            compacted = (compact(log) == 0);
+            /* The index of the new log is saved at once. */
+            if (compacted) {
+                (void)checkpoint(log);
+            }
+            pthread_mutex_lock(&log->lock);
+            /* Retried once the log doubled. */
+            log->retry_end = compacted ? 0u : (2u * log->end);
+        } else if (log->since_checkpoint >= NVM_LOG_CHECKPOINT_NB) {
+            pthread_mutex_unlock(&log->lock);
+            (void)checkpoint(log);
+            pthread_mutex_lock(&log->lock);
+        } else {
+            pthread_cond_wait(&log->work, &log->lock);
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    return NULL;
+}
+
+/* Read a chunk file of the one-file-per-chunk layout. Return its size, -1 on failure. */
+static int32_t file_read(const char *path, uint8_t *buf, uint32_t size)
+{
+    uint32_t off = 0u;
+    ssize_t l = 0;
+    int fd = open(path, O_RDONLY|O_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+    while (off < size) {
+        l = read(fd, buf + off, size - off);
+        if (l > 0) {
+            off += (uint32_t)l;
+        } else if ((l < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    (void)close(fd);
+
+    return (l < 0) ? -1 : (int32_t)off;
+}
+
+/*
+ * Move the chunk files of the one-file-per-chunk layout, named after their
+ * blob id, to the log. They are removed once the log and its index are
+ * durable.
+ */
+static void migrate(struct nvm_log *log)
+{
+    DIR *dir;
+    struct dirent *de;
+    uint64_t *moved = NULL;
+    uint64_t *grown;
+    uint64_t blob_id;
+    uint8_t *buf = malloc(NVM_LOG_MAX_CHUNK_SZ + 1u);
+    char name[sizeof("0123456789abcdef.tmp")];
+    char *path;
+    uint32_t nb = 0u, max = 0u, i;
+    uint32_t crc;
+    int32_t len;
+
+    dir = opendir(log->dir);
+    if ((dir == NULL) || (buf == NULL)) {
+        free(buf);
+        if (dir != NULL) {
+            (void)closedir(dir);
+        }
+        return;
+    }
+    /* Chunk files written by this process are complete. */
+    nvm_commit_flush();
+
+    while ((de = readdir(dir)) != NULL) {
+        if ((strlen(de->d_name) != 16u) || (strspn(de->d_name, "0123456789abcdef") != 16u)) {
+            continue;
+        }
+        if (nb == max) {
+            max = (max == 0u) ? 64u : 2u * max;
+            grown = realloc(moved, max * sizeof(uint64_t));
+            if (grown == NULL) {
+                break;
+            }
+            moved = grown;
+        }
+        blob_id = strtoull(de->d_name, NULL, 16);
+        /* Otherwise moved before a crash that left the file. */
+        if (index_find(log, blob_id) == NULL) {
+            path = path_in(log->dir, de->d_name);
+            len = (path != NULL) ? file_read(path, buf, NVM_LOG_MAX_CHUNK_SZ + 1u) : -1;
+            free(path);
+            if ((len < 0) || ((uint32_t)len > NVM_LOG_MAX_CHUNK_SZ)) {
+                /* Left in place, still read from the file. */
+                continue;
+            }
+            crc = crc32_update(0u, buf, (uint32_t)len);
+            if ((log_append(log, blob_id, buf, (uint32_t)len, crc) != 0)
+                || (index_set(log, blob_id, log->end - rec_size((uint32_t)len), (uint32_t)len, crc) != 0)) {
+                continue;
+            }
+        }
+        moved[nb++] = blob_id;
+    }
+    (void)closedir(dir);
+
+    if ((nb > 0u) && (checkpoint(log) == 0)) {
+        for (i = 0u; i < nb; i++) {
+            (void)snprintf(name, sizeof(name), "%016lx", (unsigned long)moved[i]);
+            path = path_in(log->dir, name);
+            if (path != NULL) {
+                (void)unlink(path);
+                free(path);
+            }
+            (void)snprintf(name, sizeof(name), "%016lx.tmp", (unsigned long)moved[i]);
+            path = path_in(log->dir, name);
+            if (path != NULL) {
+                (void)unlink(path);
+                free(path);
+            }
+        }
+        dir_sync(log->dir);
+    }
+    free(moved);
+    free(buf);
+}
+
+static void log_free(struct nvm_log *log)
+{
+    if (log->fd >= 0) {
+        (void)close(log->fd);
+    }
+    (void)pthread_cond_destroy(&log->work);
+    (void)pthread_mutex_destroy(&log->lock);
+    free(log->entries);
+    free(log->index_path);
+    free(log->path);
+    free(log->dir);
+    free(log);
+}
+
+/* Open the log of a directory, creating it if needed. NULL on failure. */
+static struct nvm_log *log_open(const char *dir)
+{
+    struct nvm_log_file_hdr file_hdr;
+    struct nvm_log *log = calloc(1u, sizeof(struct nvm_log));
+    struct iovec iov = {&file_hdr, sizeof(file_hdr)};
+    struct timespec ts;
+    struct stat st;
+    bool opened = false;
+
+    if (log == NULL) {
+        return NULL;
+    }
+    (void)pthread_mutex_init(&log->lock, NULL);
+    (void)pthread_cond_init(&log->work, NULL);
+    log->fd = -1;
+    log->dir = strdup(dir);
+    log->path = path_in(dir, NVM_LOG_FILE);
+    log->index_path = path_in(dir, NVM_LOG_INDEX_FILE);
+
+    do {
+        if ((log->dir == NULL) || (log->path == NULL) || (log->index_path == NULL)) {
+            break;
+        }
+        (void)mkdir(dir, S_IRWXU);
+        log->fd = open(log->path, O_CREAT|O_RDWR|O_CLOEXEC, S_IRUSR|S_IWUSR);
+        if ((log->fd < 0) || (fstat(log->fd, &st) != 0)) {
+            break;
+        }
+
+        if (((uint64_t)st.st_size >= sizeof(file_hdr))
+            && (full_pread(log->fd, &file_hdr, sizeof(file_hdr), 0u) == 0)
+            && (file_hdr.magic == NVM_LOG_MAGIC) && (file_hdr.version == NVM_LOG_VERSION)) {
+            log->gen = file_hdr.gen;
+            log_scan(log, index_load(log, (uint64_t)st.st_size));
+        } else {
+            /* New log, or crash before its header was written. */
+            (void)clock_gettime(CLOCK_REALTIME, &ts);
+            file_hdr.magic = NVM_LOG_MAGIC;
+            file_hdr.version = NVM_LOG_VERSION;
+            file_hdr.gen = ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+            if ((ftruncate(log->fd, 0) != 0) || (full_pwritev(log->fd, &iov, 1, 0u) != 0)
+                || (fdatasync(log->fd) != 0)) {
+                break;
+            }
+            dir_sync(dir);
+            log->gen = file_hdr.gen;
+            log->end = sizeof(file_hdr);
+        }
+
+        migrate(log);
+        opened = true;
+    } while (false);
+
+    if (opened == false) {
+        log_free(log);
+        log = NULL;
+    }
+
+    return log;
+}
+
+struct nvm_log *nvm_log_get(const char *dir)
+{
+    struct nvm_log *log;
+    int state;
+
+    if (dir == NULL) {
+        return NULL;
+    }
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock(&nvm_log_list_lock);
+    for (log = nvm_log_list; log != NULL; log = log->next) {
+        if (strcmp(log->dir, dir) == 0) {
+            break;
+        }
+    }
+    if (log == NULL) {
+        log = log_open(dir);
+        if (log != NULL) {
+            if (pthread_create(&log->thread, NULL, nvm_log_thread, log) == 0) {
+                log->next = nvm_log_list;
+                nvm_log_list = log;
+            } else {
+                log_free(log);
+                log = NULL;
+            }
+        }
+    }
+    pthread_mutex_unlock(&nvm_log_list_lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    return log;
+}
+
+int32_t nvm_log_write(struct nvm_log *log, uint64_t blob_id, const uint8_t *src, uint32_t size)
+{
+    uint32_t crc;
+    int32_t ret = -1;
+    int state;
+
+    if ((log == NULL) || ((src == NULL) && (size != 0u)) || (size > NVM_LOG_MAX_CHUNK_SZ)) {
+        return -1;
+    }
+    crc = crc32_update(0u, src, size);
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock(&log->lock);
+    if (log_append(log, blob_id, src, size, crc) == 0) {
+        log->dirty = true;
+        log->since_checkpoint++;
+        if (index_set(log, blob_id, log->end - rec_size(size), size, crc) == 0) {
+            ret = (int32_t)size;
+        }
+        if ((log->since_checkpoint >= NVM_LOG_CHECKPOINT_NB) || need_compaction(log)) {
+            pthread_cond_signal(&log->work);
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    return ret;
+}
+
+int32_t nvm_log_read(struct nvm_log *log, uint64_t blob_id, uint8_t *dst, uint32_t size)
+{
+    struct nvm_log_entry *e;
+    int32_t ret = 0;
+    int state;
+
+    if ((log == NULL) || (dst == NULL)) {
+        return -1;
+    }
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock(&log->lock);
+    e = index_find(log, blob_id);
+    if (e != NULL) {
+        if (size > e->size) {
+            size = e->size;
+        }
+        ret = (full_pread(log->fd, dst, size, e->off + sizeof(struct nvm_log_rec_hdr)) == 0)
+              ? (int32_t)size : -1;
+    }
+    pthread_mutex_unlock(&log->lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    return ret;
+}
+
+/*
+ * Insert an id in the nb first entries of ids, sorted by decreasing key,
+ * keeping the max largest keys.
+ */
+static void top_insert(uint64_t *ids, uint64_t *keys, uint32_t *nb, uint32_t max, uint64_t id, uint64_t key)
+{
+    uint32_t i = *nb;
+
+    if ((i == max) && ((max == 0u) || (keys[max - 1u] >= key))) {
+        return;
+    }
+    if (i == max) {
+        i--;
+    } else {
+        (*nb)++;
+    }
+    while ((i > 0u) && (keys[i - 1u] < key)) {
+        ids[i] = ids[i - 1u];
+        keys[i] = keys[i - 1u];
+        i--;
+    }
+    ids[i] = id;
+    keys[i] = key;
+}
+
+uint32_t nvm_log_list_chunks(struct nvm_log *log, const char *dir, uint64_t *ids, uint32_t max)
+{
+    DIR *d;
+    struct dirent *de;
+    struct stat st;
+    uint64_t *keys;
+    uint64_t blob_id;
+    uint32_t nb_log = 0u, nb_files = 0u, i;
+    char *path;
+    int state;
+
+    if ((ids == NULL) || (max == 0u)) {
+        return 0u;
+    }
+    keys = malloc(max * sizeof(uint64_t));
+    if (keys == NULL) {
+        return 0u;
+    }
+
+    /* Chunks of the store, the last appended record is the most recent. */
+    if (log != NULL) {
+        (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        pthread_mutex_lock(&log->lock);
+        for (i = 0u; i < log->size; i++) {
+            if (log->entries[i].off != 0u) {
+                top_insert(ids, keys, &nb_log, max, log->entries[i].blob_id, log->entries[i].off);
+            }
+        }
+        pthread_mutex_unlock(&log->lock);
+        (void)pthread_setcancelstate(state, NULL);
+    }
+
+    /* Chunk files not moved to the store, by modification time. */
+    d = (dir != NULL) ? opendir(dir) : NULL;
+    if (d != NULL) {
+        while ((nb_log < max) && ((de = readdir(d)) != NULL)) {
+            if ((strlen(de->d_name) != 16u) || (strspn(de->d_name, "0123456789abcdef") != 16u)) {
+                continue;
+            }
+            blob_id = strtoull(de->d_name, NULL, 16);
+            for (i = 0u; (i < nb_log) && (ids[i] != blob_id); i++) {
+            }
+            path = path_in(dir, de->d_name);
+            if ((i < nb_log) || (path == NULL) || (stat(path, &st) != 0)) {
+                free(path);
+                continue;
+            }
+            free(path);
+            top_insert(ids + nb_log, keys + nb_log, &nb_files, max - nb_log, blob_id,
+                       ((uint64_t)st.st_mtim.tv_sec * 1000000000u) + (uint64_t)st.st_mtim.tv_nsec);
+        }
+        (void)closedir(d);
+    }
+    free(keys);
+
+    return nb_log + nb_files;
+}
+
+int32_t nvm_log_sync_all(void)
+{
+    struct nvm_log *log;
+    int32_t ret = 0;
+    int state;
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock(&nvm_log_list_lock);
+    for (log = nvm_log_list; log != NULL; log = log->next) {
+        pthread_mutex_lock(&log->lock);
+        if (log->dirty == true) {
+            if (fdatasync(log->fd) == 0) {
+                log->dirty = false;
+            } else {
+                ret = -1;
+            }
+        }
+        pthread_mutex_unlock(&log->lock);
+    }
+    pthread_mutex_unlock(&nvm_log_list_lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    return ret;
+}
+
+void nvm_log_close(struct nvm_log *log)
+{
+    struct nvm_log **prev;
+
+    if (log == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&nvm_log_list_lock);
+    for (prev = &nvm_log_list; (*prev != NULL) && (*prev != log); prev = &(*prev)->next) {
+    }
+    if (*prev == log) {
+        *prev = log->next;
+    }
+    pthread_mutex_unlock(&nvm_log_list_lock);
+
+    pthread_mutex_lock(&log->lock);
+    log->stop = true;
+    pthread_cond_signal(&log->work);
+    pthread_mutex_unlock(&log->lock);
+    (void)pthread_join(log->thread, NULL);
+
+    (void)fdatasync(log->fd);
+    log_free(log);
+}
@@ -11,6 +11,13 @@
  * activate or otherwise use the software.
  */
 
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
 #include "sab_msg_def.h"
 #include "sab_messaging.h"
 #include "nvm.h"
@@ -24,6 +31,13 @@ struct nvm_ctx {
     uint32_t storage_handle;
     uint32_t blob_size;
     uint32_t mu_type;
+    /* Started with NVM_FLAGS_PREFETCH. */
+    bool prefetch;
+    /* Prefetch thread of the channel, running until joined. */
+    bool prefetch_running;
+    /* Asks the prefetch thread to stop, under the cache lock. */
+    bool prefetch_stop;
+    pthread_t prefetch_thread;
 };
 
 struct nvm_header_s {
@@ -32,13 +46,238 @@ struct nvm_header_s {
     uint64_t blob_id;
 };
 
-struct nvm_chunk_hdr {
+static struct nvm_ctx nvm_ctx = {0};
+
+/* Largest blob, header included. */
+#define NVM_BLOB_MAX_SZ     (16u * 1024u)
+
+/*
+ * Chunks keep the layout of the first versions, where the header size
+ * counts the header, followed by this marker: the CRC of a marked chunk
+ * covers its blob. Older readers ignore the marker. An unmarked chunk was
+ * written by an older version, its CRC covered 16 bytes past the blob that
+ * were not stored.
+ */
+#define NVM_CHUNK_MARK      0x324b434eu     /* "NCK2" */
+#define NVM_CHUNK_MARK_SZ   ((uint32_t)sizeof(uint32_t))
+/* Blob buffers, room for the marker and 64 bytes aligned. */
+#define NVM_BLOB_BUF_SZ     (NVM_BLOB_MAX_SZ + 64u)
+
+/*
+ * Chunks read or exported last, the enclave gets the same ones again each
+ * time it reloads a key group it evicted. The least recently used entry is
+ * replaced when the cache is full. The cache is shared by the channels of
+ * nvm_service(), an entry belongs to the channel type it was read for.
+ * The prefetch threads fill free entries while the manager serves the
+ * enclave: entries are taken, filled without the lock and put back.
+ */
+#ifndef NVM_CHUNK_CACHE_NB
+#define NVM_CHUNK_CACHE_NB  16u
+#endif
+
+struct nvm_chunk_cache_entry {
     uint64_t blob_id;
-    uint32_t len;
+    uint32_t mu_type;
+    uint32_t last_use;
+    /* Blob with its header, in a buffer of the pool. */
     uint8_t *data;
+    bool valid;
+    /* Unmarked chunk, checked by the enclave only. */
+    bool legacy;
+    /* Taken to be filled with the blob of blob_id and mu_type. */
+    bool busy;
 };
 
-static struct nvm_ctx nvm_ctx = {0};
+static struct nvm_chunk_cache_entry nvm_chunk_cache[NVM_CHUNK_CACHE_NB];
+static uint32_t nvm_chunk_cache_tick;
+static pthread_mutex_t nvm_chunk_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when an entry is put back. */
+static pthread_cond_t nvm_chunk_cache_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Blob buffers of NVM_BLOB_BUF_SZ bytes, allocated once when the manager
+ * starts: one per cache entry, chunks are received and read in the entry
+ * that keeps them, and one for the master blob. Requests are then served
+ * without heap calls.
+ */
+static uint8_t *nvm_pool;
+static uint8_t *nvm_master_buf;
+
+/* Allocate the blob buffers if not done yet. Return false if out of memory. */
+static bool nvm_pool_get(void)
+{
+    uint32_t i;
+
+    if (nvm_pool == NULL) {
+        nvm_pool = plat_os_abs_malloc((NVM_CHUNK_CACHE_NB + 1u) * NVM_BLOB_BUF_SZ);
+        if (nvm_pool == NULL) {
+            return false;
+        }
+        /* Fault the pages in now rather than on the first requests. */
+        plat_os_abs_memset(nvm_pool, 0u, (NVM_CHUNK_CACHE_NB + 1u) * NVM_BLOB_BUF_SZ);
+        for (i = 0u; i < NVM_CHUNK_CACHE_NB; i++) {
+            nvm_chunk_cache[i].data = nvm_pool + (i * NVM_BLOB_BUF_SZ);
+            nvm_chunk_cache[i].valid = false;
+            nvm_chunk_cache[i].busy = false;
+        }
+        nvm_master_buf = nvm_pool + (NVM_CHUNK_CACHE_NB * NVM_BLOB_BUF_SZ);
+    }
+
+    return true;
+}
+
+static void nvm_pool_release(void)
+{
+    uint32_t i;
+
+    for (i = 0u; i < NVM_CHUNK_CACHE_NB; i++) {
+        nvm_chunk_cache[i].data = NULL;
+        nvm_chunk_cache[i].valid = false;
+        nvm_chunk_cache[i].busy = false;
+    }
+    nvm_master_buf = NULL;
+    plat_os_abs_free(nvm_pool);
+    nvm_pool = NULL;
+}
+
+/* Lock the cache. The waits for an entry are not cancellation points. */
+static int nvm_chunk_cache_enter(void)
+{
+    int state;
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    (void)pthread_mutex_lock(&nvm_chunk_cache_lock);
+
+    return state;
+}
+
+static void nvm_chunk_cache_leave(int state)
+{
+    (void)pthread_mutex_unlock(&nvm_chunk_cache_lock);
+    (void)pthread_setcancelstate(state, NULL);
+}
+
+/* Entry of a blob, valid or being filled. Called with the cache locked. */
+static struct nvm_chunk_cache_entry *nvm_chunk_cache_lookup(uint32_t mu_type, uint64_t blob_id)
+{
+    uint32_t i;
+
+    for (i = 0u; i < NVM_CHUNK_CACHE_NB; i++) {
+        if ((nvm_chunk_cache[i].valid || nvm_chunk_cache[i].busy)
+            && (nvm_chunk_cache[i].blob_id == blob_id)
+            && (nvm_chunk_cache[i].mu_type == mu_type)) {
+            return &nvm_chunk_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Valid entry of a blob, once read if a prefetch thread is reading it. Called with the cache locked. */
+static struct nvm_chunk_cache_entry *nvm_chunk_cache_wait(uint32_t mu_type, uint64_t blob_id)
+{
+    struct nvm_chunk_cache_entry *entry = nvm_chunk_cache_lookup(mu_type, blob_id);
+
+    while ((entry != NULL) && entry->busy) {
+        (void)pthread_cond_wait(&nvm_chunk_cache_cond, &nvm_chunk_cache_lock);
+        entry = nvm_chunk_cache_lookup(mu_type, blob_id);
+    }
+
+    return entry;
+}
+
+static struct nvm_chunk_cache_entry *nvm_chunk_cache_find(uint32_t mu_type, uint64_t blob_id)
+{
+    struct nvm_chunk_cache_entry *entry;
+    int state = nvm_chunk_cache_enter();
+
+    entry = nvm_chunk_cache_wait(mu_type, blob_id);
+    if (entry != NULL) {
+        entry->last_use = ++nvm_chunk_cache_tick;
+    }
+    nvm_chunk_cache_leave(state);
+
+    return entry;
+}
+
+static void nvm_chunk_cache_drop(uint32_t mu_type, uint64_t blob_id)
+{
+    struct nvm_chunk_cache_entry *entry;
+    int state = nvm_chunk_cache_enter();
+
+    entry = nvm_chunk_cache_wait(mu_type, blob_id);
+    if (entry != NULL) {
+        entry->valid = false;
+    }
+    nvm_chunk_cache_leave(state);
+}
+
+/*
+ * Take an entry to fill with a blob not cached yet: a free one, else the
+ * least recently used unless prefetching, in which case NULL is returned
+ * as well if the blob is already cached or the prefetch thread of ctx is
+ * asked to stop. It is put back with nvm_chunk_cache_put().
+ */
+static struct nvm_chunk_cache_entry *nvm_chunk_cache_take(struct nvm_ctx *nvm_ctx_param, uint64_t blob_id, bool prefetch)
+{
+    struct nvm_chunk_cache_entry *entry = NULL;
+    uint32_t i;
+    int state = nvm_chunk_cache_enter();
+
+    if (!prefetch
+        || (!nvm_ctx_param->prefetch_stop && (nvm_chunk_cache_lookup(nvm_ctx_param->mu_type, blob_id) == NULL))) {
+        for (i = 0u; i < NVM_CHUNK_CACHE_NB; i++) {
+            if (nvm_chunk_cache[i].busy) {
+                continue;
+            }
+            if (!nvm_chunk_cache[i].valid) {
+                entry = &nvm_chunk_cache[i];
+                break;
+            }
+            if (!prefetch && ((entry == NULL) || (nvm_chunk_cache[i].last_use < entry->last_use))) {
+                entry = &nvm_chunk_cache[i];
+            }
+        }
+    }
+    if (entry != NULL) {
+        entry->blob_id = blob_id;
+        entry->mu_type = nvm_ctx_param->mu_type;
+        entry->valid = false;
+        entry->legacy = false;
+        entry->busy = true;
+    }
+    nvm_chunk_cache_leave(state);
+
+    return entry;
+}
+
+/* Put back a taken entry, valid if its data now hold the blob. */
+static void nvm_chunk_cache_put(struct nvm_chunk_cache_entry *entry, bool valid)
+{
+    int state = nvm_chunk_cache_enter();
+
+    entry->last_use = ++nvm_chunk_cache_tick;
+    entry->valid = valid;
+    entry->busy = false;
+    (void)pthread_cond_broadcast(&nvm_chunk_cache_cond);
+    nvm_chunk_cache_leave(state);
+}
+
+/* Drop the entries of a channel type, no longer used by its manager nor its prefetch thread. */
+static void nvm_chunk_cache_clear(uint32_t mu_type)
+{
+    uint32_t i;
+    int state = nvm_chunk_cache_enter();
+
+    for (i = 0u; i < NVM_CHUNK_CACHE_NB; i++) {
+        if (nvm_chunk_cache[i].mu_type == mu_type) {
+            nvm_chunk_cache[i].valid = false;
+            nvm_chunk_cache[i].busy = false;
+        }
+    }
+    (void)pthread_cond_broadcast(&nvm_chunk_cache_cond);
+    nvm_chunk_cache_leave(state);
+}
 
 /* Storage import processing. Return 0 on success.  */
 static uint32_t nvm_storage_import(struct nvm_ctx *nvm_ctx_param, uint8_t *data, uint32_t len)
@@ -86,57 +325,127 @@ static uint32_t nvm_storage_import(struct nvm_ctx *nvm_ctx_param, uint8_t *data,
     return ret;
 }
 
-void nvm_close_session(void)
+/*
+ * State of nvm_manager() or nvm_service() seen by the other threads.
+ * stop_fd is the eventfd polled by nvm_service() with the channels, valid
+ * while it is starting or running.
+ */
+struct nvm_state {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t status;
+    int32_t stop_fd;
+    bool stop;
+};
+
+static struct nvm_state nvm_state = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NVM_STATUS_UNDEF, -1, false
+};
+
+/* Update the status and wake up nvm_wait_ready(). Return true if a stop is requested. */
+static bool nvm_set_status(uint32_t status, int32_t stop_fd)
 {
-    if (nvm_ctx.phdl != NULL) {
-        if (nvm_ctx.storage_handle != 0u) {
-            (void)sab_close_storage_command (nvm_ctx.phdl, nvm_ctx.storage_handle, nvm_ctx.mu_type);
-            nvm_ctx.storage_handle = 0u;
+    bool stop;
+    int state;
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    (void)pthread_mutex_lock(&nvm_state.lock);
+    nvm_state.status = status;
+    nvm_state.stop_fd = stop_fd;
+    stop = nvm_state.stop;
+    if (status == NVM_STATUS_STOPPED) {
+        nvm_state.stop = false;
+    }
+    (void)pthread_cond_broadcast(&nvm_state.cond);
+    (void)pthread_mutex_unlock(&nvm_state.lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    return stop;
+}
+
+/* Stop the prefetch thread of a channel, if any, before its MU channel is closed. */
+static void nvm_prefetch_stop(struct nvm_ctx *nvm_ctx_param)
+{
+    int state;
+
+    if (nvm_ctx_param->prefetch_running) {
+        state = nvm_chunk_cache_enter();
+        nvm_ctx_param->prefetch_stop = true;
+        nvm_chunk_cache_leave(state);
+
+        (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        (void)pthread_join(nvm_ctx_param->prefetch_thread, NULL);
+        (void)pthread_setcancelstate(state, NULL);
+        nvm_ctx_param->prefetch_running = false;
+        nvm_ctx_param->prefetch_stop = false;
+    }
+}
+
+static void nvm_ctx_close(struct nvm_ctx *nvm_ctx_param)
+{
+    nvm_prefetch_stop(nvm_ctx_param);
+    if (nvm_ctx_param->phdl != NULL) {
+        if (nvm_ctx_param->storage_handle != 0u) {
+            (void)sab_close_storage_command (nvm_ctx_param->phdl, nvm_ctx_param->storage_handle, nvm_ctx_param->mu_type);
+            nvm_ctx_param->storage_handle = 0u;
         }          
-        if (nvm_ctx.session_handle != 0u) {
-            (void)sab_close_session_command (nvm_ctx.phdl, nvm_ctx.session_handle, nvm_ctx.mu_type);
-            nvm_ctx.session_handle = 0u;
+        if (nvm_ctx_param->session_handle != 0u) {
+            (void)sab_close_session_command (nvm_ctx_param->phdl, nvm_ctx_param->session_handle, nvm_ctx_param->mu_type);
+            nvm_ctx_param->session_handle = 0u;
         }
-        plat_os_abs_close_session(nvm_ctx.phdl);
-        nvm_ctx.phdl = NULL;
+        plat_os_abs_close_session(nvm_ctx_param->phdl);
+        nvm_ctx_param->phdl = NULL;
     }
+    nvm_chunk_cache_clear(nvm_ctx_param->mu_type);
+}
+
+void nvm_close_session(void)
+{
+    nvm_ctx_close(&nvm_ctx);
+    nvm_pool_release();
+    /* Next start is waited for from scratch. */
+    (void)nvm_set_status(NVM_STATUS_UNDEF, -1);
 }
 
-static void nvm_open_session(uint8_t flags)
+static void nvm_open_session(struct nvm_ctx *nvm_ctx_param, uint8_t flags)
 {
     uint32_t err = SAB_FAILURE_STATUS;
     struct plat_mu_params mu_params;
 
     do {
         /* Check if structure is already in use */
-        if (nvm_ctx.phdl != NULL) {
+        if (nvm_ctx_param->phdl != NULL) {
             break;
         }
 
+        nvm_ctx_param->prefetch = ((flags & NVM_FLAGS_PREFETCH) != 0u);
+        /* Not a flag of the enclave. */
+        flags &= ~NVM_FLAGS_PREFETCH;
+
         /* Open the Storage session on the MU */
         if ((flags & NVM_FLAGS_V2X) != 0u) {
             if ((flags & NVM_FLAGS_SHE) != 0u) {
-                nvm_ctx.mu_type = MU_CHANNEL_V2X_SHE_NVM;
+                nvm_ctx_param->mu_type = MU_CHANNEL_V2X_SHE_NVM;
             } else {
-                nvm_ctx.mu_type = MU_CHANNEL_V2X_HSM_NVM;
+                nvm_ctx_param->mu_type = MU_CHANNEL_V2X_HSM_NVM;
             }
         } else {
             if ((flags & NVM_FLAGS_SHE) != 0u) {
-                nvm_ctx.mu_type = MU_CHANNEL_PLAT_SHE_NVM;
+                nvm_ctx_param->mu_type = MU_CHANNEL_PLAT_SHE_NVM;
             } else {
-                nvm_ctx.mu_type = MU_CHANNEL_PLAT_HSM_NVM;
+                nvm_ctx_param->mu_type = MU_CHANNEL_PLAT_HSM_NVM;
             }
         }
-        nvm_ctx.phdl = plat_os_abs_open_mu_channel(nvm_ctx.mu_type, &mu_params);
+        nvm_ctx_param->phdl = plat_os_abs_open_mu_channel(nvm_ctx_param->mu_type, &mu_params);
 
-        if (nvm_ctx.phdl == NULL) {
+        if (nvm_ctx_param->phdl == NULL) {
             break;
         }
 
         /* Open the SAB session on the selected security enclave */
-        err = sab_open_session_command(nvm_ctx.phdl,
-                                       &nvm_ctx.session_handle,
-                                       nvm_ctx.mu_type,
+        err = sab_open_session_command(nvm_ctx_param->phdl,
+                                       &nvm_ctx_param->session_handle,
+                                       nvm_ctx_param->mu_type,
                                        mu_params.mu_id,
                                        mu_params.interrupt_idx,
                                        mu_params.tz,
@@ -144,26 +453,25 @@ static void nvm_open_session(uint8_t flags)
                                        SAB_OPEN_SESSION_PRIORITY_LOW,
                                        ((flags & NVM_FLAGS_V2X) != 0u) ? SAB_OPEN_SESSION_LOW_LATENCY_MASK : 0U);
         if (err != SAB_SUCCESS_STATUS) {
-            nvm_ctx.session_handle = 0u;
+            nvm_ctx_param->session_handle = 0u;
             break;
         }
 
         /* Open the NVM STORAGE session on the selected security enclave */
-        err = sab_open_storage_command(nvm_ctx.phdl,
-                                        nvm_ctx.session_handle,
-                                        &nvm_ctx.storage_handle,
-                                        nvm_ctx.mu_type,
+        err = sab_open_storage_command(nvm_ctx_param->phdl,
+                                        nvm_ctx_param->session_handle,
+                                        &nvm_ctx_param->storage_handle,
+                                        nvm_ctx_param->mu_type,
                                         flags);
         if (err != SAB_SUCCESS_STATUS) {
-            nvm_ctx.storage_handle = 0u;
+            nvm_ctx_param->storage_handle = 0u;
             break;
         }
     } while (false);
 
     /* Clean-up in case of error. */
     if (err != SAB_SUCCESS_STATUS) { 
-        nvm_close_session();
-        //clean nvm_ctx
+        nvm_ctx_close(nvm_ctx_param);
     }
 }
 
@@ -215,13 +523,13 @@ static uint32_t nvm_manager_export_master(struct nvm_ctx *nvm_ctx_param, struct
         /* Extract length of the blob from the message. */
         nvm_ctx_param->blob_size = msg->key_store_size;
         data_len = msg->key_store_size + (uint32_t)sizeof(struct nvm_header_s);
-        if ((data_len == 0u) || (data_len > 16u*1024u)) {
+        if ((data_len == 0u) || (data_len > NVM_BLOB_MAX_SZ)) {
             /* Fixing arbitrary maximum blob size to 16k for sanity checks.*/
             break;
         }
 
-        /* Allocate memory for receiving data. */
-        data = plat_os_abs_malloc(data_len);
+        /* Receive the data in the master blob buffer of the pool. */
+        data = nvm_master_buf;
         /* If data is NULL the response should be sent to platform with an error code. Process is stopped after. */
 
         /* Build the response indicating the destination address to platform. */
@@ -279,8 +587,6 @@ static uint32_t nvm_manager_export_master(struct nvm_ctx *nvm_ctx_param, struct
         }
     } while (false);
 
-    plat_os_abs_free(data);
-
     return err;
 }
 
@@ -289,11 +595,15 @@ static uint32_t nvm_manager_export_chunk(struct nvm_ctx *nvm_ctx_param, struct s
     uint32_t err = 0u;
     uint32_t data_len;
     int32_t len = 0;
-    struct nvm_chunk_hdr *chunk = NULL;
+    uint64_t blob_id;
+    uint8_t *data = NULL;
+    struct nvm_chunk_cache_entry *entry = NULL;
+    bool written = false;
     struct sab_cmd_key_store_chunk_export_rsp resp;
     struct sab_cmd_key_store_export_finish_msg finish_msg;
     uint64_t plat_addr;
     struct nvm_header_s *blob_hdr;
+    uint32_t mark = NVM_CHUNK_MARK;
 
     do {
         /* Consistency check of message length. */
@@ -303,25 +613,27 @@ static uint32_t nvm_manager_export_chunk(struct nvm_ctx *nvm_ctx_param, struct s
         /* Extract length of the blob from the message. */
         nvm_ctx_param->blob_size = msg->chunk_size;
         data_len = msg->chunk_size + (uint32_t)sizeof(struct nvm_header_s);
-        if ((data_len == 0u) || (data_len > 16u*1024u)) {
+        if ((data_len == 0u) || (data_len > NVM_BLOB_MAX_SZ)) {
             /* Fixing arbitrary maximum blob size to 16k for sanity checks.*/
             break;
         }
-        /* Allocate memory for receiving data. */
-        chunk = (struct nvm_chunk_hdr *)plat_os_abs_malloc((uint32_t)sizeof(struct nvm_chunk_hdr));
-        if (chunk != NULL) {
-            chunk->data = plat_os_abs_malloc(data_len + (uint32_t)sizeof(struct nvm_header_s));
-            chunk->blob_id = ((uint64_t)(msg->blob_id_ext) << 32u) | (uint64_t)(msg->blob_id);
-            chunk->len = data_len;
+        blob_id = ((uint64_t)(msg->blob_id_ext) << 32u) | (uint64_t)(msg->blob_id);
+        /* The cached content is outdated whatever the outcome. */
+        nvm_chunk_cache_drop(nvm_ctx_param->mu_type, blob_id);
+
+        /* Receive the data in the cache entry that keeps them once written. */
+        entry = nvm_chunk_cache_take(nvm_ctx_param, blob_id, false);
+        if (entry != NULL) {
+            data = entry->data;
         }
-        /* If allocation failed the response should be sent to platform with an error code. Process is stopped after. */
+        /* If data is NULL the response should be sent to platform with an error code. Process is stopped after. */
 
         /* Build the response indicating the destination address to platform. */
         plat_fill_rsp_msg_hdr(&resp.hdr, SAB_STORAGE_CHUNK_EXPORT_REQ, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_export_rsp), nvm_ctx_param->mu_type);
 
-        if ((chunk != NULL) && (chunk->data != NULL)) {
+        if (data != NULL) {
             plat_addr = plat_os_abs_data_buf(nvm_ctx_param->phdl,
-                                            chunk->data + (uint32_t)sizeof(struct nvm_header_s),
+                                            data + (uint32_t)sizeof(struct nvm_header_s),
                                             nvm_ctx_param->blob_size,
                                             0u);
             resp.chunk_export_address = (uint32_t)(plat_addr & 0xFFFFFFFFu);
@@ -336,7 +648,7 @@ static uint32_t nvm_manager_export_chunk(struct nvm_ctx *nvm_ctx_param, struct s
             break;
         }
 
-        if ((chunk == NULL) || (chunk->data == NULL)) {
+        if (data == NULL) {
             break;
         }
 
@@ -348,35 +660,105 @@ static uint32_t nvm_manager_export_chunk(struct nvm_ctx *nvm_ctx_param, struct s
         }
 
         if (finish_msg.export_status == SAB_EXPORT_STATUS_SUCCESS) {
-
-            blob_hdr = (struct nvm_header_s *)chunk->data;
-            blob_hdr->size = chunk->len;
-            blob_hdr->crc = plat_os_abs_crc(chunk->data + sizeof(struct nvm_header_s), chunk->len);
-            blob_hdr->blob_id = chunk->blob_id;
-
-            if (plat_os_abs_storage_write_chunk(nvm_ctx_param->phdl, chunk->data, chunk->len , chunk->blob_id) != (int32_t)(chunk->len)) {
+            blob_hdr = (struct nvm_header_s *)data;
+            blob_hdr->size = data_len;
+            blob_hdr->crc = plat_os_abs_crc(data + sizeof(struct nvm_header_s), nvm_ctx_param->blob_size);
+            blob_hdr->blob_id = blob_id;
+            plat_os_abs_memcpy(data + data_len, (uint8_t *)&mark, NVM_CHUNK_MARK_SZ);
+
+            if (plat_os_abs_storage_write_chunk(nvm_ctx_param->phdl, data, data_len + NVM_CHUNK_MARK_SZ, blob_id)
+                == (int32_t)(data_len + NVM_CHUNK_MARK_SZ)) {
+                /* Next get of this chunk is served from memory. */
+                written = true;
+            } else {
                 err = 1;
             }
         }
-        
+        nvm_ctx_param->blob_size = 0u;
+
         /* Send success to platform. */
         (void)nvm_export_finish_rsp(nvm_ctx_param, err);
 
         err = 0u;
     } while (false);
 
-    if (chunk != NULL) {
-        plat_os_abs_free(chunk->data);
+    if (entry != NULL) {
+        nvm_chunk_cache_put(entry, written);
     }
-    plat_os_abs_free(chunk);
 
     return err;
 }
 
+/*
+ * Read the chunk blob of a taken entry, header included, from storage into
+ * its buffer, with one read of the file, and check it.
+ * Return true on success.
+ */
+static bool nvm_chunk_load(struct nvm_ctx *nvm_ctx_param, struct nvm_chunk_cache_entry *entry)
+{
+    struct nvm_header_s *blob_hdr = (struct nvm_header_s *)entry->data;
+    uint32_t mark = 0u;
+    int32_t len;
+    bool valid = false;
+
+    len = plat_os_abs_storage_read_chunk(nvm_ctx_param->phdl, entry->data, NVM_BLOB_BUF_SZ, entry->blob_id);
+    if ((len >= (int32_t)sizeof(struct nvm_header_s)) && (blob_hdr->blob_id == entry->blob_id)
+        && (blob_hdr->size >= (uint32_t)sizeof(struct nvm_header_s)) && (blob_hdr->size <= NVM_BLOB_MAX_SZ)) {
+        if ((uint32_t)len == blob_hdr->size + NVM_CHUNK_MARK_SZ) {
+            plat_os_abs_memcpy((uint8_t *)&mark, entry->data + blob_hdr->size, NVM_CHUNK_MARK_SZ);
+        }
+        if (mark == NVM_CHUNK_MARK) {
+            valid = (plat_os_abs_crc(entry->data + sizeof(struct nvm_header_s),
+                                     blob_hdr->size - (uint32_t)sizeof(struct nvm_header_s)) == blob_hdr->crc);
+        } else if ((uint32_t)len == blob_hdr->size) {
+            /* Its CRC cannot be checked, see nvm_manager_get_chunk(). */
+            entry->legacy = true;
+            valid = true;
+        } else {
+            /* Truncated blob. */
+        }
+    }
+
+    return valid;
+}
+
+/*
+ * Read the chunks of the storage of a channel, the most recently written
+ * first, in the free entries of the cache. A get of a chunk being read
+ * waits for it rather than reading it again.
+ */
+static void *nvm_prefetch_thread(void *arg)
+{
+    struct nvm_ctx *nvm_ctx_param = (struct nvm_ctx *)arg;
+    struct nvm_chunk_cache_entry *entry;
+    uint64_t ids[NVM_CHUNK_CACHE_NB];
+    uint32_t nb, i;
+
+    nb = plat_os_abs_storage_list_chunks(nvm_ctx_param->phdl, ids, NVM_CHUNK_CACHE_NB);
+    for (i = 0u; i < nb; i++) {
+        entry = nvm_chunk_cache_take(nvm_ctx_param, ids[i], true);
+        if (entry != NULL) {
+            nvm_chunk_cache_put(entry, nvm_chunk_load(nvm_ctx_param, entry));
+        }
+    }
+
+    return NULL;
+}
+
+/* Start the prefetch thread of a channel opened with NVM_FLAGS_PREFETCH. */
+static void nvm_prefetch_start(struct nvm_ctx *nvm_ctx_param)
+{
+    if (nvm_ctx_param->prefetch && !nvm_ctx_param->prefetch_running
+        && (pthread_create(&nvm_ctx_param->prefetch_thread, NULL, nvm_prefetch_thread, nvm_ctx_param) == 0)) {
+        nvm_ctx_param->prefetch_running = true;
+    }
+}
+
 static uint32_t nvm_manager_get_chunk(struct nvm_ctx *nvm_ctx_param, struct sab_cmd_key_store_chunk_get_msg *msg, int32_t msg_len)
 {
     uint32_t err = 1;
-    struct nvm_header_s nvm_hdr;
+    struct nvm_header_s *blob_hdr;
+    struct nvm_chunk_cache_entry *entry;
     struct sab_cmd_key_store_chunk_get_rsp resp;
     struct sab_cmd_key_store_chunk_get_done_msg finish_msg;
     struct sab_cmd_key_store_chunk_get_done_rsp finish_rsp;
@@ -384,6 +766,7 @@ static uint32_t nvm_manager_get_chunk(struct nvm_ctx *nvm_ctx_param, struct sab_
     uint64_t plat_addr;
     int32_t len = 0;
     uint8_t *data = NULL;
+    bool loaded;
 
     do {
         /* Consistency check of message length. */
@@ -393,22 +776,29 @@ static uint32_t nvm_manager_get_chunk(struct nvm_ctx *nvm_ctx_param, struct sab_
 
         blob_id = ((uint64_t)(msg->blob_id_ext) << 32u) | (uint64_t)msg->blob_id;
 
-        if (plat_os_abs_storage_read_chunk(nvm_ctx_param->phdl, (uint8_t *)&nvm_hdr, (uint32_t)sizeof(nvm_hdr), blob_id) == (int32_t)sizeof(nvm_hdr)) {
-            data = plat_os_abs_malloc(nvm_hdr.size);
-            if (data != NULL) {;
-                if (plat_os_abs_storage_read_chunk(nvm_ctx_param->phdl, data, nvm_hdr.size, blob_id) == (int32_t)nvm_hdr.size) {
-                    err = 0u;
+        /* The CRC of a blob is checked once, when it is read from storage. */
+        entry = nvm_chunk_cache_find(nvm_ctx_param->mu_type, blob_id);
+        if (entry != NULL) {
+            data = entry->data;
+        } else {
+            entry = nvm_chunk_cache_take(nvm_ctx_param, blob_id, false);
+            if (entry != NULL) {
+                loaded = nvm_chunk_load(nvm_ctx_param, entry);
+                nvm_chunk_cache_put(entry, loaded);
+                if (loaded) {
+                    data = entry->data;
                 }
             }
         }
 
         /* Indicate platform that the blob is available for reading. */
         plat_fill_rsp_msg_hdr(&resp.hdr, SAB_STORAGE_CHUNK_GET_REQ, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_get_rsp), nvm_ctx_param->mu_type);
-        if (err == 0u) {
-            resp.chunk_size = nvm_hdr.size - (uint32_t)sizeof(struct nvm_header_s);
+        if (data != NULL) {
+            blob_hdr = (struct nvm_header_s *)data;
+            resp.chunk_size = blob_hdr->size - (uint32_t)sizeof(struct nvm_header_s);
             plat_addr = plat_os_abs_data_buf(nvm_ctx_param->phdl,
                                             data + (uint32_t)sizeof(struct nvm_header_s),
-                                            nvm_hdr.size - (uint32_t)sizeof(struct nvm_header_s),
+                                            resp.chunk_size,
                                             DATA_BUF_IS_INPUT);
             resp.chunk_addr =  (uint32_t)(plat_addr & 0xFFFFFFFFu);
             resp.rsp_code = SAB_SUCCESS_STATUS;
@@ -418,7 +808,6 @@ static uint32_t nvm_manager_get_chunk(struct nvm_ctx *nvm_ctx_param, struct sab_
             resp.rsp_code = SAB_FAILURE_STATUS;
         }
 
-        err = 1u;
         len = plat_os_abs_send_mu_message(nvm_ctx_param->phdl, (uint32_t *)&resp, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_get_rsp));
         if (len != (int32_t)sizeof(struct sab_cmd_key_store_chunk_get_rsp)) {
             break;
@@ -438,6 +827,16 @@ static uint32_t nvm_manager_get_chunk(struct nvm_ctx *nvm_ctx_param, struct sab_
             break;
         }
 
+        /*
+         * The CRC of a chunk written by an older version cannot be checked,
+         * the enclave authenticates the blob instead. The chunk is left as
+         * it is in storage, it gets its marker when the enclave exports it
+         * again. If rejected, it is read again by the next get.
+         */
+        if (entry->legacy && (finish_msg.get_status != SAB_CHUNK_GET_STATUS_SUCCEEDED)) {
+            nvm_chunk_cache_drop(nvm_ctx_param->mu_type, blob_id);
+        }
+
         /* Ackowledge last message. */
         plat_fill_rsp_msg_hdr(&finish_rsp.hdr, SAB_STORAGE_CHUNK_GET_DONE_REQ, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_get_done_rsp), nvm_ctx_param->mu_type);
         finish_rsp.rsp_code = SAB_SUCCESS_STATUS;
@@ -451,58 +850,106 @@ static uint32_t nvm_manager_get_chunk(struct nvm_ctx *nvm_ctx_param, struct sab_
 
     } while (false);
 
-    plat_os_abs_free(data);
-
     return err;
 }
 
 #define MAX_RCV_MSG_SIZE ((uint32_t)sizeof(struct sab_cmd_key_store_chunk_export_msg))
 
+/*
+ * Read the master blob from storage and import it. In case of error the
+ * storage manager starts anyway so that the platform can create and export
+ * a storage.
+ */
+static void nvm_master_load(struct nvm_ctx *nvm_ctx_param)
+{
+    struct nvm_header_s nvm_hdr;
+    uint32_t data_len;
+    uint32_t size = 0u;
+    uint8_t *map = NULL;
+
+    if (nvm_ctx_param->prefetch) {
+        /* One open of the storage, the blob is imported from the mapping. */
+        map = plat_os_abs_storage_map(nvm_ctx_param->phdl, &size);
+    }
+    if (map != NULL) {
+        if (size >= (uint32_t)sizeof(nvm_hdr)) {
+            plat_os_abs_memcpy((uint8_t *)&nvm_hdr, map, (uint32_t)sizeof(nvm_hdr));
+            data_len = nvm_hdr.size + (uint32_t)sizeof(nvm_hdr);
+            if ((data_len <= size) && (data_len <= NVM_BLOB_MAX_SZ)) {
+                (void)nvm_storage_import(nvm_ctx_param, map, data_len);
+            }
+        }
+        plat_os_abs_storage_unmap(map, size);
+        return;
+    }
+
+    /*
+     * Try to read the storage header which length is known.
+     * Then if successful extract the full length and read the whole storage into the master blob buffer.
+     */
+    if (plat_os_abs_storage_read(nvm_ctx_param->phdl, (uint8_t *)&nvm_hdr, (uint32_t)sizeof(nvm_hdr)) == (int32_t)sizeof(nvm_hdr)) {
+        data_len = nvm_hdr.size + (uint32_t)sizeof(nvm_hdr);
+        /* Larger blobs are not exported. */
+        if ((data_len <= NVM_BLOB_MAX_SZ)
+            && (plat_os_abs_storage_read(nvm_ctx_param->phdl, nvm_master_buf, data_len) == (int32_t)data_len)) {
+            (void)nvm_storage_import(nvm_ctx_param, nvm_master_buf, data_len);
+        }
+    }
+}
+
+/* Process a command received from the platform. Return 0 on success. */
+static uint32_t nvm_process_msg(struct nvm_ctx *nvm_ctx_param, uint32_t *recv_msg, int32_t len)
+{
+    struct sab_mu_hdr *hdr = (struct sab_mu_hdr *)recv_msg;
+    uint32_t err;
+
+    switch (hdr->command) {
+        case SAB_STORAGE_MASTER_EXPORT_REQ:
+            err = nvm_manager_export_master(nvm_ctx_param, (struct sab_cmd_key_store_export_start_msg *)recv_msg, len);
+        break;
+        case SAB_STORAGE_CHUNK_EXPORT_REQ:
+            err = nvm_manager_export_chunk(nvm_ctx_param, (struct sab_cmd_key_store_chunk_export_msg *)recv_msg, len);
+        break;
+        case SAB_STORAGE_CHUNK_GET_REQ:
+            err = nvm_manager_get_chunk(nvm_ctx_param, (struct sab_cmd_key_store_chunk_get_msg *)recv_msg, len);
+        break;
+        default:
+            err = 1u;
+        break;
+    }
+
+    return err;
+}
+
 void nvm_manager(uint8_t flags, uint32_t *status)
 {
     int32_t len = 0;
-    uint32_t data_len = 0u;
-    struct nvm_header_s nvm_hdr;
     uint32_t recv_msg[MAX_RCV_MSG_SIZE / sizeof(uint32_t)];
-    struct sab_mu_hdr *hdr = (struct sab_mu_hdr *)recv_msg;
-    uint32_t err = 0u;
-    uint8_t *data = NULL;
     uint8_t retry = 0;
 
     if (status != NULL) {
         *status = NVM_STATUS_STARTING;
     }
+    (void)nvm_set_status(NVM_STATUS_STARTING, -1);
 
     do {
         retry = 0;
-        nvm_open_session(flags);
+        if (!nvm_pool_get()) {
+            break;
+        }
+        nvm_open_session(&nvm_ctx, flags);
 
         if(nvm_ctx.phdl == NULL) {
             break;
         }
 
-        /*
-         * Try to read the storage header which length is known.
-         * Then if successful extract the full length and read the whole storage into an allocated buffer.
-         */
-        if (plat_os_abs_storage_read(nvm_ctx.phdl, (uint8_t *)&nvm_hdr, (uint32_t)sizeof(nvm_hdr)) == (int32_t)sizeof(nvm_hdr)) {
-            data_len = nvm_hdr.size + (uint32_t)sizeof(nvm_hdr);
-            data = plat_os_abs_malloc(data_len);
-            if (data != NULL) {
-                if (plat_os_abs_storage_read(nvm_ctx.phdl, data, data_len) == (int32_t)data_len) {
-                    /* In case of error then start anyway the storage manager process so platform can create
-                     * and export a storage.
-                     */
-                    (void)nvm_storage_import(&nvm_ctx, data, data_len);
-                }
-                plat_os_abs_free(data);
-                data = NULL;
-                len = 0;
-            }
-        }
+        /* Chunks are read while the master is imported. */
+        nvm_prefetch_start(&nvm_ctx);
+        nvm_master_load(&nvm_ctx);
         if (status != NULL) {
             *status = NVM_STATUS_RUNNING;
         }
+        (void)nvm_set_status(NVM_STATUS_RUNNING, -1);
 
         /* Infinite loop waiting for platform commands. */
         while (true)
@@ -512,25 +959,13 @@ void nvm_manager(uint8_t flags, uint32_t *status)
             if (len < 0) {
                 retry = 1;
                 /* handle case when platform/V2X are reset */
+                nvm_prefetch_stop(&nvm_ctx);
                 plat_os_abs_close_session(nvm_ctx.phdl);
                 nvm_ctx.phdl = NULL;
                 break;
             }
 
-            switch (hdr->command) {
-                case SAB_STORAGE_MASTER_EXPORT_REQ:
-                    err = nvm_manager_export_master(&nvm_ctx, (struct sab_cmd_key_store_export_start_msg *)recv_msg, len);
-                break;
-                case SAB_STORAGE_CHUNK_EXPORT_REQ:
-                    err = nvm_manager_export_chunk(&nvm_ctx, (struct sab_cmd_key_store_chunk_export_msg *)recv_msg, len);
-                break;
-                case SAB_STORAGE_CHUNK_GET_REQ:
-                    err = nvm_manager_get_chunk(&nvm_ctx, (struct sab_cmd_key_store_chunk_get_msg *)recv_msg, len);
-                break;
-                default:
-                    err = 1u;
-                break;
-            }
+            (void)nvm_process_msg(&nvm_ctx, recv_msg, len);
         }
     } while (retry);
 
@@ -539,6 +974,183 @@ void nvm_manager(uint8_t flags, uint32_t *status)
     }
 
     if (nvm_ctx.phdl != NULL) {
-        nvm_close_session();
+        nvm_ctx_close(&nvm_ctx);
+    }
+    nvm_pool_release();
+    (void)nvm_set_status(NVM_STATUS_STOPPED, -1);
+}
+
+/* One channel per NVM flags combination. */
+#define NVM_SERVICE_MAX_CHANNELS    4u
+
+/* Open a channel, import its master blob and poll it. Return true on success. */
+static bool nvm_service_open(int32_t epfd, struct nvm_ctx *nvm_ctx_param, uint8_t flags)
+{
+    struct epoll_event ev;
+    int32_t fd;
+
+    nvm_open_session(nvm_ctx_param, flags);
+    if (nvm_ctx_param->phdl == NULL) {
+        return false;
+    }
+    nvm_prefetch_start(nvm_ctx_param);
+    nvm_master_load(nvm_ctx_param);
+
+    fd = plat_os_abs_mu_poll_fd(nvm_ctx_param->phdl);
+    ev.events = EPOLLIN;
+    ev.data.ptr = nvm_ctx_param;
+    if ((fd < 0) || (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)) {
+        nvm_ctx_close(nvm_ctx_param);
+        return false;
+    }
+
+    return true;
+}
+
+void nvm_service(const uint8_t *flags, uint32_t nb)
+{
+    struct nvm_ctx ctx[NVM_SERVICE_MAX_CHANNELS];
+    struct epoll_event events[NVM_SERVICE_MAX_CHANNELS + 1u];
+    struct epoll_event ev;
+    uint32_t recv_msg[MAX_RCV_MSG_SIZE / sizeof(uint32_t)];
+    struct nvm_ctx *c;
+    int32_t epfd, stop_fd, len, n, i;
+    uint32_t k, nb_open = 0u;
+    bool stop = false;
+
+    plat_os_abs_memset((uint8_t *)ctx, 0u, (uint32_t)sizeof(ctx));
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0u, EFD_NONBLOCK | EFD_CLOEXEC);
+    (void)nvm_set_status(NVM_STATUS_STARTING, stop_fd);
+
+    do {
+        if ((flags == NULL) || (nb == 0u) || (nb > NVM_SERVICE_MAX_CHANNELS)
+            || (epfd < 0) || (stop_fd < 0) || !nvm_pool_get()) {
+            break;
+        }
+
+        /* A null pointer tells the stop request from the channels. */
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, stop_fd, &ev) != 0) {
+            break;
+        }
+
+        for (k = 0u; k < nb; k++) {
+            if (nvm_service_open(epfd, &ctx[k], flags[k])) {
+                nb_open++;
+            }
+        }
+        if (nb_open != nb) {
+            break;
+        }
+
+        stop = nvm_set_status(NVM_STATUS_RUNNING, stop_fd);
+
+        while (!stop && (nb_open > 0u)) {
+            n = epoll_wait(epfd, events, (int)(nb + 1u), -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+
+            for (i = 0; i < n; i++) {
+                c = events[i].data.ptr;
+                if (c == NULL) {
+                    stop = true;
+                    continue;
+                }
+
+                /*
+                 * The channel is readable: the command is read without
+                 * blocking, the rest of its exchange is served before
+                 * getting back to the other channels.
+                 */
+                len = plat_os_abs_read_mu_message(c->phdl, recv_msg, MAX_RCV_MSG_SIZE);
+                if (len < 0) {
+                    /* handle case when platform/V2X are reset */
+                    (void)epoll_ctl(epfd, EPOLL_CTL_DEL, plat_os_abs_mu_poll_fd(c->phdl), NULL);
+                    nvm_prefetch_stop(c);
+                    plat_os_abs_close_session(c->phdl);
+                    c->phdl = NULL;
+                    if (!nvm_service_open(epfd, c, flags[c - ctx])) {
+                        nb_open--;
+                    }
+                    continue;
+                }
+
+                (void)nvm_process_msg(c, recv_msg, len);
+            }
+        }
+    } while (false);
+
+    for (k = 0u; k < NVM_SERVICE_MAX_CHANNELS; k++) {
+        if (ctx[k].phdl != NULL) {
+            nvm_ctx_close(&ctx[k]);
+        }
+    }
+    nvm_pool_release();
+
+    (void)nvm_set_status(NVM_STATUS_STOPPED, -1);
+
+    if (stop_fd >= 0) {
+        (void)close(stop_fd);
+    }
+    if (epfd >= 0) {
+        (void)close(epfd);
+    }
+}
+
+uint32_t nvm_wait_ready(uint32_t timeout_ms)
+{
+    struct timespec ts;
+    uint32_t status;
+    int state;
+
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(timeout_ms / 1000u);
+    ts.tv_nsec += (long)(timeout_ms % 1000u) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    (void)pthread_mutex_lock(&nvm_state.lock);
+    while (nvm_state.status <= NVM_STATUS_STARTING) {
+        if (pthread_cond_timedwait(&nvm_state.cond, &nvm_state.lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    status = nvm_state.status;
+    (void)pthread_mutex_unlock(&nvm_state.lock);
+    (void)pthread_setcancelstate(state, NULL);
+
+    return status;
+}
+
+void nvm_service_stop(void)
+{
+    uint64_t one = 1u;
+    int state;
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    (void)pthread_mutex_lock(&nvm_state.lock);
+    /* nvm_manager() is stopped by cancelling its thread. */
+    if (((nvm_state.status == NVM_STATUS_STARTING)
+         || (nvm_state.status == NVM_STATUS_RUNNING)) && (nvm_state.stop_fd >= 0)) {
+        nvm_state.stop = true;
+        (void)write(nvm_state.stop_fd, &one, sizeof(one));
+        while (nvm_state.status != NVM_STATUS_STOPPED) {
+            (void)pthread_cond_wait(&nvm_state.cond, &nvm_state.lock);
+        }
+    }
+    /* Next start is waited for from scratch. */
+    if (nvm_state.status == NVM_STATUS_STOPPED) {
+        nvm_state.status = NVM_STATUS_UNDEF;
     }
+    (void)pthread_mutex_unlock(&nvm_state.lock);
+    (void)pthread_setcancelstate(state, NULL);
 }
@@ -0,0 +1,470 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "nvm_commit.h"
+#include "nvm_log.h"
+#include "nvm_storage.h"
+
+const struct nvm_storage_ops *nvm_storage_backend(const char *name)
+{
+    static const struct nvm_storage_ops *const backends[] = {
+        &nvm_storage_file_ops,
+        &nvm_storage_raw_ops,
+        &nvm_storage_ram_ops,
+    };
+    uint32_t i;
+
+    for (i = 0u; (name != NULL) && (i < sizeof(backends) / sizeof(backends[0])); i++) {
+        if (strcmp(backends[i]->name, name) == 0) {
+            return backends[i];
+        }
+    }
+
+    return NULL;
+}
+
+void nvm_storage_rank(uint64_t *ids, uint64_t *seqs, uint32_t *nb, uint32_t max,
+                      uint64_t blob_id, uint64_t seq)
+{
+    /* Insertion in the max most recent, by decreasing write order. */
+    uint32_t j = (*nb < max) ? (*nb)++ : max;
+
+    while ((j > 0u) && (seqs[j - 1u] < seq)) {
+        if (j < max) {
+            ids[j] = ids[j - 1u];
+            seqs[j] = seqs[j - 1u];
+        }
+        j--;
+    }
+    if (j < max) {
+        ids[j] = blob_id;
+        seqs[j] = seq;
+    }
+}
+
+/*
+ * File backend. Files are replaced through nvm_commit, the chunks are
+ * committed with the next master at the latest. With NVM_CHUNK_LOG the
+ * chunks are appended to the log store of their directory, chunk files
+ * left by the one-file-per-chunk layout are still read, unless the storage
+ * keeps the chunk files.
+ */
+struct nvm_storage_file {
+    struct nvm_storage base;
+    char *master_path;
+    char *chunk_dir;
+    bool chunk_files;
+};
+
+static char *file_dup(const char *s)
+{
+    char *d = NULL;
+
+    if (s != NULL) {
+        d = malloc(strlen(s) + 1u);
+        if (d != NULL) {
+            (void)strcpy(d, s);
+        }
+    }
+
+    return d;
+}
+
+/* Path of the file of a chunk, NULL if out of memory. */
+static char *file_chunk_path(struct nvm_storage_file *st, uint64_t blob_id)
+{
+    size_t len = strlen(st->chunk_dir);
+    bool slash = (len > 0u) && (st->chunk_dir[len - 1u] == '/');
+    char *path = malloc(len + sizeof("/0123456789abcdef"));
+
+    if (path != NULL) {
+        (void)sprintf(path, slash ? "%s%016lx" : "%s/%016lx", st->chunk_dir, (unsigned long)blob_id);
+    }
+
+    return path;
+}
+
+static int32_t file_read(const char *path, uint8_t *dst, uint32_t size)
+{
+    int32_t fd;
+    int32_t l = 0;
+
+    /* Read the last data written. */
+    nvm_commit_flush();
+    /* Open the file as read only. */
+    fd = open(path, O_RDONLY|O_CLOEXEC);
+    if (fd >= 0) {
+        /* Read the data. */
+        l = (int32_t)read(fd, dst, size);
+
+        (void)close(fd);
+    }
+
+    return l;
+}
+
+#ifdef NVM_CHUNK_LOG
+/* Log store of the chunks, NULL if they are kept in files. */
+static struct nvm_log *file_log(struct nvm_storage_file *st)
+{
+    return st->chunk_files ? NULL : nvm_log_get(st->chunk_dir);
+}
+#endif
+
+static void file_close(struct nvm_storage *base)
+{
+    struct nvm_storage_file *st = (struct nvm_storage_file *)base;
+
+    if (st != NULL) {
+        (void)base->ops->flush(base);
+        free(st->master_path);
+        free(st->chunk_dir);
+        free(st);
+    }
+}
+
+static struct nvm_storage *file_open(const struct nvm_storage_cfg *cfg)
+{
+    struct nvm_storage_file *st = calloc(1u, sizeof(struct nvm_storage_file));
+
+    if (st == NULL) {
+        return NULL;
+    }
+    st->base.ops = &nvm_storage_file_ops;
+    st->master_path = file_dup(cfg->master_path);
+    st->chunk_dir = file_dup(cfg->chunk_dir);
+    st->chunk_files = cfg->chunk_files;
+    if (((cfg->master_path != NULL) && (st->master_path == NULL))
+        || ((cfg->chunk_dir != NULL) && (st->chunk_dir == NULL))) {
+        free(st->master_path);
+        free(st->chunk_dir);
+        free(st);
+        return NULL;
+    }
+
+    return &st->base;
+}
+
+static int32_t file_read_blob(struct nvm_storage *base, uint64_t blob_id, uint8_t *dst, uint32_t size)
+{
+    struct nvm_storage_file *st = (struct nvm_storage_file *)base;
+    char *path;
+    int32_t l = 0;
+
+    if (blob_id == NVM_STORAGE_MASTER_ID) {
+        return (st->master_path != NULL) ? file_read(st->master_path, dst, size) : 0;
+    }
+    if (st->chunk_dir == NULL) {
+        return 0;
+    }
+#ifdef NVM_CHUNK_LOG
+    if (!st->chunk_files) {
+        l = nvm_log_read(file_log(st), blob_id, dst, size);
+        if (l != 0) {
+            return l;
+        }
+    }
+    /* Not moved to the store, read from the chunk file. */
+#endif
+    path = file_chunk_path(st, blob_id);
+    if (path != NULL) {
+        l = file_read(path, dst, size);
+        free(path);
+    }
+
+    return l;
+}
+
+static int32_t file_write_blob(struct nvm_storage *base, uint64_t blob_id, const uint8_t *src, uint32_t size)
+{
+    struct nvm_storage_file *st = (struct nvm_storage_file *)base;
+    char *path;
+    int32_t l = -1;
+
+    if (blob_id == NVM_STORAGE_MASTER_ID) {
+        if (st->master_path == NULL) {
+            return -1;
+        }
+#ifdef NVM_CHUNK_LOG
+        /* The chunks referred to by the master are durable before it. */
+        if (nvm_log_sync_all() != 0) {
+            return -1;
+        }
+#endif
+        /* Replace the file atomically, after the chunks written before. */
+        return nvm_commit_write(st->master_path, src, size, true);
+    }
+    if (st->chunk_dir == NULL) {
+        return -1;
+    }
+#ifdef NVM_CHUNK_LOG
+    if (!st->chunk_files) {
+        return nvm_log_write(file_log(st), blob_id, src, size);
+    }
+#endif
+    (void)mkdir(st->chunk_dir, S_IRWXU);
+    path = file_chunk_path(st, blob_id);
+    if (path != NULL) {
+        /* Committed with the next master at the latest. */
+        l = nvm_commit_write(path, src, size, false);
+        free(path);
+    }
+
+    return l;
+}
+
+static int32_t file_flush(struct nvm_storage *base)
+{
+    (void)base;
+    nvm_commit_flush();
+#ifdef NVM_CHUNK_LOG
+    return nvm_log_sync_all();
+#else
+    return 0;
+#endif
+}
+
+static uint32_t file_enumerate(struct nvm_storage *base, uint64_t *ids, uint32_t max)
+{
+    struct nvm_storage_file *st = (struct nvm_storage_file *)base;
+    struct nvm_log *log = NULL;
+
+    if (st->chunk_dir == NULL) {
+        return 0u;
+    }
+#ifdef NVM_CHUNK_LOG
+    log = file_log(st);
+#endif
+    /* List the chunk files committed. */
+    nvm_commit_flush();
+
+    return nvm_log_list_chunks(log, st->chunk_dir, ids, max);
+}
+
+static uint8_t *file_map_master(struct nvm_storage *base, uint32_t *size)
+{
+    struct nvm_storage_file *st = (struct nvm_storage_file *)base;
+    struct stat sb;
+    uint8_t *ptr = NULL;
+    int32_t fd;
+
+    if (st->master_path == NULL) {
+        return NULL;
+    }
+    /* Map the last data written. */
+    nvm_commit_flush();
+    fd = open(st->master_path, O_RDONLY|O_CLOEXEC);
+    if (fd >= 0) {
+        if ((fstat(fd, &sb) == 0) && (sb.st_size > 0) && (sb.st_size <= (off_t)UINT32_MAX)) {
+            ptr = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ptr = NULL;
+            } else {
+                *size = (uint32_t)sb.st_size;
+            }
+        }
+        /* The mapping stays valid. */
+        (void)close(fd);
+    }
+
+    return ptr;
+}
+
+const struct nvm_storage_ops nvm_storage_file_ops = {
+    "file",
+    file_open,
+    file_read_blob,
+    file_write_blob,
+    file_flush,
+    file_enumerate,
+    file_map_master,
+    file_close,
+};
+
+/*
+ * RAM backend: blobs kept in process memory until the storage is closed,
+ * nothing is durable. For tests.
+ */
+struct ram_blob {
+    uint64_t blob_id;
+    /* Write order. */
+    uint64_t seq;
+    uint32_t size;
+    uint8_t *data;
+};
+
+struct nvm_storage_ram {
+    struct nvm_storage base;
+    pthread_mutex_t lock;
+    struct ram_blob *blobs;
+    uint32_t nb;
+    uint32_t max;
+    uint64_t seq;
+};
+
+static struct ram_blob *ram_find(struct nvm_storage_ram *st, uint64_t blob_id)
+{
+    uint32_t i;
+
+    for (i = 0u; i < st->nb; i++) {
+        if (st->blobs[i].blob_id == blob_id) {
+            return &st->blobs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static struct nvm_storage *ram_open(const struct nvm_storage_cfg *cfg)
+{
+    struct nvm_storage_ram *st = calloc(1u, sizeof(struct nvm_storage_ram));
+
+    (void)cfg;
+    if (st != NULL) {
+        st->base.ops = &nvm_storage_ram_ops;
+        (void)pthread_mutex_init(&st->lock, NULL);
+    }
+
+    return (st != NULL) ? &st->base : NULL;
+}
+
+static int32_t ram_read_blob(struct nvm_storage *base, uint64_t blob_id, uint8_t *dst, uint32_t size)
+{
+    struct nvm_storage_ram *st = (struct nvm_storage_ram *)base;
+    struct ram_blob *b;
+    int32_t l = 0;
+
+    (void)pthread_mutex_lock(&st->lock);
+    b = ram_find(st, blob_id);
+    if (b != NULL) {
+        if (size > b->size) {
+            size = b->size;
+        }
+        (void)memcpy(dst, b->data, size);
+        l = (int32_t)size;
+    }
+    (void)pthread_mutex_unlock(&st->lock);
+
+    return l;
+}
+
+static int32_t ram_write_blob(struct nvm_storage *base, uint64_t blob_id, const uint8_t *src, uint32_t size)
+{
+    struct nvm_storage_ram *st = (struct nvm_storage_ram *)base;
+    struct ram_blob *b;
+    struct ram_blob *grown;
+    uint8_t *data;
+    int32_t l = -1;
+
+    if (size > NVM_STORAGE_MAX_BLOB_SZ) {
+        return -1;
+    }
+    data = malloc((size > 0u) ? size : 1u);
+    if (data == NULL) {
+        return -1;
+    }
+    (void)memcpy(data, src, size);
+
+    (void)pthread_mutex_lock(&st->lock);
+    b = ram_find(st, blob_id);
+    if ((b == NULL) && (st->nb == st->max)) {
+        grown = realloc(st->blobs, ((st->max == 0u) ? 16u : 2u * st->max) * sizeof(struct ram_blob));
+        if (grown != NULL) {
+            st->blobs = grown;
+            st->max = (st->max == 0u) ? 16u : 2u * st->max;
+        }
+    }
+    if ((b == NULL) && (st->nb < st->max)) {
+        b = &st->blobs[st->nb++];
+        b->blob_id = blob_id;
+        b->data = NULL;
+    }
+    if (b != NULL) {
+        free(b->data);
+        b->data = data;
+        b->size = size;
+        b->seq = ++st->seq;
+        data = NULL;
+        l = (int32_t)size;
+    }
+    (void)pthread_mutex_unlock(&st->lock);
+    free(data);
+
+    return l;
+}
+
+static int32_t ram_flush(struct nvm_storage *base)
+{
+    (void)base;
+    return 0;
+}
+
+static uint32_t ram_enumerate(struct nvm_storage *base, uint64_t *ids, uint32_t max)
+{
+    struct nvm_storage_ram *st = (struct nvm_storage_ram *)base;
+    uint64_t *seqs;
+    uint32_t nb = 0u, i;
+
+    seqs = malloc(((max > 0u) ? max : 1u) * sizeof(uint64_t));
+    if (seqs == NULL) {
+        return 0u;
+    }
+    (void)pthread_mutex_lock(&st->lock);
+    for (i = 0u; i < st->nb; i++) {
+        if (st->blobs[i].blob_id == NVM_STORAGE_MASTER_ID) {
+            continue;
+        }
+        nvm_storage_rank(ids, seqs, &nb, max, st->blobs[i].blob_id, st->blobs[i].seq);
+    }
+    (void)pthread_mutex_unlock(&st->lock);
+    free(seqs);
+
+    return nb;
+}
+
+static void ram_close(struct nvm_storage *base)
+{
+    struct nvm_storage_ram *st = (struct nvm_storage_ram *)base;
+    uint32_t i;
+
+    if (st != NULL) {
+        for (i = 0u; i < st->nb; i++) {
+            free(st->blobs[i].data);
+        }
+        free(st->blobs);
+        (void)pthread_mutex_destroy(&st->lock);
+        free(st);
+    }
+}
+
+const struct nvm_storage_ops nvm_storage_ram_ops = {
+    "ram",
+    ram_open,
+    ram_read_blob,
+    ram_write_blob,
+    ram_flush,
+    ram_enumerate,
+    NULL,
+    ram_close,
+};
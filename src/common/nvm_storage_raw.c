@@ -0,0 +1,477 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/* O_DIRECT */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "crc32.h"
+#include "nvm_storage.h"
+
+/*
+ * Raw backend: the blobs are kept in fixed size slots of a block device or
+ * partition, read and written with O_DIRECT through aligned buffers, and
+ * found through a slot table.
+ *
+ * The device starts with two copies of the table followed by the slots.
+ * A blob is replaced by writing it in a free slot, the slot of its previous
+ * content is retired. When the master is written or the storage flushed,
+ * the slots written are synchronized then the table is saved in the copy
+ * not holding the current one, so that a crash leaves one of them valid:
+ * the one with the highest sequence number is loaded at open. Retired
+ * slots are reused once the table saved no longer refers to them.
+ *
+ * The number of slots follows from the size of the device, a table of
+ * another geometry is not loaded and the storage starts empty.
+ */
+
+#define RAW_MAGIC       0x5741524eu     /* "NRAW" */
+#define RAW_VERSION     1u
+
+/* Offsets, sizes and buffers of the direct I/Os are aligned on it. */
+#define RAW_ALIGN       4096u
+/* One blob per slot. */
+#define RAW_SLOT_SZ     NVM_STORAGE_MAX_BLOB_SZ
+
+#define RAW_SLOT_FREE       0u
+#define RAW_SLOT_USED       1u
+/* Replaced, free once the table is saved. */
+#define RAW_SLOT_RETIRED    2u
+
+/* Saved table: this header followed by the entries in use. */
+struct raw_table_hdr {
+    uint32_t magic;
+    uint32_t version;
+    /* Incremented at each save. */
+    uint64_t seq;
+    uint32_t nb_slots;
+    uint32_t nb;
+    /* CRC of the entries. */
+    uint32_t crc;
+    /* CRC of the fields above. */
+    uint32_t hdr_crc;
+};
+
+struct raw_entry {
+    uint64_t blob_id;
+    /* Write order. */
+    uint64_t seq;
+    uint32_t slot;
+    uint32_t size;
+    /* CRC of the blob. */
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+struct nvm_storage_raw {
+    struct nvm_storage base;
+    pthread_mutex_t lock;
+    int fd;
+    uint32_t nb_slots;
+    /* Size of a copy of the table, aligned. */
+    uint32_t table_sz;
+    uint64_t table_seq;
+    /* Copy written at the next save. */
+    uint32_t table_copy;
+    /* Entries of the blobs, nb_slots at most. */
+    struct raw_entry *entries;
+    uint32_t nb;
+    /* RAW_SLOT_* per slot. */
+    uint8_t *slots;
+    /* Slots are allocated in turn from there. */
+    uint32_t next_slot;
+    uint64_t write_seq;
+    /* Entries changed since the table was saved. */
+    bool dirty;
+    /* Aligned buffers of a slot and of a copy of the table. */
+    uint8_t *buf;
+    uint8_t *table_buf;
+};
+
+static uint32_t raw_align(uint32_t size)
+{
+    return (size + RAW_ALIGN - 1u) & ~(RAW_ALIGN - 1u);
+}
+
+static uint32_t raw_table_size(uint32_t nb_slots)
+{
+    return raw_align((uint32_t)sizeof(struct raw_table_hdr) + (nb_slots * (uint32_t)sizeof(struct raw_entry)));
+}
+
+static uint64_t raw_slot_off(struct nvm_storage_raw *st, uint32_t slot)
+{
+    return (2u * (uint64_t)st->table_sz) + ((uint64_t)slot * RAW_SLOT_SZ);
+}
+
+static int raw_pread(int fd, uint8_t *buf, uint32_t size, uint64_t off)
+{
+    uint32_t done = 0u;
+    ssize_t l;
+
+    while (done < size) {
+        l = pread(fd, buf + done, size - done, (off_t)(off + done));
+        if (l > 0) {
+            done += (uint32_t)l;
+        } else if ((l < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int raw_pwrite(int fd, const uint8_t *buf, uint32_t size, uint64_t off)
+{
+    uint32_t done = 0u;
+    ssize_t l;
+
+    while (done < size) {
+        l = pwrite(fd, buf + done, size - done, (off_t)(off + done));
+        if (l > 0) {
+            done += (uint32_t)l;
+        } else if ((l < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static struct raw_entry *raw_find(struct nvm_storage_raw *st, uint64_t blob_id)
+{
+    uint32_t i;
+
+    for (i = 0u; i < st->nb; i++) {
+        if (st->entries[i].blob_id == blob_id) {
+            return &st->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Load a copy of the table if valid and more recent than the one loaded. */
+static void raw_load_table(struct nvm_storage_raw *st, uint32_t copy)
+{
+    struct raw_table_hdr *hdr = (struct raw_table_hdr *)st->table_buf;
+    struct raw_entry *e = (struct raw_entry *)(st->table_buf + sizeof(struct raw_table_hdr));
+    uint32_t i;
+
+    if ((raw_pread(st->fd, st->table_buf, st->table_sz, (uint64_t)copy * st->table_sz) != 0)
+        || (hdr->magic != RAW_MAGIC) || (hdr->version != RAW_VERSION)
+        || (hdr->hdr_crc != crc32_update(0u, st->table_buf, (uint32_t)offsetof(struct raw_table_hdr, hdr_crc)))
+        || (hdr->nb_slots != st->nb_slots) || (hdr->nb > st->nb_slots)
+        || (hdr->crc != crc32_update(0u, (uint8_t *)e, hdr->nb * (uint32_t)sizeof(struct raw_entry)))
+        || ((st->table_seq != 0u) && (hdr->seq <= st->table_seq))) {
+        return;
+    }
+    for (i = 0u; i < hdr->nb; i++) {
+        if ((e[i].slot >= st->nb_slots) || (e[i].size > RAW_SLOT_SZ)) {
+            return;
+        }
+    }
+
+    (void)memcpy(st->entries, e, hdr->nb * sizeof(struct raw_entry));
+    st->nb = hdr->nb;
+    st->table_seq = hdr->seq;
+    /* The other copy is overwritten first. */
+    st->table_copy = copy ^ 1u;
+}
+
+/*
+ * Make the slots written durable then save the table, retired slots become
+ * free. Return 0 on success.
+ */
+static int32_t raw_save_table(struct nvm_storage_raw *st)
+{
+    struct raw_table_hdr *hdr = (struct raw_table_hdr *)st->table_buf;
+    uint8_t *e = st->table_buf + sizeof(struct raw_table_hdr);
+    uint32_t i;
+
+    if (fdatasync(st->fd) != 0) {
+        return -1;
+    }
+
+    (void)memset(st->table_buf, 0, st->table_sz);
+    (void)memcpy(e, st->entries, st->nb * sizeof(struct raw_entry));
+    hdr->magic = RAW_MAGIC;
+    hdr->version = RAW_VERSION;
+    hdr->seq = st->table_seq + 1u;
+    hdr->nb_slots = st->nb_slots;
+    hdr->nb = st->nb;
+    hdr->crc = crc32_update(0u, e, st->nb * (uint32_t)sizeof(struct raw_entry));
+    hdr->hdr_crc = crc32_update(0u, st->table_buf, (uint32_t)offsetof(struct raw_table_hdr, hdr_crc));
+    /* A failed save is done again in the same copy, the other one stays valid. */
+    if ((raw_pwrite(st->fd, st->table_buf, st->table_sz, (uint64_t)st->table_copy * st->table_sz) != 0)
+        || (fdatasync(st->fd) != 0)) {
+        return -1;
+    }
+    st->table_seq++;
+    st->table_copy ^= 1u;
+
+    for (i = 0u; i < st->nb_slots; i++) {
+        if (st->slots[i] == RAW_SLOT_RETIRED) {
+            st->slots[i] = RAW_SLOT_FREE;
+        }
+    }
+    st->dirty = false;
+
+    return 0;
+}
+
+/* Allocate a free slot. Return nb_slots if none is left. */
+static uint32_t raw_alloc_slot(struct nvm_storage_raw *st)
+{
+    uint32_t i, slot;
+
+    for (i = 0u; i < st->nb_slots; i++) {
+        slot = (st->next_slot + i) % st->nb_slots;
+        if (st->slots[slot] == RAW_SLOT_FREE) {
+            st->next_slot = (slot + 1u) % st->nb_slots;
+            return slot;
+        }
+    }
+
+    return st->nb_slots;
+}
+
+static void raw_close(struct nvm_storage *base)
+{
+    struct nvm_storage_raw *st = (struct nvm_storage_raw *)base;
+
+    if (st != NULL) {
+        if (st->fd >= 0) {
+            (void)base->ops->flush(base);
+            (void)close(st->fd);
+        }
+        free(st->entries);
+        free(st->slots);
+        free(st->buf);
+        free(st->table_buf);
+        (void)pthread_mutex_destroy(&st->lock);
+        free(st);
+    }
+}
+
+static struct nvm_storage *raw_open(const struct nvm_storage_cfg *cfg)
+{
+    struct nvm_storage_raw *st;
+    struct stat sb;
+    uint64_t dev_size = 0u;
+    uint32_t i;
+
+    if (cfg->dev_path == NULL) {
+        return NULL;
+    }
+    st = calloc(1u, sizeof(struct nvm_storage_raw));
+    if (st == NULL) {
+        return NULL;
+    }
+    st->base.ops = &nvm_storage_raw_ops;
+    (void)pthread_mutex_init(&st->lock, NULL);
+
+    st->fd = open(cfg->dev_path, O_RDWR|O_CLOEXEC|O_DIRECT);
+    if ((st->fd < 0) && (errno == EINVAL)) {
+        /* File system without direct I/O, for a file standing for the device. */
+        st->fd = open(cfg->dev_path, O_RDWR|O_CLOEXEC);
+    }
+    if ((st->fd >= 0) && (fstat(st->fd, &sb) == 0)) {
+        if (S_ISBLK(sb.st_mode)) {
+            if (ioctl(st->fd, BLKGETSIZE64, &dev_size) != 0) {
+                dev_size = 0u;
+            }
+        } else {
+            dev_size = (uint64_t)sb.st_size;
+        }
+    }
+
+    /* As many slots as fit with the two copies of their table. */
+    st->nb_slots = (dev_size / RAW_SLOT_SZ > UINT32_MAX) ? UINT32_MAX : (uint32_t)(dev_size / RAW_SLOT_SZ);
+    while ((st->nb_slots > 0u)
+           && ((2u * (uint64_t)raw_table_size(st->nb_slots)) + ((uint64_t)st->nb_slots * RAW_SLOT_SZ) > dev_size)) {
+        st->nb_slots--;
+    }
+    st->table_sz = raw_table_size(st->nb_slots);
+
+    /* The master and at least one chunk. */
+    if ((st->fd < 0) || (st->nb_slots < 2u)
+        || (posix_memalign((void **)&st->buf, RAW_ALIGN, RAW_SLOT_SZ) != 0)
+        || (posix_memalign((void **)&st->table_buf, RAW_ALIGN, st->table_sz) != 0)) {
+        st->buf = NULL;
+        st->table_buf = NULL;
+        raw_close(&st->base);
+        return NULL;
+    }
+    st->entries = calloc(st->nb_slots, sizeof(struct raw_entry));
+    st->slots = calloc(st->nb_slots, sizeof(uint8_t));
+    if ((st->entries == NULL) || (st->slots == NULL)) {
+        raw_close(&st->base);
+        return NULL;
+    }
+
+    raw_load_table(st, 0u);
+    raw_load_table(st, 1u);
+    for (i = 0u; i < st->nb; i++) {
+        st->slots[st->entries[i].slot] = RAW_SLOT_USED;
+        if (st->entries[i].seq > st->write_seq) {
+            st->write_seq = st->entries[i].seq;
+        }
+    }
+
+    return &st->base;
+}
+
+static int32_t raw_read_blob(struct nvm_storage *base, uint64_t blob_id, uint8_t *dst, uint32_t size)
+{
+    struct nvm_storage_raw *st = (struct nvm_storage_raw *)base;
+    struct raw_entry *e;
+    int32_t l = 0;
+
+    (void)pthread_mutex_lock(&st->lock);
+    e = raw_find(st, blob_id);
+    if (e != NULL) {
+        l = -1;
+        if ((raw_pread(st->fd, st->buf, raw_align(e->size), raw_slot_off(st, e->slot)) == 0)
+            && (crc32_update(0u, st->buf, e->size) == e->crc)) {
+            if (size > e->size) {
+                size = e->size;
+            }
+            (void)memcpy(dst, st->buf, size);
+            l = (int32_t)size;
+        }
+    }
+    (void)pthread_mutex_unlock(&st->lock);
+
+    return l;
+}
+
+static int32_t raw_write_blob(struct nvm_storage *base, uint64_t blob_id, const uint8_t *src, uint32_t size)
+{
+    struct nvm_storage_raw *st = (struct nvm_storage_raw *)base;
+    struct raw_entry *e;
+    uint32_t slot;
+    int32_t l = -1;
+
+    if (size > RAW_SLOT_SZ) {
+        return -1;
+    }
+
+    (void)pthread_mutex_lock(&st->lock);
+    do {
+        e = raw_find(st, blob_id);
+        if ((e == NULL) && (st->nb == st->nb_slots)) {
+            break;
+        }
+        slot = raw_alloc_slot(st);
+        if ((slot == st->nb_slots) && (raw_save_table(st) == 0)) {
+            /* The retired slots are free now. */
+            slot = raw_alloc_slot(st);
+        }
+        if (slot == st->nb_slots) {
+            break;
+        }
+
+        (void)memcpy(st->buf, src, size);
+        (void)memset(st->buf + size, 0, raw_align(size) - size);
+        if (raw_pwrite(st->fd, st->buf, raw_align(size), raw_slot_off(st, slot)) != 0) {
+            break;
+        }
+
+        if (e == NULL) {
+            e = &st->entries[st->nb++];
+            e->blob_id = blob_id;
+        } else {
+            st->slots[e->slot] = RAW_SLOT_RETIRED;
+        }
+        st->slots[slot] = RAW_SLOT_USED;
+        e->slot = slot;
+        e->size = size;
+        e->crc = crc32_update(0u, src, size);
+        e->seq = ++st->write_seq;
+        e->reserved = 0u;
+        st->dirty = true;
+
+        /* The master commits itself and the chunks written before it. */
+        if ((blob_id == NVM_STORAGE_MASTER_ID) && (raw_save_table(st) != 0)) {
+            break;
+        }
+        l = (int32_t)size;
+    } while (false);
+    (void)pthread_mutex_unlock(&st->lock);
+
+    return l;
+}
+
+static int32_t raw_flush(struct nvm_storage *base)
+{
+    struct nvm_storage_raw *st = (struct nvm_storage_raw *)base;
+    int32_t ret = 0;
+
+    (void)pthread_mutex_lock(&st->lock);
+    if (st->dirty) {
+        ret = raw_save_table(st);
+    }
+    (void)pthread_mutex_unlock(&st->lock);
+
+    return ret;
+}
+
+static uint32_t raw_enumerate(struct nvm_storage *base, uint64_t *ids, uint32_t max)
+{
+    struct nvm_storage_raw *st = (struct nvm_storage_raw *)base;
+    uint64_t *seqs;
+    uint32_t nb = 0u, i;
+
+    seqs = malloc(((max > 0u) ? max : 1u) * sizeof(uint64_t));
+    if (seqs == NULL) {
+        return 0u;
+    }
+    (void)pthread_mutex_lock(&st->lock);
+    for (i = 0u; i < st->nb; i++) {
+        if (st->entries[i].blob_id == NVM_STORAGE_MASTER_ID) {
+            continue;
+        }
+        nvm_storage_rank(ids, seqs, &nb, max, st->entries[i].blob_id, st->entries[i].seq);
+    }
+    (void)pthread_mutex_unlock(&st->lock);
+    free(seqs);
+
+    return nb;
+}
+
+const struct nvm_storage_ops nvm_storage_raw_ops = {
+    "raw",
+    raw_open,
+    raw_read_blob,
+    raw_write_blob,
+    raw_flush,
+    raw_enumerate,
+    NULL,
+    raw_close,
+};
@@ -13,6 +13,7 @@
 
 #include "sab_messaging.h"
 #include "sab_msg_def.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -33,7 +34,7 @@ uint32_t sab_open_session_command (struct plat_os_abs_hdl *phdl, uint32_t *sessi
         cmd.priority = priority;
         cmd.operating_mode = operating_mode;
 
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_session_open_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_session_open_rsp));
         if (error != 0) {
@@ -57,7 +58,7 @@ uint32_t sab_close_session_command (struct plat_os_abs_hdl *phdl, uint32_t sessi
         plat_fill_cmd_msg_hdr(&cmd.hdr, SAB_SESSION_CLOSE_REQ, (uint32_t)sizeof(struct sab_cmd_session_close_msg), mu_type);
         cmd.session_handle = session_handle;
 
-        error =  plat_send_msg_and_get_resp(phdl,
+        error =  sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_session_close_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_session_close_rsp));
         if (error != 0) {
@@ -81,7 +82,7 @@ uint32_t sab_get_shared_buffer(struct plat_os_abs_hdl *phdl, uint32_t session_ha
         plat_fill_cmd_msg_hdr(&cmd.hdr, SAB_SHARED_BUF_REQ, (uint32_t)sizeof(struct sab_cmd_shared_buffer_msg), mu_type);
 
         cmd.session_handle = session_handle;
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_shared_buffer_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_shared_buffer_rsp));
         if (error != 0) {
@@ -123,7 +124,7 @@ uint32_t sab_open_key_store_command(struct plat_os_abs_hdl *phdl, uint32_t sessi
         cmd.min_mac_length = min_mac_length;
         cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd, (uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_key_store_open_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_key_store_open_rsp));
         if (error != 0) {
@@ -148,7 +149,7 @@ uint32_t sab_close_key_store(struct plat_os_abs_hdl *phdl, uint32_t key_store_ha
         plat_fill_cmd_msg_hdr(&cmd.hdr, SAB_KEY_STORE_CLOSE_REQ, (uint32_t)sizeof(struct sab_cmd_key_store_close_msg), mu_type);
         cmd.key_store_handle = key_store_handle;
 
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_key_store_close_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_key_store_close_rsp));
         if (error != 0) {
@@ -178,7 +179,7 @@ uint32_t sab_open_rng(struct plat_os_abs_hdl *phdl, uint32_t session_handle, uin
         cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd, (uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
         /* Send the message to Platform. */
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_rng_open_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_rng_open_rsp));
         if (error != 0) {
@@ -203,7 +204,7 @@ uint32_t sab_close_rng(struct plat_os_abs_hdl *phdl, uint32_t rng_handle, uint32
         /* Send the keys store open command to Platform. */
         plat_fill_cmd_msg_hdr(&cmd.hdr, SAB_RNG_CLOSE_REQ, (uint32_t)sizeof(struct sab_cmd_rng_close_msg), mu_type);
         cmd.rng_handle = rng_handle;
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_rng_close_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_rng_close_rsp));
 
@@ -233,7 +234,7 @@ uint32_t sab_open_storage_command(struct plat_os_abs_hdl *phdl, uint32_t session
         cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd, (uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
         /* Send the message to Platform. */
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_storage_open_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_storage_open_rsp));
         if (error != 0) {
@@ -258,7 +259,7 @@ uint32_t sab_close_storage_command(struct plat_os_abs_hdl *phdl, uint32_t storag
         /* Send the Storage close command to Platform. */
         plat_fill_cmd_msg_hdr(&cmd.hdr, SAB_STORAGE_CLOSE_REQ, (uint32_t)sizeof(struct sab_cmd_storage_close_msg), mu_type);
         cmd.storage_handle = storage_handle;
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_storage_close_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_storage_close_rsp));
 
@@ -285,7 +286,7 @@ uint32_t sab_get_info(struct plat_os_abs_hdl *phdl, uint32_t session_handle, uin
         cmd.session_handle = session_handle;
 
         /* Send the message to Platform. */
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_get_info_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_get_info_rsp));
 
@@ -327,7 +328,7 @@ uint32_t sab_open_sm2_eces(struct plat_os_abs_hdl *phdl, uint32_t key_store_hand
         cmd.crc = 0u;
         cmd.crc = plat_compute_msg_crc((uint32_t*)&cmd, (uint32_t)(sizeof(cmd) - sizeof(uint32_t)));
 
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_sm2_eces_dec_open_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_sm2_eces_dec_open_rsp));
         if (error != 0) {
@@ -350,7 +351,7 @@ uint32_t sab_close_sm2_eces(struct plat_os_abs_hdl *phdl, uint32_t sm2_eces_hand
     do {
         plat_fill_cmd_msg_hdr(&cmd.hdr, SAB_SM2_ECES_DEC_CLOSE_REQ, (uint32_t)sizeof(struct sab_cmd_sm2_eces_dec_close_msg), mu_type);
         cmd.sm2_eces_handle = sm2_eces_handle;
-        error = plat_send_msg_and_get_resp(phdl,
+        error = sab_queue_send_msg_and_get_resp(phdl,
                     (uint32_t *)&cmd, (uint32_t)sizeof(struct sab_cmd_sm2_eces_dec_close_msg),
                     (uint32_t *)&rsp, (uint32_t)sizeof(struct sab_cmd_sm2_eces_dec_close_rsp));
 
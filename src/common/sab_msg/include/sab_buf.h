@@ -0,0 +1,51 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef SAB_BUF_H
+#define SAB_BUF_H
+
+#include <stdint.h>
+
+#include "plat_os_abs.h"
+
+/*
+ * Pool of data buffers of a MU channel, allocated in regions mapped once
+ * with plat_os_abs_buf_map(). The enclave reaches a buffer of the pool by
+ * its address in the region, without plat_os_abs_data_buf().
+ * On platforms that cannot map memory (ELE and SECO, only the simulator
+ * can) the regions are plain host memory, their buffers go through
+ * plat_os_abs_data_buf() as any other.
+ */
+
+/* Size of the regions, bigger buffers get a region of their own. */
+#define SAB_BUF_REGION_SZ	(64u * 1024u)
+/* Allocation granularity, buffers are aligned on it. */
+#define SAB_BUF_BLOCK_SZ	64u
+
+/* Allocate a buffer of the pool of a channel. Return NULL if out of memory. */
+void *sab_buf_alloc(struct plat_os_abs_hdl *phdl, uint32_t size);
+
+/* Free a buffer of the pool. Return 0 if buf was allocated in the pool. */
+uint32_t sab_buf_free(struct plat_os_abs_hdl *phdl, void *buf);
+
+/*
+ * Get the enclave address of size bytes at src.
+ * Return 0 if they are located in a mapped region of the pool.
+ */
+uint32_t sab_buf_addr(struct plat_os_abs_hdl *phdl, uint8_t *src,
+		      uint32_t size, uint64_t *addr);
+
+/* Release all the regions of a channel, its buffers must no longer be used. */
+void sab_buf_release(struct plat_os_abs_hdl *phdl);
+
+#endif
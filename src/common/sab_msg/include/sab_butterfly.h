@@ -0,0 +1,44 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef SAB_BUTTERFLY_H
+#define SAB_BUTTERFLY_H
+
+#include <stdint.h>
+
+#include "sab_msg_def.h"
+
+/*
+ * Butterfly key expansions, the commands and responses are those of
+ * sab_msg_def.h. The args are op_butt_key_exp_args_t and
+ * op_st_butt_key_exp_args_t.
+ */
+
+uint32_t prepare_msg_butterfly(void *phdl,
+			       void *cmd_buf, void *rsp_buf,
+			       uint32_t *cmd_msg_sz,
+			       uint32_t *rsp_msg_sz,
+			       uint32_t msg_hdl,
+			       void *args);
+
+uint32_t proc_msg_rsp_butterfly(void *rsp_buf, void *args);
+
+uint32_t prepare_msg_st_butterfly(void *phdl,
+				  void *cmd_buf, void *rsp_buf,
+				  uint32_t *cmd_msg_sz,
+				  uint32_t *rsp_msg_sz,
+				  uint32_t msg_hdl,
+				  void *args);
+
+uint32_t proc_msg_rsp_st_butterfly(void *rsp_buf, void *args);
+#endif
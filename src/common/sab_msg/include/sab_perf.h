@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef SAB_PERF_H
+#define SAB_PERF_H
+
+#include <stdint.h>
+
+#include "internal/hsm_perf.h"
+
+/*
+ * Per message ID statistics of the requests, see hsm_perf.h. Built with
+ * HSM_PERF_STATS only, the calls compile to nothing otherwise.
+ * Timestamps are CPU counter ticks taken with sab_perf_now(), only their
+ * differences are accounted, in ns.
+ */
+#ifdef HSM_PERF_STATS
+
+uint64_t sab_perf_now(void);
+
+/*
+ * Account the duration of a phase of a message started at start.
+ * Return the end of the phase, start of the next one.
+ */
+uint64_t sab_perf_phase(uint8_t msg_id, hsm_perf_phase_t phase,
+			uint64_t start);
+
+/* Account a command built, with the data buffers set up by the thread. */
+void sab_perf_call(uint8_t msg_id);
+
+void sab_perf_error(uint8_t msg_id);
+
+/* Account a data buffer set up for the command built by the thread. */
+void sab_perf_data_buf(uint32_t size);
+
+void sab_perf_get(uint8_t msg_id, hsm_perf_stats_t *stats);
+
+void sab_perf_reset(void);
+
+#else
+
+static inline uint64_t sab_perf_now(void)
+{
+	return 0u;
+}
+
+static inline uint64_t sab_perf_phase(uint8_t msg_id,
+				      hsm_perf_phase_t phase, uint64_t start)
+{
+	return 0u;
+}
+
+static inline void sab_perf_call(uint8_t msg_id)
+{
+}
+
+static inline void sab_perf_error(uint8_t msg_id)
+{
+}
+
+static inline void sab_perf_data_buf(uint32_t size)
+{
+}
+
+#endif
+#endif
@@ -19,25 +19,34 @@
 #include "plat_os_abs.h"
 #include "plat_utils.h"
 
-#define MAX_CMD_SZ	1024
-#define MAX_CMD_RSP_SZ	1024
-
-typedef enum {
-	NOT_DONE,
-	DONE,
-	ALREADY_DONE
-} sab_msg_init_info_t;
-
-sab_msg_init_info_t add_sab_msg_handler(uint32_t msg_id, msg_type_t msg_type,
-			     uint32_t (*prep_sab_msg_handler)(void *phdl,
-							      void *cmd_buf,
-							      void *rsp_buf,
-							      uint32_t *cmd_msg_sz,
-							      uint32_t *rsp_msg_sz,
-							      uint32_t msg_hdl,
-							      void *args),
-			     uint32_t (*proc_sab_msg_rsp_handler)(void *rsp_buf,
-								  void *args));
+/*
+ * Room for the largest command and response of the messages, checked
+ * against every handler of sab_msg_handlers at build time.
+ */
+#define SAB_MSG_CMD_MAX_SZ	64u
+#define SAB_MSG_RSP_MAX_SZ	128u
+/* Command and response of a message start on their own cache line. */
+#define SAB_MSG_LINE_SZ		64u
+
+/* Command and response buffers of a message being built or in flight. */
+struct sab_msg_slot {
+	uint32_t cmd[SAB_MSG_CMD_MAX_SZ / sizeof(uint32_t)];
+	uint32_t rsp[SAB_MSG_RSP_MAX_SZ / sizeof(uint32_t)];
+} __attribute__((aligned(SAB_MSG_LINE_SZ)));
+
+/* Handlers of a message, with the sizes of its command and response. */
+struct sab_msg_handler {
+	uint32_t (*prepare)(void *phdl, void *cmd_buf, void *rsp_buf,
+			    uint32_t *cmd_msg_sz, uint32_t *rsp_msg_sz,
+			    uint32_t msg_hdl, void *args);
+	uint32_t (*process_rsp)(void *rsp_buf, void *args);
+	uint32_t cmd_sz;
+	uint32_t rsp_sz;
+};
+
+/* Handlers by message type and ID, NULL for the messages not supported. */
+extern const struct sab_msg_handler
+sab_msg_handlers[MAX_MSG_TYPE - 1][SAB_MSG_MAX_ID + 1];
 
 uint32_t process_sab_msg(struct plat_os_abs_hdl *phdl,
 			 uint32_t mu_type,
@@ -47,5 +56,23 @@ uint32_t process_sab_msg(struct plat_os_abs_hdl *phdl,
 			 void *args,
 			 uint32_t *rsp_code);
 
-void init_proc_sab_msg_engine(msg_type_t msg_type);
+/* Build the command message (payload, header and CRC) of a request. */
+uint32_t prepare_sab_msg_cmd(struct plat_os_abs_hdl *phdl,
+			     uint32_t mu_type,
+			     uint8_t msg_id,
+			     msg_type_t msg_type,
+			     uint32_t msg_hdl,
+			     void *args,
+			     uint32_t *cmd,
+			     uint32_t *rsp,
+			     uint32_t *cmd_msg_sz,
+			     uint32_t *rsp_msg_sz);
+
+/* Extract the response code and the output arguments of a response. */
+uint32_t process_sab_msg_resp(uint8_t msg_id,
+			      msg_type_t msg_type,
+			      void *args,
+			      uint32_t *rsp,
+			      uint32_t rsp_msg_sz,
+			      uint32_t *rsp_code);
 #endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#ifndef SAB_QUEUE_H
+#define SAB_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "plat_os_abs.h"
+#include "plat_utils.h"
+
+/*
+ * Request queue of a MU channel shared by several threads.
+ *
+ * Commands are written on the MU in the order they are queued, up to
+ * plat_os_abs_mu_max_in_flight() at a time, and the MU answers them in the
+ * same order. The response at the head of the queue is read either by the
+ * completion thread of the channel, when it is in asynchronous mode, or
+ * by one of the threads waiting for a response.
+ */
+
+/* Max number of asynchronous requests submitted and not yet completed. */
+#define SAB_QUEUE_MAX_PENDING	8u
+
+#define SAB_QUEUE_TICKET_NONE	0u
+
+/*
+ * Completion callback, called from the completion thread. error is the
+ * engine error (0 on success), rsp_code the response code of the enclave.
+ * The callback must not issue a request on the same channel and wait for it.
+ */
+typedef void (*sab_queue_cb_t)(uint32_t ticket, uint32_t error,
+			       uint32_t rsp_code, void *cb_arg);
+
+/* Create the queue of a channel. Return 0 on success. */
+uint32_t sab_queue_open(struct plat_os_abs_hdl *phdl);
+
+/* Stop the asynchronous mode if needed and delete the queue of a channel. */
+void sab_queue_close(struct plat_os_abs_hdl *phdl);
+
+/* Start measuring the service time of the commands of a channel. */
+void sab_queue_track_load(struct plat_os_abs_hdl *phdl);
+
+/*
+ * Load of a channel: commands written or being built and not answered yet,
+ * and rolling average of the time the enclave took to serve one, in ns (0
+ * until measured, see sab_queue_track_load()). Return 0 on success.
+ */
+uint32_t sab_queue_load(struct plat_os_abs_hdl *phdl, uint32_t *in_flight,
+			uint64_t *service_ns);
+
+/*
+ * Same as plat_send_msg_and_get_resp(), serialized with the other requests
+ * of the channel. Channels without queue go directly to the platform.
+ * Return 0 on success.
+ */
+int32_t sab_queue_send_msg_and_get_resp(struct plat_os_abs_hdl *phdl,
+					uint32_t *cmd, uint32_t cmd_len,
+					uint32_t *rsp, uint32_t rsp_len);
+
+/*
+ * Same as plat_os_abs_data_buf(), for the command being built by the calling
+ * thread: the command gets its place on the MU first, since the driver
+ * attaches the data buffers to the next command written on the channel.
+ * Buffers of the pool of the channel (sab_buf.h) are given by their address.
+ */
+uint64_t sab_queue_data_buf(struct plat_os_abs_hdl *phdl, uint8_t *src,
+			    uint32_t size, uint32_t flags);
+
+/* Give back the place taken by sab_queue_data_buf() for a command not sent. */
+void sab_queue_cancel(struct plat_os_abs_hdl *phdl);
+
+/*
+ * Send nb requests of the same type. args is an array of nb elements of
+ * args_sz bytes. The commands are built and written while the previous ones
+ * are processed, up to the MU credits, and callback is called from the
+ * calling thread with the index of each request. Return 0 if all the
+ * requests were handled.
+ */
+uint32_t sab_queue_send_batch(struct plat_os_abs_hdl *phdl,
+			      uint32_t mu_type,
+			      uint8_t msg_id,
+			      msg_type_t msg_type,
+			      uint32_t msg_hdl,
+			      void *args,
+			      uint32_t args_sz,
+			      uint32_t nb,
+			      sab_queue_cb_t callback,
+			      void *cb_arg);
+
+/*
+ * Start the completion thread of a channel. If event_fd is not NULL, an
+ * eventfd incremented on each asynchronous completion is created and
+ * returned. Return 0 on success.
+ */
+uint32_t sab_queue_async_start(struct plat_os_abs_hdl *phdl, int32_t *event_fd);
+
+/* Wait for the completion of all the pending requests and stop the thread. */
+void sab_queue_async_stop(struct plat_os_abs_hdl *phdl);
+
+/*
+ * Build and send an asynchronous request. args must stay valid until
+ * completion. Requests with a callback are released once the callback
+ * returns, the others must be collected with sab_queue_wait().
+ */
+uint32_t sab_queue_submit(struct plat_os_abs_hdl *phdl,
+			  uint32_t mu_type,
+			  uint8_t msg_id,
+			  msg_type_t msg_type,
+			  uint32_t msg_hdl,
+			  void *args,
+			  sab_queue_cb_t callback,
+			  void *cb_arg,
+			  uint32_t *ticket);
+
+/*
+ * Collect the result of a request submitted without callback. If block is
+ * false and the request is still pending, return SAB_NOT_READY_RATING.
+ */
+uint32_t sab_queue_wait(struct plat_os_abs_hdl *phdl,
+			uint32_t ticket,
+			bool block,
+			uint32_t *error,
+			uint32_t *rsp_code);
+#endif
@@ -16,6 +16,19 @@
 
 #include "sab_msg_def.h"
 
+/*
+ * Room taken by an input of a signature verification when the key, the
+ * message and the signature are packed in one region, in this order.
+ */
+#define SAB_VERIFY_SIGN_IN_SZ(sz)	(((uint32_t)(sz) + 7u) & ~7u)
+
+/*
+ * Set by hsm_verify_signature_batch() in the flags of its copies of the
+ * arguments, whose inputs are packed as above. Never sent to the enclave.
+ */
+#define SAB_VERIFY_SIGN_FLAGS_PACKED \
+				((uint8_t)(1u << 7))
+
 struct sab_signature_verify_open_msg {
 	struct sab_mu_hdr hdr;
 	uint32_t session_handle;
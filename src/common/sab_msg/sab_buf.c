@@ -0,0 +1,241 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "sab_buf.h"
+
+#include "plat_os_abs.h"
+
+/* Marks the blocks following the first one of a buffer. */
+#define BLK_CONT	0xFFFFFFFFu
+
+struct sab_buf_region {
+	struct sab_buf_region *next;
+	struct plat_os_abs_hdl *phdl;
+	uint8_t *ptr;
+	uint64_t addr;
+	/* false if the platform could not map memory: plain host memory. */
+	bool mapped;
+	uint32_t size;
+	uint32_t nb_blocks;
+	uint32_t nb_used;
+	/*
+	 * Per block: 0 if free, the number of blocks of the buffer for its
+	 * first block, BLK_CONT for the others.
+	 */
+	uint32_t *blk;
+};
+
+static pthread_rwlock_t region_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct sab_buf_region *region_list;
+
+static struct sab_buf_region *find_region(struct plat_os_abs_hdl *phdl,
+					  uint8_t *ptr, uint32_t size)
+{
+	struct sab_buf_region *r;
+
+	for (r = region_list; r != NULL; r = r->next) {
+		if ((r->phdl == phdl) && (ptr >= r->ptr)
+		    && ((uint32_t)(ptr - r->ptr) < r->size)
+		    && (size <= (r->size - (uint32_t)(ptr - r->ptr)))) {
+			break;
+		}
+	}
+
+	return r;
+}
+
+/* First fit. Return the index of the first block, nb_blocks if no room. */
+static uint32_t region_alloc(struct sab_buf_region *r, uint32_t nb)
+{
+	uint32_t i = 0u;
+	uint32_t j;
+
+	while (i + nb <= r->nb_blocks) {
+		if (r->blk[i] != 0u) {
+			/* Skip the buffer starting there. */
+			i += r->blk[i];
+			continue;
+		}
+		for (j = i; (j < i + nb) && (r->blk[j] == 0u); j++) {
+		}
+		if (j == i + nb) {
+			r->blk[i] = nb;
+			for (j = i + 1u; j < i + nb; j++) {
+				r->blk[j] = BLK_CONT;
+			}
+			r->nb_used += nb;
+			return i;
+		}
+		/* Block j starts a buffer. */
+		i = j;
+	}
+
+	return r->nb_blocks;
+}
+
+static struct sab_buf_region *region_new(struct plat_os_abs_hdl *phdl,
+					 uint32_t size)
+{
+	struct sab_buf_region *r;
+
+	r = calloc(1u, sizeof(struct sab_buf_region));
+	if (r == NULL) {
+		return NULL;
+	}
+
+	r->nb_blocks = size / SAB_BUF_BLOCK_SZ;
+	r->blk = calloc(r->nb_blocks, sizeof(uint32_t));
+	if (r->blk != NULL) {
+		r->ptr = plat_os_abs_buf_map(phdl, size, &r->addr);
+		r->mapped = (r->ptr != NULL);
+		if ((r->ptr == NULL) && (posix_memalign((void **)&r->ptr,
+							SAB_BUF_BLOCK_SZ,
+							size) != 0)) {
+			r->ptr = NULL;
+		}
+	}
+	if (r->ptr == NULL) {
+		free(r->blk);
+		free(r);
+		return NULL;
+	}
+	r->phdl = phdl;
+	r->size = size;
+
+	return r;
+}
+
+static void region_delete(struct sab_buf_region *r)
+{
+	if (r->mapped) {
+		plat_os_abs_buf_unmap(r->phdl, r->ptr, r->size);
+	} else {
+		free(r->ptr);
+	}
+	free(r->blk);
+	free(r);
+}
+
+void *sab_buf_alloc(struct plat_os_abs_hdl *phdl, uint32_t size)
+{
+	struct sab_buf_region *r;
+	uint32_t nb, i;
+	uint8_t *buf = NULL;
+
+	if ((phdl == NULL) || (size == 0u)
+	    || (size > (UINT32_MAX - SAB_BUF_REGION_SZ))) {
+		return NULL;
+	}
+	nb = (size + SAB_BUF_BLOCK_SZ - 1u) / SAB_BUF_BLOCK_SZ;
+
+	pthread_rwlock_wrlock(&region_lock);
+	for (r = region_list; r != NULL; r = r->next) {
+		if ((r->phdl == phdl) && (r->nb_blocks - r->nb_used >= nb)) {
+			i = region_alloc(r, nb);
+			if (i < r->nb_blocks) {
+				buf = r->ptr + (i * SAB_BUF_BLOCK_SZ);
+				break;
+			}
+		}
+	}
+
+	if (buf == NULL) {
+		r = region_new(phdl, (nb * SAB_BUF_BLOCK_SZ > SAB_BUF_REGION_SZ)
+				     ? nb * SAB_BUF_BLOCK_SZ
+				     : SAB_BUF_REGION_SZ);
+		if (r != NULL) {
+			(void)region_alloc(r, nb);
+			buf = r->ptr;
+			r->next = region_list;
+			region_list = r;
+		}
+	}
+	pthread_rwlock_unlock(&region_lock);
+
+	return buf;
+}
+
+uint32_t sab_buf_free(struct plat_os_abs_hdl *phdl, void *buf)
+{
+	struct sab_buf_region *r;
+	struct sab_buf_region **prev;
+	uint32_t i, j, nb;
+	uint32_t ret = 1u;
+
+	pthread_rwlock_wrlock(&region_lock);
+	r = find_region(phdl, (uint8_t *)buf, 1u);
+	if ((r != NULL)
+	    && ((uint32_t)((uint8_t *)buf - r->ptr) % SAB_BUF_BLOCK_SZ == 0u)) {
+		i = (uint32_t)((uint8_t *)buf - r->ptr) / SAB_BUF_BLOCK_SZ;
+		nb = r->blk[i];
+		if ((nb != 0u) && (nb != BLK_CONT)) {
+			for (j = i; j < i + nb; j++) {
+				r->blk[j] = 0u;
+			}
+			r->nb_used -= nb;
+			ret = 0u;
+		}
+	}
+
+	/* A region made for one big buffer goes with it, the others stay. */
+	if ((ret == 0u) && (r->nb_used == 0u)
+	    && (r->size > SAB_BUF_REGION_SZ)) {
+		for (prev = &region_list; *prev != r; prev = &(*prev)->next) {
+		}
+		*prev = r->next;
+		region_delete(r);
+	}
+	pthread_rwlock_unlock(&region_lock);
+
+	return ret;
+}
+
+uint32_t sab_buf_addr(struct plat_os_abs_hdl *phdl, uint8_t *src,
+		      uint32_t size, uint64_t *addr)
+{
+	struct sab_buf_region *r;
+	uint32_t ret = 1u;
+
+	pthread_rwlock_rdlock(&region_lock);
+	r = find_region(phdl, src, size);
+	if ((r != NULL) && r->mapped) {
+		*addr = r->addr + (uint64_t)(src - r->ptr);
+		ret = 0u;
+	}
+	pthread_rwlock_unlock(&region_lock);
+
+	return ret;
+}
+
+void sab_buf_release(struct plat_os_abs_hdl *phdl)
+{
+	struct sab_buf_region *r;
+	struct sab_buf_region **prev;
+
+	pthread_rwlock_wrlock(&region_lock);
+	prev = &region_list;
+	while (*prev != NULL) {
+		r = *prev;
+		if (r->phdl == phdl) {
+			*prev = r->next;
+			region_delete(r);
+		} else {
+			prev = &r->next;
+		}
+	}
+	pthread_rwlock_unlock(&region_lock);
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include "hsm_api.h"
+
+#include "sab_butterfly.h"
+#include "sab_queue.h"
+
+#include "plat_os_abs.h"
+#include "plat_utils.h"
+
+uint32_t prepare_msg_butterfly(void *phdl,
+			       void *cmd_buf, void *rsp_buf,
+			       uint32_t *cmd_msg_sz,
+			       uint32_t *rsp_msg_sz,
+			       uint32_t msg_hdl,
+			       void *args)
+{
+	uint32_t ret = 0;
+	struct sab_cmd_butterfly_key_exp_msg *cmd =
+		(struct sab_cmd_butterfly_key_exp_msg *) cmd_buf;
+	op_butt_key_exp_args_t *op_args = (op_butt_key_exp_args_t *) args;
+
+	cmd->key_management_handle = msg_hdl;
+	cmd->key_identifier = op_args->key_identifier;
+	cmd->expansion_function_value_addr = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->expansion_function_value,
+					op_args->expansion_function_value_size,
+					DATA_BUF_IS_INPUT);
+	cmd->hash_value_addr = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->hash_value,
+					op_args->hash_value_size,
+					DATA_BUF_IS_INPUT);
+	cmd->pr_reconstruction_value_addr = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->pr_reconstruction_value,
+					op_args->pr_reconstruction_value_size,
+					DATA_BUF_IS_INPUT);
+	cmd->expansion_function_value_size =
+				op_args->expansion_function_value_size;
+	cmd->hash_value_size = op_args->hash_value_size;
+	cmd->pr_reconstruction_value_size =
+				op_args->pr_reconstruction_value_size;
+	cmd->flags = op_args->flags;
+	cmd->dest_key_identifier = *(op_args->dest_key_identifier);
+	cmd->output_address = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->output,
+					op_args->output_size,
+					0u);
+	cmd->output_size = op_args->output_size;
+	cmd->key_type = op_args->key_type;
+	cmd->rsv = 0u;
+	cmd->key_group = op_args->key_group;
+	cmd->key_info = op_args->key_info;
+
+	*cmd_msg_sz = sizeof(struct sab_cmd_butterfly_key_exp_msg);
+	*rsp_msg_sz = sizeof(struct sab_cmd_butterfly_key_exp_rsp);
+
+	cmd->crc = 0u;
+	ret |= SAB_MSG_CRC_BIT;
+
+	return ret;
+}
+
+uint32_t proc_msg_rsp_butterfly(void *rsp_buf, void *args)
+{
+	op_butt_key_exp_args_t *op_args = (op_butt_key_exp_args_t *) args;
+	struct sab_cmd_butterfly_key_exp_rsp *rsp =
+		(struct sab_cmd_butterfly_key_exp_rsp *) rsp_buf;
+
+	if ((op_args->flags & HSM_OP_BUTTERFLY_KEY_FLAGS_CREATE)
+				== HSM_OP_BUTTERFLY_KEY_FLAGS_CREATE) {
+		*(op_args->dest_key_identifier) = rsp->dest_key_identifier;
+	}
+
+	return SAB_SUCCESS_STATUS;
+}
+
+uint32_t prepare_msg_st_butterfly(void *phdl,
+				  void *cmd_buf, void *rsp_buf,
+				  uint32_t *cmd_msg_sz,
+				  uint32_t *rsp_msg_sz,
+				  uint32_t msg_hdl,
+				  void *args)
+{
+	uint32_t ret = 0;
+	struct sab_cmd_st_butterfly_key_exp_msg *cmd =
+		(struct sab_cmd_st_butterfly_key_exp_msg *) cmd_buf;
+	op_st_butt_key_exp_args_t *op_args =
+		(op_st_butt_key_exp_args_t *) args;
+
+	cmd->key_management_handle = msg_hdl;
+	cmd->key_identifier = op_args->key_identifier;
+	cmd->exp_fct_key_identifier = op_args->expansion_fct_key_identifier;
+	cmd->exp_fct_input_address = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->expansion_fct_input,
+					op_args->expansion_fct_input_size,
+					DATA_BUF_IS_INPUT);
+	cmd->hash_value_address = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->hash_value,
+					op_args->hash_value_size,
+					DATA_BUF_IS_INPUT);
+	cmd->pr_reconst_value_address = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->pr_reconstruction_value,
+					op_args->pr_reconstruction_value_size,
+					DATA_BUF_IS_INPUT);
+	cmd->exp_fct_input_size = op_args->expansion_fct_input_size;
+	cmd->hash_value_size = op_args->hash_value_size;
+	cmd->pr_reconst_value_size = op_args->pr_reconstruction_value_size;
+	cmd->flags = op_args->flags;
+	cmd->dest_key_identifier = *(op_args->dest_key_identifier);
+	cmd->output_address = (uint32_t)sab_queue_data_buf(
+					(struct plat_os_abs_hdl *)phdl,
+					op_args->output,
+					op_args->output_size,
+					0u);
+	cmd->output_size = op_args->output_size;
+	cmd->key_type = op_args->key_type;
+	cmd->exp_fct_algorithm = op_args->expansion_fct_algo;
+	cmd->key_group = op_args->key_group;
+	cmd->key_info = op_args->key_info;
+
+	*cmd_msg_sz = sizeof(struct sab_cmd_st_butterfly_key_exp_msg);
+	*rsp_msg_sz = sizeof(struct sab_cmd_st_butterfly_key_exp_rsp);
+
+	cmd->crc = 0u;
+	ret |= SAB_MSG_CRC_BIT;
+
+	return ret;
+}
+
+uint32_t proc_msg_rsp_st_butterfly(void *rsp_buf, void *args)
+{
+	op_st_butt_key_exp_args_t *op_args =
+		(op_st_butt_key_exp_args_t *) args;
+	struct sab_cmd_st_butterfly_key_exp_rsp *rsp =
+		(struct sab_cmd_st_butterfly_key_exp_rsp *) rsp_buf;
+
+	if ((op_args->flags & HSM_OP_ST_BUTTERFLY_KEY_FLAGS_CREATE)
+				== HSM_OP_ST_BUTTERFLY_KEY_FLAGS_CREATE) {
+		*(op_args->dest_key_identifier) = rsp->dest_key_identifier;
+	}
+
+	return SAB_SUCCESS_STATUS;
+}
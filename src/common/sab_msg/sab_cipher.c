@@ -16,6 +16,7 @@
 #include "internal/hsm_cipher.h"
 
 #include "sab_cipher.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -125,17 +126,17 @@ uint32_t prepare_msg_cipher_one_go(void *phdl,
 	if (op_args->iv == NULL) {
 		cmd->iv_address = 0u;
 	} else {
-		cmd->iv_address = plat_os_abs_data_buf(phdl, op_args->iv,
+		cmd->iv_address = sab_queue_data_buf(phdl, op_args->iv,
 						       op_args->iv_size,
 						       DATA_BUF_IS_INPUT);
 	}
 	cmd->iv_size = op_args->iv_size;
 	cmd->algo = op_args->cipher_algo;
 	cmd->flags = op_args->flags;
-	cmd->input_address = plat_os_abs_data_buf(phdl, op_args->input,
+	cmd->input_address = sab_queue_data_buf(phdl, op_args->input,
 						  op_args->input_size,
 						  DATA_BUF_IS_INPUT);
-	cmd->output_address = plat_os_abs_data_buf(phdl, op_args->output,
+	cmd->output_address = sab_queue_data_buf(phdl, op_args->output,
 						   op_args->output_size,
 						   DATA_BUF_IS_OUTPUT);
 	cmd->input_size = op_args->input_size;
@@ -162,7 +163,9 @@ uint32_t proc_msg_rsp_cipher_one_go(void *rsp_buf, void *args)
 		printf("%s", err_str);
 	}
 
+#ifdef PSA_COMPLIANT
 	op_args->output_size = rsp->output_size;
+#endif
 
 	return SAB_SUCCESS_STATUS;
 }
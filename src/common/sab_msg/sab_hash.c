@@ -14,6 +14,7 @@
 #include "internal/hsm_hash.h"
 
 #include "sab_hash.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -33,12 +34,12 @@ uint32_t prepare_msg_hash_one_go(void *phdl,
 	op_hash_one_go_args_t *op_args = (op_hash_one_go_args_t *) args;
 
 	cmd->hash_hdl = msg_hdl;
-	cmd->input_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->input_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->input,
 						op_args->input_size,
 						DATA_BUF_IS_INPUT);
-	cmd->output_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->output_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->output,
 						op_args->output_size,
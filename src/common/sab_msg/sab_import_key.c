@@ -14,6 +14,7 @@
 #include "internal/hsm_importkey.h"
 
 #include "sab_import_key.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -55,7 +56,7 @@ uint32_t prepare_msg_importkey(void *phdl,
 		cmd->bit_key_sz = 0;
 		cmd->permitted_algo = 0;
 	}
-	cmd->priv_key_in_lsb_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->priv_key_in_lsb_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->encryted_prv_key,
 						cmd->in_priv_key_sz,
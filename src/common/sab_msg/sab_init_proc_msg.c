@@ -58,219 +58,174 @@
 #include "sab_mac.h"
 #endif
 
-static uint32_t prep_sab_msg_not_supported(void *phdl, void *cmd_buf,
-					   void *rsp_buf, uint32_t *cmd_msg_sz,
-					   uint32_t *rsp_msg_sz,
-					   uint32_t msg_hdl, void *args)
-{
-	printf("Error: CMD not supported.\n");
-	return SAB_CMD_NOT_SUPPORTED_RATING;
-}
-
-static uint32_t proc_sab_msg_rsp_not_supported(void *rsp_buf, void *args)
-{
-	return SAB_CMD_NOT_SUPPORTED_RATING;
-}
-
+#if MT_SAB_BUTTERFLY
+#include "sab_butterfly.h"
+#endif
 
-void init_proc_sab_msg_engine(msg_type_t msg_type)
-{
-	int i = 0;
-	int ret = NOT_DONE;
+/*
+ * Handlers of the messages, indexed by message type and ID. The message
+ * type of each group comes from the sab_msg.def of the platform, the
+ * groups it does not support are left out: their entries stay NULL.
+ * A command or response that does not fit in a struct sab_msg_slot fails
+ * the build.
+ */
+#define SAB_MSG_SZ(msg, max) \
+	((uint32_t)sizeof(msg) \
+	 + 0u * (uint32_t)sizeof(char[(sizeof(msg) <= (max)) ? 1 : -1]))
 
-	for (i = 0; i < SAB_MSG_MAX_ID; i++) {
-		ret = NOT_DONE;
+#define SAB_MSG_HANDLER(prep, proc, cmd, rsp) \
+	{(prep), (proc), SAB_MSG_SZ(cmd, SAB_MSG_CMD_MAX_SZ), \
+	 SAB_MSG_SZ(rsp, SAB_MSG_RSP_MAX_SZ)}
 
-		switch (i) {
+const struct sab_msg_handler
+sab_msg_handlers[MAX_MSG_TYPE - 1][SAB_MSG_MAX_ID + 1] = {
 #if MT_SAB_DEBUG_DUMP
-		case ROM_DEBUG_DUMP_REQ:
-			if (msg_type == MT_SAB_DEBUG_DUMP) {
-				ret = add_sab_msg_handler(i, MT_SAB_DEBUG_DUMP,
-						  prepare_msg_debugdump,
-						  proc_msg_rsp_debugdump);
-			}
-		break;
+	[MT_SAB_DEBUG_DUMP - 1][ROM_DEBUG_DUMP_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_debugdump,
+				proc_msg_rsp_debugdump,
+				struct rom_cmd_firmware_dump_cmd,
+				struct rom_cmd_firmware_dump_rsp),
 #endif
 #if MT_SAB_KEY_GENERATE
-		case SAB_KEY_GENERATE_REQ:
-			if (msg_type == MT_SAB_KEY_GENERATE) {
-				ret = add_sab_msg_handler(i, MT_SAB_KEY_GENERATE,
-						  prepare_msg_generatekey,
-						  proc_msg_rsp_generatekey);
-			}
-		break;
+	[MT_SAB_KEY_GENERATE - 1][SAB_KEY_GENERATE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_generatekey,
+				proc_msg_rsp_generatekey,
+				struct sab_cmd_generate_key_msg,
+				struct sab_cmd_generate_key_rsp),
 #endif
 #if MT_SAB_KEY_GEN_EXT
-		case SAB_KEY_GENERATE_EXT_REQ:
-			if (msg_type == MT_SAB_KEY_GEN_EXT) {
-				ret = add_sab_msg_handler(i, MT_SAB_KEY_GEN_EXT,
-						  prepare_msg_gen_key_ext,
-						  proc_msg_rsp_gen_key_ext);
-			}
+	[MT_SAB_KEY_GEN_EXT - 1][SAB_KEY_GENERATE_EXT_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_gen_key_ext,
+				proc_msg_rsp_gen_key_ext,
+				struct sab_cmd_generate_key_ext_msg,
+				struct sab_cmd_generate_key_ext_rsp),
 #endif
 #if MT_SAB_IMPORT_KEY
-		case SAB_IMPORT_KEY_REQ:
-			if (msg_type == MT_SAB_IMPORT_KEY) {
-				ret = add_sab_msg_handler(i, MT_SAB_IMPORT_KEY,
-						  prepare_msg_importkey,
-						  proc_msg_rsp_importkey);
-			}
-		break;
+	[MT_SAB_IMPORT_KEY - 1][SAB_IMPORT_KEY_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_importkey,
+				proc_msg_rsp_importkey,
+				struct sab_cmd_import_key_msg,
+				struct sab_cmd_import_key_rsp),
 #endif
 #if MT_SAB_DELETE_KEY
-		case SAB_DELETE_KEY_REQ:
-			if (msg_type == MT_SAB_DELETE_KEY) {
-				ret = add_sab_msg_handler(i, MT_SAB_DELETE_KEY,
-						  prepare_msg_del_key,
-						  proc_msg_rsp_del_key);
-			}
-		break;
+	[MT_SAB_DELETE_KEY - 1][SAB_DELETE_KEY_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_del_key,
+				proc_msg_rsp_del_key,
+				struct sab_cmd_delete_key_msg,
+				struct sab_cmd_delete_key_rsp),
 #endif
 #if MT_SAB_MANAGE_KEY
-		case SAB_MANAGE_KEY_REQ:
-			if (msg_type == MT_SAB_MANAGE_KEY) {
-				ret = add_sab_msg_handler(i, MT_SAB_MANAGE_KEY,
-						  prepare_msg_managekey,
-						  proc_msg_rsp_managekey);
-			}
-		break;
-		case SAB_MANAGE_KEY_EXT_REQ:
-			if (msg_type == MT_SAB_MANAGE_KEY) {
-				ret = add_sab_msg_handler(i, MT_SAB_MANAGE_KEY,
-						  prepare_msg_managekey_ext,
-						  proc_msg_rsp_managekey);
-			}
-		break;
+	[MT_SAB_MANAGE_KEY - 1][SAB_MANAGE_KEY_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_managekey,
+				proc_msg_rsp_managekey,
+				struct sab_cmd_manage_key_msg,
+				struct sab_cmd_manage_key_rsp),
+	[MT_SAB_MANAGE_KEY - 1][SAB_MANAGE_KEY_EXT_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_managekey_ext,
+				proc_msg_rsp_managekey,
+				struct sab_cmd_manage_key_msg,
+				struct sab_cmd_manage_key_rsp),
 #endif
 #if MT_SAB_MAC
-		case SAB_MAC_OPEN_REQ:
-			if (msg_type == MT_SAB_MAC) {
-				ret = add_sab_msg_handler(i, MT_SAB_MAC,
-						  prepare_msg_mac_open_req,
-						  proc_msg_rsp_mac_open_req);
-			}
-		break;
-		case SAB_MAC_CLOSE_REQ:
-			if (msg_type == MT_SAB_MAC) {
-				ret = add_sab_msg_handler(i, MT_SAB_MAC,
-						  prepare_msg_mac_close_req,
-						  proc_msg_rsp_mac_close_req);
-			}
-		break;
-		case SAB_MAC_ONE_GO_REQ:
-			if (msg_type == MT_SAB_MAC) {
-				ret = add_sab_msg_handler(i, MT_SAB_MAC,
-						  prepare_msg_mac_one_go,
-						  proc_msg_rsp_mac_one_go);
-			}
-		break;
+	[MT_SAB_MAC - 1][SAB_MAC_OPEN_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_mac_open_req,
+				proc_msg_rsp_mac_open_req,
+				struct sab_cmd_mac_open_msg,
+				struct sab_cmd_mac_open_rsp),
+	[MT_SAB_MAC - 1][SAB_MAC_CLOSE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_mac_close_req,
+				proc_msg_rsp_mac_close_req,
+				struct sab_cmd_mac_close_msg,
+				struct sab_cmd_mac_close_rsp),
+	[MT_SAB_MAC - 1][SAB_MAC_ONE_GO_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_mac_one_go,
+				proc_msg_rsp_mac_one_go,
+				struct sab_cmd_mac_one_go_msg,
+				struct sab_cmd_mac_one_go_rsp),
 #endif
 #if MT_SAB_CIPHER
-		case SAB_CIPHER_OPEN_REQ:
-			if (msg_type == MT_SAB_CIPHER) {
-				ret = add_sab_msg_handler(i, MT_SAB_CIPHER,
-						  prepare_msg_cipher_open_req,
-						  proc_msg_rsp_cipher_open_req);
-			}
-		break;
-		case SAB_CIPHER_CLOSE_REQ:
-			if (msg_type == MT_SAB_CIPHER) {
-				ret = add_sab_msg_handler(i, MT_SAB_CIPHER,
-						  prepare_msg_cipher_close_req,
-						  proc_msg_rsp_cipher_close_req);
-			}
-		break;
-		case SAB_CIPHER_ONE_GO_REQ:
-			if (msg_type == MT_SAB_CIPHER) {
-				ret = add_sab_msg_handler(i, MT_SAB_CIPHER,
-						  prepare_msg_cipher_one_go,
-						  proc_msg_rsp_cipher_one_go);
-			}
-		break;
+	[MT_SAB_CIPHER - 1][SAB_CIPHER_OPEN_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_cipher_open_req,
+				proc_msg_rsp_cipher_open_req,
+				struct sab_cmd_cipher_open_msg,
+				struct sab_cmd_cipher_open_rsp),
+	[MT_SAB_CIPHER - 1][SAB_CIPHER_CLOSE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_cipher_close_req,
+				proc_msg_rsp_cipher_close_req,
+				struct sab_cmd_cipher_close_msg,
+				struct sab_cmd_cipher_close_rsp),
+	[MT_SAB_CIPHER - 1][SAB_CIPHER_ONE_GO_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_cipher_one_go,
+				proc_msg_rsp_cipher_one_go,
+				struct sab_cmd_cipher_one_go_msg,
+				struct sab_cmd_cipher_one_go_rsp),
 #endif
 #if MT_SAB_HASH_GEN
-		case SAB_HASH_OPEN_REQ:
-			if (msg_type == MT_SAB_HASH_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_HASH_GEN,
-						  prepare_msg_hash_open_req,
-						  proc_msg_rsp_hash_open_req);
-			}
-		break;
-		case SAB_HASH_CLOSE_REQ:
-			if (msg_type == MT_SAB_HASH_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_HASH_GEN,
-						  prepare_msg_hash_close_req,
-						  proc_msg_rsp_hash_close_req);
-			}
-		break;
-		case SAB_HASH_ONE_GO_REQ:
-			if (msg_type == MT_SAB_HASH_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_HASH_GEN,
-						  prepare_msg_hash_one_go,
-						  proc_msg_rsp_hash_one_go);
-			}
-		break;
+	[MT_SAB_HASH_GEN - 1][SAB_HASH_OPEN_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_hash_open_req,
+				proc_msg_rsp_hash_open_req,
+				struct sab_hash_open_msg,
+				struct sab_hash_open_rsp),
+	[MT_SAB_HASH_GEN - 1][SAB_HASH_CLOSE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_hash_close_req,
+				proc_msg_rsp_hash_close_req,
+				struct sab_hash_close_msg,
+				struct sab_hash_close_rsp),
+	[MT_SAB_HASH_GEN - 1][SAB_HASH_ONE_GO_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_hash_one_go,
+				proc_msg_rsp_hash_one_go,
+				struct sab_hash_one_go_msg,
+				struct sab_hash_one_go_rsp),
 #endif
 #if MT_SAB_SIGN_GEN
-		case SAB_SIGNATURE_GENERATION_OPEN_REQ:
-			if (msg_type == MT_SAB_SIGN_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_SIGN_GEN,
-						  prepare_msg_sign_gen_open,
-						  proc_msg_rsp_sign_gen_open);
-			}
-		break;
-		case SAB_SIGNATURE_GENERATION_CLOSE_REQ:
-			if (msg_type == MT_SAB_SIGN_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_SIGN_GEN,
-						  prepare_msg_sign_gen_close,
-						  proc_msg_rsp_sign_gen_close);
-			}
-		break;
-		case SAB_SIGNATURE_GENERATE_REQ:
-			if (msg_type == MT_SAB_SIGN_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_SIGN_GEN,
-						  prepare_msg_sign_generate,
-						  proc_msg_rsp_sign_generate);
-			}
-		break;
-		case SAB_SIGNATURE_PREPARE_REQ:
-			if (msg_type == MT_SAB_SIGN_GEN) {
-				ret = add_sab_msg_handler(i, MT_SAB_SIGN_GEN,
-						  prepare_msg_prep_signature,
-						  proc_msg_rsp_prep_signature);
-			}
-		break;
+	[MT_SAB_SIGN_GEN - 1][SAB_SIGNATURE_GENERATION_OPEN_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_sign_gen_open,
+				proc_msg_rsp_sign_gen_open,
+				struct sab_signature_gen_open_msg,
+				struct sab_signature_gen_open_rsp),
+	[MT_SAB_SIGN_GEN - 1][SAB_SIGNATURE_GENERATION_CLOSE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_sign_gen_close,
+				proc_msg_rsp_sign_gen_close,
+				struct sab_signature_gen_close_msg,
+				struct sab_signature_gen_close_rsp),
+	[MT_SAB_SIGN_GEN - 1][SAB_SIGNATURE_GENERATE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_sign_generate,
+				proc_msg_rsp_sign_generate,
+				struct sab_signature_generate_msg,
+				struct sab_signature_generate_rsp),
+	[MT_SAB_SIGN_GEN - 1][SAB_SIGNATURE_PREPARE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_prep_signature,
+				proc_msg_rsp_prep_signature,
+				struct sab_prepare_signature_msg,
+				struct sab_prepare_signature_rsp),
 #endif
 #if MT_SAB_VERIFY_SIGN
-		case SAB_SIGNATURE_VERIFICATION_OPEN_REQ:
-			if (msg_type == MT_SAB_VERIFY_SIGN) {
-				ret = add_sab_msg_handler(i, MT_SAB_VERIFY_SIGN,
-						  prepare_msg_verify_sign_open,
-						  proc_msg_rsp_verify_sign_open);
-			}
-		break;
-		case SAB_SIGNATURE_VERIFICATION_CLOSE_REQ:
-			if (msg_type == MT_SAB_VERIFY_SIGN) {
-				ret = add_sab_msg_handler(i, MT_SAB_VERIFY_SIGN,
-						  prepare_msg_verify_sign_close,
-						  proc_msg_rsp_verify_sign_close);
-			}
-		break;
-		case SAB_SIGNATURE_VERIFY_REQ:
-			if (msg_type == MT_SAB_VERIFY_SIGN) {
-				ret = add_sab_msg_handler(i, MT_SAB_VERIFY_SIGN,
-						  prepare_msg_verify_sign,
-						  proc_msg_rsp_verify_sign);
-			}
-		break;
-#endif
-		default:
-			if (ret == NOT_DONE) {
-				add_sab_msg_handler(i, SAB_MSG,
-						prep_sab_msg_not_supported,
-						proc_sab_msg_rsp_not_supported);
-			}
-		}
-
-	}
-}
+	[MT_SAB_VERIFY_SIGN - 1][SAB_SIGNATURE_VERIFICATION_OPEN_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_verify_sign_open,
+				proc_msg_rsp_verify_sign_open,
+				struct sab_signature_verify_open_msg,
+				struct sab_signature_verify_open_rsp),
+	[MT_SAB_VERIFY_SIGN - 1][SAB_SIGNATURE_VERIFICATION_CLOSE_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_verify_sign_close,
+				proc_msg_rsp_verify_sign_close,
+				struct sab_signature_verify_close_msg,
+				struct sab_signature_verify_close_rsp),
+	[MT_SAB_VERIFY_SIGN - 1][SAB_SIGNATURE_VERIFY_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_verify_sign,
+				proc_msg_rsp_verify_sign,
+				struct sab_signature_verify_msg,
+				struct sab_signature_verify_rsp),
+#endif
+#if MT_SAB_BUTTERFLY
+	[MT_SAB_BUTTERFLY - 1][SAB_BUT_KEY_EXP_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_butterfly,
+				proc_msg_rsp_butterfly,
+				struct sab_cmd_butterfly_key_exp_msg,
+				struct sab_cmd_butterfly_key_exp_rsp),
+	[MT_SAB_BUTTERFLY - 1][SAB_ST_BUT_KEY_EXP_REQ] =
+		SAB_MSG_HANDLER(prepare_msg_st_butterfly,
+				proc_msg_rsp_st_butterfly,
+				struct sab_cmd_st_butterfly_key_exp_msg,
+				struct sab_cmd_st_butterfly_key_exp_rsp),
+#endif
+};
@@ -15,6 +15,7 @@
 #include "internal/hsm_key_gen_ext.h"
 
 #include "sab_key_gen_ext.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -54,7 +55,7 @@ uint32_t prepare_msg_gen_key_ext(void *phdl,
 	cmd->key_type = op_args->key_type;
 	cmd->key_group = op_args->key_group;
 	cmd->key_info = op_args->key_info;
-	cmd->out_key_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->out_key_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->out_key,
 						op_args->out_size,
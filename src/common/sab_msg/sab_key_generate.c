@@ -15,6 +15,7 @@
 #include "internal/hsm_key_generate.h"
 
 #include "sab_key_generate.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -38,7 +39,7 @@ uint32_t prepare_msg_generatekey(void *phdl,
 	cmd->out_pub_key_sz = op_args->out_size;
 	cmd->flags = op_args->flags;
 	cmd->key_group = op_args->key_group;
-#ifdef CONFIG_PLAT_SECO
+#ifndef PSA_COMPLIANT
 	cmd->key_identifier = *(op_args->key_identifier);
 	cmd->key_type = op_args->key_type;
 	cmd->key_info = op_args->key_info;
@@ -50,7 +51,7 @@ uint32_t prepare_msg_generatekey(void *phdl,
 	cmd->permitted_algo = op_args->permitted_algo;
 #endif
 
-	cmd->out_key_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->out_key_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->out_key,
 						op_args->out_size,
@@ -71,7 +72,7 @@ uint32_t proc_msg_rsp_generatekey(void *rsp_buf, void *args)
 	struct sab_cmd_generate_key_rsp *rsp =
 		(struct sab_cmd_generate_key_rsp *) rsp_buf;
 
-#ifdef CONFIG_PLAT_SECO
+#ifndef PSA_COMPLIANT
 	if ((op_args->flags & HSM_OP_KEY_GENERATION_FLAGS_CREATE)
 			== HSM_OP_KEY_GENERATION_FLAGS_CREATE)
 #endif
@@ -15,6 +15,7 @@
 
 #include "internal/hsm_mac.h"
 #include "sab_mac.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -143,7 +144,7 @@ uint32_t prepare_msg_mac_one_go(void *phdl,
 	}
 #endif
 
-	cmd->payload_address = (uint32_t)plat_os_abs_data_buf(
+	cmd->payload_address = (uint32_t)sab_queue_data_buf(
 						phdl,
 						op_args->payload,
 						op_args->payload_size,
@@ -151,13 +152,13 @@ uint32_t prepare_msg_mac_one_go(void *phdl,
 
 	if ((op_args->flags & HSM_OP_MAC_ONE_GO_FLAGS_MAC_GENERATION)
 			== HSM_OP_MAC_ONE_GO_FLAGS_MAC_GENERATION) {
-		cmd->mac_address = (uint32_t)plat_os_abs_data_buf(
+		cmd->mac_address = (uint32_t)sab_queue_data_buf(
 						phdl,
 						op_args->mac,
 						mac_size_bytes,
 						DATA_BUF_IS_OUTPUT);
 	} else {
-		cmd->mac_address = (uint32_t)plat_os_abs_data_buf(
+		cmd->mac_address = (uint32_t)sab_queue_data_buf(
 						phdl,
 						op_args->mac,
 						mac_size_bytes,
@@ -14,6 +14,7 @@
 #include "internal/hsm_managekey.h"
 
 #include "sab_managekey.h"
+#include "sab_queue.h"
 #include "plat_os_abs.h"
 #include "plat_utils.h"
 
@@ -39,7 +40,7 @@ uint32_t prepare_msg_managekey(void *phdl,
 	cmd->key_type = op_args->key_type;
 	cmd->key_group = op_args->key_group;
 	cmd->key_info = op_args->key_info;
-	cmd->input_data_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->input_data_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->input_data,
 						op_args->input_size,
@@ -90,7 +91,7 @@ uint32_t prepare_msg_managekey_ext(void *phdl,
 	cmd->key_type = op_args->key_type;
 	cmd->key_group = op_args->key_group;
 	cmd->key_info = op_args->key_info;
-	cmd->input_data_addr = (uint32_t)plat_os_abs_data_buf(
+	cmd->input_data_addr = (uint32_t)sab_queue_data_buf(
 						(struct plat_os_abs_hdl *)phdl,
 						op_args->input_data,
 						op_args->input_size,
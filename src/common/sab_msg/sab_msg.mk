@@ -15,6 +15,13 @@ include $(PLAT_PATH)/sab_msg.def
 SAB_MSG_SRC	+= \
 		$(PLAT_COMMON_PATH)/sab_msg/sab_process_msg.o \
 		$(PLAT_COMMON_PATH)/sab_msg/sab_init_proc_msg.o \
+		$(PLAT_COMMON_PATH)/sab_msg/sab_queue.o \
+		$(PLAT_COMMON_PATH)/sab_msg/sab_buf.o \
+
+ifdef PERF_STATS
+SAB_MSG_SRC	+= \
+		$(PLAT_COMMON_PATH)/sab_msg/sab_perf.o
+endif
 
 ifneq (${MT_SAB_SIGN_GEN},0x0)
 DEFINES		+=	-DMT_SAB_SIGN_GEN=${MT_SAB_SIGN_GEN}
@@ -82,6 +89,12 @@ SAB_MSG_SRC	+= \
 		$(PLAT_COMMON_PATH)/sab_msg/sab_managekey.o
 endif
 
+ifneq (${MT_SAB_BUTTERFLY},0x0)
+DEFINES		+=	-DMT_SAB_BUTTERFLY=${MT_SAB_BUTTERFLY}
+SAB_MSG_SRC	+= \
+		$(PLAT_COMMON_PATH)/sab_msg/sab_butterfly.o
+endif
+
 OBJECTS		+= $(SAB_MSG_SRC)
 
 INCLUDE_PATHS	+= \
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "sab_perf.h"
+
+/*
+ * Counters are updated with relaxed atomic additions: the requests of all
+ * the threads are accounted without lock, a reader may get the counters
+ * of a message partly updated.
+ */
+#define PERF_ADD(var, val)	__atomic_fetch_add(&(var), (val), __ATOMIC_RELAXED)
+
+static hsm_perf_stats_t perf_stats[UINT8_MAX + 1];
+
+/* Bytes of the data buffers of the command being built by the thread. */
+static __thread uint64_t perf_bytes;
+
+/*
+ * Timestamps are read from the CPU counter, at the cost of a few ns where
+ * clock_gettime() takes tens: the generic timer of ARMv8, whose frequency
+ * is known, or the TSC on x86, invariant on the CPUs of the simulator
+ * hosts, measured once against CLOCK_MONOTONIC. Other CPUs use the clock.
+ */
+static double perf_ns_per_tick = 1.0;
+static pthread_once_t perf_once = PTHREAD_ONCE_INIT;
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+static void perf_calibrate(void)
+{
+#if defined(__aarch64__)
+	uint64_t freq;
+
+	__asm__ volatile("mrs %0, cntfrq_el0" : "=r" (freq));
+	if (freq != 0u) {
+		perf_ns_per_tick = 1e9 / (double)freq;
+	}
+#elif defined(__x86_64__)
+	struct timespec wait = { 0, 5000000 };
+	uint64_t ns, ticks;
+
+	ns = clock_ns();
+	ticks = __rdtsc();
+	(void)nanosleep(&wait, NULL);
+	ns = clock_ns() - ns;
+	ticks = __rdtsc() - ticks;
+	if (ticks != 0u) {
+		perf_ns_per_tick = (double)ns / (double)ticks;
+	}
+#endif
+}
+
+uint64_t sab_perf_now(void)
+{
+#if defined(__aarch64__)
+	uint64_t ticks;
+
+	__asm__ volatile("isb; mrs %0, cntvct_el0" : "=r" (ticks) : : "memory");
+
+	return ticks;
+#elif defined(__x86_64__)
+	return __rdtsc();
+#else
+	return clock_ns();
+#endif
+}
+
+uint64_t sab_perf_phase(uint8_t msg_id, hsm_perf_phase_t phase,
+			uint64_t start)
+{
+	hsm_perf_stats_t *s = &perf_stats[msg_id];
+	uint64_t end = sab_perf_now();
+	uint64_t ns;
+	uint32_t bucket;
+
+	(void)pthread_once(&perf_once, perf_calibrate);
+	ns = (uint64_t)((double)(end - start) * perf_ns_per_tick);
+
+	/* Index of the highest bit set, plus one. */
+	bucket = (ns == 0u) ? 0u : 64u - (uint32_t)__builtin_clzll(ns);
+	if (bucket >= HSM_PERF_NB_BUCKETS) {
+		bucket = HSM_PERF_NB_BUCKETS - 1u;
+	}
+
+	(void)PERF_ADD(s->total_ns[phase], ns);
+	(void)PERF_ADD(s->hist[phase][bucket], 1u);
+
+	return end;
+}
+
+void sab_perf_call(uint8_t msg_id)
+{
+	hsm_perf_stats_t *s = &perf_stats[msg_id];
+
+	(void)PERF_ADD(s->calls, 1u);
+	if (perf_bytes != 0u) {
+		(void)PERF_ADD(s->bytes, perf_bytes);
+		perf_bytes = 0u;
+	}
+}
+
+void sab_perf_error(uint8_t msg_id)
+{
+	(void)PERF_ADD(perf_stats[msg_id].errors, 1u);
+}
+
+void sab_perf_data_buf(uint32_t size)
+{
+	perf_bytes += size;
+}
+
+void sab_perf_get(uint8_t msg_id, hsm_perf_stats_t *stats)
+{
+	memcpy(stats, &perf_stats[msg_id], sizeof(*stats));
+}
+
+void sab_perf_reset(void)
+{
+	memset(perf_stats, 0, sizeof(perf_stats));
+}
@@ -16,46 +16,12 @@
 #include <string.h>
 
 #include "sab_process_msg.h"
+#include "sab_queue.h"
+#include "sab_perf.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
 
-static bool init_done;
-
-static uint32_t (*prepare_sab_msg[MAX_MSG_TYPE - 1][SAB_MSG_MAX_ID])
-						(void *phdl, void *cmd_buf,
-						 void *rsp_buf,
-						 uint32_t *cmd_msg_sz,
-						 uint32_t *rsp_msg_sz,
-						 uint32_t msg_hdl,
-						 void *args);
-
-static uint32_t (*process_sab_msg_rsp[MAX_MSG_TYPE - 1][SAB_MSG_MAX_ID])
-						(void *rsp_buf, void *args);
-
-
-
-
-sab_msg_init_info_t add_sab_msg_handler(uint32_t msg_id, msg_type_t msg_type,
-			     uint32_t (*prep_sab_msg_handler)(void *phdl,
-							      void *cmd_buf,
-							      void *rsp_buf,
-							      uint32_t *cmd_msg_sz,
-							      uint32_t *rsp_msg_sz,
-							      uint32_t msg_hdl,
-							      void *args),
-			     uint32_t (*proc_sab_msg_rsp_handler)(void *rsp_buf,
-								  void *args))
-{
-	if (prepare_sab_msg[msg_type - 1][msg_id] != NULL)
-		return ALREADY_DONE;
-
-	prepare_sab_msg[msg_type - 1][msg_id] = prep_sab_msg_handler;
-	process_sab_msg_rsp[msg_type - 1][msg_id] = proc_sab_msg_rsp_handler;
-
-	return DONE;
-}
-
 static void hexdump(uint32_t buf[], uint32_t size)
 {
 	int i = 0;
@@ -67,69 +33,86 @@ static void hexdump(uint32_t buf[], uint32_t size)
 	}
 }
 
-uint32_t process_sab_msg(struct plat_os_abs_hdl *phdl,
-			 uint32_t mu_type,
-			 uint8_t msg_id,
-			 msg_type_t msg_type,
-			 uint32_t msg_hdl,
-			 void *args,
-			 uint32_t *rsp_code)
+uint32_t prepare_sab_msg_cmd(struct plat_os_abs_hdl *phdl,
+			     uint32_t mu_type,
+			     uint8_t msg_id,
+			     msg_type_t msg_type,
+			     uint32_t msg_hdl,
+			     void *args,
+			     uint32_t *cmd,
+			     uint32_t *rsp,
+			     uint32_t *cmd_msg_sz,
+			     uint32_t *rsp_msg_sz)
 {
+	const struct sab_msg_handler *handler;
 	int32_t error = 1;
-	int msg_type_id;
-	uint32_t cmd_msg_sz = 0;
-	uint32_t rsp_msg_sz = 0;
 	bool crc_added = false;
-	uint32_t cmd[MAX_CMD_SZ];
-	uint32_t rsp[MAX_CMD_RSP_SZ];
-
-	if (init_done == false) {
-		for (msg_type_id = ROM_MSG; msg_type_id < MAX_MSG_TYPE;
-				msg_type_id++) {
-			init_proc_sab_msg_engine(msg_type_id);
-		}
-		init_done = true;
-	}
+	uint64_t start = sab_perf_now();
 
-	memset(cmd, 0x0, MAX_CMD_SZ);
-	memset(rsp, 0x0, MAX_CMD_RSP_SZ);
+	*cmd_msg_sz = 0;
+	*rsp_msg_sz = 0;
 
-	if (msg_type <= NOT_SUPPORTED && msg_type >= MAX_MSG_TYPE) {
+	if ((msg_type <= NOT_SUPPORTED) || (msg_type >= MAX_MSG_TYPE)) {
 		error = SAB_INVALID_MESSAGE_RATING;
+		sab_perf_error(msg_id);
 		goto out;
 	}
 
 	if (msg_id > SAB_MSG_MAX_ID) {
 		error = SAB_NO_MESSAGE_RATING;
+		sab_perf_error(msg_id);
 		goto out;
 	}
 
-	error = prepare_sab_msg[msg_type - 1][msg_id](phdl, &cmd, &rsp, &cmd_msg_sz,
-					&rsp_msg_sz, msg_hdl, args);
+	handler = &sab_msg_handlers[msg_type - 1][msg_id];
+	if (handler->prepare == NULL) {
+		printf("Error: CMD [0x%x] not supported.\n", msg_id);
+		error = SAB_CMD_NOT_SUPPORTED_RATING;
+		sab_perf_error(msg_id);
+		goto out;
+	}
+
+	/* Only the bytes of this message are sent or read. */
+	memset(cmd, 0x0, handler->cmd_sz);
+	memset(rsp, 0x0, handler->rsp_sz);
+	*cmd_msg_sz = handler->cmd_sz;
+	*rsp_msg_sz = handler->rsp_sz;
+
+	error = handler->prepare(phdl, cmd, rsp, cmd_msg_sz, rsp_msg_sz,
+				 msg_hdl, args);
 
 	if ((error & SAB_MSG_CRC_BIT) == SAB_MSG_CRC_BIT) {
 		crc_added = true;
 	}
 
 	plat_build_cmd_msg_hdr((struct sab_mu_hdr *)cmd, msg_type,
-				msg_id, cmd_msg_sz, mu_type);
+				msg_id, *cmd_msg_sz, mu_type);
 
 	if (crc_added == true) {
-		plat_compute_msg_crc(cmd, (cmd_msg_sz - sizeof(uint32_t)));
+		plat_compute_msg_crc(cmd, (*cmd_msg_sz - sizeof(uint32_t)));
 	}
 
 #ifdef DEBUG
 	printf("\n---------- MSG Command with msg id[0x%x] = %d -------------\n", msg_id, msg_id);
-	hexdump(cmd, cmd_msg_sz);
+	hexdump(cmd, *cmd_msg_sz);
 	printf("\n-------------------MSG END-----------------------------------\n");
 #endif
+	sab_perf_call(msg_id);
+	(void)sab_perf_phase(msg_id, HSM_PERF_PHASE_PREPARE, start);
+	error = 0;
+out:
+	return error;
+}
 
-	/* Send the message to platform. */
-	error = plat_send_msg_and_get_resp(phdl,
-		cmd, cmd_msg_sz, rsp, rsp_msg_sz);
-	if (error) {
-		goto out;
-	}
+uint32_t process_sab_msg_resp(uint8_t msg_id,
+			      msg_type_t msg_type,
+			      void *args,
+			      uint32_t *rsp,
+			      uint32_t rsp_msg_sz,
+			      uint32_t *rsp_code)
+{
+	uint32_t error = 0;
+	uint64_t start = sab_perf_now();
 
 #ifdef DEBUG
 	printf("\n--------MSG Command response with msg id[0x%x] = %d ---------\n", msg_id, msg_id);
@@ -140,11 +123,56 @@ uint32_t process_sab_msg(struct plat_os_abs_hdl *phdl,
 	*rsp_code = (*(rsp + 1));
 
 	if (SAB_STATUS_SUCCESS(msg_type) == *rsp_code) {
-		error = process_sab_msg_rsp[msg_type - 1][msg_id](&rsp, args);
+		error = sab_msg_handlers[msg_type - 1][msg_id].process_rsp(rsp,
+									   args);
 	} else {
 		printf("ERROR received SAB MSG CMD [0x%x] response[=0x%x]\n",
 						msg_id, *rsp_code);
+		sab_perf_error(msg_id);
 	}
+	(void)sab_perf_phase(msg_id, HSM_PERF_PHASE_POST, start);
+
+	return error;
+}
+
+uint32_t process_sab_msg(struct plat_os_abs_hdl *phdl,
+			 uint32_t mu_type,
+			 uint8_t msg_id,
+			 msg_type_t msg_type,
+			 uint32_t msg_hdl,
+			 void *args,
+			 uint32_t *rsp_code)
+{
+	int32_t error = 1;
+	uint32_t cmd_msg_sz = 0;
+	uint32_t rsp_msg_sz = 0;
+	/*
+	 * Synchronous messages live on the stack of the caller: several
+	 * threads can send on the same session, a slot kept in the session
+	 * would have to be reserved under a lock. The queue only needs the
+	 * response buffer until the caller is woken up.
+	 */
+	struct sab_msg_slot msg;
+
+	error = prepare_sab_msg_cmd(phdl, mu_type, msg_id, msg_type, msg_hdl,
+				    args, msg.cmd, msg.rsp, &cmd_msg_sz,
+				    &rsp_msg_sz);
+	if (error) {
+		sab_queue_cancel(phdl);
+		goto out;
+	}
+
+	/* Send the message to platform, after the other requests queued on
+	 * the session by other threads.
+	 */
+	error = sab_queue_send_msg_and_get_resp(phdl,
+		msg.cmd, cmd_msg_sz, msg.rsp, rsp_msg_sz);
+	if (error) {
+		goto out;
+	}
+
+	error = process_sab_msg_resp(msg_id, msg_type, args, msg.rsp,
+				     rsp_msg_sz, rsp_code);
 out:
 	return error;
 }
@@ -0,0 +1,1040 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#include "sab_queue.h"
+#include "sab_buf.h"
+#include "sab_process_msg.h"
+#include "sab_perf.h"
+
+#include "plat_os_abs.h"
+#include "plat_utils.h"
+
+typedef enum {
+	SLOT_FREE,
+	SLOT_RESERVED,
+	SLOT_IN_FLIGHT,
+	SLOT_DONE,
+} sab_queue_slot_state_t;
+
+struct sab_queue_slot;
+
+/* A command written on the MU and waiting for its response. */
+struct sab_queue_req {
+	struct sab_queue_req *next;
+	uint32_t *rsp;
+	uint32_t rsp_len;
+	int32_t rsp_read;
+	bool done;
+	/* Message ID and time of the write, for the statistics. */
+	uint8_t msg_id;
+	uint64_t sent;
+	/* Time of the write, when the load of the queue is tracked. */
+	uint64_t queued;
+	/* NULL for the synchronous requests. */
+	struct sab_queue_slot *slot;
+	/* Wait condition of the thread waiting for the response, if any. */
+	pthread_cond_t *wake;
+};
+
+struct sab_queue_slot {
+	struct sab_msg_slot msg;
+	struct sab_queue_req req;
+	uint32_t cmd_msg_sz;
+	uint32_t rsp_msg_sz;
+	uint8_t msg_id;
+	msg_type_t msg_type;
+	void *args;
+	uint32_t ticket;
+	sab_queue_slot_state_t state;
+	uint32_t error;
+	uint32_t rsp_code;
+	sab_queue_cb_t callback;
+	void *cb_arg;
+};
+
+/* Command of a batch, written on the MU and waiting for its response. */
+struct sab_queue_batch_slot {
+	struct sab_msg_slot msg;
+	struct sab_queue_req req;
+	uint32_t cmd_msg_sz;
+	uint32_t rsp_msg_sz;
+	bool sent;
+	/* Next slot of the free list or of the ring of a batch. */
+	struct sab_queue_batch_slot *next;
+};
+
+struct sab_queue {
+	struct sab_queue *next;
+	struct plat_os_abs_hdl *phdl;
+	/*
+	 * One reference for the list, one per thread using the queue and one
+	 * per MU credit reserved: the queue is freed by the last one dropped.
+	 */
+	uint32_t refs;
+	/* Protects all the fields below. */
+	pthread_mutex_t lock;
+	/* Signaled once per MU credit given back. */
+	pthread_cond_t credit;
+	/* Responses read, slots and completion thread state. */
+	pthread_cond_t cond;
+	/* Keeps the queue order identical to the order of the MU writes. */
+	pthread_mutex_t send_lock;
+	struct sab_queue_req *head;
+	struct sab_queue_req *tail;
+	uint32_t in_flight;
+	uint32_t max_in_flight;
+	bool reader_busy;
+	/* Asynchronous mode. */
+	bool async;
+	bool stop;
+	pthread_t thread;
+	int32_t event_fd;
+	uint32_t next_ticket;
+	/* Slots reserved and not yet completed. */
+	uint32_t nb_pending;
+	struct sab_queue_slot *slots;
+	/* Slots of the batches, kept for the next ones. */
+	struct sab_queue_batch_slot *batch_free;
+	/* Load tracking, see sab_queue_track_load(). */
+	bool track;
+	uint64_t last_done;
+	uint64_t service_ns;
+};
+
+static pthread_rwlock_t queue_list_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct sab_queue *queue_list;
+
+/*
+ * Queue on which the current thread holds a MU credit for the command it is
+ * building. The data buffers of a command are set up in the driver context
+ * of the channel, so a command is only built once it can be written.
+ */
+static __thread struct sab_queue *reserved_q;
+
+/*
+ * Condition on which the current thread waits for its responses: the
+ * reader only wakes the owner of the response read and the owner of the
+ * next one, which becomes the reader.
+ */
+static __thread pthread_cond_t wait_cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t queue_now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* Find the queue of a channel and take a reference on it. */
+static struct sab_queue *get_queue(struct plat_os_abs_hdl *phdl)
+{
+	struct sab_queue *q;
+
+	pthread_rwlock_rdlock(&queue_list_lock);
+	for (q = queue_list; q != NULL; q = q->next) {
+		if (q->phdl == phdl) {
+			(void)__atomic_fetch_add(&q->refs, 1u, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&queue_list_lock);
+
+	return q;
+}
+
+static void queue_free(struct sab_queue *q);
+
+static void put_queue(struct sab_queue *q)
+{
+	if ((q != NULL)
+		&& (__atomic_sub_fetch(&q->refs, 1u, __ATOMIC_ACQ_REL) == 0u)) {
+		queue_free(q);
+	}
+}
+
+/*
+ * Read the response of the request at the head of the queue.
+ * Called with the lock held, released during the read.
+ */
+static struct sab_queue_req *read_head(struct sab_queue *q)
+{
+	struct sab_queue_req *req = q->head;
+	uint64_t now, start;
+	int32_t len;
+
+	q->reader_busy = true;
+	pthread_mutex_unlock(&q->lock);
+
+	len = plat_os_abs_read_mu_message(q->phdl, req->rsp, req->rsp_len);
+	(void)sab_perf_phase(req->msg_id, HSM_PERF_PHASE_WAIT, req->sent);
+	if (len <= 0) {
+		sab_perf_error(req->msg_id);
+	}
+
+	pthread_mutex_lock(&q->lock);
+	if (q->track && (len > 0)) {
+		/*
+		 * The enclave served the command from its write or from the
+		 * previous response, whichever is the latest.
+		 */
+		now = queue_now_ns();
+		start = (req->queued > q->last_done) ? req->queued
+						      : q->last_done;
+		q->service_ns = (q->service_ns == 0u) ? (now - start)
+			: (((7u * q->service_ns) + (now - start)) / 8u);
+		q->last_done = now;
+	}
+	q->head = req->next;
+	if (q->head == NULL) {
+		q->tail = NULL;
+	}
+	q->in_flight--;
+	q->reader_busy = false;
+	req->rsp_read = len;
+	req->done = true;
+	if (req->wake != NULL) {
+		pthread_cond_signal(req->wake);
+	}
+	if ((q->head != NULL) && (q->head->wake != NULL)) {
+		pthread_cond_signal(q->head->wake);
+	}
+	pthread_cond_signal(&q->credit);
+	pthread_cond_broadcast(&q->cond);
+
+	return req;
+}
+
+/* Give back the credit of a command built and finally not sent. */
+static void drop_reservation(void)
+{
+	struct sab_queue *q = reserved_q;
+
+	if (q == NULL) {
+		return;
+	}
+	reserved_q = NULL;
+
+	/* The reservation holds a reference: the queue is still there. */
+	pthread_mutex_lock(&q->lock);
+	q->in_flight--;
+	pthread_cond_signal(&q->credit);
+	pthread_mutex_unlock(&q->lock);
+	put_queue(q);
+}
+
+/*
+ * Wait for a MU credit, unless the thread already holds it. The waiters
+ * sleep on their own condition, woken one per credit given back, so that
+ * a response does not wake all the threads sharing the channel.
+ */
+static void queue_reserve(struct sab_queue *q)
+{
+	if (reserved_q == q) {
+		return;
+	}
+	drop_reservation();
+
+	pthread_mutex_lock(&q->lock);
+	while (q->in_flight >= q->max_in_flight) {
+		if ((q->async == false) && (q->reader_busy == false)
+				&& (q->head != NULL)) {
+			/* Make room by reading a response for its owner. */
+			(void)read_head(q);
+		} else {
+			pthread_cond_wait(&q->credit, &q->lock);
+		}
+	}
+	q->in_flight++;
+	pthread_mutex_unlock(&q->lock);
+	(void)__atomic_fetch_add(&q->refs, 1u, __ATOMIC_RELAXED);
+	reserved_q = q;
+}
+
+/* Write a command on the MU and queue its request. Return 0 on success. */
+static int32_t queue_send(struct sab_queue *q, struct sab_queue_req *req,
+			  uint32_t *cmd, uint32_t cmd_len)
+{
+	int32_t len;
+
+	req->next = NULL;
+	req->rsp_read = 0;
+	req->done = false;
+	req->queued = 0u;
+	/* The responses of the asynchronous requests go to the thread. */
+	req->wake = (req->slot == NULL) ? &wait_cond : NULL;
+	req->msg_id = ((struct sab_mu_hdr *)cmd)->command;
+	req->sent = sab_perf_now();
+
+	/* The credit goes with the command, the caller holds the queue. */
+	queue_reserve(q);
+	reserved_q = NULL;
+	put_queue(q);
+
+	pthread_mutex_lock(&q->send_lock);
+	len = plat_os_abs_send_mu_message(q->phdl, cmd, cmd_len);
+	pthread_mutex_lock(&q->lock);
+	if (len == (int32_t)cmd_len) {
+		if (q->tail != NULL) {
+			q->tail->next = req;
+		} else {
+			q->head = req;
+		}
+		q->tail = req;
+		if (req->slot != NULL) {
+			req->slot->state = SLOT_IN_FLIGHT;
+		}
+		if (q->track) {
+			req->queued = queue_now_ns();
+		}
+	} else {
+		q->in_flight--;
+		pthread_cond_signal(&q->credit);
+		sab_perf_error(req->msg_id);
+	}
+	req->sent = sab_perf_phase(req->msg_id, HSM_PERF_PHASE_SEND,
+				   req->sent);
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+	pthread_mutex_unlock(&q->send_lock);
+
+	return (len == (int32_t)cmd_len) ? 0 : -1;
+}
+
+/* Wait for the response of a request sent by the calling thread. */
+static void queue_wait_done(struct sab_queue *q, struct sab_queue_req *req)
+{
+	/* Without completion thread, the first waiter reads the responses. */
+	pthread_mutex_lock(&q->lock);
+	while (req->done == false) {
+		if ((q->async == false) && (q->reader_busy == false)) {
+			(void)read_head(q);
+		} else {
+			pthread_cond_wait(req->wake, &q->lock);
+		}
+	}
+	pthread_mutex_unlock(&q->lock);
+}
+
+int32_t sab_queue_send_msg_and_get_resp(struct plat_os_abs_hdl *phdl,
+					uint32_t *cmd, uint32_t cmd_len,
+					uint32_t *rsp, uint32_t rsp_len)
+{
+	struct sab_queue *q;
+	struct sab_queue_req req;
+	uint64_t start;
+	int32_t error;
+
+	q = get_queue(phdl);
+	if (q == NULL) {
+		/* Write and read in one call: all accounted as wait. */
+		start = sab_perf_now();
+		error = plat_send_msg_and_get_resp(phdl, cmd, cmd_len,
+						   rsp, rsp_len);
+		(void)sab_perf_phase(((struct sab_mu_hdr *)cmd)->command,
+				     HSM_PERF_PHASE_WAIT, start);
+		if (error != 0) {
+			sab_perf_error(((struct sab_mu_hdr *)cmd)->command);
+		}
+		return error;
+	}
+
+	error = -1;
+	do {
+		/* Command and response need to be at least 1 word for the header. */
+		if ((cmd_len < (uint32_t)sizeof(uint32_t))
+			|| (rsp_len < (uint32_t)sizeof(uint32_t))) {
+			break;
+		}
+
+		req.rsp = rsp;
+		req.rsp_len = rsp_len;
+		req.slot = NULL;
+		if (queue_send(q, &req, cmd, cmd_len) != 0) {
+			break;
+		}
+
+		queue_wait_done(q, &req);
+		if (req.rsp_read > 0) {
+			error = 0;
+		}
+	} while (false);
+	put_queue(q);
+
+	return error;
+}
+
+uint64_t sab_queue_data_buf(struct plat_os_abs_hdl *phdl, uint8_t *src,
+			    uint32_t size, uint32_t flags)
+{
+	struct sab_queue *q;
+	uint64_t addr;
+
+	/* Buffers of the pool are already reachable: nothing to set up. */
+	if (sab_buf_addr(phdl, src, size, &addr) == 0u) {
+		return addr;
+	}
+
+	q = get_queue(phdl);
+	if (q != NULL) {
+		queue_reserve(q);
+		put_queue(q);
+	}
+	sab_perf_data_buf(size);
+
+	return plat_os_abs_data_buf(phdl, src, size, flags);
+}
+
+void sab_queue_cancel(struct plat_os_abs_hdl *phdl)
+{
+	if ((reserved_q != NULL) && (reserved_q->phdl == phdl)) {
+		drop_reservation();
+	}
+}
+
+static void release_slot(struct sab_queue *q, struct sab_queue_slot *slot)
+{
+	slot->state = SLOT_FREE;
+	slot->ticket = SAB_QUEUE_TICKET_NONE;
+	slot->args = NULL;
+	slot->callback = NULL;
+	pthread_cond_broadcast(&q->cond);
+}
+
+/* Called with the lock held, released during the processing. */
+static void complete_slot(struct sab_queue *q, struct sab_queue_slot *slot)
+{
+	uint64_t one = 1u;
+
+	pthread_mutex_unlock(&q->lock);
+	if (slot->req.rsp_read <= 0) {
+		slot->error = 1u;
+		slot->rsp_code = SAB_NO_MESSAGE_RATING;
+	} else {
+		slot->error = process_sab_msg_resp(slot->msg_id,
+						   slot->msg_type,
+						   slot->args,
+						   slot->msg.rsp,
+						   slot->rsp_msg_sz,
+						   &slot->rsp_code);
+	}
+	pthread_mutex_lock(&q->lock);
+	slot->state = SLOT_DONE;
+
+	if (slot->callback != NULL) {
+		pthread_mutex_unlock(&q->lock);
+		slot->callback(slot->ticket, slot->error,
+			       slot->rsp_code, slot->cb_arg);
+		pthread_mutex_lock(&q->lock);
+		release_slot(q, slot);
+	} else {
+		pthread_cond_broadcast(&q->cond);
+	}
+	q->nb_pending--;
+
+	if (q->event_fd >= 0) {
+		(void)write(q->event_fd, &one, sizeof(one));
+	}
+}
+
+static void *sab_queue_completion_thread(void *arg)
+{
+	struct sab_queue *q = (struct sab_queue *)arg;
+	struct sab_queue_req *req;
+
+	pthread_mutex_lock(&q->lock);
+	for (;;) {
+		if ((q->head != NULL) && (q->reader_busy == false)) {
+			req = read_head(q);
+			if (req->slot != NULL) {
+				complete_slot(q, req->slot);
+			}
+		} else if ((q->head == NULL) && (q->stop == true)
+				&& (q->nb_pending == 0u)) {
+			break;
+		} else {
+			pthread_cond_wait(&q->cond, &q->lock);
+		}
+	}
+	/* Waiters of synchronous requests read their responses again. */
+	q->async = false;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+
+	return NULL;
+}
+
+uint32_t sab_queue_open(struct plat_os_abs_hdl *phdl)
+{
+	struct sab_queue *q;
+
+	if (phdl == NULL) {
+		return 1u;
+	}
+	q = get_queue(phdl);
+	if (q != NULL) {
+		put_queue(q);
+		return 1u;
+	}
+
+	q = calloc(1u, sizeof(struct sab_queue));
+	if (q == NULL) {
+		return 1u;
+	}
+
+	q->phdl = phdl;
+	q->max_in_flight = plat_os_abs_mu_max_in_flight(phdl);
+	if (q->max_in_flight == 0u) {
+		q->max_in_flight = 1u;
+	}
+	q->refs = 1u;
+	q->event_fd = -1;
+	q->next_ticket = 1u;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_mutex_init(&q->send_lock, NULL);
+	pthread_cond_init(&q->credit, NULL);
+	pthread_cond_init(&q->cond, NULL);
+
+	pthread_rwlock_wrlock(&queue_list_lock);
+	q->next = queue_list;
+	queue_list = q;
+	pthread_rwlock_unlock(&queue_list_lock);
+
+	return 0u;
+}
+
+void sab_queue_track_load(struct plat_os_abs_hdl *phdl)
+{
+	struct sab_queue *q = get_queue(phdl);
+
+	if (q != NULL) {
+		pthread_mutex_lock(&q->lock);
+		q->track = true;
+		pthread_mutex_unlock(&q->lock);
+		put_queue(q);
+	}
+}
+
+uint32_t sab_queue_load(struct plat_os_abs_hdl *phdl, uint32_t *in_flight,
+			uint64_t *service_ns)
+{
+	struct sab_queue *q = get_queue(phdl);
+
+	if (q == NULL) {
+		return 1u;
+	}
+	pthread_mutex_lock(&q->lock);
+	*in_flight = q->in_flight;
+	*service_ns = q->service_ns;
+	pthread_mutex_unlock(&q->lock);
+	put_queue(q);
+
+	return 0u;
+}
+
+/* Give back a list of slots to the free list of the queue. */
+static void batch_slots_put(struct sab_queue *q,
+			    struct sab_queue_batch_slot *list)
+{
+	struct sab_queue_batch_slot *last;
+
+	if (list == NULL) {
+		return;
+	}
+	for (last = list; last->next != NULL; last = last->next) {
+	}
+
+	pthread_mutex_lock(&q->lock);
+	last->next = q->batch_free;
+	q->batch_free = list;
+	pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * Take nb slots for a batch, linked in a list, allocating the ones the free
+ * list of the queue is short of. Return NULL if out of memory.
+ */
+static struct sab_queue_batch_slot *batch_slots_get(struct sab_queue *q,
+						    uint32_t nb)
+{
+	struct sab_queue_batch_slot *list = NULL;
+	struct sab_queue_batch_slot *slot;
+	uint32_t i;
+
+	pthread_mutex_lock(&q->lock);
+	for (i = 0u; (i < nb) && (q->batch_free != NULL); i++) {
+		slot = q->batch_free;
+		q->batch_free = slot->next;
+		slot->next = list;
+		list = slot;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	for (; i < nb; i++) {
+		if (posix_memalign((void **)&slot, SAB_MSG_LINE_SZ,
+				   sizeof(struct sab_queue_batch_slot)) != 0) {
+			batch_slots_put(q, list);
+			return NULL;
+		}
+		slot->next = list;
+		list = slot;
+	}
+
+	for (slot = list; slot != NULL; slot = slot->next) {
+		slot->sent = false;
+	}
+
+	return list;
+}
+
+static void batch_slots_free(struct sab_queue_batch_slot *list)
+{
+	struct sab_queue_batch_slot *slot;
+
+	while (list != NULL) {
+		slot = list;
+		list = slot->next;
+		free(slot);
+	}
+}
+
+static void queue_async_stop(struct sab_queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	if ((q->async == false) || (q->stop == true)) {
+		pthread_mutex_unlock(&q->lock);
+		return;
+	}
+	/* The thread exits once all the requests in flight are completed. */
+	q->stop = true;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+
+	pthread_join(q->thread, NULL);
+
+	pthread_mutex_lock(&q->lock);
+	q->stop = false;
+	if (q->event_fd >= 0) {
+		(void)close(q->event_fd);
+		q->event_fd = -1;
+	}
+	pthread_mutex_unlock(&q->lock);
+}
+
+void sab_queue_close(struct plat_os_abs_hdl *phdl)
+{
+	struct sab_queue *q;
+	struct sab_queue **prev;
+
+	pthread_rwlock_wrlock(&queue_list_lock);
+	for (prev = &queue_list; *prev != NULL; prev = &(*prev)->next) {
+		if ((*prev)->phdl == phdl) {
+			break;
+		}
+	}
+	q = *prev;
+	if (q != NULL) {
+		*prev = q->next;
+	}
+	pthread_rwlock_unlock(&queue_list_lock);
+
+	if (q == NULL) {
+		return;
+	}
+
+	/* Threads still using the queue keep it until they are done. */
+	queue_async_stop(q);
+	put_queue(q);
+}
+
+static void queue_free(struct sab_queue *q)
+{
+	pthread_cond_destroy(&q->cond);
+	pthread_cond_destroy(&q->credit);
+	pthread_mutex_destroy(&q->send_lock);
+	pthread_mutex_destroy(&q->lock);
+	free(q->slots);
+	batch_slots_free(q->batch_free);
+	free(q);
+}
+
+uint32_t sab_queue_async_start(struct plat_os_abs_hdl *phdl, int32_t *event_fd)
+{
+	struct sab_queue *q;
+	uint32_t error = 1u;
+	uint32_t i;
+
+	q = get_queue(phdl);
+	if (q == NULL) {
+		return error;
+	}
+
+	pthread_mutex_lock(&q->lock);
+	do {
+		if (q->async == true) {
+			break;
+		}
+
+		if (q->slots == NULL) {
+			if (posix_memalign((void **)&q->slots, SAB_MSG_LINE_SZ,
+					   SAB_QUEUE_MAX_PENDING
+					   * sizeof(struct sab_queue_slot)) != 0) {
+				q->slots = NULL;
+				break;
+			}
+			memset(q->slots, 0, SAB_QUEUE_MAX_PENDING
+					    * sizeof(struct sab_queue_slot));
+		}
+		/* Results not collected before the last stop are lost. */
+		for (i = 0u; i < SAB_QUEUE_MAX_PENDING; i++) {
+			release_slot(q, &q->slots[i]);
+		}
+
+		if (event_fd != NULL) {
+			q->event_fd = eventfd(0u, EFD_CLOEXEC | EFD_NONBLOCK);
+			if (q->event_fd < 0) {
+				break;
+			}
+		}
+
+		if (pthread_create(&q->thread, NULL,
+				   sab_queue_completion_thread, q) != 0) {
+			if (q->event_fd >= 0) {
+				(void)close(q->event_fd);
+				q->event_fd = -1;
+			}
+			break;
+		}
+
+		if (event_fd != NULL) {
+			*event_fd = q->event_fd;
+		}
+		q->async = true;
+		error = 0u;
+	} while (false);
+	pthread_mutex_unlock(&q->lock);
+	put_queue(q);
+
+	return error;
+}
+
+void sab_queue_async_stop(struct plat_os_abs_hdl *phdl)
+{
+	struct sab_queue *q = get_queue(phdl);
+
+	if (q != NULL) {
+		queue_async_stop(q);
+		put_queue(q);
+	}
+}
+
+uint32_t sab_queue_submit(struct plat_os_abs_hdl *phdl,
+			  uint32_t mu_type,
+			  uint8_t msg_id,
+			  msg_type_t msg_type,
+			  uint32_t msg_hdl,
+			  void *args,
+			  sab_queue_cb_t callback,
+			  void *cb_arg,
+			  uint32_t *ticket)
+{
+	struct sab_queue *q;
+	struct sab_queue_slot *slot = NULL;
+	uint32_t error = 1u;
+	uint32_t nb_done;
+	uint32_t i;
+
+	if (ticket == NULL) {
+		return SAB_INVALID_MESSAGE_RATING;
+	}
+	q = get_queue(phdl);
+	if (q == NULL) {
+		return SAB_INVALID_MESSAGE_RATING;
+	}
+
+	/* Reserve a slot, waiting for a completion if they are all in use. */
+	pthread_mutex_lock(&q->lock);
+	while ((q->async == true) && (q->stop == false)) {
+		nb_done = 0u;
+		for (i = 0u; i < SAB_QUEUE_MAX_PENDING; i++) {
+			if (q->slots[i].state == SLOT_FREE) {
+				slot = &q->slots[i];
+				break;
+			}
+			if ((q->slots[i].state == SLOT_DONE)
+					&& (q->slots[i].callback == NULL)) {
+				nb_done++;
+			}
+		}
+		/* Nothing will free a slot until the caller collects a result. */
+		if ((slot != NULL) || (nb_done == SAB_QUEUE_MAX_PENDING)) {
+			break;
+		}
+		pthread_cond_wait(&q->cond, &q->lock);
+	}
+	if (slot == NULL) {
+		error = (q->async == true) ? SAB_NOT_READY_RATING
+					   : SAB_INVALID_MESSAGE_RATING;
+		pthread_mutex_unlock(&q->lock);
+		put_queue(q);
+		return error;
+	}
+	slot->state = SLOT_RESERVED;
+	slot->ticket = q->next_ticket++;
+	if (q->next_ticket == SAB_QUEUE_TICKET_NONE) {
+		q->next_ticket++;
+	}
+	slot->msg_id = msg_id;
+	slot->msg_type = msg_type;
+	slot->args = args;
+	slot->callback = callback;
+	slot->cb_arg = cb_arg;
+	slot->error = 0u;
+	slot->rsp_code = 0u;
+	*ticket = slot->ticket;
+	q->nb_pending++;
+	pthread_mutex_unlock(&q->lock);
+
+	/* Build the command while the enclave works on the previous ones. */
+	do {
+		error = prepare_sab_msg_cmd(phdl, mu_type, msg_id, msg_type,
+					    msg_hdl, args, slot->msg.cmd,
+					    slot->msg.rsp, &slot->cmd_msg_sz,
+					    &slot->rsp_msg_sz);
+		if (error != 0u) {
+			break;
+		}
+
+		/* Command and response need to be at least 1 word for the header. */
+		if ((slot->cmd_msg_sz < (uint32_t)sizeof(uint32_t))
+			|| (slot->rsp_msg_sz < (uint32_t)sizeof(uint32_t))) {
+			error = 1u;
+			break;
+		}
+
+		slot->req.rsp = slot->msg.rsp;
+		slot->req.rsp_len = slot->rsp_msg_sz;
+		slot->req.slot = slot;
+		if (queue_send(q, &slot->req, slot->msg.cmd,
+			       slot->cmd_msg_sz) != 0) {
+			error = 1u;
+		}
+	} while (false);
+
+	if (error != 0u) {
+		sab_queue_cancel(phdl);
+		pthread_mutex_lock(&q->lock);
+		release_slot(q, slot);
+		q->nb_pending--;
+		pthread_mutex_unlock(&q->lock);
+		*ticket = SAB_QUEUE_TICKET_NONE;
+	}
+	put_queue(q);
+
+	return error;
+}
+
+uint32_t sab_queue_wait(struct plat_os_abs_hdl *phdl,
+			uint32_t ticket,
+			bool block,
+			uint32_t *error,
+			uint32_t *rsp_code)
+{
+	struct sab_queue *q;
+	struct sab_queue_slot *slot = NULL;
+	uint32_t ret = 0u;
+	uint32_t i;
+
+	if (ticket == SAB_QUEUE_TICKET_NONE) {
+		return SAB_INVALID_MESSAGE_RATING;
+	}
+	q = get_queue(phdl);
+	if (q == NULL) {
+		return SAB_INVALID_MESSAGE_RATING;
+	}
+
+	pthread_mutex_lock(&q->lock);
+	for (i = 0u; (q->slots != NULL) && (i < SAB_QUEUE_MAX_PENDING); i++) {
+		if ((q->slots[i].ticket == ticket)
+				&& (q->slots[i].state != SLOT_FREE)
+				&& (q->slots[i].callback == NULL)) {
+			slot = &q->slots[i];
+			break;
+		}
+	}
+
+	if (slot == NULL) {
+		ret = SAB_INVALID_MESSAGE_RATING;
+	} else {
+		while ((slot->state != SLOT_DONE) && (block == true)) {
+			pthread_cond_wait(&q->cond, &q->lock);
+		}
+		if (slot->state == SLOT_DONE) {
+			if (error != NULL) {
+				*error = slot->error;
+			}
+			if (rsp_code != NULL) {
+				*rsp_code = slot->rsp_code;
+			}
+			release_slot(q, slot);
+		} else {
+			ret = SAB_NOT_READY_RATING;
+		}
+	}
+	pthread_mutex_unlock(&q->lock);
+	put_queue(q);
+
+	return ret;
+}
+
+static void batch_complete(struct sab_queue *q,
+			   struct sab_queue_batch_slot *slot,
+			   uint8_t msg_id,
+			   msg_type_t msg_type,
+			   void *args,
+			   uint32_t idx,
+			   sab_queue_cb_t callback,
+			   void *cb_arg)
+{
+	uint32_t error = 1u;
+	uint32_t rsp_code = SAB_NO_MESSAGE_RATING;
+
+	if (slot->sent == false) {
+		return;
+	}
+	slot->sent = false;
+
+	queue_wait_done(q, &slot->req);
+	if (slot->req.rsp_read > 0) {
+		error = process_sab_msg_resp(msg_id, msg_type, args,
+					     slot->msg.rsp, slot->rsp_msg_sz,
+					     &rsp_code);
+	}
+	callback(idx, error, rsp_code, cb_arg);
+}
+
+uint32_t sab_queue_send_batch(struct plat_os_abs_hdl *phdl,
+			      uint32_t mu_type,
+			      uint8_t msg_id,
+			      msg_type_t msg_type,
+			      uint32_t msg_hdl,
+			      void *args,
+			      uint32_t args_sz,
+			      uint32_t nb,
+			      sab_queue_cb_t callback,
+			      void *cb_arg)
+{
+	struct sab_queue *q;
+	struct sab_queue_batch_slot *slots, *last, *slot;
+	uint8_t *op_args = (uint8_t *)args;
+	uint32_t nb_slots;
+	uint32_t error, rsp_code;
+	uint32_t i;
+
+	if ((args == NULL) || (callback == NULL)) {
+		return SAB_INVALID_MESSAGE_RATING;
+	}
+
+	if (nb == 0u) {
+		return 0u;
+	}
+
+	q = get_queue(phdl);
+	if (q == NULL) {
+		/* No pipelining on this channel. */
+		for (i = 0u; i < nb; i++) {
+			rsp_code = SAB_NO_MESSAGE_RATING;
+			error = process_sab_msg(phdl, mu_type, msg_id, msg_type,
+						msg_hdl, op_args + (i * args_sz),
+						&rsp_code);
+			callback(i, error, rsp_code, cb_arg);
+		}
+		return 0u;
+	}
+
+	/* One slot per command the MU can hold: all of them are built ahead. */
+	nb_slots = q->max_in_flight;
+	if (nb_slots > nb) {
+		nb_slots = nb;
+	}
+	slots = batch_slots_get(q, nb_slots);
+	if (slots == NULL) {
+		put_queue(q);
+		return SAB_OUT_OF_MEMORY_RATING;
+	}
+
+	/* The slots are used round robin: close their list in a ring. */
+	for (last = slots; last->next != NULL; last = last->next) {
+	}
+	last->next = slots;
+
+	slot = last;
+	for (i = 0u; i < nb; i++) {
+		slot = slot->next;
+		if (i >= nb_slots) {
+			/* Responses come back in order, the oldest one first. */
+			batch_complete(q, slot, msg_id, msg_type,
+				       op_args + ((i - nb_slots) * args_sz),
+				       i - nb_slots, callback, cb_arg);
+		}
+
+		error = prepare_sab_msg_cmd(phdl, mu_type, msg_id, msg_type,
+					    msg_hdl, op_args + (i * args_sz),
+					    slot->msg.cmd, slot->msg.rsp,
+					    &slot->cmd_msg_sz,
+					    &slot->rsp_msg_sz);
+		if ((error == 0u)
+			&& ((slot->cmd_msg_sz < (uint32_t)sizeof(uint32_t))
+			|| (slot->rsp_msg_sz < (uint32_t)sizeof(uint32_t)))) {
+			error = 1u;
+		}
+		if (error == 0u) {
+			slot->req.rsp = slot->msg.rsp;
+			slot->req.rsp_len = slot->rsp_msg_sz;
+			slot->req.slot = NULL;
+			if (queue_send(q, &slot->req, slot->msg.cmd,
+				       slot->cmd_msg_sz) != 0) {
+				error = 1u;
+			}
+		} else {
+			sab_queue_cancel(phdl);
+		}
+
+		if (error == 0u) {
+			slot->sent = true;
+		} else {
+			callback(i, error, SAB_NO_MESSAGE_RATING, cb_arg);
+		}
+	}
+
+	/* The oldest command left follows the last one sent. */
+	for (i = (nb > nb_slots) ? (nb - nb_slots) : 0u; i < nb; i++) {
+		slot = slot->next;
+		batch_complete(q, slot, msg_id, msg_type,
+			       op_args + (i * args_sz), i, callback, cb_arg);
+	}
+
+	last->next = NULL;
+	batch_slots_put(q, slots);
+	put_queue(q);
+
+	return 0u;
+}
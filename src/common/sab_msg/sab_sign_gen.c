@@ -13,6 +13,7 @@
 
 #include "internal/hsm_sign_gen.h"
 #include "sab_sign_gen.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -104,11 +105,11 @@ uint32_t prepare_msg_sign_generate(void *phdl,
 
 	cmd->sig_gen_hdl = msg_hdl;
 	cmd->key_identifier = op_args->key_identifier;
-	cmd->message_addr = (uint32_t)plat_os_abs_data_buf(phdl,
+	cmd->message_addr = (uint32_t)sab_queue_data_buf(phdl,
 							op_args->message,
 							op_args->message_size,
 							DATA_BUF_IS_INPUT);
-	cmd->signature_addr = (uint32_t)plat_os_abs_data_buf(phdl,
+	cmd->signature_addr = (uint32_t)sab_queue_data_buf(phdl,
 							op_args->signature,
 							op_args->signature_size,
 							0u);
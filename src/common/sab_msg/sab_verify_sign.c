@@ -15,6 +15,7 @@
 
 #include "internal/hsm_verify_sign.h"
 #include "sab_verify_sign.h"
+#include "sab_queue.h"
 
 #include "plat_os_abs.h"
 #include "plat_utils.h"
@@ -101,18 +102,35 @@ uint32_t prepare_msg_verify_sign(void *phdl,
 	op_verify_sign_args_t *op_args = (op_verify_sign_args_t *)args;
 
 	cmd->sig_ver_hdl = msg_hdl;
-	cmd->key_addr = (uint32_t)plat_os_abs_data_buf(phdl,
-			op_args->key,
-			op_args->key_size,
-			DATA_BUF_IS_INPUT);
-	cmd->msg_addr = (uint32_t)plat_os_abs_data_buf(phdl,
-			op_args->message,
-			op_args->message_size,
-			DATA_BUF_IS_INPUT);
-	cmd->sig_addr = (uint32_t)plat_os_abs_data_buf(phdl,
-			op_args->signature,
-			op_args->signature_size,
-			DATA_BUF_IS_INPUT);
+	if ((op_args->flags & SAB_VERIFY_SIGN_FLAGS_PACKED) != 0u) {
+		/* Batch, inputs packed in one region: a single buffer to set up. */
+		cmd->key_addr = (uint32_t)sab_queue_data_buf(phdl,
+				op_args->key,
+				(uint32_t)(op_args->signature - op_args->key)
+					+ op_args->signature_size,
+				DATA_BUF_IS_INPUT);
+		cmd->msg_addr = 0u;
+		cmd->sig_addr = 0u;
+		if (cmd->key_addr != 0u) {
+			cmd->msg_addr = cmd->key_addr +
+				SAB_VERIFY_SIGN_IN_SZ(op_args->key_size);
+			cmd->sig_addr = cmd->msg_addr +
+				SAB_VERIFY_SIGN_IN_SZ(op_args->message_size);
+		}
+	} else {
+		cmd->key_addr = (uint32_t)sab_queue_data_buf(phdl,
+				op_args->key,
+				op_args->key_size,
+				DATA_BUF_IS_INPUT);
+		cmd->msg_addr = (uint32_t)sab_queue_data_buf(phdl,
+				op_args->message,
+				op_args->message_size,
+				DATA_BUF_IS_INPUT);
+		cmd->sig_addr = (uint32_t)sab_queue_data_buf(phdl,
+				op_args->signature,
+				op_args->signature_size,
+				DATA_BUF_IS_INPUT);
+	}
 	cmd->key_size = op_args->key_size;
 	cmd->sig_size = op_args->signature_size;
 	cmd->message_size = op_args->message_size;
@@ -121,7 +139,7 @@ uint32_t prepare_msg_verify_sign(void *phdl,
 	cmd->key_security_size = op_args->key_sz;
 	cmd->key_type = op_args->psa_key_type;
 #endif
-	cmd->flags = op_args->flags;
+	cmd->flags = op_args->flags & ~SAB_VERIFY_SIGN_FLAGS_PACKED;
 	memset(cmd->reserved, 0, SAB_CMD_VERIFY_SIGN_RESERVED);
 	cmd->crc = 0u;
 
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sha2.h"
+
+/*
+ * SHA-2 on the host, for the hashes the enclave cannot do in one message.
+ * Not used with any secret: no care is taken about side channels.
+ */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+    0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+    0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+    0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+    0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+    0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+    0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+    0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u,
+};
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+static const uint32_t sha224_iv[8] = {
+    0xc1059ed8u, 0x367cd507u, 0x3070dd17u, 0xf70e5939u, 0xffc00b31u, 0x68581511u, 0x64f98fa7u, 0xbefa4fa4u,
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u,
+};
+
+static const uint64_t sha384_iv[8] = {
+    0xcbbb9d5dc1059ed8ull, 0x629a292a367cd507ull, 0x9159015a3070dd17ull, 0x152fecd8f70e5939ull,
+    0x67332667ffc00b31ull, 0x8eb44a8768581511ull, 0xdb0c2e0d64f98fa7ull, 0x47b5481dbefa4fa4ull,
+};
+
+static const uint64_t sha512_iv[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+    0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32u - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64u - (n))))
+
+static void sha256_block(uint64_t *state, const uint8_t *blk)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    uint32_t i;
+
+    for (i = 0u; i < 16u; i++) {
+        w[i] = ((uint32_t)blk[4u*i] << 24) | ((uint32_t)blk[4u*i + 1u] << 16)
+            | ((uint32_t)blk[4u*i + 2u] << 8) | (uint32_t)blk[4u*i + 3u];
+    }
+    for (i = 16u; i < 64u; i++) {
+        w[i] = (ROR32(w[i - 2u], 17u) ^ ROR32(w[i - 2u], 19u) ^ (w[i - 2u] >> 10))
+            + w[i - 7u]
+            + (ROR32(w[i - 15u], 7u) ^ ROR32(w[i - 15u], 18u) ^ (w[i - 15u] >> 3))
+            + w[i - 16u];
+    }
+
+    a = (uint32_t)state[0]; b = (uint32_t)state[1];
+    c = (uint32_t)state[2]; d = (uint32_t)state[3];
+    e = (uint32_t)state[4]; f = (uint32_t)state[5];
+    g = (uint32_t)state[6]; h = (uint32_t)state[7];
+
+    for (i = 0u; i < 64u; i++) {
+        t1 = h + (ROR32(e, 6u) ^ ROR32(e, 11u) ^ ROR32(e, 25u)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (ROR32(a, 2u) ^ ROR32(a, 13u) ^ ROR32(a, 22u)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] = (uint32_t)(state[0] + a); state[1] = (uint32_t)(state[1] + b);
+    state[2] = (uint32_t)(state[2] + c); state[3] = (uint32_t)(state[3] + d);
+    state[4] = (uint32_t)(state[4] + e); state[5] = (uint32_t)(state[5] + f);
+    state[6] = (uint32_t)(state[6] + g); state[7] = (uint32_t)(state[7] + h);
+}
+
+static void sha512_block(uint64_t *state, const uint8_t *blk)
+{
+    uint64_t w[80];
+    uint64_t a, b, c, d, e, f, g, h, t1, t2;
+    uint32_t i, j;
+
+    for (i = 0u; i < 16u; i++) {
+        w[i] = 0u;
+        for (j = 0u; j < 8u; j++) {
+            w[i] = (w[i] << 8) | (uint64_t)blk[8u*i + j];
+        }
+    }
+    for (i = 16u; i < 80u; i++) {
+        w[i] = (ROR64(w[i - 2u], 19u) ^ ROR64(w[i - 2u], 61u) ^ (w[i - 2u] >> 6))
+            + w[i - 7u]
+            + (ROR64(w[i - 15u], 1u) ^ ROR64(w[i - 15u], 8u) ^ (w[i - 15u] >> 7))
+            + w[i - 16u];
+    }
+
+    a = state[0]; b = state[1]; c = state[2]; d = state[3];
+    e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+    for (i = 0u; i < 80u; i++) {
+        t1 = h + (ROR64(e, 14u) ^ ROR64(e, 18u) ^ ROR64(e, 41u)) + ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+        t2 = (ROR64(a, 28u) ^ ROR64(a, 34u) ^ ROR64(a, 39u)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+/* digest_size selects the algorithm: 28, 32 (SHA-224/256) or 48, 64 (SHA-384/512). */
+void sha2_init(struct sha2_ctx *ctx, uint32_t digest_size)
+{
+    uint32_t i;
+
+    (void)memset(ctx, 0, sizeof(*ctx));
+    ctx->digest_size = digest_size;
+    if (digest_size > 32u) {
+        ctx->block_size = 128u;
+        for (i = 0u; i < 8u; i++) {
+            ctx->state[i] = (digest_size == 48u) ? sha384_iv[i] : sha512_iv[i];
+        }
+    } else {
+        ctx->block_size = 64u;
+        for (i = 0u; i < 8u; i++) {
+            ctx->state[i] = (digest_size == 28u) ? sha224_iv[i] : sha256_iv[i];
+        }
+    }
+}
+
+static void sha_block(struct sha2_ctx *ctx, const uint8_t *blk)
+{
+    if (ctx->block_size == 128u) {
+        sha512_block(ctx->state, blk);
+    } else {
+        sha256_block(ctx->state, blk);
+    }
+}
+
+void sha2_update(struct sha2_ctx *ctx, const uint8_t *data, uint32_t len)
+{
+    uint32_t n;
+
+    ctx->count += len;
+    if (ctx->buf_len != 0u) {
+        n = ctx->block_size - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        (void)memcpy(ctx->buf + ctx->buf_len, data, n);
+        ctx->buf_len += n;
+        data += n;
+        len -= n;
+        if (ctx->buf_len == ctx->block_size) {
+            sha_block(ctx, ctx->buf);
+            ctx->buf_len = 0u;
+        }
+    }
+    while (len >= ctx->block_size) {
+        sha_block(ctx, data);
+        data += ctx->block_size;
+        len -= ctx->block_size;
+    }
+    if (len != 0u) {
+        (void)memcpy(ctx->buf, data, len);
+        ctx->buf_len = len;
+    }
+}
+
+void sha2_final(struct sha2_ctx *ctx, uint8_t *out)
+{
+    uint64_t bits = ctx->count * 8u;
+    uint32_t len_off = ctx->block_size - 8u;
+    uint32_t word = (ctx->block_size == 128u) ? 8u : 4u;
+    uint32_t i;
+
+    ctx->buf[ctx->buf_len++] = 0x80u;
+    if (ctx->buf_len > len_off) {
+        (void)memset(ctx->buf + ctx->buf_len, 0, ctx->block_size - ctx->buf_len);
+        sha_block(ctx, ctx->buf);
+        ctx->buf_len = 0u;
+    }
+    (void)memset(ctx->buf + ctx->buf_len, 0, len_off - ctx->buf_len);
+    for (i = 0u; i < 8u; i++) {
+        ctx->buf[len_off + i] = (uint8_t)(bits >> (56u - 8u*i));
+    }
+    sha_block(ctx, ctx->buf);
+
+    for (i = 0u; i < ctx->digest_size; i++) {
+        out[i] = (uint8_t)(ctx->state[i / word] >> (8u * (word - 1u - (i % word))));
+    }
+}
@@ -20,10 +20,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
-#include <zlib.h>
 #include "she_api.h"
 #include "plat_os_abs.h"
+#include "crc32.h"
+#include "nvm_storage.h"
 #include "ele_mu_ioctl.h"
 
 
@@ -125,6 +127,12 @@ uint32_t plat_os_abs_has_v2x_hw(void)
     return ret;
 }
 
+/* The MU driver only handles one command at a time per channel. */
+uint32_t plat_os_abs_mu_max_in_flight(struct plat_os_abs_hdl *phdl)
+{
+    return 1U;
+}
+
 
 /* Close a previously opened session (SHE or storage). */
 void plat_os_abs_close_session(struct plat_os_abs_hdl *phdl)
@@ -147,6 +155,12 @@ int32_t plat_os_abs_read_mu_message(struct plat_os_abs_hdl *phdl, uint32_t *mess
     return (int32_t)read(phdl->fd, message, size);
 };
 
+/* The MU device is polled directly, provided its driver implements poll(). */
+int32_t plat_os_abs_mu_poll_fd(struct plat_os_abs_hdl *phdl)
+{
+    return phdl->fd;
+}
+
 /* Map the shared buffer allocated by Seco. */
 int32_t plat_os_abs_configure_shared_buf(struct plat_os_abs_hdl *phdl, uint32_t shared_buf_off, uint32_t size)
 {
@@ -179,132 +193,112 @@ uint64_t plat_os_abs_data_buf(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32
     return io.ele_addr;
 }
 
-uint32_t plat_os_abs_crc(uint8_t *data, uint32_t size)
+/*
+ * The ELE MU driver only exposes IO buffers set up per command and the
+ * shared buffer in secure memory: no memory can stay mapped across commands.
+ */
+/* The driver has no interface to map memory for the enclave. */
+uint8_t *plat_os_abs_buf_map(struct plat_os_abs_hdl *phdl, uint32_t size, uint64_t *addr)
 {
-    return ((uint32_t)crc32(0xFFFFFFFFu, data, size) ^ 0xFFFFFFFFu);
+    return NULL;
 }
 
-/* Write data in a file located in NVM. Return the size of the written data. */
-int32_t plat_os_abs_storage_write(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size)
+void plat_os_abs_buf_unmap(struct plat_os_abs_hdl *phdl, uint8_t *ptr, uint32_t size)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    char *path;
+}
 
-    switch(phdl->type) {
-    case MU_CHANNEL_PLAT_HSM_NVM:
-        path = ELE_NVM_HSM_STORAGE_FILE;
-        break;
-    default:
-        path = NULL;
-        break;
+uint32_t plat_os_abs_crc(uint8_t *data, uint32_t size)
+{
+    return crc32_update(0u, data, size);
+}
+
+/*
+ * Storage of the HSM NVM channel, opened at the first access and kept as
+ * long as the process: files below /etc/ele_hsm/, or the raw partition
+ * given by NVM_RAW_DEV at build time.
+ */
+static struct nvm_storage *ele_hsm_storage;
+static pthread_mutex_t ele_storage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct nvm_storage *ele_storage(struct plat_os_abs_hdl *phdl)
+{
+    struct nvm_storage_cfg cfg = {
+        ELE_NVM_HSM_STORAGE_FILE,
+        ELE_NVM_HSM_STORAGE_CHUNK_PATH,
+#ifdef NVM_STORAGE_RAW_DEV
+        NVM_STORAGE_RAW_DEV,
+#else
+        NULL,
+#endif
+        false,
+    };
+    struct nvm_storage *st;
+
+    if (phdl->type != MU_CHANNEL_PLAT_HSM_NVM) {
+        return NULL;
     }
-    if (path != NULL) {
-        /* Open or create the file with access reserved to the current user. */
-        fd = open(path, O_CREAT|O_WRONLY|O_SYNC, S_IRUSR|S_IWUSR);
-        if (fd >= 0) {
-            /* Write the data. */
-            l = (int32_t)write(fd, src, size);
-
-            (void)close(fd);
-        }
+
+    (void)pthread_mutex_lock(&ele_storage_lock);
+    if (ele_hsm_storage == NULL) {
+#ifdef NVM_STORAGE_RAW_DEV
+        ele_hsm_storage = nvm_storage_raw_ops.open(&cfg);
+#else
+        ele_hsm_storage = nvm_storage_file_ops.open(&cfg);
+#endif
     }
+    st = ele_hsm_storage;
+    (void)pthread_mutex_unlock(&ele_storage_lock);
 
-    return l;
+    return st;
+}
+
+/* Write data in a file located in NVM. Return the size of the written data. */
+int32_t plat_os_abs_storage_write(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size)
+{
+    struct nvm_storage *st = ele_storage(phdl);
+
+    return (st != NULL) ? st->ops->write_blob(st, NVM_STORAGE_MASTER_ID, src, size) : 0;
 }
 
 int32_t plat_os_abs_storage_read(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    char *path;
+    struct nvm_storage *st = ele_storage(phdl);
 
-    switch(phdl->type) {
-    case MU_CHANNEL_PLAT_HSM_NVM:
-        path = ELE_NVM_HSM_STORAGE_FILE;
-        break;
-    default:
-        path = NULL;
-        break;
-    }
+    return (st != NULL) ? st->ops->read_blob(st, NVM_STORAGE_MASTER_ID, dst, size) : 0;
+}
 
-    if (path != NULL) {
-        /* Open the file as read only. */
-        fd = open(path, O_RDONLY);
-        if (fd >= 0) {
-            /* Read the data. */
-            l = (int32_t)read(fd, dst, size);
+uint8_t *plat_os_abs_storage_map(struct plat_os_abs_hdl *phdl, uint32_t *size)
+{
+    struct nvm_storage *st = ele_storage(phdl);
 
-            (void)close(fd);
-        }
-    }
-    return l;
+    return ((st != NULL) && (st->ops->map_master != NULL)) ? st->ops->map_master(st, size) : NULL;
 }
 
-/* Write data in a file located in NVM. Return the size of the written data. */
-int32_t plat_os_abs_storage_write_chunk(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint64_t blob_id)
+void plat_os_abs_storage_unmap(uint8_t *ptr, uint32_t size)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    int n = -1;
-    char *path = NULL;
-
-    if (phdl->type == MU_CHANNEL_PLAT_HSM_NVM) {
-        path = malloc(sizeof(ELE_NVM_HSM_STORAGE_CHUNK_PATH)+16u);
-
-        if (path != NULL) {
-            (void)mkdir(ELE_NVM_HSM_STORAGE_CHUNK_PATH, S_IRUSR|S_IWUSR);
-            n = snprintf(path, sizeof(ELE_NVM_HSM_STORAGE_CHUNK_PATH)+16u,
-                            "%s%016lx", ELE_NVM_HSM_STORAGE_CHUNK_PATH, blob_id);
-        }
-    } else {
-        path = NULL;
-    }
+    (void)munmap(ptr, size);
+}
 
-    if (n > 0) {
-        /* Open or create the file with access reserved to the current user. */
-        fd = open(path, O_CREAT|O_WRONLY|O_SYNC, S_IRUSR|S_IWUSR);
-        if (fd >= 0) {
-            /* Write the data. */
-            l = (int32_t)write(fd, src, size);
+uint32_t plat_os_abs_storage_list_chunks(struct plat_os_abs_hdl *phdl, uint64_t *ids, uint32_t max)
+{
+    struct nvm_storage *st = ele_storage(phdl);
 
-            (void)close(fd);
-        }
-    }
+    return (st != NULL) ? st->ops->enumerate(st, ids, max) : 0u;
+}
+
+/* Write data in a file located in NVM. Return the size of the written data. */
+int32_t plat_os_abs_storage_write_chunk(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint64_t blob_id)
+{
+    struct nvm_storage *st = ele_storage(phdl);
 
-    free(path);
-    return l;
+    return (st != NULL) ? st->ops->write_blob(st, blob_id, src, size) : 0;
 }
 
 int32_t plat_os_abs_storage_read_chunk(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size, uint64_t blob_id)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    int n = -1;
-    char *path;
-
-    if (phdl->type == MU_CHANNEL_PLAT_HSM_NVM) {
-        path = malloc(sizeof(ELE_NVM_HSM_STORAGE_CHUNK_PATH)+16u);
-
-        if (path != NULL) {
-            (void)mkdir(ELE_NVM_HSM_STORAGE_CHUNK_PATH, S_IRUSR|S_IWUSR);
-            n = snprintf(path, sizeof(ELE_NVM_HSM_STORAGE_CHUNK_PATH)+16u,
-                            "%s%016lx", ELE_NVM_HSM_STORAGE_CHUNK_PATH, blob_id);
-        }
-    }
+    struct nvm_storage *st = ele_storage(phdl);
 
-    if (n > 0) {
-        /* Open the file as read only. */
-        fd = open(path, O_RDONLY);
-        if (fd >= 0) {
-            /* Read the data. */
-            l = (int32_t)read(fd, dst, size);
-
-            (void)close(fd);
-        }
-    }
-    free(path);
-    return l;
+    return (st != NULL) ? st->ops->read_blob(st, blob_id, dst, size) : 0;
 }
 
 void plat_os_abs_memset(uint8_t *dst, uint8_t val, uint32_t len)
@@ -20,10 +20,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
-#include <zlib.h>
 #include "she_api.h"
 #include "plat_os_abs.h"
+#include "crc32.h"
+#include "nvm_storage.h"
 #include "seco_mu_ioctl.h"
 
 
@@ -181,6 +183,12 @@ uint32_t plat_os_abs_has_v2x_hw(void)
     return ret;
 }
 
+/* The MU driver only handles one command at a time per channel. */
+uint32_t plat_os_abs_mu_max_in_flight(struct plat_os_abs_hdl *phdl)
+{
+    return 1U;
+}
+
 
 /* Close a previously opened session (SHE or storage). */
 void plat_os_abs_close_session(struct plat_os_abs_hdl *phdl)
@@ -203,6 +211,12 @@ int32_t plat_os_abs_read_mu_message(struct plat_os_abs_hdl *phdl, uint32_t *mess
     return (int32_t)read(phdl->fd, message, size);
 };
 
+/* The MU device is polled directly, provided its driver implements poll(). */
+int32_t plat_os_abs_mu_poll_fd(struct plat_os_abs_hdl *phdl)
+{
+    return phdl->fd;
+}
+
 /* Map the shared buffer allocated by Seco. */
 int32_t plat_os_abs_configure_shared_buf(struct plat_os_abs_hdl *phdl, uint32_t shared_buf_off, uint32_t size)
 {
@@ -235,168 +249,127 @@ uint64_t plat_os_abs_data_buf(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32
     return io.seco_addr;
 }
 
+/*
+ * The SECO MU driver only exposes IO buffers set up per command and the
+ * shared buffer in secure memory: no memory can stay mapped across commands.
+ */
+/* The driver has no interface to map memory for the enclave. */
+uint8_t *plat_os_abs_buf_map(struct plat_os_abs_hdl *phdl, uint32_t size, uint64_t *addr)
+{
+    return NULL;
+}
+
+void plat_os_abs_buf_unmap(struct plat_os_abs_hdl *phdl, uint8_t *ptr, uint32_t size)
+{
+}
+
 uint32_t plat_os_abs_crc(uint8_t *data, uint32_t size)
 {
-    return ((uint32_t)crc32(0xFFFFFFFFu, data, size) ^ 0xFFFFFFFFu);
+    return crc32_update(0u, data, size);
 }
 
-/* Write data in a file located in NVM. Return the size of the written data. */
-int32_t plat_os_abs_storage_write(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size)
+/*
+ * Storages of the NVM channels, opened at the first access and kept as long
+ * as the process. The SHE ones only hold a master file. The HSM blobs of the
+ * platform go to the raw partition given by NVM_RAW_DEV at build time, if
+ * any.
+ */
+static struct nvm_storage *seco_storages[4];
+static pthread_mutex_t seco_storage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct nvm_storage *seco_storage(struct plat_os_abs_hdl *phdl)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    char *path;
+    const struct nvm_storage_ops *ops = &nvm_storage_file_ops;
+    struct nvm_storage_cfg cfg = {NULL, NULL, NULL, false};
+    struct nvm_storage *st;
+    uint32_t idx;
 
     switch(phdl->type) {
     case MU_CHANNEL_PLAT_SHE_NVM:
-        path = SECO_NVM_SHE_STORAGE_FILE;
+        idx = 0u;
+        cfg.master_path = SECO_NVM_SHE_STORAGE_FILE;
         break;
     case MU_CHANNEL_PLAT_HSM_NVM:
-        path = SECO_NVM_HSM_STORAGE_FILE;
+        idx = 1u;
+        cfg.master_path = SECO_NVM_HSM_STORAGE_FILE;
+        cfg.chunk_dir = SECO_NVM_HSM_STORAGE_CHUNK_PATH;
+#ifdef NVM_STORAGE_RAW_DEV
+        cfg.dev_path = NVM_STORAGE_RAW_DEV;
+        ops = &nvm_storage_raw_ops;
+#endif
         break;
     case MU_CHANNEL_V2X_SHE_NVM:
-        path = V2X_NVM_SHE_STORAGE_FILE;
+        idx = 2u;
+        cfg.master_path = V2X_NVM_SHE_STORAGE_FILE;
         break;
     case MU_CHANNEL_V2X_HSM_NVM:
-        path = V2X_NVM_HSM_STORAGE_FILE;
+        idx = 3u;
+        cfg.master_path = V2X_NVM_HSM_STORAGE_FILE;
+        cfg.chunk_dir = V2X_NVM_HSM_STORAGE_CHUNK_PATH;
+        /* The chunk log is only used for the platform HSM. */
+        cfg.chunk_files = true;
         break;
     default:
-        path = NULL;
-        break;
+        return NULL;
     }
-    if (path != NULL) {
-        /* Open or create the file with access reserved to the current user. */
-        fd = open(path, O_CREAT|O_WRONLY|O_SYNC, S_IRUSR|S_IWUSR);
-        if (fd >= 0) {
-            /* Write the data. */
-            l = (int32_t)write(fd, src, size);
-
-            (void)close(fd);
-        }
+
+    (void)pthread_mutex_lock(&seco_storage_lock);
+    if (seco_storages[idx] == NULL) {
+        seco_storages[idx] = ops->open(&cfg);
     }
+    st = seco_storages[idx];
+    (void)pthread_mutex_unlock(&seco_storage_lock);
 
-    return l;
+    return st;
 }
 
-int32_t plat_os_abs_storage_read(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size)
+/* Write data in a file located in NVM. Return the size of the written data. */
+int32_t plat_os_abs_storage_write(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    char *path;
+    struct nvm_storage *st = seco_storage(phdl);
 
-    switch(phdl->type) {
-    case MU_CHANNEL_PLAT_SHE_NVM:
-        path = SECO_NVM_SHE_STORAGE_FILE;
-        break;
-    case MU_CHANNEL_PLAT_HSM_NVM:
-        path = SECO_NVM_HSM_STORAGE_FILE;
-        break;
-    case MU_CHANNEL_V2X_SHE_NVM:
-        path = V2X_NVM_SHE_STORAGE_FILE;
-        break;
-    case MU_CHANNEL_V2X_HSM_NVM:
-        path = V2X_NVM_HSM_STORAGE_FILE;
-        break;
-    default:
-        path = NULL;
-        break;
-    }
+    return (st != NULL) ? st->ops->write_blob(st, NVM_STORAGE_MASTER_ID, src, size) : 0;
+}
 
-    if (path != NULL) {
-        /* Open the file as read only. */
-        fd = open(path, O_RDONLY);
-        if (fd >= 0) {
-            /* Read the data. */
-            l = (int32_t)read(fd, dst, size);
+int32_t plat_os_abs_storage_read(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size)
+{
+    struct nvm_storage *st = seco_storage(phdl);
 
-            (void)close(fd);
-        }
-    }
-    return l;
+    return (st != NULL) ? st->ops->read_blob(st, NVM_STORAGE_MASTER_ID, dst, size) : 0;
 }
 
-/* Write data in a file located in NVM. Return the size of the written data. */
-int32_t plat_os_abs_storage_write_chunk(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint64_t blob_id)
+uint8_t *plat_os_abs_storage_map(struct plat_os_abs_hdl *phdl, uint32_t *size)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    int n = -1;
-    char *path = NULL;
-
-    if (phdl->type == MU_CHANNEL_PLAT_HSM_NVM) {
-        path = malloc(sizeof(SECO_NVM_HSM_STORAGE_CHUNK_PATH)+16u);
-
-        if (path != NULL) {
-            (void)mkdir(SECO_NVM_HSM_STORAGE_CHUNK_PATH, S_IRUSR|S_IWUSR);
-            n = snprintf(path, sizeof(SECO_NVM_HSM_STORAGE_CHUNK_PATH)+16u,
-                            "%s%016lx", SECO_NVM_HSM_STORAGE_CHUNK_PATH, blob_id);
-        }
-    } else if (phdl->type == MU_CHANNEL_V2X_HSM_NVM) {
-        path = malloc(sizeof(V2X_NVM_HSM_STORAGE_CHUNK_PATH)+16u);
+    struct nvm_storage *st = seco_storage(phdl);
 
-        if (path != NULL) {
-            (void)mkdir(V2X_NVM_HSM_STORAGE_CHUNK_PATH, S_IRUSR|S_IWUSR);
-            n = snprintf(path, sizeof(V2X_NVM_HSM_STORAGE_CHUNK_PATH)+16u,
-                            "%s%016lx", V2X_NVM_HSM_STORAGE_CHUNK_PATH, blob_id);
-        }
-    } else {
-        path = NULL;
-    }
+    return ((st != NULL) && (st->ops->map_master != NULL)) ? st->ops->map_master(st, size) : NULL;
+}
 
-    if (n > 0) {
-        /* Open or create the file with access reserved to the current user. */
-        fd = open(path, O_CREAT|O_WRONLY|O_SYNC, S_IRUSR|S_IWUSR);
-        if (fd >= 0) {
-            /* Write the data. */
-            l = (int32_t)write(fd, src, size);
+void plat_os_abs_storage_unmap(uint8_t *ptr, uint32_t size)
+{
+    (void)munmap(ptr, size);
+}
 
-            (void)close(fd);
-        }
-    }
+uint32_t plat_os_abs_storage_list_chunks(struct plat_os_abs_hdl *phdl, uint64_t *ids, uint32_t max)
+{
+    struct nvm_storage *st = seco_storage(phdl);
 
-    free(path);
-    return l;
+    return (st != NULL) ? st->ops->enumerate(st, ids, max) : 0u;
 }
 
-int32_t plat_os_abs_storage_read_chunk(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size, uint64_t blob_id)
+/* Write data in a file located in NVM. Return the size of the written data. */
+int32_t plat_os_abs_storage_write_chunk(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint64_t blob_id)
 {
-    int32_t fd = -1;
-    int32_t l = 0;
-    int n = -1;
-    char *path;
-
-    if (phdl->type == MU_CHANNEL_PLAT_HSM_NVM) {
-        path = malloc(sizeof(SECO_NVM_HSM_STORAGE_CHUNK_PATH)+16u);
-
-        if (path != NULL) {
-            (void)mkdir(SECO_NVM_HSM_STORAGE_CHUNK_PATH, S_IRUSR|S_IWUSR);
-            n = snprintf(path, sizeof(SECO_NVM_HSM_STORAGE_CHUNK_PATH)+16u,
-                            "%s%016lx", SECO_NVM_HSM_STORAGE_CHUNK_PATH, blob_id);
-        }
-    } else if (phdl->type == MU_CHANNEL_V2X_HSM_NVM) {
-        path = malloc(sizeof(V2X_NVM_HSM_STORAGE_CHUNK_PATH)+16u);
+    struct nvm_storage *st = seco_storage(phdl);
 
-        if (path != NULL) {
-            (void)mkdir(V2X_NVM_HSM_STORAGE_CHUNK_PATH, S_IRUSR|S_IWUSR);
-            n = snprintf(path, sizeof(V2X_NVM_HSM_STORAGE_CHUNK_PATH)+16u,
-                            "%s%016lx", V2X_NVM_HSM_STORAGE_CHUNK_PATH, blob_id);
-        }
-    } else {
-        path = NULL;
-    }
+    return (st != NULL) ? st->ops->write_blob(st, blob_id, src, size) : 0;
+}
 
-    if (n > 0) {
-        /* Open the file as read only. */
-        fd = open(path, O_RDONLY);
-        if (fd >= 0) {
-            /* Read the data. */
-            l = (int32_t)read(fd, dst, size);
+int32_t plat_os_abs_storage_read_chunk(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size, uint64_t blob_id)
+{
+    struct nvm_storage *st = seco_storage(phdl);
 
-            (void)close(fd);
-        }
-    }
-    free(path);
-    return l;
+    return (st != NULL) ? st->ops->read_blob(st, blob_id, dst, size) : 0;
 }
 
 void plat_os_abs_memset(uint8_t *dst, uint8_t val, uint32_t len)
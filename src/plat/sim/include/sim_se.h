@@ -0,0 +1,166 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#ifndef SIM_SE_H
+#define SIM_SE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * In-process software model of the secure enclave used by the "sim" platform.
+ *
+ * Each MU channel opened through plat_os_abs is backed by a sim_se_chan.
+ * Commands written on a channel are queued to the engine modelling the core
+ * behind that MU (SECO/ELE core, V2X SV0/SV1/SG0/SG1 accelerators, V2X
+ * control core). Every engine runs its own worker thread which decodes the
+ * SAB message, applies it to the enclave state, holds it for the modelled
+ * service time and finally posts the response on the originating channel.
+ *
+ * Enclave initiated exchanges (storage export, chunk get) are posted on the
+ * NVM channel of the same domain and complete once the NVM manager answered.
+ *
+ * The model is driven by the following environment variables:
+ * - SIM_SE_TIME_SCALE:  percentage applied to every service time (default 100,
+ *                       0 disables all delays).
+ * - SIM_SE_V2X_SCALE:   additional percentage applied on V2X engines (default 40).
+ * - SIM_SE_COST_<id>:   "<base_ns>[,<ps_per_byte>]" service time of the SAB
+ *                       command <id> (2 hex digits, e.g. SIM_SE_COST_72).
+ * - SIM_SE_SYSCALL_NS:  host side cost of a kernel crossing (send, read and
+ *                       data_buf), spent in the caller thread (default 1000).
+ * - SIM_SE_MU_DEPTH:    number of commands a channel can have in flight
+ *                       before a send blocks (default 1, as on hardware).
+ * - SIM_SE_V2X:         0 to report a platform without V2X accelerator.
+ * - SIM_SE_NVM_DIR:     directory used for the storage files (default
+ *                       /tmp/sim_hsm/).
+ * - SIM_SE_NVM_BACKEND: storage backend, "file", "raw" or "ram" (default
+ *                       file). raw uses a file of SIM_SE_NVM_DIR standing
+ *                       for the partition.
+ * - SIM_SE_NVM_RAW_KB:  size of the file standing for the raw partition,
+ *                       extended if smaller (default 4096).
+ * - SIM_SE_RESIDENT_GROUPS: max number of key groups kept in enclave memory
+ *                       per key store, 0 for no limit (default 0).
+ * - SIM_SE_NVM_TIMEOUT_MS: how long the enclave waits for the NVM manager
+ *                       (default 5000).
+ * - SIM_SE_STORAGE_NS:  latency of a storage read (master or chunk file, or
+ *                       mapping), spent in the caller thread (default 0,
+ *                       files in the page cache).
+ */
+
+#define SIM_SE_MAX_MSG_WORDS    256u
+#define SIM_SE_MAP_ENTRIES      1024u
+/* Host regions kept reachable until unpinned, above the recycled addresses. */
+#define SIM_SE_PIN_ENTRIES      16u
+#define SIM_SE_PIN_BASE         0xF0000000u
+
+/* Engines, one per modelled core. */
+#define SIM_SE_ENGINE_PLAT      0u
+#define SIM_SE_ENGINE_V2X_SV0   1u
+#define SIM_SE_ENGINE_V2X_SV1   2u
+#define SIM_SE_ENGINE_V2X_SG0   3u
+#define SIM_SE_ENGINE_V2X_SG1   4u
+#define SIM_SE_ENGINE_V2X_CTRL  5u
+#define SIM_SE_ENGINE_NB        6u
+
+/* Storage domains, each served by its own NVM manager. */
+#define SIM_SE_DOMAIN_PLAT      0u
+#define SIM_SE_DOMAIN_V2X       1u
+#define SIM_SE_DOMAIN_NB        2u
+
+struct sim_se_msg {
+    struct sim_se_msg *next;
+    uint32_t len;
+    uint32_t words[SIM_SE_MAX_MSG_WORDS];
+};
+
+struct sim_se_map_entry {
+    uint32_t addr;
+    uint32_t size;
+    uint8_t *ptr;
+};
+
+struct sim_se_chan {
+    uint32_t type;
+    uint32_t engine;
+    uint32_t domain;
+    uint32_t is_nvm;
+    uint32_t storage_hdl;           /* storage handle opened on this NVM channel. */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct sim_se_msg *rx_head;     /* messages to be read by the host. */
+    struct sim_se_msg *rx_tail;
+    struct sim_se_msg *inbox;       /* host responses to enclave requests. */
+    uint32_t in_flight;             /* commands sent, response not yet read. */
+    uint32_t closed;
+    int32_t evfd;                   /* eventfd counting rx messages, -1 until polled. */
+    pthread_mutex_t map_lock;
+    uint32_t map_head;
+    uint32_t map_next_addr;
+    struct sim_se_map_entry map[SIM_SE_MAP_ENTRIES];
+    uint32_t pin_next_addr;
+    struct sim_se_map_entry pin[SIM_SE_PIN_ENTRIES];
+};
+
+/* Context of a command being processed by an engine. */
+struct sim_se_op {
+    struct sim_se_chan *chan;       /* channel the command was received on. */
+    uint32_t engine;
+    uint32_t *cmd;
+    uint32_t cmd_len;
+    uint32_t *rsp;
+    uint32_t rsp_len;               /* response length in bytes, set by the handler. */
+    uint32_t bytes;                 /* payload bytes processed, for the cost model. */
+    uint32_t cost_pct;              /* handler adjustment of the service time. */
+};
+
+typedef uint32_t (*sim_se_handler_t)(struct sim_se_op *op);
+
+struct sim_se_cost {
+    uint32_t base_ns;
+    uint32_t ps_per_byte;
+};
+
+/* Channels (sim_se.c) */
+struct sim_se_chan *sim_se_chan_open(uint32_t type);
+void sim_se_chan_close(struct sim_se_chan *chan);
+int32_t sim_se_chan_write(struct sim_se_chan *chan, uint32_t *msg, uint32_t size);
+int32_t sim_se_chan_read(struct sim_se_chan *chan, uint32_t *msg, uint32_t size);
+int32_t sim_se_chan_fd(struct sim_se_chan *chan);
+uint32_t sim_se_chan_map(struct sim_se_chan *chan, uint8_t *ptr, uint32_t size);
+uint32_t sim_se_chan_pin(struct sim_se_chan *chan, uint8_t *ptr, uint32_t size);
+void sim_se_chan_unpin(struct sim_se_chan *chan, uint8_t *ptr);
+uint8_t *sim_se_chan_resolve(struct sim_se_chan *chan, uint32_t addr, uint32_t size);
+void sim_se_syscall(void);
+void sim_se_storage_access(void);
+uint32_t sim_se_has_v2x(void);
+uint32_t sim_se_mu_max_in_flight(void);
+uint32_t sim_se_env(const char *name, uint32_t def);
+const char *sim_se_nvm_dir(void);
+
+/* Enclave initiated storage exchanges (sim_se.c) */
+uint32_t sim_se_nvm_export(uint32_t domain, uint8_t cmd, uint64_t blob_id, uint8_t *blob, uint32_t len);
+uint32_t sim_se_nvm_get_chunk(uint32_t domain, uint64_t blob_id, uint8_t *blob, uint32_t max_len, uint32_t *len);
+
+/* Message decoding and enclave state (sim_se_msg.c) */
+sim_se_handler_t sim_se_get_handler(uint8_t cmd, uint8_t ver);
+void sim_se_get_cost(uint8_t cmd, struct sim_se_cost *cost);
+
+/* Primitives (sim_se_crypto.c), SHA-2 is the one of the library (sha2.h). */
+void sim_se_sha(uint32_t digest_size, const uint8_t *data, uint32_t len, uint8_t *out);
+void sim_se_expand(const uint8_t *seed, uint32_t seed_len, uint8_t *out, uint32_t len);
+void sim_se_block_encrypt(const uint8_t *key, const uint8_t *in, uint8_t *out);
+void sim_se_block_decrypt(const uint8_t *key, const uint8_t *in, uint8_t *out);
+void sim_se_random(uint8_t *out, uint32_t len);
+
+#endif
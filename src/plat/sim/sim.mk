@@ -0,0 +1,45 @@
+#
+# Copyright 2022 NXP
+#
+# NXP Confidential.
+# This software is owned or controlled by NXP and may only be used strictly
+# in accordance with the applicable license terms.  By expressly accepting
+# such terms or by downloading, installing, activating and/or otherwise using
+# the software, you are agreeing that you have read, and that you agree to
+# comply with and are bound by, such license terms.  If you do not agree to be
+# bound by the applicable license terms, then you may not retain, install,
+# activate or otherwise use the software.
+#
+
+# Software model of the enclave, see src/plat/sim/include/sim_se.h.
+
+MINOR_VER := 0
+
+SHE_LIB := lib$(PLAT)_she.a
+HSM_LIB := lib$(PLAT)_hsm_$(MAJOR_VER).$(MINOR_VER).a
+NVM_LIB := lib$(PLAT)_nvm_$(MAJOR_VER).$(MINOR_VER).a
+
+DEFINES		+=	-DCONFIG_PLAT_SIM -DLIB_MINOR_VERSION=${MINOR_VER}
+
+# PSA API as on ELE, unless SIM_NO_PSA is set: the simulator then takes the
+# non PSA messages of SECO. Only the perf tests are built then, the others
+# tell the non PSA API from the SECO platform.
+ifdef SIM_NO_PSA
+HSM_TEST :=
+SHE_TEST :=
+V2X_TEST :=
+else
+HSM_TEST := $(PLAT)_hsm_test
+SHE_TEST := $(PLAT)_she_test
+V2X_TEST := $(PLAT)_v2x_test
+DEFINES		+=	-DPSA_COMPLIANT
+endif
+
+# The simulator speaks the ELE message format: share its helpers.
+PLAT_OBJECTS	:=	$(PLAT_PATH)/sim_os_abs_linux.o \
+			src/plat/ele/ele_utils.o \
+			$(PLAT_PATH)/sim_se.o \
+			$(PLAT_PATH)/sim_se_msg.o \
+			$(PLAT_PATH)/sim_se_crypto.o
+
+OBJECTS	+= $(PLAT_OBJECTS)
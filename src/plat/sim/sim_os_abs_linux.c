@@ -0,0 +1,341 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "plat_os_abs.h"
+#include "crc32.h"
+#include "nvm_storage.h"
+#include "sim_se.h"
+
+/*
+ * Simulated platform: the MU devices are replaced by the in-process enclave
+ * model of sim_se.c, storage goes below SIM_SE_NVM_DIR through the backend
+ * selected by SIM_SE_NVM_BACKEND (see nvm_storage.h).
+ */
+
+#define SIM_DEFAULT_DID             0x7u
+#define SIM_DEFAULT_TZ              0x0u
+#define SIM_DEFAULT_MU              0x2u
+#define SIM_DEFAULT_INTERRUPT_IDX   0x0u
+
+#define SIM_PATH_MAX                256u
+
+static char SIM_NVM_HSM_STORAGE_FILE[] = "hsm_nvm_master";
+static char SIM_NVM_HSM_STORAGE_CHUNK_DIR[] = "hsm/";
+static char SIM_NVM_V2X_STORAGE_FILE[] = "v2x_nvm_master";
+static char SIM_NVM_V2X_STORAGE_CHUNK_DIR[] = "v2x/";
+/* Files standing for the raw partitions. */
+static char SIM_NVM_HSM_STORAGE_RAW[] = "hsm_nvm.raw";
+static char SIM_NVM_V2X_STORAGE_RAW[] = "v2x_nvm.raw";
+
+/* Open a session and returns a pointer to the handle or NULL in case of error.
+ * Here it consists in opening a channel on the simulated enclave.
+ */
+struct plat_os_abs_hdl *plat_os_abs_open_mu_channel(uint32_t type, struct plat_mu_params *mu_params)
+{
+    struct plat_os_abs_hdl *phdl = malloc(sizeof(struct plat_os_abs_hdl));
+
+    if ((phdl != NULL) && (mu_params != NULL)) {
+        sim_se_syscall();
+        phdl->chan = sim_se_chan_open(type);
+        if (phdl->chan == NULL) {
+            free(phdl);
+            phdl = NULL;
+        } else {
+            phdl->fd = -1;
+            phdl->type = type;
+            mu_params->mu_id = SIM_DEFAULT_MU;
+            mu_params->interrupt_idx = SIM_DEFAULT_INTERRUPT_IDX;
+            mu_params->tz = SIM_DEFAULT_TZ;
+            mu_params->did = SIM_DEFAULT_DID;
+        }
+    } else {
+        free(phdl);
+        phdl = NULL;
+    }
+    return phdl;
+}
+
+/* Check if the V2X accelerator is present on this HW. */
+uint32_t plat_os_abs_has_v2x_hw(void)
+{
+    return sim_se_has_v2x();
+}
+
+/* The model holds up to SIM_SE_MU_DEPTH commands per channel. */
+uint32_t plat_os_abs_mu_max_in_flight(struct plat_os_abs_hdl *phdl)
+{
+    return sim_se_mu_max_in_flight();
+}
+
+
+/* Close a previously opened session (SHE or storage). */
+void plat_os_abs_close_session(struct plat_os_abs_hdl *phdl)
+{
+    sim_se_chan_close(phdl->chan);
+
+    free(phdl);
+}
+
+/* Send a message to the enclave on the MU. Return the size of the data written. */
+int32_t plat_os_abs_send_mu_message(struct plat_os_abs_hdl *phdl, uint32_t *message, uint32_t size)
+{
+    sim_se_syscall();
+    return sim_se_chan_write(phdl->chan, message, size);
+}
+
+/* Read a message from the enclave on the MU. Return the size of the data that were read. */
+int32_t plat_os_abs_read_mu_message(struct plat_os_abs_hdl *phdl, uint32_t *message, uint32_t size)
+{
+    sim_se_syscall();
+    return sim_se_chan_read(phdl->chan, message, size);
+}
+
+/* The model has no device, the channel signals its messages on an eventfd. */
+int32_t plat_os_abs_mu_poll_fd(struct plat_os_abs_hdl *phdl)
+{
+    return sim_se_chan_fd(phdl->chan);
+}
+
+/* No shared buffer to map: the enclave reaches host buffers directly. */
+int32_t plat_os_abs_configure_shared_buf(struct plat_os_abs_hdl *phdl, uint32_t shared_buf_off, uint32_t size)
+{
+    return 0;
+}
+
+
+uint64_t plat_os_abs_data_buf(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint32_t flags)
+{
+    sim_se_syscall();
+    return (uint64_t)sim_se_chan_map(phdl->chan, src, size);
+}
+
+uint8_t *plat_os_abs_buf_map(struct plat_os_abs_hdl *phdl, uint32_t size, uint64_t *addr)
+{
+    uint8_t *ptr = NULL;
+    uint32_t sim_addr;
+
+    sim_se_syscall();
+    if (posix_memalign((void **)&ptr, 64u, size) != 0) {
+        return NULL;
+    }
+    sim_addr = sim_se_chan_pin(phdl->chan, ptr, size);
+    if (sim_addr == 0u) {
+        free(ptr);
+        return NULL;
+    }
+    *addr = sim_addr;
+
+    return ptr;
+}
+
+void plat_os_abs_buf_unmap(struct plat_os_abs_hdl *phdl, uint8_t *ptr, uint32_t size)
+{
+    sim_se_syscall();
+    sim_se_chan_unpin(phdl->chan, ptr);
+    free(ptr);
+}
+
+uint32_t plat_os_abs_crc(uint8_t *data, uint32_t size)
+{
+    return crc32_update(0u, data, size);
+}
+
+/*
+ * Storage of each NVM channel, opened at the first access and kept as long
+ * as the process, so that the RAM backend survives NVM manager restarts.
+ */
+static struct nvm_storage *sim_storages[2];
+static pthread_mutex_t sim_storage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Size of the file standing for the raw partition, in KiB. */
+#define SIM_RAW_DEFAULT_KB          4096u
+
+/* Create the file standing for the raw partition if too small. */
+static void sim_storage_raw_create(const char *path)
+{
+    off_t size = (off_t)sim_se_env("SIM_SE_NVM_RAW_KB", SIM_RAW_DEFAULT_KB) * 1024;
+    struct stat st;
+    int32_t fd;
+
+    fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, S_IRUSR|S_IWUSR);
+    if (fd >= 0) {
+        if ((fstat(fd, &st) == 0) && (st.st_size < size)) {
+            (void)ftruncate(fd, size);
+        }
+        (void)close(fd);
+    }
+}
+
+/* Storage of the NVM channel of phdl, NULL on failure. */
+static struct nvm_storage *sim_storage(struct plat_os_abs_hdl *phdl)
+{
+    const char *dir = sim_se_nvm_dir();
+    const char *backend = getenv("SIM_SE_NVM_BACKEND");
+    const struct nvm_storage_ops *ops;
+    struct nvm_storage_cfg cfg;
+    char master[SIM_PATH_MAX];
+    char chunk_dir[SIM_PATH_MAX];
+    char dev[SIM_PATH_MAX];
+    struct nvm_storage *st;
+    char *file;
+    char *chunks;
+    char *raw;
+    uint32_t idx;
+
+    switch (phdl->type) {
+    case MU_CHANNEL_PLAT_HSM_NVM:
+        idx = 0u;
+        file = SIM_NVM_HSM_STORAGE_FILE;
+        chunks = SIM_NVM_HSM_STORAGE_CHUNK_DIR;
+        raw = SIM_NVM_HSM_STORAGE_RAW;
+        break;
+    case MU_CHANNEL_V2X_HSM_NVM:
+        idx = 1u;
+        file = SIM_NVM_V2X_STORAGE_FILE;
+        chunks = SIM_NVM_V2X_STORAGE_CHUNK_DIR;
+        raw = SIM_NVM_V2X_STORAGE_RAW;
+        break;
+    default:
+        return NULL;
+    }
+
+    (void)pthread_mutex_lock(&sim_storage_lock);
+    st = sim_storages[idx];
+    if (st == NULL) {
+        ops = nvm_storage_backend(((backend != NULL) && (*backend != '\0')) ? backend : "file");
+        (void)snprintf(master, sizeof(master), "%s%s", dir, file);
+        (void)snprintf(chunk_dir, sizeof(chunk_dir), "%s%s", dir, chunks);
+        (void)snprintf(dev, sizeof(dev), "%s%s", dir, raw);
+        cfg.master_path = master;
+        cfg.chunk_dir = chunk_dir;
+        cfg.dev_path = dev;
+        cfg.chunk_files = false;
+
+        (void)mkdir(dir, S_IRWXU);
+        if (ops == &nvm_storage_raw_ops) {
+            sim_storage_raw_create(dev);
+        }
+        if (ops != NULL) {
+            st = ops->open(&cfg);
+        }
+        sim_storages[idx] = st;
+    }
+    (void)pthread_mutex_unlock(&sim_storage_lock);
+
+    return st;
+}
+
+/* Write data in a file located in NVM. Return the size of the written data. */
+int32_t plat_os_abs_storage_write(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size)
+{
+    struct nvm_storage *st = sim_storage(phdl);
+
+    return (st != NULL) ? st->ops->write_blob(st, NVM_STORAGE_MASTER_ID, src, size) : -1;
+}
+
+int32_t plat_os_abs_storage_read(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size)
+{
+    struct nvm_storage *st = sim_storage(phdl);
+
+    if (st == NULL) {
+        return 0;
+    }
+    sim_se_storage_access();
+
+    return st->ops->read_blob(st, NVM_STORAGE_MASTER_ID, dst, size);
+}
+
+uint8_t *plat_os_abs_storage_map(struct plat_os_abs_hdl *phdl, uint32_t *size)
+{
+    struct nvm_storage *st = sim_storage(phdl);
+
+    if ((st == NULL) || (st->ops->map_master == NULL)) {
+        return NULL;
+    }
+    sim_se_storage_access();
+
+    return st->ops->map_master(st, size);
+}
+
+void plat_os_abs_storage_unmap(uint8_t *ptr, uint32_t size)
+{
+    (void)munmap(ptr, size);
+}
+
+uint32_t plat_os_abs_storage_list_chunks(struct plat_os_abs_hdl *phdl, uint64_t *ids, uint32_t max)
+{
+    struct nvm_storage *st = sim_storage(phdl);
+
+    return (st != NULL) ? st->ops->enumerate(st, ids, max) : 0u;
+}
+
+/* Write data in a file located in NVM. Return the size of the written data. */
+int32_t plat_os_abs_storage_write_chunk(struct plat_os_abs_hdl *phdl, uint8_t *src, uint32_t size, uint64_t blob_id)
+{
+    struct nvm_storage *st = sim_storage(phdl);
+
+    return (st != NULL) ? st->ops->write_blob(st, blob_id, src, size) : -1;
+}
+
+int32_t plat_os_abs_storage_read_chunk(struct plat_os_abs_hdl *phdl, uint8_t *dst, uint32_t size, uint64_t blob_id)
+{
+    struct nvm_storage *st = sim_storage(phdl);
+
+    if (st == NULL) {
+        return 0;
+    }
+    sim_se_storage_access();
+
+    return st->ops->read_blob(st, blob_id, dst, size);
+}
+
+void plat_os_abs_memset(uint8_t *dst, uint8_t val, uint32_t len)
+{
+    (void)memset(dst, (int32_t)val, len);
+}
+
+void plat_os_abs_memcpy(uint8_t *dst, uint8_t *src, uint32_t len)
+{
+    (void)memcpy(dst, src, len);
+}
+
+uint8_t *plat_os_abs_malloc(uint32_t size)
+{
+    return (uint8_t *)malloc(size);
+}
+
+void plat_os_abs_free(void *ptr)
+{
+    free(ptr);
+}
+
+void plat_os_abs_start_system_rng(struct plat_os_abs_hdl *phdl)
+{
+    /* The simulated enclave RNG is always available. */
+}
+
+int32_t plat_os_abs_send_signed_message(struct plat_os_abs_hdl *phdl, uint8_t *signed_message, uint32_t msg_len)
+{
+    /* Signed messages are not modelled. */
+    return -1;
+}
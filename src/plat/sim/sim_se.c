@@ -0,0 +1,893 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "plat_os_abs.h"
+#include "plat_utils.h"
+#include "sim_se.h"
+
+struct sim_se_engine {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    uint32_t started;
+    uint32_t id;
+    uint32_t scale_pct;
+    struct sim_se_req *head;
+    struct sim_se_req *tail;
+};
+
+struct sim_se_req {
+    struct sim_se_req *next;
+    struct sim_se_chan *chan;
+    struct sim_se_msg msg;
+};
+
+static struct sim_se_engine sim_se_engines[SIM_SE_ENGINE_NB];
+static struct sim_se_chan *sim_se_nvm_chan[SIM_SE_DOMAIN_NB];
+static pthread_mutex_t sim_se_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t sim_se_once = PTHREAD_ONCE_INIT;
+
+static uint32_t sim_se_time_scale;
+static uint32_t sim_se_syscall_ns;
+static uint32_t sim_se_storage_ns;
+static uint32_t sim_se_mu_depth;
+static uint32_t sim_se_nvm_timeout_ms;
+static char sim_se_nvm_path[256];
+
+uint32_t sim_se_env(const char *name, uint32_t def)
+{
+    char *val = getenv(name);
+    uint32_t ret = def;
+
+    if ((val != NULL) && (*val != '\0')) {
+        ret = (uint32_t)strtoul(val, NULL, 0);
+    }
+
+    return ret;
+}
+
+static uint64_t sim_se_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Wait until the given monotonic time. Sleep for the bulk of long waits and
+ * spin on the last part since the scheduler wake-up jitter is in the same
+ * order of magnitude as the shortest service times.
+ */
+static void sim_se_wait_until(uint64_t deadline)
+{
+    struct timespec ts;
+    uint64_t now = sim_se_now();
+
+    if ((deadline > now) && ((deadline - now) > 200000u)) {
+        ts.tv_sec = (time_t)((deadline - 100000u) / 1000000000u);
+        ts.tv_nsec = (long)((deadline - 100000u) % 1000000000u);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+    while (sim_se_now() < deadline) {
+    }
+}
+
+void sim_se_syscall(void)
+{
+    if (sim_se_syscall_ns != 0u) {
+        sim_se_wait_until(sim_se_now() + sim_se_syscall_ns);
+    }
+}
+
+uint32_t sim_se_has_v2x(void)
+{
+    return sim_se_env("SIM_SE_V2X", 1u);
+}
+
+static void sim_se_init(void);
+
+uint32_t sim_se_mu_max_in_flight(void)
+{
+    (void)pthread_once(&sim_se_once, sim_se_init);
+    return sim_se_mu_depth;
+}
+
+void sim_se_storage_access(void)
+{
+    (void)pthread_once(&sim_se_once, sim_se_init);
+    if (sim_se_storage_ns != 0u) {
+        sim_se_wait_until(sim_se_now() + sim_se_storage_ns);
+    }
+}
+
+const char *sim_se_nvm_dir(void)
+{
+    return sim_se_nvm_path;
+}
+
+static void *sim_se_engine_thread(void *arg);
+
+static void sim_se_init(void)
+{
+    const char *dir = getenv("SIM_SE_NVM_DIR");
+    uint32_t i;
+
+    sim_se_time_scale = sim_se_env("SIM_SE_TIME_SCALE", 100u);
+    sim_se_syscall_ns = sim_se_env("SIM_SE_SYSCALL_NS", 1000u);
+    sim_se_storage_ns = sim_se_env("SIM_SE_STORAGE_NS", 0u);
+    sim_se_mu_depth = sim_se_env("SIM_SE_MU_DEPTH", 1u);
+    sim_se_nvm_timeout_ms = sim_se_env("SIM_SE_NVM_TIMEOUT_MS", 5000u);
+    if (sim_se_mu_depth == 0u) {
+        sim_se_mu_depth = 1u;
+    }
+
+    if ((dir == NULL) || (*dir == '\0')) {
+        dir = "/tmp/sim_hsm";
+    }
+    (void)snprintf(sim_se_nvm_path, sizeof(sim_se_nvm_path), "%s/", dir);
+
+    for (i = 0u; i < SIM_SE_ENGINE_NB; i++) {
+        (void)pthread_mutex_init(&sim_se_engines[i].lock, NULL);
+        (void)pthread_cond_init(&sim_se_engines[i].cond, NULL);
+        sim_se_engines[i].id = i;
+        sim_se_engines[i].scale_pct = (i == SIM_SE_ENGINE_PLAT) ? 100u
+                                        : sim_se_env("SIM_SE_V2X_SCALE", 40u);
+    }
+}
+
+/* Engines are started on first use and live as long as the process. */
+static int32_t sim_se_engine_start(struct sim_se_engine *eng)
+{
+    pthread_attr_t attr;
+    int32_t err = 0;
+
+    (void)pthread_mutex_lock(&sim_se_lock);
+    if (eng->started == 0u) {
+        (void)pthread_attr_init(&attr);
+        (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        err = pthread_create(&eng->thread, &attr, sim_se_engine_thread, eng);
+        (void)pthread_attr_destroy(&attr);
+        if (err == 0) {
+            eng->started = 1u;
+        }
+    }
+    (void)pthread_mutex_unlock(&sim_se_lock);
+
+    return err;
+}
+
+struct sim_se_chan *sim_se_chan_open(uint32_t type)
+{
+    struct sim_se_chan *chan = NULL;
+    uint32_t engine, domain, is_nvm = 0u;
+
+    (void)pthread_once(&sim_se_once, sim_se_init);
+
+    switch (type) {
+    case MU_CHANNEL_PLAT_HSM:
+    case MU_CHANNEL_PLAT_HSM_2ND:
+        engine = SIM_SE_ENGINE_PLAT;
+        domain = SIM_SE_DOMAIN_PLAT;
+        break;
+    case MU_CHANNEL_PLAT_HSM_NVM:
+        engine = SIM_SE_ENGINE_PLAT;
+        domain = SIM_SE_DOMAIN_PLAT;
+        is_nvm = 1u;
+        break;
+    case MU_CHANNEL_V2X_SV0:
+        engine = SIM_SE_ENGINE_V2X_SV0;
+        domain = SIM_SE_DOMAIN_V2X;
+        break;
+    case MU_CHANNEL_V2X_SV1:
+        engine = SIM_SE_ENGINE_V2X_SV1;
+        domain = SIM_SE_DOMAIN_V2X;
+        break;
+    case MU_CHANNEL_V2X_SG0:
+        engine = SIM_SE_ENGINE_V2X_SG0;
+        domain = SIM_SE_DOMAIN_V2X;
+        break;
+    case MU_CHANNEL_V2X_SG1:
+        engine = SIM_SE_ENGINE_V2X_SG1;
+        domain = SIM_SE_DOMAIN_V2X;
+        break;
+    case MU_CHANNEL_V2X_HSM_NVM:
+        engine = SIM_SE_ENGINE_V2X_CTRL;
+        domain = SIM_SE_DOMAIN_V2X;
+        is_nvm = 1u;
+        break;
+    default:
+        /* SHE is not modelled. */
+        engine = SIM_SE_ENGINE_NB;
+        domain = SIM_SE_DOMAIN_NB;
+        break;
+    }
+
+    do {
+        if (engine == SIM_SE_ENGINE_NB) {
+            break;
+        }
+        if ((domain != SIM_SE_DOMAIN_PLAT) && (sim_se_has_v2x() == 0u)) {
+            break;
+        }
+        if (sim_se_engine_start(&sim_se_engines[engine]) != 0) {
+            break;
+        }
+
+        chan = calloc(1u, sizeof(struct sim_se_chan));
+        if (chan == NULL) {
+            break;
+        }
+        chan->type = type;
+        chan->engine = engine;
+        chan->domain = domain;
+        chan->is_nvm = is_nvm;
+        chan->map_next_addr = 0x10000u;
+        chan->pin_next_addr = SIM_SE_PIN_BASE;
+        chan->evfd = -1;
+        (void)pthread_mutex_init(&chan->lock, NULL);
+        (void)pthread_cond_init(&chan->cond, NULL);
+        (void)pthread_mutex_init(&chan->map_lock, NULL);
+
+        if (is_nvm != 0u) {
+            (void)pthread_mutex_lock(&sim_se_lock);
+            if (sim_se_nvm_chan[domain] == NULL) {
+                sim_se_nvm_chan[domain] = chan;
+            } else {
+                /* Only one storage manager per domain. */
+                free(chan);
+                chan = NULL;
+            }
+            (void)pthread_mutex_unlock(&sim_se_lock);
+        }
+    } while (false);
+
+    return chan;
+}
+
+/*
+ * The storage manager thread may be cancelled while blocked on a channel,
+ * make sure it does not leave the channel locked.
+ */
+static void sim_se_unlock(void *lock)
+{
+    (void)pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+static void sim_se_free_list(struct sim_se_msg *msg)
+{
+    struct sim_se_msg *next;
+
+    while (msg != NULL) {
+        next = msg->next;
+        free(msg);
+        msg = next;
+    }
+}
+
+/*
+ * Closing a channel with commands still queued on the engine is not
+ * supported: the caller must have read all the responses.
+ */
+void sim_se_chan_close(struct sim_se_chan *chan)
+{
+    if (chan->is_nvm != 0u) {
+        (void)pthread_mutex_lock(&sim_se_lock);
+        if (sim_se_nvm_chan[chan->domain] == chan) {
+            sim_se_nvm_chan[chan->domain] = NULL;
+        }
+        (void)pthread_mutex_unlock(&sim_se_lock);
+    }
+
+    (void)pthread_mutex_lock(&chan->lock);
+    chan->closed = 1u;
+    (void)pthread_cond_broadcast(&chan->cond);
+    (void)pthread_mutex_unlock(&chan->lock);
+
+    sim_se_free_list(chan->rx_head);
+    sim_se_free_list(chan->inbox);
+    if (chan->evfd >= 0) {
+        (void)close(chan->evfd);
+    }
+    (void)pthread_mutex_destroy(&chan->map_lock);
+    (void)pthread_cond_destroy(&chan->cond);
+    (void)pthread_mutex_destroy(&chan->lock);
+    free(chan);
+}
+
+static uint32_t sim_se_is_rsp_tag(uint8_t tag)
+{
+    return ((tag == MESSAGING_TAG_RESPONSE) || (tag == V2X_SV0_IND_TAG)
+            || (tag == V2X_SV1_IND_TAG) || (tag == V2X_SHE_IND_TAG)
+            || (tag == V2X_SG0_IND_TAG) || (tag == V2X_SG1_IND_TAG)) ? 1u : 0u;
+}
+
+/* Host to enclave: queue a command on the engine or deliver a response to a pending enclave request. */
+int32_t sim_se_chan_write(struct sim_se_chan *chan, uint32_t *msg, uint32_t size)
+{
+    struct sim_se_engine *eng = &sim_se_engines[chan->engine];
+    struct sim_se_req *req;
+    struct sim_se_msg *rsp;
+    struct sim_se_msg **last;
+    int32_t ret = -1;
+
+    do {
+        if ((size < sizeof(uint32_t)) || (size > sizeof(req->msg.words))) {
+            break;
+        }
+
+        if (sim_se_is_rsp_tag(((struct sab_mu_hdr *)msg)->tag) != 0u) {
+            rsp = malloc(sizeof(struct sim_se_msg));
+            if (rsp == NULL) {
+                break;
+            }
+            rsp->next = NULL;
+            rsp->len = size;
+            (void)memcpy(rsp->words, msg, size);
+
+            (void)pthread_mutex_lock(&chan->lock);
+            last = &chan->inbox;
+            while (*last != NULL) {
+                last = &(*last)->next;
+            }
+            *last = rsp;
+            (void)pthread_cond_broadcast(&chan->cond);
+            (void)pthread_mutex_unlock(&chan->lock);
+            ret = (int32_t)size;
+            break;
+        }
+
+        req = malloc(sizeof(struct sim_se_req));
+        if (req == NULL) {
+            break;
+        }
+        req->next = NULL;
+        req->chan = chan;
+        req->msg.len = size;
+        (void)memcpy(req->msg.words, msg, size);
+
+        /* Block while the channel already has its quota of commands in flight. */
+        (void)pthread_mutex_lock(&chan->lock);
+        pthread_cleanup_push(sim_se_unlock, &chan->lock);
+        while ((chan->in_flight >= sim_se_mu_depth) && (chan->closed == 0u)) {
+            (void)pthread_cond_wait(&chan->cond, &chan->lock);
+        }
+        chan->in_flight++;
+        pthread_cleanup_pop(1);
+
+        (void)pthread_mutex_lock(&eng->lock);
+        if (eng->tail != NULL) {
+            eng->tail->next = req;
+        } else {
+            eng->head = req;
+        }
+        eng->tail = req;
+        (void)pthread_cond_signal(&eng->cond);
+        (void)pthread_mutex_unlock(&eng->lock);
+
+        ret = (int32_t)size;
+    } while (false);
+
+    return ret;
+}
+
+/* Add nb messages to the eventfd count of a polled channel, chan->lock held. */
+static void sim_se_chan_signal(struct sim_se_chan *chan, uint64_t nb)
+{
+    if ((chan->evfd >= 0) && (nb != 0u)) {
+        (void)write(chan->evfd, &nb, sizeof(nb));
+    }
+}
+
+static void sim_se_post(struct sim_se_chan *chan, struct sim_se_msg *msg)
+{
+    msg->next = NULL;
+    (void)pthread_mutex_lock(&chan->lock);
+    if (chan->rx_tail != NULL) {
+        chan->rx_tail->next = msg;
+    } else {
+        chan->rx_head = msg;
+    }
+    chan->rx_tail = msg;
+    sim_se_chan_signal(chan, 1u);
+    (void)pthread_cond_broadcast(&chan->cond);
+    (void)pthread_mutex_unlock(&chan->lock);
+}
+
+/* Enclave to host: block until a message is available on the channel. */
+int32_t sim_se_chan_read(struct sim_se_chan *chan, uint32_t *msg, uint32_t size)
+{
+    struct sim_se_msg *rx;
+    uint64_t one;
+    uint32_t len;
+
+    (void)pthread_mutex_lock(&chan->lock);
+    pthread_cleanup_push(sim_se_unlock, &chan->lock);
+    while ((chan->rx_head == NULL) && (chan->closed == 0u)) {
+        (void)pthread_cond_wait(&chan->cond, &chan->lock);
+    }
+    rx = chan->rx_head;
+    if (rx != NULL) {
+        chan->rx_head = rx->next;
+        if (chan->rx_head == NULL) {
+            chan->rx_tail = NULL;
+        }
+        if (chan->evfd >= 0) {
+            /* Semaphore mode: one message less. */
+            (void)read(chan->evfd, &one, sizeof(one));
+        }
+        /* Responses free a slot, enclave requests (tagged as commands) do not. */
+        if ((sim_se_is_rsp_tag(((struct sab_mu_hdr *)rx->words)->tag) != 0u)
+            && (chan->in_flight > 0u)) {
+            chan->in_flight--;
+            (void)pthread_cond_broadcast(&chan->cond);
+        }
+    }
+    pthread_cleanup_pop(1);
+
+    if (rx == NULL) {
+        return -1;
+    }
+
+    len = (rx->len < size) ? rx->len : size;
+    (void)memcpy(msg, rx->words, len);
+    free(rx);
+
+    return (int32_t)len;
+}
+
+/*
+ * Eventfd readable while messages are queued on the channel, created on
+ * first use so that channels that are never polled do not pay for it.
+ */
+int32_t sim_se_chan_fd(struct sim_se_chan *chan)
+{
+    struct sim_se_msg *rx;
+    uint64_t nb = 0u;
+    int32_t fd;
+
+    (void)pthread_mutex_lock(&chan->lock);
+    if (chan->evfd < 0) {
+        chan->evfd = eventfd(0u, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+        for (rx = chan->rx_head; rx != NULL; rx = rx->next) {
+            nb++;
+        }
+        sim_se_chan_signal(chan, nb);
+    }
+    fd = chan->evfd;
+    (void)pthread_mutex_unlock(&chan->lock);
+
+    return fd;
+}
+
+/*
+ * Register a host buffer and return the 32 bits address the enclave will
+ * use to reach it. Addresses are allocated linearly and recycled once the
+ * 32 bits space wraps; the last SIM_SE_MAP_ENTRIES buffers stay reachable.
+ */
+uint32_t sim_se_chan_map(struct sim_se_chan *chan, uint8_t *ptr, uint32_t size)
+{
+    struct sim_se_map_entry *e;
+    uint32_t addr;
+
+    (void)pthread_mutex_lock(&chan->map_lock);
+    addr = (chan->map_next_addr + 63u) & ~63u;
+    if ((addr < chan->map_next_addr) || ((SIM_SE_PIN_BASE - addr) <= size)) {
+        addr = 0x10000u;
+    }
+    chan->map_next_addr = addr + size + 1u;
+
+    e = &chan->map[chan->map_head];
+    e->addr = addr;
+    e->size = size;
+    e->ptr = ptr;
+    chan->map_head = (chan->map_head + 1u) % SIM_SE_MAP_ENTRIES;
+    (void)pthread_mutex_unlock(&chan->map_lock);
+
+    return addr;
+}
+
+/*
+ * Register a host region reachable by the enclave until it is unpinned, as
+ * memory mapped once for all the commands. Pinned addresses are not reused.
+ * Return 0 if no entry or address range is left.
+ */
+uint32_t sim_se_chan_pin(struct sim_se_chan *chan, uint8_t *ptr, uint32_t size)
+{
+    struct sim_se_map_entry *e;
+    uint32_t addr = 0u;
+    uint32_t i;
+
+    (void)pthread_mutex_lock(&chan->map_lock);
+    for (i = 0u; i < SIM_SE_PIN_ENTRIES; i++) {
+        e = &chan->pin[i];
+        if (e->ptr == NULL) {
+            break;
+        }
+    }
+    if ((i < SIM_SE_PIN_ENTRIES) && (size != 0u)
+        && ((0xFFFFFFFFu - chan->pin_next_addr) > size)) {
+        addr = chan->pin_next_addr;
+        chan->pin_next_addr = (addr + size + 63u) & ~63u;
+        e->addr = addr;
+        e->size = size;
+        e->ptr = ptr;
+    }
+    (void)pthread_mutex_unlock(&chan->map_lock);
+
+    return addr;
+}
+
+void sim_se_chan_unpin(struct sim_se_chan *chan, uint8_t *ptr)
+{
+    uint32_t i;
+
+    (void)pthread_mutex_lock(&chan->map_lock);
+    for (i = 0u; i < SIM_SE_PIN_ENTRIES; i++) {
+        if (chan->pin[i].ptr == ptr) {
+            chan->pin[i].ptr = NULL;
+            break;
+        }
+    }
+    (void)pthread_mutex_unlock(&chan->map_lock);
+}
+
+uint8_t *sim_se_chan_resolve(struct sim_se_chan *chan, uint32_t addr, uint32_t size)
+{
+    struct sim_se_map_entry *e;
+    uint8_t *ptr = NULL;
+    uint32_t i, idx;
+
+    (void)pthread_mutex_lock(&chan->map_lock);
+    for (i = 0u; (addr >= SIM_SE_PIN_BASE) && (i < SIM_SE_PIN_ENTRIES); i++) {
+        e = &chan->pin[i];
+        if ((e->ptr != NULL) && (addr >= e->addr)
+            && ((addr - e->addr) <= e->size) && (size <= (e->size - (addr - e->addr)))) {
+            ptr = e->ptr + (addr - e->addr);
+            break;
+        }
+    }
+    for (i = 1u; (ptr == NULL) && (i <= SIM_SE_MAP_ENTRIES); i++) {
+        idx = (chan->map_head + SIM_SE_MAP_ENTRIES - i) % SIM_SE_MAP_ENTRIES;
+        e = &chan->map[idx];
+        if ((e->ptr != NULL) && (addr >= e->addr)
+            && ((addr - e->addr) <= e->size) && (size <= (e->size - (addr - e->addr)))) {
+            ptr = e->ptr + (addr - e->addr);
+            break;
+        }
+    }
+    (void)pthread_mutex_unlock(&chan->map_lock);
+
+    return ptr;
+}
+
+static uint64_t sim_se_service_ns(struct sim_se_engine *eng, struct sim_se_op *op)
+{
+    struct sim_se_cost cost;
+    uint64_t ns;
+
+    sim_se_get_cost((uint8_t)(op->cmd[0] >> 16), &cost);
+    ns = (uint64_t)cost.base_ns + (((uint64_t)cost.ps_per_byte * op->bytes) / 1000u);
+    ns = (ns * op->cost_pct) / 100u;
+    ns = (ns * eng->scale_pct) / 100u;
+
+    return (ns * sim_se_time_scale) / 100u;
+}
+
+static uint32_t sim_se_not_supported(struct sim_se_op *op)
+{
+    return SAB_FAILURE_STATUS | ((uint32_t)SAB_UNKNOWN_ID_RATING << 8);
+}
+
+static void *sim_se_engine_thread(void *arg)
+{
+    struct sim_se_engine *eng = (struct sim_se_engine *)arg;
+    struct sim_se_req *req;
+    struct sim_se_msg *rsp;
+    struct sim_se_op op;
+    struct sab_mu_hdr *hdr;
+    sim_se_handler_t handler;
+    uint64_t start;
+    uint32_t rsp_code;
+
+    while (true) {
+        (void)pthread_mutex_lock(&eng->lock);
+        while (eng->head == NULL) {
+            (void)pthread_cond_wait(&eng->cond, &eng->lock);
+        }
+        req = eng->head;
+        eng->head = req->next;
+        if (eng->head == NULL) {
+            eng->tail = NULL;
+        }
+        (void)pthread_mutex_unlock(&eng->lock);
+
+        start = sim_se_now();
+        hdr = (struct sab_mu_hdr *)req->msg.words;
+
+        rsp = calloc(1u, sizeof(struct sim_se_msg));
+        if (rsp == NULL) {
+            free(req);
+            continue;
+        }
+
+        op.chan = req->chan;
+        op.engine = eng->id;
+        op.cmd = req->msg.words;
+        op.cmd_len = req->msg.len;
+        op.rsp = rsp->words;
+        op.rsp_len = 2u * (uint32_t)sizeof(uint32_t);
+        op.bytes = 0u;
+        op.cost_pct = 100u;
+
+        handler = sim_se_get_handler(hdr->command, hdr->ver);
+        if (handler == NULL) {
+            handler = sim_se_not_supported;
+        }
+        rsp_code = handler(&op);
+
+        plat_fill_rsp_msg_hdr((struct sab_mu_hdr *)rsp->words, hdr->command, op.rsp_len, req->chan->type);
+        rsp->words[1] = rsp_code;
+        rsp->len = op.rsp_len;
+
+        sim_se_wait_until(start + sim_se_service_ns(eng, &op));
+        sim_se_post(req->chan, rsp);
+        free(req);
+    }
+
+    return NULL;
+}
+
+/* Wait for the host answer to an enclave request posted on an NVM channel. */
+static struct sim_se_msg *sim_se_nvm_wait(struct sim_se_chan *chan)
+{
+    struct sim_se_msg *rsp = NULL;
+    struct timespec ts;
+    int err = 0;
+
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(sim_se_nvm_timeout_ms / 1000u);
+    ts.tv_nsec += (long)(sim_se_nvm_timeout_ms % 1000u) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    (void)pthread_mutex_lock(&chan->lock);
+    while ((chan->inbox == NULL) && (chan->closed == 0u) && (err == 0)) {
+        err = pthread_cond_timedwait(&chan->cond, &chan->lock, &ts);
+    }
+    rsp = chan->inbox;
+    if (rsp != NULL) {
+        chan->inbox = rsp->next;
+    }
+    (void)pthread_mutex_unlock(&chan->lock);
+
+    return rsp;
+}
+
+static struct sim_se_msg *sim_se_nvm_request(struct sim_se_chan *chan, uint8_t cmd, uint32_t len)
+{
+    struct sim_se_msg *msg = calloc(1u, sizeof(struct sim_se_msg));
+
+    if (msg != NULL) {
+        plat_fill_cmd_msg_hdr((struct sab_mu_hdr *)msg->words, cmd, len, chan->type);
+        msg->len = len;
+    }
+    return msg;
+}
+
+/*
+ * Storage manager channel serving a domain. The platform manager serves the
+ * V2X domain too when no V2X manager is running, and the other way around.
+ */
+static struct sim_se_chan *sim_se_get_nvm_chan(uint32_t domain)
+{
+    struct sim_se_chan *chan;
+
+    (void)pthread_mutex_lock(&sim_se_lock);
+    chan = sim_se_nvm_chan[domain];
+    if ((chan == NULL) || (chan->storage_hdl == 0u)) {
+        chan = sim_se_nvm_chan[(domain + 1u) % SIM_SE_DOMAIN_NB];
+    }
+    if ((chan != NULL) && (chan->storage_hdl == 0u)) {
+        chan = NULL;
+    }
+    (void)pthread_mutex_unlock(&sim_se_lock);
+
+    return chan;
+}
+
+/* Finish an export sequence once the data have been copied. Return 0 on success. */
+static uint32_t sim_se_nvm_export_finish(struct sim_se_chan *chan)
+{
+    struct sab_cmd_key_store_export_finish_msg *finish;
+    struct sab_cmd_key_store_export_finish_rsp *finish_rsp;
+    struct sim_se_msg *msg, *rsp;
+    uint32_t err = 1u;
+
+    msg = sim_se_nvm_request(chan, SAB_STORAGE_EXPORT_FINISH_REQ,
+                             (uint32_t)sizeof(struct sab_cmd_key_store_export_finish_msg));
+    if (msg != NULL) {
+        finish = (struct sab_cmd_key_store_export_finish_msg *)msg->words;
+        finish->storage_handle = chan->storage_hdl;
+        finish->export_status = SAB_EXPORT_STATUS_SUCCESS;
+        sim_se_post(chan, msg);
+
+        rsp = sim_se_nvm_wait(chan);
+        if (rsp != NULL) {
+            finish_rsp = (struct sab_cmd_key_store_export_finish_rsp *)rsp->words;
+            if (finish_rsp->rsp_code == SAB_SUCCESS_STATUS) {
+                err = 0u;
+            }
+            free(rsp);
+        }
+    }
+
+    return err;
+}
+
+/*
+ * Export a master (SAB_STORAGE_MASTER_EXPORT_REQ) or chunk
+ * (SAB_STORAGE_CHUNK_EXPORT_REQ) blob through the storage manager.
+ * Return 0 on success.
+ */
+uint32_t sim_se_nvm_export(uint32_t domain, uint8_t cmd, uint64_t blob_id, uint8_t *blob, uint32_t len)
+{
+    struct sim_se_chan *chan = sim_se_get_nvm_chan(domain);
+    struct sab_cmd_key_store_export_start_msg *master;
+    struct sab_cmd_key_store_export_start_rsp *master_rsp;
+    struct sab_cmd_key_store_chunk_export_msg *chunk;
+    struct sab_cmd_key_store_chunk_export_rsp *chunk_rsp;
+    struct sim_se_msg *msg, *rsp = NULL;
+    uint32_t rsp_code = SAB_FAILURE_STATUS;
+    uint32_t addr = 0u;
+    uint8_t *dst;
+    uint32_t err = 1u;
+
+    do {
+        if (chan == NULL) {
+            break;
+        }
+
+        if (cmd == SAB_STORAGE_MASTER_EXPORT_REQ) {
+            msg = sim_se_nvm_request(chan, cmd, (uint32_t)sizeof(struct sab_cmd_key_store_export_start_msg));
+            if (msg == NULL) {
+                break;
+            }
+            master = (struct sab_cmd_key_store_export_start_msg *)msg->words;
+            master->storage_handle = chan->storage_hdl;
+            master->key_store_size = len;
+            sim_se_post(chan, msg);
+
+            rsp = sim_se_nvm_wait(chan);
+            if (rsp == NULL) {
+                break;
+            }
+            master_rsp = (struct sab_cmd_key_store_export_start_rsp *)rsp->words;
+            rsp_code = master_rsp->rsp_code;
+            addr = master_rsp->key_store_export_address;
+        } else {
+            msg = sim_se_nvm_request(chan, cmd, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_export_msg));
+            if (msg == NULL) {
+                break;
+            }
+            chunk = (struct sab_cmd_key_store_chunk_export_msg *)msg->words;
+            chunk->storage_handle = chan->storage_hdl;
+            chunk->chunk_size = len;
+            chunk->blob_id = (uint32_t)(blob_id & 0xFFFFFFFFu);
+            chunk->blob_id_ext = (uint32_t)(blob_id >> 32u);
+            (void)plat_compute_msg_crc(msg->words, (uint32_t)(sizeof(struct sab_cmd_key_store_chunk_export_msg) - sizeof(uint32_t)));
+            sim_se_post(chan, msg);
+
+            rsp = sim_se_nvm_wait(chan);
+            if (rsp == NULL) {
+                break;
+            }
+            chunk_rsp = (struct sab_cmd_key_store_chunk_export_rsp *)rsp->words;
+            rsp_code = chunk_rsp->rsp_code;
+            addr = chunk_rsp->chunk_export_address;
+        }
+
+        if (rsp_code != SAB_SUCCESS_STATUS) {
+            break;
+        }
+
+        dst = sim_se_chan_resolve(chan, addr, len);
+        if (dst == NULL) {
+            break;
+        }
+        (void)memcpy(dst, blob, len);
+
+        err = sim_se_nvm_export_finish(chan);
+    } while (false);
+
+    free(rsp);
+
+    return err;
+}
+
+/* Fetch a chunk blob from the storage manager. Return 0 on success. */
+uint32_t sim_se_nvm_get_chunk(uint32_t domain, uint64_t blob_id, uint8_t *blob, uint32_t max_len, uint32_t *len)
+{
+    struct sim_se_chan *chan = sim_se_get_nvm_chan(domain);
+    struct sab_cmd_key_store_chunk_get_msg *get;
+    struct sab_cmd_key_store_chunk_get_rsp *get_rsp;
+    struct sab_cmd_key_store_chunk_get_done_msg *done;
+    struct sim_se_msg *msg, *rsp = NULL;
+    uint8_t *src;
+    uint32_t err = 1u;
+
+    do {
+        if (chan == NULL) {
+            break;
+        }
+
+        msg = sim_se_nvm_request(chan, SAB_STORAGE_CHUNK_GET_REQ, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_get_msg));
+        if (msg == NULL) {
+            break;
+        }
+        get = (struct sab_cmd_key_store_chunk_get_msg *)msg->words;
+        get->storage_handle = chan->storage_hdl;
+        get->blob_id = (uint32_t)(blob_id & 0xFFFFFFFFu);
+        get->blob_id_ext = (uint32_t)(blob_id >> 32u);
+        sim_se_post(chan, msg);
+
+        rsp = sim_se_nvm_wait(chan);
+        if (rsp == NULL) {
+            break;
+        }
+        get_rsp = (struct sab_cmd_key_store_chunk_get_rsp *)rsp->words;
+        if (get_rsp->rsp_code != SAB_SUCCESS_STATUS) {
+            /* Nothing else is expected from the manager in that case. */
+            break;
+        }
+
+        src = sim_se_chan_resolve(chan, get_rsp->chunk_addr, get_rsp->chunk_size);
+        if ((src != NULL) && (get_rsp->chunk_size <= max_len)) {
+            (void)memcpy(blob, src, get_rsp->chunk_size);
+            *len = get_rsp->chunk_size;
+            err = 0u;
+        }
+
+        msg = sim_se_nvm_request(chan, SAB_STORAGE_CHUNK_GET_DONE_REQ, (uint32_t)sizeof(struct sab_cmd_key_store_chunk_get_done_msg));
+        if (msg == NULL) {
+            err = 1u;
+            break;
+        }
+        done = (struct sab_cmd_key_store_chunk_get_done_msg *)msg->words;
+        done->storage_handle = chan->storage_hdl;
+        done->get_status = SAB_CHUNK_GET_STATUS_SUCCEEDED;
+        sim_se_post(chan, msg);
+
+        free(rsp);
+        rsp = sim_se_nvm_wait(chan);
+        if (rsp == NULL) {
+            err = 1u;
+        }
+    } while (false);
+
+    free(rsp);
+
+    return err;
+}
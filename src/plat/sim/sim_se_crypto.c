@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "sim_se.h"
+#include "sha2.h"
+
+/*
+ * Primitives used by the software enclave.
+ *
+ * SHA-2 is the real one of the library so digests can be checked against any
+ * other implementation. Everything else (block cipher, signatures, key derivation)
+ * is a cheap deterministic stand-in: it is self consistent (what the model
+ * encrypts it decrypts, what it signs it verifies) but provides no security.
+ */
+
+void sim_se_sha(uint32_t digest_size, const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    struct sha2_ctx ctx;
+
+    sha2_init(&ctx, digest_size);
+    sha2_update(&ctx, data, len);
+    sha2_final(&ctx, out);
+}
+
+/* Derive len bytes from a seed: SHA-256(seed || counter) blocks. */
+void sim_se_expand(const uint8_t *seed, uint32_t seed_len, uint8_t *out, uint32_t len)
+{
+    struct sha2_ctx ctx;
+    uint8_t blk[32];
+    uint8_t ctr[4];
+    uint32_t i = 0u;
+    uint32_t n;
+
+    while (len != 0u) {
+        ctr[0] = (uint8_t)(i >> 24); ctr[1] = (uint8_t)(i >> 16);
+        ctr[2] = (uint8_t)(i >> 8); ctr[3] = (uint8_t)i;
+        sha2_init(&ctx, 32u);
+        sha2_update(&ctx, seed, seed_len);
+        sha2_update(&ctx, ctr, sizeof(ctr));
+        sha2_final(&ctx, blk);
+        n = (len < sizeof(blk)) ? len : (uint32_t)sizeof(blk);
+        (void)memcpy(out, blk, n);
+        out += n;
+        len -= n;
+        i++;
+    }
+}
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64_t load64(const uint8_t *p)
+{
+    uint64_t v;
+
+    (void)memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void store64(uint8_t *p, uint64_t v)
+{
+    (void)memcpy(p, &v, sizeof(v));
+}
+
+#define SIM_SE_BLOCK_ROUNDS 8u
+
+/* 128-bit Feistel permutation keyed by 32 bytes of key material. */
+void sim_se_block_encrypt(const uint8_t *key, const uint8_t *in, uint8_t *out)
+{
+    uint64_t l = load64(in);
+    uint64_t r = load64(in + 8);
+    uint64_t t;
+    uint32_t i;
+
+    for (i = 0u; i < SIM_SE_BLOCK_ROUNDS; i++) {
+        t = l ^ mix64(r ^ load64(key + 8u * (i % 4u)) ^ i);
+        l = r;
+        r = t;
+    }
+    store64(out, l);
+    store64(out + 8, r);
+}
+
+void sim_se_block_decrypt(const uint8_t *key, const uint8_t *in, uint8_t *out)
+{
+    uint64_t l = load64(in);
+    uint64_t r = load64(in + 8);
+    uint64_t t;
+    uint32_t i;
+
+    for (i = SIM_SE_BLOCK_ROUNDS; i > 0u; i--) {
+        t = r ^ mix64(l ^ load64(key + 8u * ((i - 1u) % 4u)) ^ (i - 1u));
+        r = l;
+        l = t;
+    }
+    store64(out, l);
+    store64(out + 8, r);
+}
+
+static pthread_mutex_t rng_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t rng_state;
+
+void sim_se_random(uint8_t *out, uint32_t len)
+{
+    struct timespec ts;
+    uint64_t v;
+    uint32_t n;
+
+    (void)pthread_mutex_lock(&rng_lock);
+    if (rng_state == 0u) {
+        (void)clock_gettime(CLOCK_REALTIME, &ts);
+        rng_state = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ 0x9e3779b97f4a7c15ull;
+    }
+    while (len != 0u) {
+        rng_state += 0x9e3779b97f4a7c15ull;
+        v = mix64(rng_state);
+        n = (len < sizeof(v)) ? len : (uint32_t)sizeof(v);
+        (void)memcpy(out, &v, n);
+        out += n;
+        len -= n;
+    }
+    (void)pthread_mutex_unlock(&rng_lock);
+}
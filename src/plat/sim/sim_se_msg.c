@@ -0,0 +1,1835 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "hsm_api.h"
+#include "sab_msg_def.h"
+#include "sha2.h"
+#include "sab_sign_gen.h"
+#include "sab_verify_sign.h"
+#include "sab_hash.h"
+#include "sab_cipher.h"
+#include "sab_mac.h"
+#include "sab_key_generate.h"
+#include "sab_import_key.h"
+#include "sab_delete_key.h"
+#include "plat_os_abs.h"
+#include "plat_utils.h"
+#include "sim_se.h"
+
+/*
+ * SAB message decoding and enclave state of the software enclave.
+ *
+ * Keys are only represented by a 32 bytes seed from which everything else
+ * is derived:
+ * - public key: x || y where x = expand(seed) and y = expand("y" || x), so a
+ *   compressed point (x) can be decompressed without the private part.
+ * - signature: expand(SHA-256(x) || digest), digest being the input when
+ *   HSM_OP_*_FLAGS_INPUT_DIGEST and its SHA-256 otherwise.
+ * - block cipher: Feistel permutation keyed by SHA-256(seed).
+ * - MAC: SHA-256(SHA-256(seed) || payload).
+ *
+ * Persistent keys are grouped in key groups exported as chunks when a STRICT
+ * operation updates them. The master blob holds the key store list and the
+ * key id to key group directory. Groups are loaded back on first use and, when
+ * SIM_SE_RESIDENT_GROUPS is set, evicted in LRU order to model the limited
+ * enclave memory.
+ */
+
+#define SIM_SE_ERR(rating)          (SAB_FAILURE_STATUS | ((uint32_t)(rating) << 8))
+
+#define SIM_SE_MAX_OBJS             1024u
+#define SIM_SE_OBJ_IDX_BITS         10u
+#define SIM_SE_MAX_KEY_STORES       16u
+#define SIM_SE_MAX_GROUPS           1024u
+#define SIM_SE_MAX_KEYS_PER_GROUP   100u
+#define SIM_SE_MAX_DATA             32u
+#define SIM_SE_MAX_DATA_SZ          2048u
+#define SIM_SE_MAX_PUB_KEYS         256u
+#define SIM_SE_MAX_PUB_KEY_SZ       512u
+#define SIM_SE_SEED_SZ              32u
+#define SIM_SE_BLOB_MAX_SZ          (16u * 1024u - 16u)
+
+/* HSM_OP_GENERATE_SIGN_FLAGS_LOW_LATENCY_SIGNATURE, only defined by the non PSA API. */
+#define SIM_SE_SIGN_FLAGS_LOW_LATENCY   (1u << 2)
+
+#define SIM_SE_MASTER_MAGIC         0x4d455353u     /* "SSEM" */
+#define SIM_SE_CHUNK_MAGIC          0x43455353u     /* "SSEC" */
+
+enum sim_se_obj_kind {
+    SIM_SE_OBJ_FREE = 0,
+    SIM_SE_OBJ_SESSION,
+    SIM_SE_OBJ_KEY_STORE,
+    SIM_SE_OBJ_KEY_MGMT,
+    SIM_SE_OBJ_SIG_GEN,
+    SIM_SE_OBJ_SIG_VER,
+    SIM_SE_OBJ_HASH,
+    SIM_SE_OBJ_CIPHER,
+    SIM_SE_OBJ_MAC,
+    SIM_SE_OBJ_RNG,
+    SIM_SE_OBJ_DATA_STORAGE,
+    SIM_SE_OBJ_STORAGE,
+    SIM_SE_OBJ_SERVICE,             /* other services without specific state. */
+};
+
+struct sim_se_key {
+    uint32_t id;
+    uint16_t group;
+    uint16_t type;
+    uint16_t bits;
+    uint16_t pub_size;
+    uint8_t seed[SIM_SE_SEED_SZ];
+};
+
+struct sim_se_group {
+    uint16_t id;
+    uint8_t resident;
+    uint8_t dirty;                  /* modified since last export. */
+    uint8_t locked;                 /* HSM_OP_MANAGE_KEY_GROUP_FLAGS_CACHE_LOCKDOWN */
+    uint32_t nkeys;
+    uint64_t last_use;
+    struct sim_se_key keys[SIM_SE_MAX_KEYS_PER_GROUP];
+};
+
+struct sim_se_dir {
+    uint32_t key_id;
+    uint16_t group;
+    uint16_t persistent;
+};
+
+struct sim_se_data {
+    uint16_t id;
+    uint16_t len;
+    uint8_t data[SIM_SE_MAX_DATA_SZ];
+};
+
+struct sim_se_ks {
+    uint32_t id;
+    uint32_t nonce;
+    uint32_t next_key_id;
+    uint32_t opened;
+    uint32_t persistent;            /* key store known by the NVM. */
+    uint32_t ngroups;
+    struct sim_se_group *groups[SIM_SE_MAX_GROUPS];
+    uint32_t ndir;
+    uint32_t dir_cap;
+    struct sim_se_dir *dir;
+    uint32_t ndata;
+    struct sim_se_data *data[SIM_SE_MAX_DATA];
+};
+
+struct sim_se_pub_key {
+    uint32_t ref;
+    uint16_t size;
+    uint8_t key[SIM_SE_MAX_PUB_KEY_SZ];
+};
+
+struct sim_se_obj {
+    uint32_t hdl;
+    uint32_t kind;
+    uint32_t domain;
+    struct sim_se_ks *ks;
+    uint32_t prepared;              /* SIG_GEN: prepared signatures available. */
+    uint32_t npub;                  /* SIG_VER: imported public keys. */
+    struct sim_se_pub_key *pub;
+};
+
+struct sim_se_op_desc {
+    sim_se_handler_t handler;
+    uint32_t kind;                  /* object created by generic open handlers. */
+    struct sim_se_cost cost;
+};
+
+static pthread_mutex_t sim_se_state = PTHREAD_MUTEX_INITIALIZER;
+static struct sim_se_obj sim_se_objs[SIM_SE_MAX_OBJS];
+static uint32_t sim_se_obj_gen[SIM_SE_MAX_OBJS];
+static struct sim_se_ks *sim_se_ks[SIM_SE_MAX_KEY_STORES];
+static uint64_t sim_se_tick;
+static uint32_t sim_se_resident_groups;
+
+/*
+ * Objects handling. All the functions below are called with the state lock
+ * held.
+ */
+static struct sim_se_obj *sim_se_obj_new(uint32_t kind, uint32_t domain)
+{
+    struct sim_se_obj *obj = NULL;
+    uint32_t i;
+
+    for (i = 0u; i < SIM_SE_MAX_OBJS; i++) {
+        if (sim_se_objs[i].kind == SIM_SE_OBJ_FREE) {
+            obj = &sim_se_objs[i];
+            sim_se_obj_gen[i] = (sim_se_obj_gen[i] + 1u) & ((1u << (32u - SIM_SE_OBJ_IDX_BITS)) - 1u);
+            if (sim_se_obj_gen[i] == 0u) {
+                sim_se_obj_gen[i] = 1u;
+            }
+            (void)memset(obj, 0, sizeof(*obj));
+            obj->hdl = (sim_se_obj_gen[i] << SIM_SE_OBJ_IDX_BITS) | i;
+            obj->kind = kind;
+            obj->domain = domain;
+            break;
+        }
+    }
+
+    return obj;
+}
+
+static struct sim_se_obj *sim_se_obj_get(uint32_t hdl)
+{
+    struct sim_se_obj *obj = &sim_se_objs[hdl & (SIM_SE_MAX_OBJS - 1u)];
+
+    if ((obj->kind == SIM_SE_OBJ_FREE) || (obj->hdl != hdl)) {
+        obj = NULL;
+    }
+    return obj;
+}
+
+static void sim_se_obj_free(struct sim_se_obj *obj)
+{
+    if ((obj->kind == SIM_SE_OBJ_KEY_STORE) && (obj->ks != NULL)) {
+        obj->ks->opened = 0u;
+    }
+    free(obj->pub);
+    (void)memset(obj, 0, sizeof(*obj));
+}
+
+/* Key stores and key groups. */
+static struct sim_se_ks *sim_se_ks_find(uint32_t id)
+{
+    struct sim_se_ks *ks = NULL;
+    uint32_t i;
+
+    for (i = 0u; i < SIM_SE_MAX_KEY_STORES; i++) {
+        if ((sim_se_ks[i] != NULL) && (sim_se_ks[i]->id == id)) {
+            ks = sim_se_ks[i];
+            break;
+        }
+    }
+    return ks;
+}
+
+static struct sim_se_ks *sim_se_ks_new(uint32_t id, uint32_t nonce)
+{
+    struct sim_se_ks *ks = NULL;
+    uint32_t i;
+
+    for (i = 0u; i < SIM_SE_MAX_KEY_STORES; i++) {
+        if (sim_se_ks[i] == NULL) {
+            ks = calloc(1u, sizeof(struct sim_se_ks));
+            if (ks != NULL) {
+                ks->id = id;
+                ks->nonce = nonce;
+                ks->next_key_id = 1u;
+                sim_se_ks[i] = ks;
+            }
+            break;
+        }
+    }
+    return ks;
+}
+
+static void sim_se_ks_delete(struct sim_se_ks *ks)
+{
+    uint32_t i;
+
+    for (i = 0u; i < SIM_SE_MAX_KEY_STORES; i++) {
+        if (sim_se_ks[i] == ks) {
+            sim_se_ks[i] = NULL;
+        }
+    }
+    for (i = 0u; i < ks->ngroups; i++) {
+        free(ks->groups[i]);
+    }
+    for (i = 0u; i < ks->ndata; i++) {
+        free(ks->data[i]);
+    }
+    free(ks->dir);
+    free(ks);
+}
+
+static struct sim_se_group *sim_se_group_find(struct sim_se_ks *ks, uint16_t id)
+{
+    struct sim_se_group *grp = NULL;
+    uint32_t i;
+
+    for (i = 0u; i < ks->ngroups; i++) {
+        if (ks->groups[i]->id == id) {
+            grp = ks->groups[i];
+            break;
+        }
+    }
+    return grp;
+}
+
+static struct sim_se_group *sim_se_group_new(struct sim_se_ks *ks, uint16_t id)
+{
+    struct sim_se_group *grp = NULL;
+
+    if (ks->ngroups < SIM_SE_MAX_GROUPS) {
+        grp = calloc(1u, sizeof(struct sim_se_group));
+        if (grp != NULL) {
+            grp->id = id;
+            ks->groups[ks->ngroups++] = grp;
+        }
+    }
+    return grp;
+}
+
+static uint64_t sim_se_blob_id(struct sim_se_ks *ks, uint16_t group)
+{
+    return ((uint64_t)ks->id << 32u) | (uint64_t)group;
+}
+
+/* Drop the least recently used clean groups above the residency budget. */
+static void sim_se_group_evict(struct sim_se_ks *ks, struct sim_se_group *keep)
+{
+    struct sim_se_group *lru;
+    uint32_t resident, i;
+
+    if (sim_se_resident_groups == 0u) {
+        return;
+    }
+
+    while (true) {
+        resident = 0u;
+        lru = NULL;
+        for (i = 0u; i < ks->ngroups; i++) {
+            if (ks->groups[i]->resident == 0u) {
+                continue;
+            }
+            resident++;
+            if ((ks->groups[i] != keep) && (ks->groups[i]->dirty == 0u)
+                && (ks->groups[i]->locked == 0u)
+                && ((lru == NULL) || (ks->groups[i]->last_use < lru->last_use))) {
+                lru = ks->groups[i];
+            }
+        }
+        if ((resident <= sim_se_resident_groups) || (lru == NULL)) {
+            break;
+        }
+        lru->resident = 0u;
+        lru->nkeys = 0u;
+    }
+}
+
+static uint32_t sim_se_group_load(struct sim_se_ks *ks, struct sim_se_group *grp, uint32_t domain)
+{
+    uint8_t *blob;
+    uint32_t *hdr;
+    uint32_t len = 0u;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_NOT_POSSIBLE_RETRIEVE_CHUNK);
+
+    blob = malloc(SIM_SE_BLOB_MAX_SZ);
+    if (blob != NULL) {
+        if (sim_se_nvm_get_chunk(domain, sim_se_blob_id(ks, grp->id), blob, SIM_SE_BLOB_MAX_SZ, &len) == 0u) {
+            hdr = (uint32_t *)blob;
+            if ((len >= 4u * sizeof(uint32_t)) && (hdr[0] == SIM_SE_CHUNK_MAGIC)
+                && (hdr[1] == ks->id) && (hdr[2] == grp->id)
+                && (hdr[3] <= SIM_SE_MAX_KEYS_PER_GROUP)
+                && (len >= (4u * sizeof(uint32_t)) + (hdr[3] * sizeof(struct sim_se_key)))) {
+                grp->nkeys = hdr[3];
+                (void)memcpy(grp->keys, blob + (4u * sizeof(uint32_t)), grp->nkeys * sizeof(struct sim_se_key));
+                grp->resident = 1u;
+                grp->dirty = 0u;
+                rsp_code = SAB_SUCCESS_STATUS;
+            }
+        }
+        free(blob);
+    }
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_group_use(struct sim_se_ks *ks, struct sim_se_group *grp, uint32_t domain)
+{
+    uint32_t rsp_code = SAB_SUCCESS_STATUS;
+
+    if (grp->resident == 0u) {
+        rsp_code = sim_se_group_load(ks, grp, domain);
+    }
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        grp->last_use = ++sim_se_tick;
+        sim_se_group_evict(ks, grp);
+    }
+    return rsp_code;
+}
+
+static uint32_t sim_se_export_chunk(struct sim_se_ks *ks, struct sim_se_group *grp, uint32_t domain)
+{
+    uint32_t len = (4u * (uint32_t)sizeof(uint32_t)) + (grp->nkeys * (uint32_t)sizeof(struct sim_se_key));
+    uint32_t *blob = malloc(len);
+    uint32_t rsp_code = SIM_SE_ERR(SAB_NVM_ERROR_RATING);
+
+    if (blob != NULL) {
+        blob[0] = SIM_SE_CHUNK_MAGIC;
+        blob[1] = ks->id;
+        blob[2] = grp->id;
+        blob[3] = grp->nkeys;
+        (void)memcpy(&blob[4], grp->keys, grp->nkeys * sizeof(struct sim_se_key));
+        if (sim_se_nvm_export(domain, SAB_STORAGE_CHUNK_EXPORT_REQ, sim_se_blob_id(ks, grp->id), (uint8_t *)blob, len) == 0u) {
+            grp->dirty = 0u;
+            rsp_code = SAB_SUCCESS_STATUS;
+        }
+        free(blob);
+    }
+    return rsp_code;
+}
+
+/*
+ * Master blob: magic, number of key stores, then for each persistent key
+ * store: id, nonce, next key id, number of persistent keys and the list of
+ * (key id, group) pairs.
+ */
+static uint32_t sim_se_export_master(uint32_t domain)
+{
+    uint32_t *blob;
+    uint32_t len = 2u;
+    uint32_t nks = 0u;
+    uint32_t i, j, n, cnt_idx;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_NVM_ERROR_RATING);
+
+    blob = malloc(SIM_SE_BLOB_MAX_SZ);
+    if (blob == NULL) {
+        return rsp_code;
+    }
+
+    for (i = 0u; i < SIM_SE_MAX_KEY_STORES; i++) {
+        if ((sim_se_ks[i] == NULL) || (sim_se_ks[i]->persistent == 0u)) {
+            continue;
+        }
+        if (((len + 4u) * sizeof(uint32_t)) > SIM_SE_BLOB_MAX_SZ) {
+            break;
+        }
+        blob[len++] = sim_se_ks[i]->id;
+        blob[len++] = sim_se_ks[i]->nonce;
+        blob[len++] = sim_se_ks[i]->next_key_id;
+        cnt_idx = len++;
+        n = 0u;
+        for (j = 0u; j < sim_se_ks[i]->ndir; j++) {
+            if (sim_se_ks[i]->dir[j].persistent == 0u) {
+                continue;
+            }
+            if (((len + 2u) * sizeof(uint32_t)) > SIM_SE_BLOB_MAX_SZ) {
+                break;
+            }
+            blob[len++] = sim_se_ks[i]->dir[j].key_id;
+            blob[len++] = sim_se_ks[i]->dir[j].group;
+            n++;
+        }
+        blob[cnt_idx] = n;
+        nks++;
+    }
+    blob[0] = SIM_SE_MASTER_MAGIC;
+    blob[1] = nks;
+
+    if (sim_se_nvm_export(domain, SAB_STORAGE_MASTER_EXPORT_REQ, 0u, (uint8_t *)blob, len * (uint32_t)sizeof(uint32_t)) == 0u) {
+        rsp_code = SAB_SUCCESS_STATUS;
+    }
+    free(blob);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_import_master(uint32_t *blob, uint32_t len)
+{
+    struct sim_se_ks *ks;
+    struct sim_se_group *grp;
+    uint32_t words = len / (uint32_t)sizeof(uint32_t);
+    uint32_t pos = 2u;
+    uint32_t i, j, n;
+
+    if ((words < 2u) || (blob[0] != SIM_SE_MASTER_MAGIC)) {
+        return SIM_SE_ERR(SAB_INVALID_MESSAGE_RATING);
+    }
+
+    for (i = 0u; (i < blob[1]) && ((pos + 4u) <= words); i++) {
+        ks = sim_se_ks_find(blob[pos]);
+        if ((ks != NULL) && (ks->opened == 0u)) {
+            sim_se_ks_delete(ks);
+            ks = NULL;
+        }
+        if (ks == NULL) {
+            ks = sim_se_ks_new(blob[pos], blob[pos + 1u]);
+        }
+        n = blob[pos + 3u];
+        if ((ks == NULL) || (ks->opened != 0u) || ((pos + 4u + (2u * n)) > words)) {
+            pos += 4u + (2u * n);
+            continue;
+        }
+        ks->next_key_id = blob[pos + 2u];
+        ks->persistent = 1u;
+        pos += 4u;
+        ks->dir = calloc(n + 1u, sizeof(struct sim_se_dir));
+        ks->dir_cap = (ks->dir != NULL) ? (n + 1u) : 0u;
+        for (j = 0u; (j < n) && (ks->dir != NULL); j++) {
+            ks->dir[j].key_id = blob[pos];
+            ks->dir[j].group = (uint16_t)blob[pos + 1u];
+            ks->dir[j].persistent = 1u;
+            ks->ndir++;
+            if (sim_se_group_find(ks, (uint16_t)blob[pos + 1u]) == NULL) {
+                grp = sim_se_group_new(ks, (uint16_t)blob[pos + 1u]);
+                (void)grp;
+            }
+            pos += 2u;
+        }
+    }
+
+    return SAB_SUCCESS_STATUS;
+}
+
+static struct sim_se_dir *sim_se_dir_find(struct sim_se_ks *ks, uint32_t key_id)
+{
+    struct sim_se_dir *d = NULL;
+    uint32_t i;
+
+    for (i = 0u; i < ks->ndir; i++) {
+        if (ks->dir[i].key_id == key_id) {
+            d = &ks->dir[i];
+            break;
+        }
+    }
+    return d;
+}
+
+/* Resolve a key used by a service, loading its group if needed. */
+static uint32_t sim_se_key_get(uint32_t svc_hdl, uint32_t key_id, struct sim_se_key *out)
+{
+    struct sim_se_obj *obj;
+    struct sim_se_dir *d;
+    struct sim_se_group *grp;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_ID_RATING);
+    uint32_t i;
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    do {
+        obj = sim_se_obj_get(svc_hdl);
+        if ((obj == NULL) || (obj->ks == NULL)) {
+            rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+            break;
+        }
+        d = sim_se_dir_find(obj->ks, key_id);
+        if (d == NULL) {
+            break;
+        }
+        grp = sim_se_group_find(obj->ks, d->group);
+        if (grp == NULL) {
+            break;
+        }
+        rsp_code = sim_se_group_use(obj->ks, grp, obj->domain);
+        if (rsp_code != SAB_SUCCESS_STATUS) {
+            break;
+        }
+        rsp_code = SIM_SE_ERR(SAB_UNKNOWN_ID_RATING);
+        for (i = 0u; i < grp->nkeys; i++) {
+            if (grp->keys[i].id == key_id) {
+                *out = grp->keys[i];
+                rsp_code = SAB_SUCCESS_STATUS;
+                break;
+            }
+        }
+    } while (false);
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+/*
+ * Add a key to a key store. A STRICT request is acknowledged only once the
+ * updated group and master have been exported.
+ */
+static uint32_t sim_se_key_add(struct sim_se_obj *obj, struct sim_se_key *key, uint32_t persistent, uint32_t strict)
+{
+    struct sim_se_ks *ks = obj->ks;
+    struct sim_se_group *grp;
+    struct sim_se_dir *d;
+    uint32_t rsp_code;
+    uint32_t i;
+
+    do {
+        if (key->id == 0u) {
+            key->id = ks->next_key_id++;
+        } else if (key->id >= ks->next_key_id) {
+            ks->next_key_id = key->id + 1u;
+        }
+
+        grp = sim_se_group_find(ks, key->group);
+        if (grp == NULL) {
+            grp = sim_se_group_new(ks, key->group);
+            if (grp == NULL) {
+                rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+                break;
+            }
+            grp->resident = 1u;
+        }
+        rsp_code = sim_se_group_use(ks, grp, obj->domain);
+        if (rsp_code != SAB_SUCCESS_STATUS) {
+            break;
+        }
+
+        d = sim_se_dir_find(ks, key->id);
+        if (d != NULL) {
+            if (d->group != key->group) {
+                rsp_code = SIM_SE_ERR(SAB_ID_CONFLICT_RATING);
+                break;
+            }
+            for (i = 0u; i < grp->nkeys; i++) {
+                if (grp->keys[i].id == key->id) {
+                    grp->keys[i] = *key;
+                    break;
+                }
+            }
+        } else {
+            if (grp->nkeys >= SIM_SE_MAX_KEYS_PER_GROUP) {
+                rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEM_TO_STORE_KEY_IN_KEYGRP);
+                break;
+            }
+            if (ks->ndir == ks->dir_cap) {
+                d = realloc(ks->dir, (ks->dir_cap + 64u) * sizeof(struct sim_se_dir));
+                if (d == NULL) {
+                    rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+                    break;
+                }
+                ks->dir = d;
+                ks->dir_cap += 64u;
+            }
+            d = &ks->dir[ks->ndir++];
+            d->key_id = key->id;
+            d->group = key->group;
+            d->persistent = (uint16_t)persistent;
+            grp->keys[grp->nkeys++] = *key;
+        }
+
+        if (persistent != 0u) {
+            grp->dirty = 1u;
+        }
+        if ((persistent != 0u) && (strict != 0u)) {
+            ks->persistent = 1u;
+            rsp_code = sim_se_export_chunk(ks, grp, obj->domain);
+            if (rsp_code == SAB_SUCCESS_STATUS) {
+                rsp_code = sim_se_export_master(obj->domain);
+            }
+        }
+    } while (false);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_key_del(struct sim_se_obj *obj, uint32_t key_id, uint32_t strict)
+{
+    struct sim_se_ks *ks = obj->ks;
+    struct sim_se_group *grp;
+    struct sim_se_dir *d;
+    uint32_t persistent;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_ID_RATING);
+    uint32_t i;
+
+    do {
+        d = sim_se_dir_find(ks, key_id);
+        if (d == NULL) {
+            break;
+        }
+        grp = sim_se_group_find(ks, d->group);
+        if (grp == NULL) {
+            break;
+        }
+        rsp_code = sim_se_group_use(ks, grp, obj->domain);
+        if (rsp_code != SAB_SUCCESS_STATUS) {
+            break;
+        }
+        for (i = 0u; i < grp->nkeys; i++) {
+            if (grp->keys[i].id == key_id) {
+                grp->keys[i] = grp->keys[--grp->nkeys];
+                break;
+            }
+        }
+        persistent = d->persistent;
+        *d = ks->dir[--ks->ndir];
+        if (persistent != 0u) {
+            grp->dirty = 1u;
+            if (strict != 0u) {
+                rsp_code = sim_se_export_chunk(ks, grp, obj->domain);
+                if (rsp_code == SAB_SUCCESS_STATUS) {
+                    rsp_code = sim_se_export_master(obj->domain);
+                }
+            }
+        }
+    } while (false);
+
+    return rsp_code;
+}
+
+/* Derived values. */
+static void sim_se_pub_key(struct sim_se_key *key, uint8_t *out, uint32_t size)
+{
+    uint32_t half = size / 2u;
+    uint8_t seed[SIM_SE_SEED_SZ + 1u];
+
+    seed[0] = 'p';
+    (void)memcpy(&seed[1], key->seed, SIM_SE_SEED_SZ);
+    sim_se_expand(seed, sizeof(seed), out, half);
+    seed[0] = 'y';
+    sim_se_expand(out, half, out + half, size - half);
+}
+
+/* SHA-256 of the x coordinate of an uncompressed public key. */
+static void sim_se_pub_digest(uint8_t *key, uint32_t size, uint8_t *out)
+{
+    sim_se_sha(32u, key, size / 2u, out);
+}
+
+/* The RSA and ECDSA schemes are modelled, SM2 is not. */
+static uint32_t sim_se_scheme_check(uint32_t scheme)
+{
+#ifdef PSA_COMPLIANT
+    switch (scheme & 0xFFFFFF00u) {
+    case 0x06000200u:   /* RSA PKCS#1 v1.5 */
+    case 0x06000300u:   /* RSA PSS */
+    case 0x06000600u:   /* ECDSA */
+        return SAB_SUCCESS_STATUS;
+    default:
+        return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+    }
+#else
+    return (scheme == HSM_SIGNATURE_SCHEME_DSA_SM2_FP_256_SM3) ?
+        SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING) : SAB_SUCCESS_STATUS;
+#endif
+}
+
+/* Neither are the SM2 and SM4 keys. */
+static uint32_t sim_se_key_type_check(uint32_t type)
+{
+#ifdef PSA_COMPLIANT
+    return (type == HSM_KEY_TYPE_SM4) ? SIM_SE_ERR(SAB_KEY_NOT_SUPPORTED_RATING) : SAB_SUCCESS_STATUS;
+#else
+    return ((type == HSM_KEY_TYPE_DSA_SM2_FP_256) || (type == HSM_KEY_TYPE_SM4_128)) ?
+        SIM_SE_ERR(SAB_KEY_NOT_SUPPORTED_RATING) : SAB_SUCCESS_STATUS;
+#endif
+}
+
+static void sim_se_signature(uint8_t *pub_digest, uint8_t *msg, uint32_t msg_size, uint32_t is_message,
+                             uint8_t *sig, uint32_t sig_size)
+{
+    uint8_t seed[64];
+
+    (void)memcpy(seed, pub_digest, 32u);
+    if (is_message != 0u) {
+        sim_se_sha(32u, msg, msg_size, &seed[32]);
+    } else {
+        (void)memset(&seed[32], 0, 32u);
+        (void)memcpy(&seed[32], msg, (msg_size < 32u) ? msg_size : 32u);
+    }
+    sim_se_expand(seed, sizeof(seed), sig, sig_size);
+}
+
+static void sim_se_cipher_key(struct sim_se_key *key, uint8_t *out)
+{
+    sim_se_sha(32u, key->seed, SIM_SE_SEED_SZ, out);
+}
+
+static void sim_se_ctr_xor(uint8_t *ckey, uint8_t *iv, uint8_t *in, uint8_t *out, uint32_t len)
+{
+    uint8_t ctr[16];
+    uint8_t ks[16];
+    uint32_t i, j;
+
+    (void)memcpy(ctr, iv, sizeof(ctr));
+    for (i = 0u; i < len; i += 16u) {
+        sim_se_block_encrypt(ckey, ctr, ks);
+        for (j = 0u; (j < 16u) && ((i + j) < len); j++) {
+            out[i + j] = in[i + j] ^ ks[j];
+        }
+        /* Big endian increment of the full counter block. */
+        for (j = 16u; j > 0u; j--) {
+            if (++ctr[j - 1u] != 0u) {
+                break;
+            }
+        }
+    }
+    (void)memcpy(iv, ctr, sizeof(ctr));
+}
+
+static void sim_se_mac(struct sim_se_key *key, uint8_t *data, uint32_t len, uint8_t *out, uint32_t out_len)
+{
+    struct sha2_ctx ctx;
+    uint8_t ckey[32];
+    uint8_t digest[32];
+
+    sim_se_cipher_key(key, ckey);
+    sha2_init(&ctx, 32u);
+    sha2_update(&ctx, ckey, sizeof(ckey));
+    sha2_update(&ctx, data, len);
+    sha2_final(&ctx, digest);
+    (void)memcpy(out, digest, (out_len < sizeof(digest)) ? out_len : sizeof(digest));
+}
+
+static uint8_t *sim_se_buf(struct sim_se_op *op, uint32_t addr, uint32_t size)
+{
+    op->bytes += size;
+    return sim_se_chan_resolve(op->chan, addr, size);
+}
+
+/* Sessions and services. */
+static uint32_t sim_se_session_open(struct sim_se_op *op)
+{
+    struct sab_cmd_session_open_rsp *rsp = (struct sab_cmd_session_open_rsp *)op->rsp;
+    struct sim_se_obj *obj;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_new(SIM_SE_OBJ_SESSION, op->chan->domain);
+    if (obj != NULL) {
+        rsp->session_handle = obj->hdl;
+        rsp_code = SAB_SUCCESS_STATUS;
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_session_open_rsp);
+
+    return rsp_code;
+}
+
+static const struct sim_se_op_desc *sim_se_desc(uint8_t cmd);
+
+/*
+ * All the service open messages carry the parent handle in their first word
+ * and all the responses return the new handle right after the response code.
+ */
+static uint32_t sim_se_service_open(struct sim_se_op *op)
+{
+    struct sim_se_obj *parent, *obj;
+    uint8_t cmd = ((struct sab_mu_hdr *)op->cmd)->command;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    parent = sim_se_obj_get(op->cmd[1]);
+    if (parent != NULL) {
+        obj = sim_se_obj_new(sim_se_desc(cmd)->kind, parent->domain);
+        if (obj != NULL) {
+            obj->ks = parent->ks;
+            op->rsp[2] = obj->hdl;
+            rsp_code = SAB_SUCCESS_STATUS;
+        } else {
+            rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+        }
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+    op->rsp_len = 3u * (uint32_t)sizeof(uint32_t);
+
+    return rsp_code;
+}
+
+/* All the close messages carry the handle to be closed in their first word. */
+static uint32_t sim_se_service_close(struct sim_se_op *op)
+{
+    struct sim_se_obj *obj;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_get(op->cmd[1]);
+    if (obj != NULL) {
+        if ((obj->kind == SIM_SE_OBJ_STORAGE) && (op->chan->storage_hdl == obj->hdl)) {
+            op->chan->storage_hdl = 0u;
+        }
+        sim_se_obj_free(obj);
+        rsp_code = SAB_SUCCESS_STATUS;
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_storage_open(struct sim_se_op *op)
+{
+    uint32_t rsp_code = sim_se_service_open(op);
+
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        op->chan->storage_hdl = op->rsp[2];
+    }
+    return rsp_code;
+}
+
+static uint32_t sim_se_shared_buf(struct sim_se_op *op)
+{
+    struct sab_cmd_shared_buffer_rsp *rsp = (struct sab_cmd_shared_buffer_rsp *)op->rsp;
+
+    rsp->shared_buf_offset = 0u;
+    rsp->shared_buf_size = 0x3E0u;
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_shared_buffer_rsp);
+
+    return SAB_SUCCESS_STATUS;
+}
+
+static uint32_t sim_se_get_info(struct sim_se_op *op)
+{
+    struct sab_cmd_get_info_rsp *rsp = (struct sab_cmd_get_info_rsp *)op->rsp;
+
+    rsp->user_sab_id = 0x53494d00u;     /* "SIM" */
+    rsp->uid_lower = 0x01234567u;
+    rsp->uid_upper = 0x89abcdefu;
+    rsp->monotonic_counter = 0u;
+    rsp->lifecycle = 0x20u;
+    rsp->version = 0x00010000u;
+    rsp->version_ext = 0u;
+    rsp->fips_mode = 0u;
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_get_info_rsp);
+
+    return SAB_SUCCESS_STATUS;
+}
+
+static uint32_t sim_se_debug_dump(struct sim_se_op *op)
+{
+    op->rsp_len = 3u * (uint32_t)sizeof(uint32_t);
+
+    return ROM_SUCCESS_STATUS;
+}
+
+static uint32_t sim_se_success(struct sim_se_op *op)
+{
+    return SAB_SUCCESS_STATUS;
+}
+
+/* Commands whose cryptography is not modelled (SM2/SM3/SM4, ECIES, AEAD, key exchange). */
+static uint32_t sim_se_not_supported(struct sim_se_op *op)
+{
+    return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+}
+
+/* Key store. */
+static uint32_t sim_se_key_store_open(struct sim_se_op *op)
+{
+    struct sab_cmd_key_store_open_msg *cmd = (struct sab_cmd_key_store_open_msg *)op->cmd;
+    struct sab_cmd_key_store_open_rsp *rsp = (struct sab_cmd_key_store_open_rsp *)op->rsp;
+    struct sim_se_obj *session, *obj;
+    struct sim_se_ks *ks;
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_key_store_open_rsp);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    do {
+        session = sim_se_obj_get(cmd->session_handle);
+        if ((session == NULL) || (session->kind != SIM_SE_OBJ_SESSION)) {
+            rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+            break;
+        }
+
+        ks = sim_se_ks_find(cmd->key_store_id);
+        if ((cmd->flags & HSM_SVC_KEY_STORE_FLAGS_CREATE) != 0u) {
+            if (ks != NULL) {
+                rsp_code = SIM_SE_ERR(SAB_KEY_STORE_CONFLICT_RATING);
+                break;
+            }
+            ks = sim_se_ks_new(cmd->key_store_id, cmd->password);
+            if (ks == NULL) {
+                rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+                break;
+            }
+        } else if (ks == NULL) {
+            rsp_code = SIM_SE_ERR(SAB_UNKNOWN_KEY_STORE_RATING);
+            break;
+        } else if (ks->nonce != cmd->password) {
+            rsp_code = SIM_SE_ERR(SAB_KEY_STORE_AUTH_RATING);
+            break;
+        } else if (ks->opened != 0u) {
+            rsp_code = SIM_SE_ERR(SAB_KEY_STORE_CONFLICT_RATING);
+            break;
+        }
+
+        obj = sim_se_obj_new(SIM_SE_OBJ_KEY_STORE, session->domain);
+        if (obj == NULL) {
+            rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+            break;
+        }
+        obj->ks = ks;
+        ks->opened = 1u;
+        rsp->key_store_handle = obj->hdl;
+        rsp_code = SAB_SUCCESS_STATUS;
+
+        if (((cmd->flags & HSM_SVC_KEY_STORE_FLAGS_CREATE) != 0u)
+            && ((cmd->flags & HSM_SVC_KEY_STORE_FLAGS_STRICT_OPERATION) != 0u)) {
+            ks->persistent = 1u;
+            rsp_code = sim_se_export_master(session->domain);
+        }
+    } while (false);
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_master_import(struct sim_se_op *op)
+{
+    struct sab_cmd_key_store_import_msg *cmd = (struct sab_cmd_key_store_import_msg *)op->cmd;
+    uint8_t *blob = sim_se_buf(op, cmd->key_store_address, cmd->key_store_size);
+    uint32_t rsp_code = SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+
+    if (blob != NULL) {
+        (void)pthread_mutex_lock(&sim_se_state);
+        rsp_code = sim_se_import_master((uint32_t *)blob, cmd->key_store_size);
+        (void)pthread_mutex_unlock(&sim_se_state);
+    }
+    return rsp_code;
+}
+
+/* Key management. */
+static uint32_t sim_se_key_generate(struct sim_se_op *op)
+{
+    struct sab_cmd_generate_key_msg *cmd = (struct sab_cmd_generate_key_msg *)op->cmd;
+    struct sab_cmd_generate_key_rsp *rsp = (struct sab_cmd_generate_key_rsp *)op->rsp;
+    struct sim_se_obj *obj;
+    struct sim_se_key key;
+    uint8_t *out = NULL;
+    uint32_t persistent;
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_generate_key_rsp);
+
+    rsp_code = sim_se_key_type_check(cmd->key_type);
+    if (rsp_code != SAB_SUCCESS_STATUS) {
+        return rsp_code;
+    }
+
+    (void)memset(&key, 0, sizeof(key));
+    key.group = cmd->key_group;
+    key.type = cmd->key_type;
+#ifdef PSA_COMPLIANT
+    key.bits = cmd->key_sz;
+    persistent = (cmd->key_lifetime != HSM_KEY_LIFE_VOLATILE) ? 1u : 0u;
+#else
+    /* The size is given by the type, keys are not updated in place. */
+    if ((cmd->flags & HSM_OP_KEY_GENERATION_FLAGS_UPDATE) != 0u) {
+        return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+    }
+    persistent = ((cmd->key_info & HSM_KEY_INFO_TRANSIENT) == 0u) ? 1u : 0u;
+#endif
+    key.pub_size = cmd->out_pub_key_sz;
+    sim_se_random(key.seed, sizeof(key.seed));
+
+    if (cmd->out_pub_key_sz != 0u) {
+        out = sim_se_buf(op, cmd->out_key_addr, cmd->out_pub_key_sz);
+        if (out == NULL) {
+            return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+        }
+    }
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_get(cmd->key_management_handle);
+    if ((obj == NULL) || (obj->ks == NULL)) {
+        rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+    } else {
+        rsp_code = sim_se_key_add(obj, &key, persistent,
+                                  cmd->flags & HSM_OP_KEY_GENERATION_FLAGS_STRICT_OPERATION);
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        if (out != NULL) {
+            sim_se_pub_key(&key, out, cmd->out_pub_key_sz);
+        }
+        rsp->key_identifier = key.id;
+#ifdef PSA_COMPLIANT
+        rsp->out_key_sz = cmd->out_pub_key_sz;
+#endif
+    }
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_key_import(struct sim_se_op *op)
+{
+    struct sab_cmd_import_key_msg *cmd = (struct sab_cmd_import_key_msg *)op->cmd;
+    struct sab_cmd_import_key_rsp *rsp = (struct sab_cmd_import_key_rsp *)op->rsp;
+    struct sim_se_obj *obj;
+    struct sim_se_key key;
+    uint8_t *in;
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_import_key_rsp);
+
+    rsp_code = sim_se_key_type_check(cmd->key_type);
+    if (rsp_code != SAB_SUCCESS_STATUS) {
+        return rsp_code;
+    }
+
+    in = sim_se_buf(op, cmd->priv_key_in_lsb_addr, cmd->in_priv_key_sz);
+    if ((in == NULL) && (cmd->in_priv_key_sz != 0u)) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+
+    (void)memset(&key, 0, sizeof(key));
+    key.id = cmd->key_id;
+    key.group = cmd->key_group;
+    key.type = cmd->key_type;
+    key.bits = cmd->bit_key_sz;
+    key.pub_size = (uint16_t)(((cmd->bit_key_sz + 7u) / 8u) * 2u);
+    sim_se_sha(32u, in, cmd->in_priv_key_sz, key.seed);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_get(cmd->key_management_hdl);
+    if ((obj == NULL) || (obj->ks == NULL)) {
+        rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+    } else {
+        rsp_code = sim_se_key_add(obj, &key,
+                                  (cmd->key_lifetime != HSM_KEY_LIFE_VOLATILE) ? 1u : 0u,
+                                  cmd->flags & HSM_OP_IMPORT_KEY_FLAGS_STRICT_OPERATION);
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        rsp->key_identifier = key.id;
+    }
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_key_delete(struct sim_se_op *op)
+{
+    struct sab_cmd_delete_key_msg *cmd = (struct sab_cmd_delete_key_msg *)op->cmd;
+    struct sim_se_obj *obj;
+    uint32_t rsp_code;
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_get(cmd->key_management_hdl);
+    if ((obj == NULL) || (obj->ks == NULL)) {
+        rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+    } else {
+        rsp_code = sim_se_key_del(obj, cmd->key_identifier,
+                                  cmd->flags & HSM_OP_DEL_KEY_FLAGS_STRICT_OPERATION);
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_manage_key_group(struct sim_se_op *op)
+{
+    struct sab_cmd_manage_key_group_msg *cmd = (struct sab_cmd_manage_key_group_msg *)op->cmd;
+    struct sim_se_obj *obj;
+    struct sim_se_group *grp;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    do {
+        obj = sim_se_obj_get(cmd->key_management_handle);
+        if ((obj == NULL) || (obj->ks == NULL)) {
+            break;
+        }
+        grp = sim_se_group_find(obj->ks, cmd->key_group);
+        if (grp == NULL) {
+            rsp_code = SIM_SE_ERR(SAB_UNKNOWN_ID_RATING);
+            break;
+        }
+        rsp_code = sim_se_group_use(obj->ks, grp, obj->domain);
+        if (rsp_code != SAB_SUCCESS_STATUS) {
+            break;
+        }
+        if ((cmd->flags & HSM_OP_MANAGE_KEY_GROUP_FLAGS_CACHE_LOCKDOWN) != 0u) {
+            grp->locked = 1u;
+        }
+        if ((cmd->flags & HSM_OP_MANAGE_KEY_GROUP_FLAGS_CACHE_UNLOCK) != 0u) {
+            grp->locked = 0u;
+        }
+        if ((cmd->flags & HSM_OP_MANAGE_KEY_GROUP_FLAGS_STRICT_OPERATION) != 0u) {
+            rsp_code = sim_se_export_chunk(obj->ks, grp, obj->domain);
+            if (rsp_code == SAB_SUCCESS_STATUS) {
+                rsp_code = sim_se_export_master(obj->domain);
+            }
+        }
+    } while (false);
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+/* Derive a new key from a source key and the expansion inputs. */
+static uint32_t sim_se_butterfly_common(struct sim_se_op *op, uint32_t km_hdl, uint32_t key_id,
+                                        uint8_t *in1, uint32_t in1_size, uint8_t *in2, uint32_t in2_size,
+                                        uint32_t flags, uint32_t *dest_key_id, uint16_t key_group,
+                                        uint8_t *out, uint16_t out_size)
+{
+    struct sim_se_obj *obj;
+    struct sim_se_key src, key;
+    struct sha2_ctx ctx;
+    uint32_t rsp_code;
+
+    rsp_code = sim_se_key_get(km_hdl, key_id, &src);
+    if (rsp_code != SAB_SUCCESS_STATUS) {
+        return rsp_code;
+    }
+
+    key = src;
+    key.id = ((flags & HSM_OP_BUTTERFLY_KEY_FLAGS_CREATE) != 0u) ? 0u : *dest_key_id;
+    key.group = key_group;
+    key.pub_size = out_size;
+    sha2_init(&ctx, 32u);
+    sha2_update(&ctx, src.seed, sizeof(src.seed));
+    if (in1 != NULL) {
+        sha2_update(&ctx, in1, in1_size);
+    }
+    if (in2 != NULL) {
+        sha2_update(&ctx, in2, in2_size);
+    }
+    sha2_final(&ctx, key.seed);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_get(km_hdl);
+    if ((obj == NULL) || (obj->ks == NULL)) {
+        rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+    } else {
+        rsp_code = sim_se_key_add(obj, &key, 1u, flags & HSM_OP_BUTTERFLY_KEY_FLAGS_STRICT_OPERATION);
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        if (out != NULL) {
+            sim_se_pub_key(&key, out, out_size);
+        }
+        *dest_key_id = key.id;
+    }
+    return rsp_code;
+}
+
+static uint32_t sim_se_butterfly(struct sim_se_op *op)
+{
+    struct sab_cmd_butterfly_key_exp_msg *cmd = (struct sab_cmd_butterfly_key_exp_msg *)op->cmd;
+    struct sab_cmd_butterfly_key_exp_rsp *rsp = (struct sab_cmd_butterfly_key_exp_rsp *)op->rsp;
+    uint32_t dest = cmd->dest_key_identifier;
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_butterfly_key_exp_rsp);
+    rsp_code = sim_se_butterfly_common(op, cmd->key_management_handle, cmd->key_identifier,
+                    sim_se_buf(op, cmd->expansion_function_value_addr, cmd->expansion_function_value_size),
+                    cmd->expansion_function_value_size,
+                    sim_se_buf(op, cmd->hash_value_addr, cmd->hash_value_size),
+                    cmd->hash_value_size,
+                    cmd->flags, &dest, cmd->key_group,
+                    sim_se_buf(op, cmd->output_address, cmd->output_size), cmd->output_size);
+    rsp->dest_key_identifier = dest;
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_st_butterfly(struct sim_se_op *op)
+{
+    struct sab_cmd_st_butterfly_key_exp_msg *cmd = (struct sab_cmd_st_butterfly_key_exp_msg *)op->cmd;
+    struct sab_cmd_st_butterfly_key_exp_rsp *rsp = (struct sab_cmd_st_butterfly_key_exp_rsp *)op->rsp;
+    uint32_t dest = cmd->dest_key_identifier;
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_st_butterfly_key_exp_rsp);
+    rsp_code = sim_se_butterfly_common(op, cmd->key_management_handle, cmd->key_identifier,
+                    sim_se_buf(op, cmd->exp_fct_input_address, cmd->exp_fct_input_size),
+                    cmd->exp_fct_input_size,
+                    sim_se_buf(op, cmd->hash_value_address, cmd->hash_value_size),
+                    cmd->hash_value_size,
+                    cmd->flags, &dest, cmd->key_group,
+                    sim_se_buf(op, cmd->output_address, cmd->output_size), cmd->output_size);
+    rsp->dest_key_identifier = dest;
+
+    return rsp_code;
+}
+
+/* Signature generation and verification. */
+static uint32_t sim_se_sign_generate(struct sim_se_op *op)
+{
+    struct sab_signature_generate_msg *cmd = (struct sab_signature_generate_msg *)op->cmd;
+    struct sab_signature_generate_rsp *rsp = (struct sab_signature_generate_rsp *)op->rsp;
+    struct sim_se_obj *obj;
+    struct sim_se_key key;
+    uint8_t pub[SIM_SE_MAX_PUB_KEY_SZ];
+    uint8_t digest[32];
+    uint8_t *msg, *sig;
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_signature_generate_rsp);
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+    if ((cmd->flags & HSM_OP_GENERATE_SIGN_FLAGS_COMPRESSED_POINT) != 0u) {
+        return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+    }
+#endif
+    rsp_code = sim_se_scheme_check(cmd->scheme_id);
+    if (rsp_code != SAB_SUCCESS_STATUS) {
+        return rsp_code;
+    }
+
+    msg = sim_se_buf(op, cmd->message_addr, cmd->message_size);
+    sig = sim_se_buf(op, cmd->signature_addr, cmd->signature_size);
+    if ((msg == NULL) || (sig == NULL)) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+
+    if ((cmd->flags & SIM_SE_SIGN_FLAGS_LOW_LATENCY) != 0u) {
+        (void)pthread_mutex_lock(&sim_se_state);
+        obj = sim_se_obj_get(cmd->sig_gen_hdl);
+        if ((obj != NULL) && (obj->prepared > 0u)) {
+            obj->prepared--;
+            rsp_code = SAB_SUCCESS_STATUS;
+        } else {
+            rsp_code = SIM_SE_ERR(SAB_NOT_READY_RATING);
+        }
+        (void)pthread_mutex_unlock(&sim_se_state);
+        if (rsp_code != SAB_SUCCESS_STATUS) {
+            return rsp_code;
+        }
+        /* The expensive part was done by the prepare command. */
+        op->cost_pct = 30u;
+    }
+
+    rsp_code = sim_se_key_get(cmd->sig_gen_hdl, cmd->key_identifier, &key);
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        if ((key.pub_size == 0u) || (key.pub_size > sizeof(pub))) {
+            key.pub_size = (uint16_t)(cmd->signature_size & ~1u);
+        }
+        sim_se_pub_key(&key, pub, key.pub_size);
+        sim_se_pub_digest(pub, key.pub_size, digest);
+        sim_se_signature(digest, msg, cmd->message_size,
+                         cmd->flags & HSM_OP_GENERATE_SIGN_FLAGS_INPUT_MESSAGE,
+                         sig, cmd->signature_size);
+#ifdef PSA_COMPLIANT
+        rsp->signature_size = cmd->signature_size;
+#endif
+    }
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_sign_prepare(struct sim_se_op *op)
+{
+    struct sab_prepare_signature_msg *cmd = (struct sab_prepare_signature_msg *)op->cmd;
+    struct sim_se_obj *obj;
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    obj = sim_se_obj_get(cmd->sig_gen_hdl);
+    if ((obj != NULL) && (obj->kind == SIM_SE_OBJ_SIG_GEN)) {
+        obj->prepared++;
+        rsp_code = SAB_SUCCESS_STATUS;
+    }
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_verify(struct sim_se_op *op)
+{
+    struct sab_signature_verify_msg *cmd = (struct sab_signature_verify_msg *)op->cmd;
+    struct sab_signature_verify_rsp *rsp = (struct sab_signature_verify_rsp *)op->rsp;
+    struct sim_se_obj *obj;
+    uint8_t key_buf[SIM_SE_MAX_PUB_KEY_SZ];
+    uint8_t expected[SIM_SE_MAX_PUB_KEY_SZ];
+    uint8_t digest[32];
+    uint8_t *key, *msg, *sig;
+    uint32_t key_size = cmd->key_size;
+    uint32_t rsp_code = SAB_SUCCESS_STATUS;
+    uint32_t i;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_signature_verify_rsp);
+    rsp->verification_status = 0u;
+
+    if ((cmd->flags & HSM_OP_VERIFY_SIGN_FLAGS_COMPRESSED_POINT) != 0u) {
+        return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+    }
+    rsp_code = sim_se_scheme_check(cmd->sig_scheme);
+    if (rsp_code != SAB_SUCCESS_STATUS) {
+        return rsp_code;
+    }
+
+    key = sim_se_buf(op, cmd->key_addr, cmd->key_size);
+    msg = sim_se_buf(op, cmd->msg_addr, cmd->message_size);
+    sig = sim_se_buf(op, cmd->sig_addr, cmd->sig_size);
+    if ((key == NULL) || (msg == NULL) || (sig == NULL) || (cmd->sig_size > sizeof(expected))) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+
+    if ((cmd->flags & HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL) != 0u) {
+        /* The key buffer carries the reference returned by the public key import. */
+        rsp_code = SIM_SE_ERR(SAB_UNKNOWN_ID_RATING);
+        (void)pthread_mutex_lock(&sim_se_state);
+        obj = sim_se_obj_get(cmd->sig_ver_hdl);
+        for (i = 0u; (obj != NULL) && (cmd->key_size >= sizeof(uint32_t)) && (i < obj->npub); i++) {
+            if (obj->pub[i].ref == *(uint32_t *)key) {
+                key_size = obj->pub[i].size;
+                (void)memcpy(key_buf, obj->pub[i].key, key_size);
+                rsp_code = SAB_SUCCESS_STATUS;
+                break;
+            }
+        }
+        (void)pthread_mutex_unlock(&sim_se_state);
+        key = key_buf;
+        /* The key was validated by the import, at the cost of that command. */
+        op->cost_pct = 92u;
+    }
+
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        sim_se_pub_digest(key, key_size, digest);
+        sim_se_signature(digest, msg, cmd->message_size,
+                         cmd->flags & HSM_OP_VERIFY_SIGN_FLAGS_INPUT_MESSAGE,
+                         expected, cmd->sig_size);
+        if (memcmp(expected, sig, cmd->sig_size) == 0) {
+            rsp->verification_status = HSM_VERIFICATION_STATUS_SUCCESS;
+        }
+    }
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_import_pub_key(struct sim_se_op *op)
+{
+    struct sab_import_pub_key_msg *cmd = (struct sab_import_pub_key_msg *)op->cmd;
+    struct sab_import_pub_key_rsp *rsp = (struct sab_import_pub_key_rsp *)op->rsp;
+    struct sim_se_obj *obj;
+    struct sim_se_pub_key *pub;
+    uint8_t *key = sim_se_buf(op, cmd->key_addr, cmd->key_size);
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_import_pub_key_rsp);
+    if ((key == NULL) || (cmd->key_size > SIM_SE_MAX_PUB_KEY_SZ)) {
+        return SIM_SE_ERR(SAB_INVALID_PARAM_RATING);
+    }
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    do {
+        obj = sim_se_obj_get(cmd->sig_ver_hdl);
+        if ((obj == NULL) || (obj->kind != SIM_SE_OBJ_SIG_VER)) {
+            break;
+        }
+        if (obj->pub == NULL) {
+            obj->pub = calloc(SIM_SE_MAX_PUB_KEYS, sizeof(struct sim_se_pub_key));
+        }
+        if ((obj->pub == NULL) || (obj->npub >= SIM_SE_MAX_PUB_KEYS)) {
+            rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+            break;
+        }
+        pub = &obj->pub[obj->npub];
+        pub->ref = 0x100u + obj->npub;
+        pub->size = cmd->key_size;
+        (void)memcpy(pub->key, key, cmd->key_size);
+        obj->npub++;
+        rsp->key_ref = pub->ref;
+        rsp_code = SAB_SUCCESS_STATUS;
+    } while (false);
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+static uint32_t sim_se_pub_key_decompress(struct sim_se_op *op)
+{
+    struct sab_public_key_decompression_msg *cmd = (struct sab_public_key_decompression_msg *)op->cmd;
+    uint8_t *in = sim_se_buf(op, cmd->input_address, cmd->input_size);
+    uint8_t *out = sim_se_buf(op, cmd->output_address, cmd->out_size);
+    uint32_t half = cmd->out_size / 2u;
+    uint32_t n = cmd->input_size;
+
+    if ((in == NULL) || (out == NULL)) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+    if ((n & 1u) != 0u) {
+        in++;
+        n--;
+    }
+    (void)memset(out, 0, half);
+    (void)memcpy(out, in, (n < half) ? n : half);
+    sim_se_expand(out, half, out + half, cmd->out_size - half);
+
+    return SAB_SUCCESS_STATUS;
+}
+
+static uint32_t sim_se_pub_key_reconstruct(struct sim_se_op *op)
+{
+    struct sab_public_key_reconstruct_msg *cmd = (struct sab_public_key_reconstruct_msg *)op->cmd;
+    struct sha2_ctx ctx;
+    uint8_t *pu = sim_se_buf(op, cmd->pu_address, cmd->pu_size);
+    uint8_t *hash = sim_se_buf(op, cmd->hash_address, cmd->hash_size);
+    uint8_t *ca = sim_se_buf(op, cmd->ca_key_address, cmd->ca_key_size);
+    uint8_t *out = sim_se_buf(op, cmd->out_key_address, cmd->out_key_size);
+    uint8_t seed[32];
+    uint32_t half = cmd->out_key_size / 2u;
+
+    if ((pu == NULL) || (hash == NULL) || (ca == NULL) || (out == NULL)) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+    sha2_init(&ctx, 32u);
+    sha2_update(&ctx, pu, cmd->pu_size);
+    sha2_update(&ctx, hash, cmd->hash_size);
+    sha2_update(&ctx, ca, cmd->ca_key_size);
+    sha2_final(&ctx, seed);
+    sim_se_expand(seed, sizeof(seed), out, half);
+    sim_se_expand(out, half, out + half, cmd->out_key_size - half);
+
+    return SAB_SUCCESS_STATUS;
+}
+
+/* Hash, cipher and MAC. */
+static uint32_t sim_se_digest_size(uint32_t algo)
+{
+    uint32_t size;
+
+    switch (algo) {
+    case HSM_HASH_ALGO_SHA_224:
+        size = 28u;
+        break;
+    case HSM_HASH_ALGO_SHA_256:
+        size = 32u;
+        break;
+    case HSM_HASH_ALGO_SHA_384:
+        size = 48u;
+        break;
+    case HSM_HASH_ALGO_SHA_512:
+        size = 64u;
+        break;
+    default:
+        /* SM3 is not modelled. */
+        size = 0u;
+        break;
+    }
+    return size;
+}
+
+static uint32_t sim_se_hash_one_go(struct sim_se_op *op)
+{
+    struct sab_hash_one_go_msg *cmd = (struct sab_hash_one_go_msg *)op->cmd;
+    uint8_t *in = sim_se_buf(op, cmd->input_addr, cmd->input_size);
+    uint8_t *out = sim_se_chan_resolve(op->chan, cmd->output_addr, cmd->output_size);
+    uint32_t size = sim_se_digest_size(cmd->algo);
+
+    if (size == 0u) {
+        return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+    }
+    if (((in == NULL) && (cmd->input_size != 0u)) || (out == NULL)) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+    if (cmd->output_size < size) {
+        return SIM_SE_ERR(SAB_OUT_LEN_TOO_SHORT_RATING);
+    }
+    sim_se_sha(size, in, cmd->input_size, out);
+
+    return SAB_SUCCESS_STATUS;
+}
+
+#define SIM_SE_CIPHER_MAX_SZ    1024u
+
+/* AES ECB and CBC on the non PSA API, where CCM and SM4 are not modelled. */
+#ifndef PSA_COMPLIANT
+#define HSM_CIPHER_ONE_GO_ALGO_ECB  HSM_CIPHER_ONE_GO_ALGO_AES_ECB
+#define HSM_CIPHER_ONE_GO_ALGO_CBC  HSM_CIPHER_ONE_GO_ALGO_AES_CBC
+#endif
+
+static uint32_t sim_se_cipher_one_go(struct sim_se_op *op)
+{
+    struct sab_cmd_cipher_one_go_msg *cmd = (struct sab_cmd_cipher_one_go_msg *)op->cmd;
+    struct sab_cmd_cipher_one_go_rsp *rsp = (struct sab_cmd_cipher_one_go_rsp *)op->rsp;
+    struct sim_se_key key;
+    uint8_t ckey[32];
+    uint8_t chain[16], tmp[16];
+    uint8_t *iv = NULL, *in, *out;
+    uint32_t encrypt = cmd->flags & HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT;
+    uint32_t rsp_code;
+    uint32_t i, j;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_cipher_one_go_rsp);
+
+    if ((cmd->input_size > SIM_SE_CIPHER_MAX_SZ) || (cmd->output_size > SIM_SE_CIPHER_MAX_SZ)
+        || (cmd->output_size < cmd->input_size)) {
+        return SIM_SE_ERR(SAB_INVALID_PARAM_RATING);
+    }
+#ifdef PSA_COMPLIANT
+    if ((cmd->algo != HSM_CIPHER_ONE_GO_ALGO_CTR) && ((cmd->input_size % 16u) != 0u)) {
+        return SIM_SE_ERR(SAB_INVALID_PARAM_RATING);
+    }
+#else
+    if ((cmd->algo != HSM_CIPHER_ONE_GO_ALGO_ECB) && (cmd->algo != HSM_CIPHER_ONE_GO_ALGO_CBC)) {
+        return SIM_SE_ERR(SAB_FEATURE_NOT_SUPPORTED_RATING);
+    }
+    if ((cmd->input_size % 16u) != 0u) {
+        return SIM_SE_ERR(SAB_INVALID_PARAM_RATING);
+    }
+#endif
+    if (cmd->algo != HSM_CIPHER_ONE_GO_ALGO_ECB) {
+        iv = sim_se_chan_resolve(op->chan, cmd->iv_address, cmd->iv_size);
+        if ((iv == NULL) || (cmd->iv_size != 16u)) {
+            return SIM_SE_ERR(SAB_INVALID_PARAM_RATING);
+        }
+    }
+    in = sim_se_buf(op, cmd->input_address, cmd->input_size);
+    out = sim_se_chan_resolve(op->chan, cmd->output_address, cmd->output_size);
+    if ((in == NULL) || (out == NULL)) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+
+    rsp_code = sim_se_key_get(cmd->cipher_handle, cmd->key_id, &key);
+    if (rsp_code != SAB_SUCCESS_STATUS) {
+        return rsp_code;
+    }
+    sim_se_cipher_key(&key, ckey);
+
+    switch (cmd->algo) {
+#ifdef PSA_COMPLIANT
+    case HSM_CIPHER_ONE_GO_ALGO_CTR:
+        (void)memcpy(chain, iv, sizeof(chain));
+        sim_se_ctr_xor(ckey, chain, in, out, cmd->input_size);
+        break;
+#endif
+    case HSM_CIPHER_ONE_GO_ALGO_CBC:
+        (void)memcpy(chain, iv, sizeof(chain));
+        for (i = 0u; i < cmd->input_size; i += 16u) {
+            if (encrypt != 0u) {
+                for (j = 0u; j < 16u; j++) {
+                    tmp[j] = in[i + j] ^ chain[j];
+                }
+                sim_se_block_encrypt(ckey, tmp, &out[i]);
+                (void)memcpy(chain, &out[i], sizeof(chain));
+            } else {
+                (void)memcpy(tmp, &in[i], sizeof(tmp));
+                sim_se_block_decrypt(ckey, tmp, &out[i]);
+                for (j = 0u; j < 16u; j++) {
+                    out[i + j] ^= chain[j];
+                }
+                (void)memcpy(chain, tmp, sizeof(chain));
+            }
+        }
+        break;
+    default:
+        for (i = 0u; i < cmd->input_size; i += 16u) {
+            if (encrypt != 0u) {
+                sim_se_block_encrypt(ckey, &in[i], &out[i]);
+            } else {
+                sim_se_block_decrypt(ckey, &in[i], &out[i]);
+            }
+        }
+        break;
+    }
+#ifdef PSA_COMPLIANT
+    rsp->output_size = cmd->input_size;
+#else
+    (void)rsp;
+#endif
+
+    return SAB_SUCCESS_STATUS;
+}
+
+static uint32_t sim_se_mac_one_go(struct sim_se_op *op)
+{
+    struct sab_cmd_mac_one_go_msg *cmd = (struct sab_cmd_mac_one_go_msg *)op->cmd;
+    struct sab_cmd_mac_one_go_rsp *rsp = (struct sab_cmd_mac_one_go_rsp *)op->rsp;
+    struct sim_se_key key;
+    uint8_t expected[32];
+    uint8_t *payload = sim_se_buf(op, cmd->payload_address, cmd->payload_size);
+    uint8_t *mac = sim_se_chan_resolve(op->chan, cmd->mac_address, cmd->mac_size);
+    uint32_t rsp_code;
+
+    op->rsp_len = (uint32_t)sizeof(struct sab_cmd_mac_one_go_rsp);
+    rsp->verification_status = 0u;
+
+    if ((payload == NULL) || (mac == NULL) || (cmd->mac_size > sizeof(expected))) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+    rsp_code = sim_se_key_get(cmd->mac_handle, cmd->key_id, &key);
+    if (rsp_code == SAB_SUCCESS_STATUS) {
+        if ((cmd->flags & HSM_OP_MAC_ONE_GO_FLAGS_MAC_GENERATION) != 0u) {
+            sim_se_mac(&key, payload, cmd->payload_size, mac, cmd->mac_size);
+        } else {
+            sim_se_mac(&key, payload, cmd->payload_size, expected, cmd->mac_size);
+            if (memcmp(expected, mac, cmd->mac_size) == 0) {
+                rsp->verification_status = HSM_MAC_VERIFICATION_STATUS_SUCCESS;
+            }
+        }
+    }
+
+    return rsp_code;
+}
+
+/* RNG and data storage. */
+static uint32_t sim_se_get_random(struct sim_se_op *op)
+{
+    struct sab_cmd_get_rnd_msg *cmd = (struct sab_cmd_get_rnd_msg *)op->cmd;
+    uint8_t *out = sim_se_buf(op, cmd->rnd_addr, cmd->rnd_size);
+
+    if (out == NULL) {
+        return SIM_SE_ERR(SAB_INVALID_ADDRESS_RATING);
+    }
+    sim_se_random(out, cmd->rnd_size);
+
+    return SAB_SUCCESS_STATUS;
+}
+
+static uint32_t sim_se_data_storage(struct sim_se_op *op)
+{
+    struct sab_cmd_data_storage_msg *cmd = (struct sab_cmd_data_storage_msg *)op->cmd;
+    struct sim_se_obj *obj;
+    struct sim_se_ks *ks;
+    struct sim_se_data *d = NULL;
+    uint8_t *buf = sim_se_buf(op, cmd->data_address, cmd->data_size);
+    uint32_t rsp_code = SIM_SE_ERR(SAB_UNKNOWN_HANDLE_RATING);
+    uint32_t i;
+
+    if ((buf == NULL) || (cmd->data_size > SIM_SE_MAX_DATA_SZ)) {
+        return SIM_SE_ERR(SAB_INVALID_PARAM_RATING);
+    }
+
+    (void)pthread_mutex_lock(&sim_se_state);
+    do {
+        obj = sim_se_obj_get(cmd->data_storage_handle);
+        if ((obj == NULL) || (obj->ks == NULL)) {
+            break;
+        }
+        ks = obj->ks;
+        for (i = 0u; i < ks->ndata; i++) {
+            if (ks->data[i]->id == cmd->data_id) {
+                d = ks->data[i];
+                break;
+            }
+        }
+        if ((cmd->flags & HSM_OP_DATA_STORAGE_FLAGS_STORE) != 0u) {
+            if (d == NULL) {
+                if (ks->ndata >= SIM_SE_MAX_DATA) {
+                    rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+                    break;
+                }
+                d = calloc(1u, sizeof(struct sim_se_data));
+                if (d == NULL) {
+                    rsp_code = SIM_SE_ERR(SAB_OUT_OF_MEMORY_RATING);
+                    break;
+                }
+                d->id = cmd->data_id;
+                ks->data[ks->ndata++] = d;
+            }
+            d->len = (uint16_t)cmd->data_size;
+            (void)memcpy(d->data, buf, cmd->data_size);
+        } else {
+            if ((d == NULL) || (d->len > cmd->data_size)) {
+                rsp_code = SIM_SE_ERR(SAB_UNKNOWN_ID_RATING);
+                break;
+            }
+            (void)memcpy(buf, d->data, d->len);
+        }
+        rsp_code = SAB_SUCCESS_STATUS;
+    } while (false);
+    (void)pthread_mutex_unlock(&sim_se_state);
+
+    return rsp_code;
+}
+
+/*
+ * Dispatch table: handler, kind of object created by generic open handlers,
+ * base service time in ns and per-byte time in ps. Orders of magnitude are
+ * those measured on i.MX8 class parts, the V2X engines are further scaled by
+ * SIM_SE_V2X_SCALE.
+ */
+static struct sim_se_op_desc sim_se_ops[SAB_MSG_MAX_ID + 1u] = {
+    [SAB_SESSION_OPEN_REQ]                  = {sim_se_session_open, 0u, {30000u, 0u}},
+    [SAB_SESSION_CLOSE_REQ]                 = {sim_se_service_close, 0u, {20000u, 0u}},
+    [SAB_SHARED_BUF_REQ]                    = {sim_se_shared_buf, 0u, {5000u, 0u}},
+    [SAB_PUB_KEY_RECONSTRUCTION_REQ]        = {sim_se_pub_key_reconstruct, 0u, {900000u, 0u}},
+    [SAB_PUB_KEY_DECOMPRESSION_REQ]         = {sim_se_pub_key_decompress, 0u, {300000u, 0u}},
+    [SAB_ECIES_ENC_REQ]                     = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_GET_INFO_REQ]                      = {sim_se_get_info, 0u, {10000u, 0u}},
+    [SAB_RNG_OPEN_REQ]                      = {sim_se_service_open, SIM_SE_OBJ_RNG, {10000u, 0u}},
+    [SAB_RNG_CLOSE_REQ]                     = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_RNG_GET_RANDOM]                    = {sim_se_get_random, 0u, {10000u, 20000u}},
+    [SAB_RNG_EXTEND_SEED]                   = {sim_se_success, 0u, {10000u, 0u}},
+    [SAB_KEY_STORE_OPEN_REQ]                = {sim_se_key_store_open, 0u, {100000u, 0u}},
+    [SAB_KEY_STORE_CLOSE_REQ]               = {sim_se_service_close, 0u, {20000u, 0u}},
+    [SAB_PUB_KEY_RECOVERY_REQ]              = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_KEY_MANAGEMENT_OPEN_REQ]           = {sim_se_service_open, SIM_SE_OBJ_KEY_MGMT, {10000u, 0u}},
+    [SAB_KEY_MANAGEMENT_CLOSE_REQ]          = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_KEY_GENERATE_REQ]                  = {sim_se_key_generate, 0u, {1000000u, 0u}},
+    [SAB_IMPORT_KEY_REQ]                    = {sim_se_key_import, 0u, {300000u, 0u}},
+    [SAB_BUT_KEY_EXP_REQ]                   = {sim_se_butterfly, 0u, {1200000u, 0u}},
+    [SAB_MANAGE_KEY_GROUP_REQ]              = {sim_se_manage_key_group, 0u, {20000u, 0u}},
+    [SAB_ROOT_KEK_EXPORT_REQ]               = {sim_se_success, 0u, {50000u, 0u}},
+    [SAB_KEY_EXCHANGE_REQ]                  = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_TLS_FINISH_REQ]                    = {sim_se_success, 0u, {50000u, 0u}},
+    [SAB_ST_BUT_KEY_EXP_REQ]                = {sim_se_st_butterfly, 0u, {1200000u, 0u}},
+    [SAB_DELETE_KEY_REQ]                    = {sim_se_key_delete, 0u, {50000u, 0u}},
+    [SAB_MAC_OPEN_REQ]                      = {sim_se_service_open, SIM_SE_OBJ_MAC, {10000u, 0u}},
+    [SAB_MAC_CLOSE_REQ]                     = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_MAC_ONE_GO_REQ]                    = {sim_se_mac_one_go, 0u, {15000u, 8000u}},
+    [SAB_CIPHER_OPEN_REQ]                   = {sim_se_service_open, SIM_SE_OBJ_CIPHER, {10000u, 0u}},
+    [SAB_CIPHER_CLOSE_REQ]                  = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_CIPHER_ONE_GO_REQ]                 = {sim_se_cipher_one_go, 0u, {15000u, 10000u}},
+    [SAB_CIPHER_ECIES_DECRYPT_REQ]          = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_AUTH_ENC_REQ]                      = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_SIGNATURE_GENERATION_OPEN_REQ]     = {sim_se_service_open, SIM_SE_OBJ_SIG_GEN, {10000u, 0u}},
+    [SAB_SIGNATURE_GENERATION_CLOSE_REQ]    = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_SIGNATURE_GENERATE_REQ]            = {sim_se_sign_generate, 0u, {600000u, 0u}},
+    [SAB_SIGNATURE_PREPARE_REQ]             = {sim_se_sign_prepare, 0u, {450000u, 0u}},
+    [SAB_SIGNATURE_VERIFICATION_OPEN_REQ]   = {sim_se_service_open, SIM_SE_OBJ_SIG_VER, {10000u, 0u}},
+    [SAB_SIGNATURE_VERIFICATION_CLOSE_REQ]  = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_SIGNATURE_VERIFY_REQ]              = {sim_se_verify, 0u, {1000000u, 0u}},
+    [SAB_IMPORT_PUB_KEY]                    = {sim_se_import_pub_key, 0u, {80000u, 0u}},
+    [SAB_HASH_OPEN_REQ]                     = {sim_se_service_open, SIM_SE_OBJ_HASH, {10000u, 0u}},
+    [SAB_HASH_CLOSE_REQ]                    = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_HASH_ONE_GO_REQ]                   = {sim_se_hash_one_go, 0u, {10000u, 5000u}},
+    [SAB_DATA_STORAGE_OPEN_REQ]             = {sim_se_service_open, SIM_SE_OBJ_DATA_STORAGE, {10000u, 0u}},
+    [SAB_DATA_STORAGE_CLOSE_REQ]            = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_DATA_STORAGE_REQ]                  = {sim_se_data_storage, 0u, {100000u, 1000u}},
+    [SAB_SM2_GET_Z_REQ]                     = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_SM2_ECES_ENC_REQ]                  = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_SM2_ECES_DEC_OPEN_REQ]             = {sim_se_service_open, SIM_SE_OBJ_SERVICE, {10000u, 0u}},
+    [SAB_SM2_ECES_DEC_CLOSE_REQ]            = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_SM2_ECES_DEC_REQ]                  = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_KEY_GENERIC_CRYPTO_SRV_OPEN_REQ]   = {sim_se_service_open, SIM_SE_OBJ_SERVICE, {10000u, 0u}},
+    [SAB_KEY_GENERIC_CRYPTO_SRV_CLOSE_REQ]  = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_KEY_GENERIC_CRYPTO_SRV_REQ]        = {sim_se_not_supported, 0u, {5000u, 0u}},
+    [SAB_STORAGE_OPEN_REQ]                  = {sim_se_storage_open, SIM_SE_OBJ_STORAGE, {10000u, 0u}},
+    [SAB_STORAGE_CLOSE_REQ]                 = {sim_se_service_close, 0u, {10000u, 0u}},
+    [SAB_STORAGE_MASTER_IMPORT_REQ]         = {sim_se_master_import, 0u, {200000u, 2000u}},
+};
+
+static const struct sim_se_op_desc sim_se_rom_debug_dump = {sim_se_debug_dump, 0u, {5000u, 0u}};
+
+static pthread_once_t sim_se_ops_once = PTHREAD_ONCE_INIT;
+
+/* Apply the SIM_SE_COST_<id> overrides. */
+static void sim_se_ops_init(void)
+{
+    char name[sizeof("SIM_SE_COST_XX")];
+    char *val, *end;
+    uint32_t i;
+
+    for (i = 0u; i <= SAB_MSG_MAX_ID; i++) {
+        (void)snprintf(name, sizeof(name), "SIM_SE_COST_%02X", i);
+        val = getenv(name);
+        if (val == NULL) {
+            continue;
+        }
+        sim_se_ops[i].cost.base_ns = (uint32_t)strtoul(val, &end, 0);
+        if (*end == ',') {
+            sim_se_ops[i].cost.ps_per_byte = (uint32_t)strtoul(end + 1, NULL, 0);
+        }
+    }
+    sim_se_resident_groups = sim_se_env("SIM_SE_RESIDENT_GROUPS", 0u);
+}
+
+static const struct sim_se_op_desc *sim_se_desc(uint8_t cmd)
+{
+    return &sim_se_ops[cmd];
+}
+
+sim_se_handler_t sim_se_get_handler(uint8_t cmd, uint8_t ver)
+{
+    (void)pthread_once(&sim_se_ops_once, sim_se_ops_init);
+
+    if ((ver == MESSAGING_VERSION_6) && (cmd == ROM_DEBUG_DUMP_REQ)) {
+        return sim_se_rom_debug_dump.handler;
+    }
+    return sim_se_ops[cmd].handler;
+}
+
+void sim_se_get_cost(uint8_t cmd, struct sim_se_cost *cost)
+{
+    *cost = sim_se_ops[cmd].cost;
+}
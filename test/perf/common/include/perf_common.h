@@ -0,0 +1,83 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#ifndef PERF_COMMON_H
+#define PERF_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hsm_api.h"
+#include "nvm.h"
+
+/* Sessions and services most perf programs run their operations on. */
+struct perf_hsm {
+    hsm_hdl_t session;
+    hsm_hdl_t key_store;
+    hsm_hdl_t key_mgmt;
+};
+
+/* Number of failed checks so far. */
+extern int perf_failures;
+
+/*
+ * Check a condition, report it with its location when it does not hold.
+ * Evaluate to the condition, so that a setup step can stop the program.
+ */
+#define PERF_CHECK(cond)    perf_check((cond), #cond, __FILE__, __LINE__)
+
+bool perf_check(bool ok, const char *expr, const char *file, int line);
+
+/* Monotonic time in seconds, for durations. */
+double perf_now_s(void);
+
+/*
+ * Start the NVM manager with flags in a thread and wait until it serves
+ * commands. Return 0 on success.
+ */
+int perf_nvm_start(uint8_t flags);
+
+/* Stop the NVM manager started with perf_nvm_start(). */
+void perf_nvm_stop(void);
+
+/*
+ * Open the key store of the perf programs (created by the first run) on a
+ * session. Return the error of the last attempt.
+ */
+hsm_err_t perf_open_key_store(hsm_hdl_t session_hdl, hsm_hdl_t *key_store_hdl);
+
+/*
+ * Open a session with default arguments, the key store of the perf programs
+ * and its key management service. Return 0 on success.
+ */
+int perf_hsm_open(struct perf_hsm *hsm);
+
+/* Close what perf_hsm_open() opened. */
+void perf_hsm_close(struct perf_hsm *hsm);
+
+/*
+ * Generate a transient NIST P-256 key for ECDSA SHA-256 in key_group.
+ * pub_key receives the 64 bytes of the public key.
+ */
+hsm_err_t perf_gen_p256_key(hsm_hdl_t key_mgmt_hdl, uint16_t key_group,
+                            uint32_t *key_id, uint8_t *pub_key);
+
+/* Generate a transient AES-256 key for the ciphers in key_group. */
+hsm_err_t perf_gen_aes256_key(hsm_hdl_t key_mgmt_hdl, uint16_t key_group,
+                              uint32_t *key_id);
+
+/* Print the number of failed checks and get the exit code of the program. */
+int perf_exit_code(void);
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "perf_common.h"
+
+int perf_failures;
+
+static uint32_t nvm_status;
+static uint8_t nvm_flags;
+static pthread_t nvm_tid;
+
+static void *nvm_thread(void *arg)
+{
+    nvm_manager(nvm_flags, &nvm_status);
+    return NULL;
+}
+
+bool perf_check(bool ok, const char *expr, const char *file, int line)
+{
+    if (!ok) {
+        printf("%s:%d: check failed: %s\n", file, line, expr);
+        perf_failures++;
+    }
+
+    return ok;
+}
+
+double perf_now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int perf_nvm_start(uint8_t flags)
+{
+    nvm_status = NVM_STATUS_UNDEF;
+    nvm_flags = flags;
+
+    (void)pthread_create(&nvm_tid, NULL, nvm_thread, NULL);
+    if (nvm_wait_ready(5000u) != NVM_STATUS_RUNNING) {
+        printf("nvm manager failed to start\n");
+        (void)pthread_cancel(nvm_tid);
+        (void)pthread_join(nvm_tid, NULL);
+        nvm_close_session();
+        return 1;
+    }
+
+    return 0;
+}
+
+void perf_nvm_stop(void)
+{
+    (void)pthread_cancel(nvm_tid);
+    (void)pthread_join(nvm_tid, NULL);
+
+    nvm_close_session();
+}
+
+hsm_err_t perf_open_key_store(hsm_hdl_t session_hdl, hsm_hdl_t *key_store_hdl)
+{
+    open_svc_key_store_args_t args = {0};
+    hsm_err_t err;
+
+    args.key_store_identifier = 0xABCD;
+    args.authentication_nonce = 0x1234;
+    args.max_updates_number   = 100;
+    args.flags                = HSM_SVC_KEY_STORE_FLAGS_CREATE;
+    err = hsm_open_key_store_service(session_hdl, &args, key_store_hdl);
+    if (err != HSM_NO_ERROR) {
+        /* Key store already created by a previous run. */
+        args.flags = 0;
+        err = hsm_open_key_store_service(session_hdl, &args, key_store_hdl);
+    }
+
+    return err;
+}
+
+int perf_hsm_open(struct perf_hsm *hsm)
+{
+    open_session_args_t session_args = {0};
+    open_svc_key_management_args_t key_mgmt_args = {0};
+    hsm_err_t err;
+
+    memset(hsm, 0, sizeof(*hsm));
+
+    err = hsm_open_session(&session_args, &hsm->session);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        return 1;
+    }
+
+    err = perf_open_key_store(hsm->session, &hsm->key_store);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        (void)hsm_close_session(hsm->session);
+        return 1;
+    }
+
+    err = hsm_open_key_management_service(hsm->key_store, &key_mgmt_args, &hsm->key_mgmt);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        (void)hsm_close_key_store_service(hsm->key_store);
+        (void)hsm_close_session(hsm->session);
+        return 1;
+    }
+
+    return 0;
+}
+
+void perf_hsm_close(struct perf_hsm *hsm)
+{
+    (void)hsm_close_key_management_service(hsm->key_mgmt);
+    (void)hsm_close_key_store_service(hsm->key_store);
+    (void)PERF_CHECK(hsm_close_session(hsm->session) == HSM_NO_ERROR);
+}
+
+hsm_err_t perf_gen_p256_key(hsm_hdl_t key_mgmt_hdl, uint16_t key_group,
+                            uint32_t *key_id, uint8_t *pub_key)
+{
+    op_generate_key_args_t args = {0};
+
+    args.key_identifier = key_id;
+    args.out_size = 64;
+    args.key_group = key_group;
+#ifdef PSA_COMPLIANT
+    args.key_lifetime = HSM_KEY_LIFE_VOLATILE;
+    args.key_usage = HSM_KEY_USAGE_SIGN_HASH | HSM_KEY_USAGE_VERIFY_HASH;
+    args.permitted_algo = PERMITTED_ALGO_ECDSA_SHA256;
+#else
+    args.flags = HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+    args.key_info = HSM_KEY_INFO_TRANSIENT;
+#endif
+    args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+    args.out_key = pub_key;
+
+    return hsm_generate_key(key_mgmt_hdl, &args);
+}
+
+hsm_err_t perf_gen_aes256_key(hsm_hdl_t key_mgmt_hdl, uint16_t key_group,
+                              uint32_t *key_id)
+{
+    op_generate_key_args_t args = {0};
+
+    args.key_identifier = key_id;
+    args.out_size = 0;
+    args.key_group = key_group;
+#ifdef PSA_COMPLIANT
+    args.key_lifetime = HSM_KEY_LIFE_VOLATILE;
+    args.key_usage = HSM_KEY_USAGE_ENCRYPT | HSM_KEY_USAGE_DECRYPT;
+    args.permitted_algo = PERMITTED_ALGO_ALL_CIPHER;
+#else
+    args.flags = HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+    args.key_info = HSM_KEY_INFO_TRANSIENT;
+#endif
+    args.key_type = HSM_KEY_TYPE_AES_256;
+    args.out_key = NULL;
+
+    return hsm_generate_key(key_mgmt_hdl, &args);
+}
+
+int perf_exit_code(void)
+{
+    printf("%d failures\n", perf_failures);
+
+    return (perf_failures == 0) ? 0 : 1;
+}
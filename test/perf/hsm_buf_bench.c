@@ -0,0 +1,149 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * AES-CBC throughput with buffers from malloc(), set up by the library on
+ * each call, against buffers from hsm_buf_alloc() given to the enclave by
+ * their address. Results of both are checked against each other.
+ * On the simulator, SIM_SE_SYSCALL_NS sets the cost of each driver call.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_OPS      2000
+#define IV_SIZE     16
+
+/* Encrypt NB_OPS times. */
+static void encrypt_loop(hsm_hdl_t cipher_hdl, uint32_t key_id, uint8_t *iv,
+                        uint8_t *in, uint8_t *out, uint32_t size, double *elapsed)
+{
+    op_cipher_one_go_args_t cipher_args;
+    double start;
+    int i, failed = 0;
+
+    memset(&cipher_args, 0, sizeof(cipher_args));
+    cipher_args.key_identifier = key_id;
+    cipher_args.iv = iv;
+    cipher_args.iv_size = IV_SIZE;
+#ifdef PSA_COMPLIANT
+    cipher_args.cipher_algo = HSM_CIPHER_ONE_GO_ALGO_CBC;
+#else
+    cipher_args.cipher_algo = HSM_CIPHER_ONE_GO_ALGO_AES_CBC;
+#endif
+    cipher_args.flags = HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT;
+    cipher_args.input = in;
+    cipher_args.output = out;
+    cipher_args.input_size = size;
+    cipher_args.output_size = size;
+
+    start = perf_now_s();
+    for (i = 0; i < NB_OPS; i++) {
+        if (hsm_cipher_one_go(cipher_hdl, &cipher_args) != HSM_NO_ERROR) {
+            failed++;
+        }
+    }
+    *elapsed = perf_now_s() - start;
+
+    (void)PERF_CHECK(failed == 0);
+}
+
+static void bench(hsm_hdl_t session_hdl, hsm_hdl_t cipher_hdl, uint32_t key_id,
+                  uint32_t size)
+{
+    uint8_t *iv, *in, *out, *pool_iv, *pool_in, *pool_out;
+    double malloc_s = 0, pool_s = 0;
+    uint32_t i;
+
+    iv = malloc(IV_SIZE);
+    in = malloc(size);
+    out = malloc(size);
+    pool_iv = hsm_buf_alloc(session_hdl, IV_SIZE);
+    pool_in = hsm_buf_alloc(session_hdl, size);
+    pool_out = hsm_buf_alloc(session_hdl, size);
+
+    if (PERF_CHECK((iv != NULL) && (in != NULL) && (out != NULL)
+                   && (pool_iv != NULL) && (pool_in != NULL) && (pool_out != NULL))) {
+        memset(iv, 0x5A, IV_SIZE);
+        for (i = 0; i < size; i++) {
+            in[i] = (uint8_t)i;
+        }
+        memcpy(pool_iv, iv, IV_SIZE);
+        memcpy(pool_in, in, size);
+
+        encrypt_loop(cipher_hdl, key_id, iv, in, out, size, &malloc_s);
+        encrypt_loop(cipher_hdl, key_id, pool_iv, pool_in, pool_out,
+                     size, &pool_s);
+        (void)PERF_CHECK(memcmp(out, pool_out, size) == 0);
+
+        printf("%5u bytes: malloc %8.1f ops/s, hsm_buf_alloc %8.1f ops/s (x%.2f)\n",
+               size, NB_OPS / malloc_s, NB_OPS / pool_s, malloc_s / pool_s);
+    }
+
+    free(iv);
+    free(in);
+    free(out);
+    hsm_buf_free(session_hdl, pool_iv);
+    hsm_buf_free(session_hdl, pool_in);
+    hsm_buf_free(session_hdl, pool_out);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_cipher_args_t open_cipher_args = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t cipher_hdl;
+    uint32_t key_id = 0;
+    uint32_t size;
+    hsm_err_t err;
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_aes256_key(hsm.key_mgmt, 1001, &key_id);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        err = hsm_open_cipher_service(hsm.key_store, &open_cipher_args, &cipher_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        printf("\n---------------------------------------------------\n");
+        for (size = 64; size <= 1024; size *= 4) {
+            bench(hsm.session, cipher_hdl, key_id, size);
+        }
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_cipher_service(cipher_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
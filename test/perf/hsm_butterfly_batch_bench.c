@@ -0,0 +1,245 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Pseudonym key provisioning throughput: butterfly key expansions of one
+ * master key, one hsm_butterfly_key_expansion() call per key against
+ * hsm_butterfly_key_expansion_batch(), and the same for the standalone
+ * expansion. The keys derived by both from the same values must match.
+ * The keys are created in groups of GROUP_KEYS, the room of a key group.
+ * On the simulator, SIM_SE_MU_DEPTH sets how many commands the MU holds.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NB_GROUPS       4
+#define GROUP_KEYS      100
+#define NB_KEYS         (NB_GROUPS * GROUP_KEYS)
+/* Groups of the keys derived one call per key, then by the batches. */
+#define LOOP_GROUP      200
+#define BATCH_GROUP     (LOOP_GROUP + NB_GROUPS)
+#define VALUE_SIZE      32
+#define PUB_KEY_SIZE    64
+
+static uint8_t fk_values[NB_KEYS][VALUE_SIZE];
+static uint8_t hash_values[NB_KEYS][VALUE_SIZE];
+static uint8_t prv_values[NB_KEYS][VALUE_SIZE];
+static uint8_t loop_keys[NB_KEYS][PUB_KEY_SIZE];
+static uint8_t batch_keys[NB_KEYS][PUB_KEY_SIZE];
+static uint32_t loop_ids[NB_KEYS];
+static uint32_t batch_ids[NB_KEYS];
+static hsm_err_t results[NB_KEYS];
+
+/* Check that the loop and the batch derived the same keys. */
+static void compare_keys(const char *name)
+{
+    int i, failed = 0;
+
+    for (i = 0; i < NB_KEYS; i++) {
+        if ((results[i] != HSM_NO_ERROR) || (batch_ids[i] == 0u)
+            || (batch_ids[i] == loop_ids[i])
+            || (memcmp(loop_keys[i], batch_keys[i], PUB_KEY_SIZE) != 0)) {
+            failed++;
+        }
+    }
+    if (failed != 0) {
+        printf("%s: %d keys differ\n", name, failed);
+    }
+    (void)PERF_CHECK(failed == 0);
+}
+
+/* One call per key. Return the time taken, count the failures. */
+static double loop_expansion(hsm_hdl_t key_mgmt_hdl, uint32_t master_id)
+{
+    op_butt_key_exp_args_t args;
+    double start = perf_now_s();
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < NB_KEYS; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = master_id;
+        args.expansion_function_value = fk_values[i];
+        args.hash_value = hash_values[i];
+        args.pr_reconstruction_value = prv_values[i];
+        args.expansion_function_value_size = VALUE_SIZE;
+        args.hash_value_size = VALUE_SIZE;
+        args.pr_reconstruction_value_size = VALUE_SIZE;
+        args.flags = HSM_OP_BUTTERFLY_KEY_FLAGS_CREATE | HSM_OP_BUTTERFLY_KEY_FLAGS_IMPLICIT_CERTIF;
+        loop_ids[i] = 0u;
+        args.dest_key_identifier = &loop_ids[i];
+        args.output = loop_keys[i];
+        args.output_size = PUB_KEY_SIZE;
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.key_group = LOOP_GROUP + (i / GROUP_KEYS);
+        args.key_info = HSM_KEY_INFO_TRANSIENT;
+        err = hsm_butterfly_key_expansion(key_mgmt_hdl, &args);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+
+    return perf_now_s() - start;
+}
+
+/* One batch per key group. */
+static double batch_expansion(hsm_hdl_t key_mgmt_hdl, uint32_t master_id)
+{
+    op_butt_key_exp_batch_args_t args;
+    double start = perf_now_s();
+    hsm_err_t err;
+    int g;
+
+    memset(batch_ids, 0, sizeof(batch_ids));
+    memset(batch_keys, 0, sizeof(batch_keys));
+    for (g = 0; g < NB_GROUPS; g++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = master_id;
+        args.expansion_function_values = fk_values[g * GROUP_KEYS];
+        args.hash_values = hash_values[g * GROUP_KEYS];
+        args.pr_reconstruction_values = prv_values[g * GROUP_KEYS];
+        args.expansion_function_value_size = VALUE_SIZE;
+        args.hash_value_size = VALUE_SIZE;
+        args.pr_reconstruction_value_size = VALUE_SIZE;
+        args.flags = HSM_OP_BUTTERFLY_KEY_FLAGS_CREATE | HSM_OP_BUTTERFLY_KEY_FLAGS_IMPLICIT_CERTIF;
+        args.dest_key_identifiers = &batch_ids[g * GROUP_KEYS];
+        args.output = batch_keys[g * GROUP_KEYS];
+        args.output_size = PUB_KEY_SIZE;
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.key_group = BATCH_GROUP + g;
+        args.key_info = HSM_KEY_INFO_TRANSIENT;
+        err = hsm_butterfly_key_expansion_batch(key_mgmt_hdl, &args, GROUP_KEYS,
+                                                &results[g * GROUP_KEYS]);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+
+    return perf_now_s() - start;
+}
+
+static double st_loop_expansion(hsm_hdl_t key_mgmt_hdl, uint32_t master_id)
+{
+    op_st_butt_key_exp_args_t args;
+    double start = perf_now_s();
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < NB_KEYS; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = master_id;
+        args.expansion_fct_key_identifier = master_id;
+        args.expansion_fct_input = fk_values[i];
+        args.expansion_fct_input_size = VALUE_SIZE;
+        args.flags = HSM_OP_ST_BUTTERFLY_KEY_FLAGS_CREATE | HSM_OP_ST_BUTTERFLY_KEY_FLAGS_EXPLICIT_CERTIF;
+        loop_ids[i] = 0u;
+        args.dest_key_identifier = &loop_ids[i];
+        args.output = loop_keys[i];
+        args.output_size = PUB_KEY_SIZE;
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.key_group = LOOP_GROUP + (2 * NB_GROUPS) + (i / GROUP_KEYS);
+        args.key_info = HSM_KEY_INFO_TRANSIENT;
+        err = hsm_standalone_butterfly_key_expansion(key_mgmt_hdl, &args);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+
+    return perf_now_s() - start;
+}
+
+static double st_batch_expansion(hsm_hdl_t key_mgmt_hdl, uint32_t master_id)
+{
+    op_st_butt_key_exp_batch_args_t args;
+    double start = perf_now_s();
+    hsm_err_t err;
+    int g;
+
+    memset(batch_ids, 0, sizeof(batch_ids));
+    memset(batch_keys, 0, sizeof(batch_keys));
+    for (g = 0; g < NB_GROUPS; g++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = master_id;
+        args.expansion_fct_key_identifier = master_id;
+        /* The inputs are read one after the other. */
+        args.expansion_fct_inputs = fk_values[g * GROUP_KEYS];
+        args.expansion_fct_input_size = VALUE_SIZE;
+        args.flags = HSM_OP_ST_BUTTERFLY_KEY_FLAGS_CREATE | HSM_OP_ST_BUTTERFLY_KEY_FLAGS_EXPLICIT_CERTIF;
+        args.dest_key_identifiers = &batch_ids[g * GROUP_KEYS];
+        args.output = batch_keys[g * GROUP_KEYS];
+        args.output_size = PUB_KEY_SIZE;
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.key_group = LOOP_GROUP + (3 * NB_GROUPS) + g;
+        args.key_info = HSM_KEY_INFO_TRANSIENT;
+        err = hsm_standalone_butterfly_key_expansion_batch(key_mgmt_hdl, &args, GROUP_KEYS,
+                                                           &results[g * GROUP_KEYS]);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+
+    return perf_now_s() - start;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    struct perf_hsm hsm;
+    uint8_t pub_key[PUB_KEY_SIZE];
+    uint32_t master_id = 0;
+    hsm_err_t err;
+    double loop_s, batch_s, st_loop_s, st_batch_s;
+    int i;
+
+    for (i = 0; i < NB_KEYS; i++) {
+        memset(fk_values[i], i, VALUE_SIZE);
+        memset(hash_values[i], i + 1, VALUE_SIZE);
+        memset(prv_values[i], i + 2, VALUE_SIZE);
+        fk_values[i][0] = (uint8_t)(i >> 8);
+    }
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_p256_key(hsm.key_mgmt, LOOP_GROUP - 1, &master_id, pub_key);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        loop_s = loop_expansion(hsm.key_mgmt, master_id);
+        batch_s = batch_expansion(hsm.key_mgmt, master_id);
+        compare_keys("butterfly");
+
+        st_loop_s = st_loop_expansion(hsm.key_mgmt, master_id);
+        st_batch_s = st_batch_expansion(hsm.key_mgmt, master_id);
+        compare_keys("standalone butterfly");
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d keys\n", NB_KEYS);
+        printf("butterfly per-call loop:   %.1f keys/s\n", NB_KEYS / loop_s);
+        printf("butterfly batch:           %.1f keys/s (x%.2f)\n", NB_KEYS / batch_s, loop_s / batch_s);
+        printf("standalone per-call loop:  %.1f keys/s\n", NB_KEYS / st_loop_s);
+        printf("standalone batch:          %.1f keys/s (x%.2f)\n", NB_KEYS / st_batch_s,
+               st_loop_s / st_batch_s);
+        printf("---------------------------------------------------\n");
+
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
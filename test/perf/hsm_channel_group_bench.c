@@ -0,0 +1,249 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Verification throughput of several threads sharing one low latency
+ * session without key store: on one V2X verification MU, then on a
+ * channel group (HSM_OPEN_SESSION_CHANNEL_GROUP_MASK) spreading the
+ * verifications over SV0 and SV1, at low and high priority.
+ * All the verifications are checked, also with a key imported by
+ * hsm_import_public_key() on the channel group, one by one from the threads
+ * and in a batch.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NB_SIGNATURES   64
+#define NB_THREADS      4
+#define NB_VERIFY       256     /* per thread */
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+static uint8_t pub_key[64];
+static uint8_t digests[NB_SIGNATURES][32];
+static uint8_t signatures[NB_SIGNATURES][SIGNATURE_SIZE];
+static op_generate_sign_args_t sig_gen_args[NB_SIGNATURES];
+static hsm_err_t results[NB_SIGNATURES];
+
+struct verifier {
+    pthread_t tid;
+    hsm_hdl_t sig_ver_hdl;
+    /* Reference of the imported key, 0 to pass the key. */
+    uint32_t key_ref;
+    int id;
+    int failed;
+};
+
+static void verify_args(op_verify_sign_args_t *args, int sig, uint32_t *key_ref)
+{
+    memset(args, 0, sizeof(*args));
+    args->key = pub_key;
+    args->message = digests[sig];
+    args->signature = signatures[sig];
+    args->key_size = sizeof(pub_key);
+    args->signature_size = sizeof(signatures[sig]);
+    args->message_size = sizeof(digests[sig]);
+#ifdef PSA_COMPLIANT
+    args->key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+    args->scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+    args->scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+    args->flags = HSM_OP_VERIFY_SIGN_FLAGS_INPUT_DIGEST;
+    if (*key_ref != 0u) {
+        args->key = (uint8_t *)key_ref;
+        args->key_size = sizeof(*key_ref);
+        args->flags |= HSM_OP_VERIFY_SIGN_FLAGS_KEY_INTERNAL;
+    }
+}
+
+static void *verify_thread(void *arg)
+{
+    struct verifier *v = (struct verifier *)arg;
+    op_verify_sign_args_t args;
+    hsm_verification_status_t status;
+    hsm_err_t err;
+    int i, sig;
+
+    for (i = 0; i < NB_VERIFY; i++) {
+        sig = (v->id + i) % NB_SIGNATURES;
+        verify_args(&args, sig, &v->key_ref);
+        status = 0;
+        err = hsm_verify_signature(v->sig_ver_hdl, &args, &status);
+        if ((err != HSM_NO_ERROR) || (status != HSM_VERIFICATION_STATUS_SUCCESS)) {
+            v->failed++;
+        }
+    }
+
+    return NULL;
+}
+
+/* Verify all the signatures in one batch with the imported key. */
+static void verify_batch(hsm_hdl_t sig_ver_hdl, uint32_t *key_ref)
+{
+    static op_verify_sign_args_t ops[NB_SIGNATURES];
+    static hsm_verification_status_t status[NB_SIGNATURES];
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < NB_SIGNATURES; i++) {
+        verify_args(&ops[i], i, key_ref);
+    }
+    err = hsm_verify_signature_batch(sig_ver_hdl, ops, NB_SIGNATURES, status);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    for (i = 0; i < NB_SIGNATURES; i++) {
+        (void)PERF_CHECK(status[i] == HSM_VERIFICATION_STATUS_SUCCESS);
+    }
+}
+
+/*
+ * Verify from NB_THREADS threads on a new session, with the key imported on
+ * it if import is set. Return the throughput.
+ */
+static double verify_run(uint8_t priority, uint8_t operating_mode, int import)
+{
+    open_session_args_t open_session_args = {0};
+    open_svc_sign_ver_args_t open_sig_ver_args = {0};
+    op_import_public_key_args_t import_args = {0};
+    struct verifier verifiers[NB_THREADS];
+    hsm_hdl_t session_hdl, sig_ver_hdl;
+    uint32_t key_ref = 0;
+    double start, elapsed;
+    hsm_err_t err;
+    int i;
+
+    open_session_args.session_priority = priority;
+    open_session_args.operating_mode = operating_mode;
+    err = hsm_open_session(&open_session_args, &session_hdl);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        return 0.0;
+    }
+    err = hsm_open_signature_verification_service(session_hdl, &open_sig_ver_args, &sig_ver_hdl);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        (void)hsm_close_session(session_hdl);
+        return 0.0;
+    }
+    if (import) {
+        import_args.key = pub_key;
+        import_args.key_size = sizeof(pub_key);
+        import_args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        err = hsm_import_public_key(sig_ver_hdl, &import_args, &key_ref);
+        (void)PERF_CHECK((err == HSM_NO_ERROR) && (key_ref != 0u));
+    }
+
+    start = perf_now_s();
+    for (i = 0; i < NB_THREADS; i++) {
+        verifiers[i].sig_ver_hdl = sig_ver_hdl;
+        verifiers[i].key_ref = key_ref;
+        verifiers[i].id = i;
+        verifiers[i].failed = 0;
+        (void)pthread_create(&verifiers[i].tid, NULL, verify_thread, &verifiers[i]);
+    }
+    for (i = 0; i < NB_THREADS; i++) {
+        (void)pthread_join(verifiers[i].tid, NULL);
+        (void)PERF_CHECK(verifiers[i].failed == 0);
+    }
+    elapsed = perf_now_s() - start;
+    if (import) {
+        verify_batch(sig_ver_hdl, &key_ref);
+    }
+
+    (void)hsm_close_signature_verification_service(sig_ver_hdl);
+    (void)hsm_close_session(session_hdl);
+
+    return (NB_THREADS * NB_VERIFY) / elapsed;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t sig_gen_hdl;
+    uint32_t key_id = 0;
+    hsm_err_t err;
+    double single, group, group_high, group_imported;
+    int i;
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_p256_key(hsm.key_mgmt, 1, &key_id, pub_key);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        for (i = 0; i < NB_SIGNATURES; i++) {
+            memset(digests[i], i, sizeof(digests[i]));
+            sig_gen_args[i].key_identifier = key_id;
+            sig_gen_args[i].message = digests[i];
+            sig_gen_args[i].signature = signatures[i];
+            sig_gen_args[i].message_size = sizeof(digests[i]);
+            sig_gen_args[i].signature_size = sizeof(signatures[i]);
+#ifdef PSA_COMPLIANT
+            sig_gen_args[i].scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+            sig_gen_args[i].scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+            sig_gen_args[i].flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+        }
+        err = hsm_generate_signature_batch(sig_gen_hdl, sig_gen_args, NB_SIGNATURES, results);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        single = verify_run(HSM_OPEN_SESSION_PRIORITY_LOW,
+                            HSM_OPEN_SESSION_LOW_LATENCY_MASK | HSM_OPEN_SESSION_NO_KEY_STORE_MASK, 0);
+        group = verify_run(HSM_OPEN_SESSION_PRIORITY_LOW,
+                           HSM_OPEN_SESSION_LOW_LATENCY_MASK | HSM_OPEN_SESSION_NO_KEY_STORE_MASK
+                           | HSM_OPEN_SESSION_CHANNEL_GROUP_MASK, 0);
+        group_high = verify_run(HSM_OPEN_SESSION_PRIORITY_HIGH,
+                                HSM_OPEN_SESSION_LOW_LATENCY_MASK | HSM_OPEN_SESSION_NO_KEY_STORE_MASK
+                                | HSM_OPEN_SESSION_CHANNEL_GROUP_MASK, 0);
+        group_imported = verify_run(HSM_OPEN_SESSION_PRIORITY_LOW,
+                                    HSM_OPEN_SESSION_LOW_LATENCY_MASK | HSM_OPEN_SESSION_NO_KEY_STORE_MASK
+                                    | HSM_OPEN_SESSION_CHANNEL_GROUP_MASK, 1);
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d threads x %d verifications\n", NB_THREADS, NB_VERIFY);
+        printf("one MU:                   %.1f ops/s\n", single);
+        printf("channel group:            %.1f ops/s (x%.2f)\n", group, group / single);
+        printf("channel group, high prio: %.1f ops/s (x%.2f)\n", group_high, group_high / single);
+        printf("channel group, imported:  %.1f ops/s (x%.2f)\n", group_imported, group_imported / single);
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Streaming cipher: hsm_cipher_init/update/final against the loop of
+ * hsm_cipher_one_go() over HSM_CIPHER_ONE_GO_MAX_SZ chunks, with the IV
+ * chained by the caller, that it replaces. Outputs of both must match, for
+ * any part size, also when each part is ciphered in place in the same
+ * buffer, and the in place decryption must give back the input.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DATA_SIZE   (16u * 1024u * 1024u)
+#define PART_SIZE       (64u * 1024u)
+#define ODD_PART_SIZE   1000u
+#define BLOCK_SIZE      16u
+
+struct cipher_mode {
+    const char *name;
+    hsm_op_cipher_one_go_algo_t algo;
+    /* Size of the data not a multiple of the block size. */
+    bool any_size;
+};
+
+static const struct cipher_mode modes[] = {
+#ifdef PSA_COMPLIANT
+    {"ECB", HSM_CIPHER_ONE_GO_ALGO_ECB, false},
+    {"CBC", HSM_CIPHER_ONE_GO_ALGO_CBC, false},
+    {"CTR", HSM_CIPHER_ONE_GO_ALGO_CTR, true},
+#else
+    {"ECB", HSM_CIPHER_ONE_GO_ALGO_AES_ECB, false},
+    {"CBC", HSM_CIPHER_ONE_GO_ALGO_AES_CBC, false},
+#endif
+};
+
+static uint8_t iv_data[BLOCK_SIZE] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+};
+
+static void init_args(op_cipher_one_go_args_t *args, uint32_t key_id,
+                      const struct cipher_mode *mode, uint8_t *iv,
+                      hsm_op_cipher_one_go_flags_t flags)
+{
+    memset(args, 0, sizeof(*args));
+    args->key_identifier = key_id;
+    args->cipher_algo = mode->algo;
+    args->flags = flags;
+    if (strcmp(mode->name, "ECB") != 0) {
+        args->iv = iv;
+        args->iv_size = BLOCK_SIZE;
+    }
+}
+
+/* What callers do without the streaming API: chunks and IV chaining. */
+static hsm_err_t encrypt_chunks(hsm_hdl_t cipher_hdl, uint32_t key_id,
+                                const struct cipher_mode *mode,
+                                uint8_t *in, uint8_t *out, uint32_t size)
+{
+    op_cipher_one_go_args_t args;
+    uint8_t iv[BLOCK_SIZE];
+    uint32_t off, sz, i, carry;
+    hsm_err_t err = HSM_NO_ERROR;
+
+    memcpy(iv, iv_data, sizeof(iv));
+    for (off = 0; (off < size) && (err == HSM_NO_ERROR); off += sz) {
+        sz = ((size - off) < HSM_CIPHER_ONE_GO_MAX_SZ) ? (size - off)
+                                                       : HSM_CIPHER_ONE_GO_MAX_SZ;
+        init_args(&args, key_id, mode, iv, HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT);
+        args.input = in + off;
+        args.output = out + off;
+        args.input_size = sz;
+        args.output_size = sz;
+        err = hsm_cipher_one_go(cipher_hdl, &args);
+
+        if (strcmp(mode->name, "CBC") == 0) {
+            memcpy(iv, out + off + sz - BLOCK_SIZE, BLOCK_SIZE);
+        } else if (strcmp(mode->name, "CTR") == 0) {
+            carry = sz / BLOCK_SIZE;
+            for (i = BLOCK_SIZE; (i > 0) && (carry != 0); i--) {
+                carry += iv[i - 1];
+                iv[i - 1] = (uint8_t)carry;
+                carry >>= 8;
+            }
+        }
+    }
+
+    return err;
+}
+
+static hsm_err_t cipher_parts(hsm_hdl_t cipher_hdl, uint32_t key_id,
+                              const struct cipher_mode *mode,
+                              hsm_op_cipher_one_go_flags_t flags,
+                              uint8_t *in, uint8_t *out, uint32_t size,
+                              uint32_t part_size)
+{
+    op_cipher_one_go_args_t args;
+    hsm_cipher_ctx_t *ctx;
+    uint32_t off, len, out_off = 0, out_len;
+    hsm_err_t err;
+
+    init_args(&args, key_id, mode, iv_data, flags);
+    err = hsm_cipher_init(cipher_hdl, &args, &ctx);
+    if (err != HSM_NO_ERROR) {
+        return err;
+    }
+    for (off = 0; (off < size) && (err == HSM_NO_ERROR); off += len) {
+        len = ((size - off) < part_size) ? (size - off) : part_size;
+        out_len = size - out_off;
+        err = hsm_cipher_update(ctx, in + off, out + out_off, len, &out_len);
+        out_off += out_len;
+    }
+    if (err != HSM_NO_ERROR) {
+        (void)hsm_cipher_final(ctx, NULL, NULL);
+        return err;
+    }
+    out_len = size - out_off;
+    err = hsm_cipher_final(ctx, out + out_off, &out_len);
+    if ((err == HSM_NO_ERROR) && (out_off + out_len != size)) {
+        err = HSM_GENERAL_ERROR;
+    }
+
+    return err;
+}
+
+/*
+ * Same as cipher_parts() with each part copied to one buffer and ciphered in
+ * place there, as when reading a file part by part.
+ */
+static hsm_err_t cipher_parts_in_place(hsm_hdl_t cipher_hdl, uint32_t key_id,
+                                       const struct cipher_mode *mode,
+                                       hsm_op_cipher_one_go_flags_t flags,
+                                       uint8_t *in, uint8_t *out, uint32_t size)
+{
+    uint8_t part[ODD_PART_SIZE + BLOCK_SIZE];
+    op_cipher_one_go_args_t args;
+    hsm_cipher_ctx_t *ctx;
+    uint32_t off, len, out_off = 0, out_len;
+    hsm_err_t err;
+
+    init_args(&args, key_id, mode, iv_data, flags);
+    err = hsm_cipher_init(cipher_hdl, &args, &ctx);
+    if (err != HSM_NO_ERROR) {
+        return err;
+    }
+    for (off = 0; (off < size) && (err == HSM_NO_ERROR); off += len) {
+        len = ((size - off) < ODD_PART_SIZE) ? (size - off) : ODD_PART_SIZE;
+        memcpy(part, in + off, len);
+        out_len = sizeof(part);
+        err = hsm_cipher_update(ctx, part, part, len, &out_len);
+        if ((err == HSM_NO_ERROR) && (out_len > size - out_off)) {
+            err = HSM_GENERAL_ERROR;
+        }
+        if (err == HSM_NO_ERROR) {
+            memcpy(out + out_off, part, out_len);
+            out_off += out_len;
+        }
+    }
+    if (err != HSM_NO_ERROR) {
+        (void)hsm_cipher_final(ctx, NULL, NULL);
+        return err;
+    }
+    out_len = size - out_off;
+    err = hsm_cipher_final(ctx, out + out_off, &out_len);
+    if ((err == HSM_NO_ERROR) && (out_off + out_len != size)) {
+        err = HSM_GENERAL_ERROR;
+    }
+
+    return err;
+}
+
+static void bench(hsm_hdl_t cipher_hdl, uint32_t key_id,
+                  const struct cipher_mode *mode, uint8_t *plain,
+                  uint8_t *ref, uint8_t *out, uint32_t size)
+{
+    double start, loop_s, stream_s;
+    hsm_err_t err;
+
+    memset(ref, 0, size);
+    start = perf_now_s();
+    err = encrypt_chunks(cipher_hdl, key_id, mode, plain, ref, size);
+    loop_s = perf_now_s() - start;
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+    memset(out, 0, size);
+    start = perf_now_s();
+    err = cipher_parts(cipher_hdl, key_id, mode, HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT,
+                       plain, out, size, PART_SIZE);
+    stream_s = perf_now_s() - start;
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(out, ref, size) == 0);
+
+    memset(out, 0, size);
+    err = cipher_parts(cipher_hdl, key_id, mode, HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT,
+                       plain, out, size, ODD_PART_SIZE);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(out, ref, size) == 0);
+
+    memset(out, 0, size);
+    err = cipher_parts_in_place(cipher_hdl, key_id, mode,
+                                HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT, plain, out, size);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(out, ref, size) == 0);
+
+    /* In place decryption of the reference. */
+    err = cipher_parts(cipher_hdl, key_id, mode, HSM_CIPHER_ONE_GO_FLAGS_DECRYPT,
+                       ref, ref, size, PART_SIZE);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(ref, plain, size) == 0);
+
+    printf("%s %9u bytes: chunk loop %7.1f MB/s, stream %7.1f MB/s (x%.2f)\n",
+           mode->name, size, size / loop_s / 1e6, size / stream_s / 1e6,
+           loop_s / stream_s);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_cipher_args_t open_cipher_args = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t cipher_hdl;
+    uint8_t *plain, *ref, *out;
+    uint32_t key_id = 0, size, i;
+    hsm_err_t err;
+    int m;
+
+    plain = malloc(MAX_DATA_SIZE);
+    ref = malloc(MAX_DATA_SIZE);
+    out = malloc(MAX_DATA_SIZE);
+    if ((plain == NULL) || (ref == NULL) || (out == NULL)) {
+        printf("cannot allocate the data\n");
+        return 1;
+    }
+    for (i = 0; i < MAX_DATA_SIZE; i++) {
+        plain[i] = (uint8_t)(i * 7u + (i >> 8));
+    }
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        free(plain);
+        free(ref);
+        free(out);
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_aes256_key(hsm.key_mgmt, 1, &key_id);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        err = hsm_open_cipher_service(hsm.key_store, &open_cipher_args, &cipher_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        printf("\n---------------------------------------------------\n");
+        for (m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m++) {
+            for (size = 64u * 1024u; size <= MAX_DATA_SIZE; size *= 16u) {
+                bench(cipher_hdl, key_id, &modes[m], plain, ref, out,
+                      modes[m].any_size ? size - 5u : size);
+            }
+        }
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_cipher_service(cipher_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+    free(plain);
+    free(ref);
+    free(out);
+
+    return perf_exit_code();
+}
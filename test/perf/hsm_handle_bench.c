@@ -0,0 +1,144 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+/*
+ * Cost of service_hdl_to_ptr() against the number of services open, compared
+ * with a linear scan of an array of the same services. Up to 8 services the
+ * library table is a small array read without lock, beyond it is hashed.
+ * No enclave is needed: the services are added to the library tables with
+ * made-up handles.
+ */
+
+#include "hsm_api.h"
+#include "internal/hsm_handle.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SERVICES    4096
+#define NB_LOOKUPS      1000000
+#define NB_WARMUP       100000
+
+static uint32_t lfsr_state = 0x12345678;
+
+static uint32_t next_rand(void)
+{
+    /* xorshift32 */
+    lfsr_state ^= lfsr_state << 13;
+    lfsr_state ^= lfsr_state >> 17;
+    lfsr_state ^= lfsr_state << 5;
+    return lfsr_state;
+}
+
+/* Previous lookup: scan of the services until the handle is found. */
+static struct hsm_service_hdl_s *linear_lookup(struct hsm_service_hdl_s **services,
+                                               int nb, uint32_t hdl)
+{
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        if (services[i]->service_hdl == hdl) {
+            return services[i];
+        }
+    }
+    return NULL;
+}
+
+static void bench(int nb_services)
+{
+    static struct hsm_service_hdl_s *services[MAX_SERVICES];
+    static uint32_t lookups[NB_LOOKUPS];
+    struct hsm_session_hdl_s *sess_ptr;
+    struct hsm_service_hdl_s *found;
+    double start, table_ns, linear_ns;
+    int i, errors = 0;
+
+    /* Any non NULL value, the channel is never used. */
+    sess_ptr = add_session((struct plat_os_abs_hdl *)&lfsr_state, 0);
+    if (!PERF_CHECK(sess_ptr != NULL)) {
+        return;
+    }
+    sess_ptr->session_hdl = next_rand() | 1u;
+    register_session(sess_ptr);
+
+    for (i = 0; i < nb_services; i++) {
+        services[i] = add_service(sess_ptr);
+        if (!PERF_CHECK(services[i] != NULL)) {
+            delete_session(sess_ptr);
+            return;
+        }
+        services[i]->service_hdl = next_rand() | 1u;
+        register_service(services[i]);
+    }
+
+    for (i = 0; i < NB_LOOKUPS; i++) {
+        lookups[i] = services[next_rand() % nb_services]->service_hdl;
+    }
+
+    /* Warm up the caches and the branch predictors, untimed. */
+    for (i = 0; i < NB_WARMUP; i++) {
+        (void)service_hdl_to_ptr(lookups[i]);
+        (void)linear_lookup(services, nb_services, lookups[i]);
+    }
+
+    start = perf_now_s();
+    for (i = 0; i < NB_LOOKUPS; i++) {
+        found = service_hdl_to_ptr(lookups[i]);
+        if ((found == NULL) || (found->service_hdl != lookups[i])) {
+            errors++;
+        }
+    }
+    table_ns = (perf_now_s() - start) * 1e9 / NB_LOOKUPS;
+
+    start = perf_now_s();
+    for (i = 0; i < NB_LOOKUPS; i++) {
+        found = linear_lookup(services, nb_services, lookups[i]);
+        if (found == NULL) {
+            errors++;
+        }
+    }
+    linear_ns = (perf_now_s() - start) * 1e9 / NB_LOOKUPS;
+
+    printf("%5d services: table %6.1f ns/lookup, linear scan %8.1f ns/lookup\n",
+           nb_services, table_ns, linear_ns);
+
+    /* Close half of the services and check the others are still found. */
+    for (i = 0; i < nb_services; i += 2) {
+        delete_service(services[i]);
+    }
+    for (i = 1; i < nb_services; i += 2) {
+        if (service_hdl_to_ptr(services[i]->service_hdl) != services[i]) {
+            errors++;
+        }
+    }
+    /* The remaining services are deleted with their session. */
+    delete_session(sess_ptr);
+
+    if (errors != 0) {
+        printf("%d lookup errors\n", errors);
+    }
+    (void)PERF_CHECK(errors == 0);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    int nb;
+
+    for (nb = 8; nb <= MAX_SERVICES; nb *= 4) {
+        bench(nb);
+    }
+
+    return perf_exit_code();
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Streaming hash: known answers for both modes of hsm_hash_init/update/final
+ * (input hashed by the enclave up to HSM_HASH_ONE_GO_MAX_SZ, on the host
+ * beyond) and SHA-256 throughput for inputs from 4 KiB to 64 MiB, given in
+ * 64 KiB parts.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INPUT_SIZE  (64u * 1024u * 1024u)
+#define PART_SIZE       (64u * 1024u)
+
+/* SHA-256("") */
+static const uint8_t empty_digest[32] = {
+    0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+    0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55,
+};
+
+/* SHA-256("abc") */
+static const uint8_t abc_digest[32] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+};
+
+/* SHA-256 of one million 'a' */
+static const uint8_t million_a_digest[32] = {
+    0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+    0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0,
+};
+
+/* Hash size bytes of data given in parts of part_size bytes. */
+static hsm_err_t hash_parts(hsm_hdl_t hash_hdl, uint8_t *data, uint32_t size,
+                            uint32_t part_size, uint8_t *digest)
+{
+    hsm_hash_ctx_t *ctx;
+    hsm_err_t err;
+    uint32_t off, len;
+
+    err = hsm_hash_init(hash_hdl, HSM_HASH_ALGO_SHA_256, &ctx);
+    if (err != HSM_NO_ERROR) {
+        return err;
+    }
+    for (off = 0; (off < size) && (err == HSM_NO_ERROR); off += len) {
+        len = ((size - off) < part_size) ? (size - off) : part_size;
+        err = hsm_hash_update(ctx, data + off, len);
+    }
+    if (err != HSM_NO_ERROR) {
+        (void)hsm_hash_final(ctx, NULL, 0);
+        return err;
+    }
+    return hsm_hash_final(ctx, digest, 32);
+}
+
+static void known_answers(hsm_hdl_t hash_hdl, uint8_t *data)
+{
+    op_hash_one_go_args_t hash_args = {0};
+    uint8_t digest[32], ref[32];
+    hsm_err_t err;
+
+    /* No update: no data buffer taken, empty input hashed by the enclave. */
+    err = hash_parts(hash_hdl, data, 0, 1, digest);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(digest, empty_digest, sizeof(digest)) == 0);
+
+    /* Hashed by the enclave. */
+    memcpy(data, "abc", 3);
+    err = hash_parts(hash_hdl, data, 3, 1, digest);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(digest, abc_digest, sizeof(digest)) == 0);
+
+    /* Hashed on the host. */
+    memset(data, 'a', 1000000);
+    err = hash_parts(hash_hdl, data, 1000000, 1000, digest);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(digest, million_a_digest, sizeof(digest)) == 0);
+
+    /* Largest input for the enclave, against one hsm_hash_one_go(). */
+    hash_args.input = data;
+    hash_args.input_size = HSM_HASH_ONE_GO_MAX_SZ;
+    hash_args.output = ref;
+    hash_args.output_size = sizeof(ref);
+    hash_args.algo = HSM_HASH_ALGO_SHA_256;
+    err = hsm_hash_one_go(hash_hdl, &hash_args);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    err = hash_parts(hash_hdl, data, HSM_HASH_ONE_GO_MAX_SZ, 4096, digest);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(digest, ref, sizeof(digest)) == 0);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_session_args_t open_session_args = {0};
+    open_svc_hash_args_t open_hash_args = {0};
+    hsm_hdl_t session_hdl, hash_hdl;
+    uint8_t digest[32];
+    uint8_t *data;
+    uint32_t size;
+    hsm_err_t err;
+    double start, elapsed;
+
+    data = malloc(MAX_INPUT_SIZE);
+    if (data == NULL) {
+        printf("cannot allocate %u bytes\n", MAX_INPUT_SIZE);
+        return 1;
+    }
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        free(data);
+        return 1;
+    }
+
+    do {
+        err = hsm_open_session(&open_session_args, &session_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            break;
+        }
+
+        err = hsm_open_hash_service(session_hdl, &open_hash_args, &hash_hdl);
+        if (PERF_CHECK(err == HSM_NO_ERROR)) {
+            known_answers(hash_hdl, data);
+
+            memset(data, 0x5A, MAX_INPUT_SIZE);
+            printf("\n---------------------------------------------------\n");
+            for (size = 4096; size <= MAX_INPUT_SIZE; size *= 4) {
+                start = perf_now_s();
+                err = hash_parts(hash_hdl, data, size, PART_SIZE, digest);
+                elapsed = perf_now_s() - start;
+                (void)PERF_CHECK(err == HSM_NO_ERROR);
+                printf("%9u bytes (%s): %9.1f MB/s\n", size,
+                       (size <= HSM_HASH_ONE_GO_MAX_SZ) ? "enclave" : "host",
+                       size / elapsed / 1e6);
+            }
+            printf("---------------------------------------------------\n");
+
+            (void)hsm_close_hash_service(hash_hdl);
+        }
+
+        err = hsm_close_session(session_hdl);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    } while (0);
+
+    perf_nvm_stop();
+    free(data);
+
+    return perf_exit_code();
+}
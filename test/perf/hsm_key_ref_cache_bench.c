@@ -0,0 +1,301 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Verification throughput of a V2X like message stream, the popularity of
+ * the senders following a Zipf law: without key reference cache, then
+ * with a cache of fewer slots than senders. All the verifications are
+ * checked, and a wrong signature from a sender whose key is imported must
+ * still fail. A key deletion on the session must drop the references, and
+ * a cache on a channel group must be released with its session.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_SENDERS      96
+#define NB_MESSAGES     4000
+#define NB_THREADS      4
+#define NB_SLOTS        64u
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+static uint8_t pub_keys[NB_SENDERS][64];
+static uint8_t digests[NB_SENDERS][32];
+static uint8_t signatures[NB_SENDERS][SIGNATURE_SIZE];
+static uint8_t stream[NB_MESSAGES];
+static hsm_hdl_t sig_ver_hdl;
+
+struct verifier {
+    pthread_t tid;
+    int id;
+    int failed;
+};
+
+static bool verify(int sender, int sig)
+{
+    op_verify_sign_args_t args = {0};
+    hsm_verification_status_t status = 0;
+    hsm_err_t err;
+
+    args.key = pub_keys[sender];
+    args.message = digests[sig];
+    args.signature = signatures[sig];
+    args.key_size = sizeof(pub_keys[sender]);
+    args.signature_size = sizeof(signatures[sig]);
+    args.message_size = sizeof(digests[sig]);
+#ifdef PSA_COMPLIANT
+    args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+    args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+    args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+    args.flags = HSM_OP_VERIFY_SIGN_FLAGS_INPUT_DIGEST;
+    err = hsm_verify_signature(sig_ver_hdl, &args, &status);
+
+    return (err == HSM_NO_ERROR) && (status == HSM_VERIFICATION_STATUS_SUCCESS);
+}
+
+static void *verify_thread(void *arg)
+{
+    struct verifier *v = (struct verifier *)arg;
+    int i;
+
+    for (i = v->id; i < NB_MESSAGES; i += NB_THREADS) {
+        if (!verify(stream[i], stream[i])) {
+            v->failed++;
+        }
+    }
+
+    return NULL;
+}
+
+static double verify_run(void)
+{
+    struct verifier verifiers[NB_THREADS];
+    double start;
+    int i;
+
+    start = perf_now_s();
+    for (i = 0; i < NB_THREADS; i++) {
+        verifiers[i].id = i;
+        verifiers[i].failed = 0;
+        (void)pthread_create(&verifiers[i].tid, NULL, verify_thread, &verifiers[i]);
+    }
+    for (i = 0; i < NB_THREADS; i++) {
+        (void)pthread_join(verifiers[i].tid, NULL);
+        (void)PERF_CHECK(verifiers[i].failed == 0);
+    }
+
+    return NB_MESSAGES / (perf_now_s() - start);
+}
+
+/* Senders of the messages, sender i with a probability in 1/(i+1). */
+static void zipf_stream(void)
+{
+    double cdf[NB_SENDERS], sum = 0.0, u;
+    int i, s;
+
+    for (i = 0; i < NB_SENDERS; i++) {
+        sum += 1.0 / (double)(i + 1);
+        cdf[i] = sum;
+    }
+    srand(1);
+    for (i = 0; i < NB_MESSAGES; i++) {
+        u = sum * (double)rand() / ((double)RAND_MAX + 1.0);
+        for (s = 0; (s < NB_SENDERS - 1) && (cdf[s] <= u); s++) {
+        }
+        stream[i] = (uint8_t)s;
+    }
+}
+
+/* Delete a key of the session: the cache must import its keys again. */
+static void check_invalidation(struct perf_hsm *hsm)
+{
+    hsm_key_ref_cache_stats_t before = {0}, after = {0};
+#ifdef HSM_DELETE_KEY
+    op_delete_key_args_t del_args = {0};
+#else
+    op_manage_key_args_t mng_args = {0};
+#endif
+    uint8_t pub_key[64];
+    uint32_t key_id = 0;
+    hsm_err_t err;
+
+    err = perf_gen_p256_key(hsm->key_mgmt, 3, &key_id, pub_key);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(verify(0, 0));
+    (void)hsm_get_key_ref_cache_stats(sig_ver_hdl, &before);
+
+#ifdef HSM_DELETE_KEY
+    del_args.key_identifier = &key_id;
+    del_args.key_group = 3;
+    err = hsm_delete_key(hsm->key_mgmt, &del_args);
+#else
+    mng_args.key_identifier = &key_id;
+    mng_args.flags = HSM_OP_MANAGE_KEY_FLAGS_DELETE;
+    mng_args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+    mng_args.key_group = 3;
+    err = hsm_manage_key(hsm->key_mgmt, &mng_args);
+#endif
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(verify(0, 0));
+    (void)PERF_CHECK(verify(0, 0));
+
+    (void)hsm_get_key_ref_cache_stats(sig_ver_hdl, &after);
+    (void)PERF_CHECK(after.invalidations == before.invalidations + 1u);
+    (void)PERF_CHECK(after.misses == before.misses + 1u);
+    (void)PERF_CHECK(after.hits == before.hits + 1u);
+    (void)PERF_CHECK(after.used == 1u);
+}
+
+/*
+ * Verify through a cache on a channel group, then close the session with
+ * the service and the cache still open.
+ */
+static void check_group_session(void)
+{
+    open_session_args_t open_session_args = {0};
+    open_svc_sign_ver_args_t open_sig_ver_args = {0};
+    hsm_key_ref_cache_stats_t stats = {0};
+    hsm_hdl_t session_hdl;
+    hsm_err_t err;
+
+    open_session_args.session_priority = HSM_OPEN_SESSION_PRIORITY_LOW;
+    open_session_args.operating_mode = HSM_OPEN_SESSION_LOW_LATENCY_MASK
+                                       | HSM_OPEN_SESSION_NO_KEY_STORE_MASK
+                                       | HSM_OPEN_SESSION_CHANNEL_GROUP_MASK;
+    err = hsm_open_session(&open_session_args, &session_hdl);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        return;
+    }
+    err = hsm_open_signature_verification_service(session_hdl, &open_sig_ver_args, &sig_ver_hdl);
+    if (PERF_CHECK(err == HSM_NO_ERROR)) {
+        err = hsm_set_key_ref_cache(sig_ver_hdl, NB_SLOTS);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        (void)verify_run();
+        err = hsm_get_key_ref_cache_stats(sig_ver_hdl, &stats);
+        (void)PERF_CHECK((err == HSM_NO_ERROR) && (stats.hits + stats.misses == NB_MESSAGES));
+    }
+
+    err = hsm_close_session(session_hdl);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    err = hsm_get_key_ref_cache_stats(sig_ver_hdl, &stats);
+    (void)PERF_CHECK(err == HSM_UNKNOWN_HANDLE);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    open_svc_sign_ver_args_t open_sig_ver_args = {0};
+    op_generate_sign_args_t sig_gen_args = {0};
+    hsm_key_ref_cache_stats_t stats = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t sig_gen_hdl;
+    uint32_t key_id;
+    hsm_err_t err;
+    double uncached, cached;
+    int i;
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        /* One key and one signed message per sender. */
+        for (i = 0; i < NB_SENDERS; i++) {
+            key_id = 0;
+            err = perf_gen_p256_key(hsm.key_mgmt, 1 + (i / 50), &key_id, pub_keys[i]);
+            (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+            memset(digests[i], i, sizeof(digests[i]));
+            sig_gen_args.key_identifier = key_id;
+            sig_gen_args.message = digests[i];
+            sig_gen_args.signature = signatures[i];
+            sig_gen_args.message_size = sizeof(digests[i]);
+            sig_gen_args.signature_size = sizeof(signatures[i]);
+#ifdef PSA_COMPLIANT
+            sig_gen_args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+            sig_gen_args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+            sig_gen_args.flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+            err = hsm_generate_signature(sig_gen_hdl, &sig_gen_args);
+            (void)PERF_CHECK(err == HSM_NO_ERROR);
+        }
+
+        err = hsm_open_signature_verification_service(hsm.session, &open_sig_ver_args, &sig_ver_hdl);
+        if (PERF_CHECK(err == HSM_NO_ERROR)) {
+            zipf_stream();
+            uncached = verify_run();
+
+            err = hsm_set_key_ref_cache(sig_ver_hdl, NB_SLOTS);
+            (void)PERF_CHECK(err == HSM_NO_ERROR);
+            cached = verify_run();
+            err = hsm_get_key_ref_cache_stats(sig_ver_hdl, &stats);
+            (void)PERF_CHECK(err == HSM_NO_ERROR);
+            (void)PERF_CHECK(stats.hits + stats.misses == NB_MESSAGES);
+
+            /* Key of sender 0 imported, signature of sender 1. */
+            (void)PERF_CHECK(!verify(0, 1));
+
+            /* Slots set by the first call, counters reset by a new one. */
+            (void)PERF_CHECK(hsm_set_key_ref_cache(sig_ver_hdl, NB_SLOTS + 1u) == HSM_INVALID_PARAM);
+            (void)PERF_CHECK(hsm_set_key_ref_cache(sig_ver_hdl, 0u) == HSM_NO_ERROR);
+            (void)PERF_CHECK(verify(0, 0));
+            (void)PERF_CHECK(hsm_set_key_ref_cache(sig_ver_hdl, NB_SLOTS) == HSM_NO_ERROR);
+            check_invalidation(&hsm);
+
+            printf("\n---------------------------------------------------\n");
+            printf("%d messages from %d senders (Zipf), %d threads, %u slots\n",
+                   NB_MESSAGES, NB_SENDERS, NB_THREADS, NB_SLOTS);
+            printf("without cache: %.1f verifications/s\n", uncached);
+            printf("with cache:    %.1f verifications/s (x%.2f)\n", cached, cached / uncached);
+            printf("hits %lu imports %lu (%.1f%% hits), %lu evictions, %lu recycles\n",
+                   (unsigned long)stats.hits, (unsigned long)stats.misses,
+                   100.0 * (double)stats.hits / (double)(stats.hits + stats.misses),
+                   (unsigned long)stats.evictions, (unsigned long)stats.recycles);
+            printf("---------------------------------------------------\n");
+
+            (void)hsm_close_signature_verification_service(sig_ver_hdl);
+            check_group_session();
+        }
+
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
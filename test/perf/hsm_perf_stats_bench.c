@@ -0,0 +1,132 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Statistics of hsm_get_perf_stats(): counters of a known number of hash
+ * requests, latency of each of their phases, and cost of the accounting.
+ * The library must be built with PERF_STATS=1.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include "sab_msg_def.h"
+#include "sab_perf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NB_REQUESTS     1000
+#define NB_ACCOUNTS     1000000
+#define INPUT_SIZE      1024
+
+static const char *phase_names[HSM_PERF_NB_PHASES] = {
+    "prepare", "send", "wait", "post",
+};
+
+static void print_stats(hsm_perf_stats_t *stats)
+{
+    uint32_t p, b;
+
+    printf("calls %lu, errors %lu, bytes %lu\n", (unsigned long)stats->calls,
+           (unsigned long)stats->errors, (unsigned long)stats->bytes);
+    for (p = 0; p < HSM_PERF_NB_PHASES; p++) {
+        printf("%-8s mean %8.0f ns:", phase_names[p],
+               (stats->calls != 0) ? (double)stats->total_ns[p] / stats->calls : 0.0);
+        for (b = 0; b < HSM_PERF_NB_BUCKETS; b++) {
+            if (stats->hist[p][b] != 0) {
+                printf(" <2^%u:%lu", b, (unsigned long)stats->hist[p][b]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_session_args_t open_session_args = {0};
+    open_svc_hash_args_t open_hash_args = {0};
+    op_hash_one_go_args_t hash_args = {0};
+    hsm_perf_stats_t stats;
+    hsm_hdl_t session_hdl, hash_hdl;
+    uint8_t input[INPUT_SIZE];
+    uint8_t digest[32];
+    uint64_t hist_total;
+    double start;
+    hsm_err_t err;
+    int i;
+
+    err = hsm_reset_perf_stats();
+    if (err == HSM_FEATURE_NOT_SUPPORTED) {
+        printf("library built without PERF_STATS=1, nothing to check\n");
+        return 0;
+    }
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        err = hsm_open_session(&open_session_args, &session_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            break;
+        }
+
+        err = hsm_open_hash_service(session_hdl, &open_hash_args, &hash_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            (void)hsm_close_session(session_hdl);
+            break;
+        }
+
+        memset(input, 0x5A, sizeof(input));
+        hash_args.input = input;
+        hash_args.input_size = sizeof(input);
+        hash_args.output = digest;
+        hash_args.output_size = sizeof(digest);
+        hash_args.algo = HSM_HASH_ALGO_SHA_256;
+
+        (void)hsm_reset_perf_stats();
+        for (i = 0; i < NB_REQUESTS; i++) {
+            (void)PERF_CHECK(hsm_hash_one_go(hash_hdl, &hash_args) == HSM_NO_ERROR);
+        }
+        err = hsm_get_perf_stats(SAB_HASH_ONE_GO_REQ, &stats);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        printf("\n---------------------------------------------------\n");
+        print_stats(&stats);
+        (void)PERF_CHECK(stats.calls == NB_REQUESTS);
+        (void)PERF_CHECK(stats.errors == 0);
+        (void)PERF_CHECK(stats.bytes == (uint64_t)NB_REQUESTS * (INPUT_SIZE + sizeof(digest)));
+        for (hist_total = 0, i = 0; i < (int)HSM_PERF_NB_BUCKETS; i++) {
+            hist_total += stats.hist[HSM_PERF_PHASE_WAIT][i];
+        }
+        (void)PERF_CHECK(hist_total == NB_REQUESTS);
+
+        /* Cost of the accounting of one phase, on a message ID not used. */
+        start = perf_now_s();
+        for (i = 0; i < NB_ACCOUNTS; i++) {
+            (void)sab_perf_phase(0, HSM_PERF_PHASE_POST, sab_perf_now());
+        }
+        printf("accounting of a phase: %.1f ns\n", (perf_now_s() - start) * 1e9 / NB_ACCOUNTS);
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_hash_service(hash_hdl);
+
+        err = hsm_close_session(session_hdl);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Public key decompressions of a V2X like message stream: a few nearby
+ * senders send most of the messages. The stream is decompressed without
+ * and with the public key cache, from several threads, and every key is
+ * compared with the one computed by the enclave. Public key reconstructions
+ * are checked the same way, with more inputs than cache entries.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_SENDERS      64
+#define NB_MESSAGES     4000
+#define NB_THREADS      4
+#define CACHE_ENTRIES   128u
+#define NB_CERTS        256
+#define NB_REC          1000
+
+static hsm_hdl_t session_hdl;
+static uint8_t comp_keys[NB_SENDERS][33];
+static uint8_t ref_keys[NB_SENDERS][64];
+static uint8_t stream[NB_MESSAGES];
+
+struct worker {
+    pthread_t tid;
+    int id;
+    int failed;
+};
+
+static hsm_err_t decompress(uint8_t *key, uint8_t *out)
+{
+    op_pub_key_dec_args_t args = {0};
+
+    args.key = key;
+    args.key_size = 33;
+    args.out_key = out;
+    args.out_key_size = 64;
+    args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+
+    return hsm_pub_key_decompression(session_hdl, &args);
+}
+
+static void *decompress_thread(void *arg)
+{
+    struct worker *w = (struct worker *)arg;
+    uint8_t out[64];
+    int i, s;
+
+    for (i = w->id; i < NB_MESSAGES; i += NB_THREADS) {
+        s = stream[i];
+        if ((decompress(comp_keys[s], out) != HSM_NO_ERROR)
+            || (memcmp(out, ref_keys[s], sizeof(out)) != 0)) {
+            w->failed++;
+        }
+    }
+
+    return NULL;
+}
+
+static double decompress_run(void)
+{
+    struct worker workers[NB_THREADS];
+    double start;
+    int i;
+
+    start = perf_now_s();
+    for (i = 0; i < NB_THREADS; i++) {
+        workers[i].id = i;
+        workers[i].failed = 0;
+        (void)pthread_create(&workers[i].tid, NULL, decompress_thread, &workers[i]);
+    }
+    for (i = 0; i < NB_THREADS; i++) {
+        (void)pthread_join(workers[i].tid, NULL);
+        (void)PERF_CHECK(workers[i].failed == 0);
+    }
+
+    return NB_MESSAGES / (perf_now_s() - start);
+}
+
+/* About 80% of the picks are among the first nb / 8 items. */
+static int pick(int nb)
+{
+    return ((rand() % 5) != 0) ? (rand() % (nb / 8)) : (rand() % nb);
+}
+
+static void reconstruction_run(void)
+{
+    static uint8_t pub_rec[NB_CERTS][33], hash[NB_CERTS][32], ca_key[64];
+    static uint8_t ref[NB_CERTS][64];
+    op_pub_key_rec_args_t args = {0};
+    uint8_t out[64];
+    hsm_err_t err;
+    int i, c, failed = 0;
+
+    for (i = 0; i < NB_CERTS; i++) {
+        memset(pub_rec[i], i + 1, sizeof(pub_rec[i]));
+        memset(hash[i], 0x80 + i, sizeof(hash[i]));
+    }
+    memset(ca_key, 0xCA, sizeof(ca_key));
+
+    args.ca_key = ca_key;
+    args.pub_rec_size = sizeof(pub_rec[0]);
+    args.hash_size = sizeof(hash[0]);
+    args.ca_key_size = sizeof(ca_key);
+    args.out_key_size = sizeof(out);
+    args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+
+    for (i = 0; i < NB_CERTS; i++) {
+        args.pub_rec = pub_rec[i];
+        args.hash = hash[i];
+        args.out_key = ref[i];
+        err = hsm_pub_key_reconstruction(session_hdl, &args);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+
+    err = hsm_set_pub_key_cache(CACHE_ENTRIES);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        return;
+    }
+    for (i = 0; i < NB_REC; i++) {
+        c = pick(NB_CERTS);
+        args.pub_rec = pub_rec[c];
+        args.hash = hash[c];
+        args.out_key = out;
+        if ((hsm_pub_key_reconstruction(session_hdl, &args) != HSM_NO_ERROR)
+            || (memcmp(out, ref[c], sizeof(out)) != 0)) {
+            failed++;
+        }
+    }
+    (void)PERF_CHECK(failed == 0);
+
+    /* Same points, other hash: not a hit. */
+    args.pub_rec = pub_rec[0];
+    args.hash = hash[1];
+    args.out_key = out;
+    err = hsm_pub_key_reconstruction(session_hdl, &args);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    (void)PERF_CHECK(memcmp(out, ref[0], sizeof(out)) != 0);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_session_args_t open_session_args = {0};
+    hsm_pub_key_cache_stats_t stats = {0};
+    hsm_err_t err;
+    double uncached, cached;
+    int i;
+
+    do {
+        err = hsm_open_session(&open_session_args, &session_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            break;
+        }
+
+        srand(1);
+        for (i = 0; i < NB_SENDERS; i++) {
+            memset(comp_keys[i], 0x40 + i, 32);
+            comp_keys[i][32] = (uint8_t)(i & 1);
+            err = decompress(comp_keys[i], ref_keys[i]);
+            (void)PERF_CHECK(err == HSM_NO_ERROR);
+        }
+        for (i = 0; i < NB_MESSAGES; i++) {
+            stream[i] = (uint8_t)pick(NB_SENDERS);
+        }
+
+        uncached = decompress_run();
+
+        err = hsm_set_pub_key_cache(CACHE_ENTRIES);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        cached = decompress_run();
+        err = hsm_get_pub_key_cache_stats(&stats);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        (void)PERF_CHECK(stats.dec_hits + stats.dec_misses == NB_MESSAGES);
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d messages from %d senders, %d threads\n", NB_MESSAGES, NB_SENDERS, NB_THREADS);
+        printf("without cache: %.1f decompressions/s\n", uncached);
+        printf("with cache:    %.1f decompressions/s (x%.2f)\n", cached, cached / uncached);
+        printf("hits %lu misses %lu (%.1f%%), %u/%u entries used\n",
+               (unsigned long)stats.dec_hits, (unsigned long)stats.dec_misses,
+               100.0 * (double)stats.dec_hits / (double)(stats.dec_hits + stats.dec_misses),
+               stats.used, stats.entries);
+
+        /* Not resized while allocated. */
+        (void)PERF_CHECK(hsm_set_pub_key_cache(CACHE_ENTRIES / 2u) == HSM_INVALID_PARAM);
+        /* References computed with the cache disabled. */
+        (void)hsm_set_pub_key_cache(0u);
+        reconstruction_run();
+        (void)hsm_get_pub_key_cache_stats(&stats);
+        printf("reconstruction: hits %lu misses %lu, %lu evictions\n",
+               (unsigned long)stats.rec_hits, (unsigned long)stats.rec_misses,
+               (unsigned long)stats.evictions);
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_set_pub_key_cache(0u);
+
+        err = hsm_close_session(session_hdl);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    } while (0);
+
+    return perf_exit_code();
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+/*
+ * Signature generation and verification throughput: one call per message,
+ * as in the v2x sig_loop_thread, against hsm_generate_signature_batch() and
+ * hsm_verify_signature_batch(). All the signatures are checked.
+ * On the simulator, SIM_SE_MU_DEPTH sets how many commands the MU holds.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_SIGNATURES   256
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+static uint8_t digests[NB_SIGNATURES][32];
+static uint8_t signatures[NB_SIGNATURES][SIGNATURE_SIZE];
+static op_generate_sign_args_t sig_gen_args[NB_SIGNATURES];
+static hsm_err_t results[NB_SIGNATURES];
+static op_verify_sign_args_t sig_ver_args[NB_SIGNATURES];
+static hsm_verification_status_t ver_status[NB_SIGNATURES];
+
+static void init_sign_args(uint32_t key_id, int nb)
+{
+    int i;
+
+    memset(signatures, 0, sizeof(signatures));
+    for (i = 0; i < nb; i++) {
+        memset(digests[i], i, sizeof(digests[i]));
+        memset(&sig_gen_args[i], 0, sizeof(sig_gen_args[i]));
+        sig_gen_args[i].key_identifier = key_id;
+        sig_gen_args[i].message = digests[i];
+        sig_gen_args[i].signature = signatures[i];
+        sig_gen_args[i].message_size = sizeof(digests[i]);
+        sig_gen_args[i].signature_size = sizeof(signatures[i]);
+#ifdef PSA_COMPLIANT
+        sig_gen_args[i].scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+        sig_gen_args[i].scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+        sig_gen_args[i].flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+    }
+}
+
+static void init_verify_args(uint8_t *pub_key, int nb)
+{
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        memset(&sig_ver_args[i], 0, sizeof(sig_ver_args[i]));
+        sig_ver_args[i].key = pub_key;
+        sig_ver_args[i].message = digests[i];
+        sig_ver_args[i].signature = signatures[i];
+        sig_ver_args[i].key_size = 64;
+        sig_ver_args[i].signature_size = sizeof(signatures[i]);
+        sig_ver_args[i].message_size = sizeof(digests[i]);
+#ifdef PSA_COMPLIANT
+        sig_ver_args[i].key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        sig_ver_args[i].scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+        sig_ver_args[i].scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+        sig_ver_args[i].flags = HSM_OP_VERIFY_SIGN_FLAGS_INPUT_DIGEST;
+        ver_status[i] = 0;
+    }
+}
+
+/* Return the number of signatures that do not verify. */
+static int verify_all(hsm_hdl_t sig_ver_serv, uint8_t *pub_key, int nb)
+{
+    hsm_err_t err;
+    int i, failed = 0;
+
+    init_verify_args(pub_key, nb);
+    for (i = 0; i < nb; i++) {
+        err = hsm_verify_signature(sig_ver_serv, &sig_ver_args[i], &ver_status[i]);
+        if ((err != HSM_NO_ERROR) || (ver_status[i] != HSM_VERIFICATION_STATUS_SUCCESS)) {
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+/* Same as verify_all() with one call. */
+static int verify_all_batch(hsm_hdl_t sig_ver_serv, uint8_t *pub_key, int nb)
+{
+    hsm_err_t err;
+    int i, failed = 0;
+
+    init_verify_args(pub_key, nb);
+    err = hsm_verify_signature_batch(sig_ver_serv, sig_ver_args, nb, ver_status);
+    (void)PERF_CHECK(err == HSM_NO_ERROR);
+    for (i = 0; i < nb; i++) {
+        if (ver_status[i] != HSM_VERIFICATION_STATUS_SUCCESS) {
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    open_svc_sign_ver_args_t open_sig_ver_args = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t sig_gen_hdl, sig_ver_hdl;
+    uint8_t pub_key[64];
+    uint32_t key_id = 0;
+    hsm_err_t err;
+    double start, loop_s, batch_s, ver_loop_s, ver_batch_s;
+    int i, nb = NB_SIGNATURES, failed;
+
+    if (argc > 1)
+        nb = atoi(argv[1]);
+    if ((nb <= 0) || (nb > NB_SIGNATURES))
+        nb = NB_SIGNATURES;
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_p256_key(hsm.key_mgmt, 1, &key_id, pub_key);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+        err = hsm_open_signature_verification_service(hsm.session, &open_sig_ver_args, &sig_ver_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            (void)hsm_close_signature_generation_service(sig_gen_hdl);
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        /* One call per signature. */
+        init_sign_args(key_id, nb);
+        start = perf_now_s();
+        for (i = 0, failed = 0; i < nb; i++) {
+            if (hsm_generate_signature(sig_gen_hdl, &sig_gen_args[i]) != HSM_NO_ERROR) {
+                failed++;
+            }
+        }
+        loop_s = perf_now_s() - start;
+        (void)PERF_CHECK(failed == 0);
+        (void)PERF_CHECK(verify_all(sig_ver_hdl, pub_key, nb) == 0);
+
+        /* One call for all the signatures. */
+        init_sign_args(key_id, nb);
+        start = perf_now_s();
+        err = hsm_generate_signature_batch(sig_gen_hdl, sig_gen_args, nb, results);
+        batch_s = perf_now_s() - start;
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        for (i = 0, failed = 0; i < nb; i++) {
+            if (results[i] != HSM_NO_ERROR) {
+                failed++;
+            }
+        }
+        (void)PERF_CHECK(failed == 0);
+
+        start = perf_now_s();
+        (void)PERF_CHECK(verify_all(sig_ver_hdl, pub_key, nb) == 0);
+        ver_loop_s = perf_now_s() - start;
+
+        start = perf_now_s();
+        (void)PERF_CHECK(verify_all_batch(sig_ver_hdl, pub_key, nb) == 0);
+        ver_batch_s = perf_now_s() - start;
+
+        /* A corrupted signature must be reported by its own status only. */
+        signatures[nb / 2][0] ^= 0x01;
+        (void)PERF_CHECK(verify_all_batch(sig_ver_hdl, pub_key, nb) == 1);
+        (void)PERF_CHECK(ver_status[nb / 2] != HSM_VERIFICATION_STATUS_SUCCESS);
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d signatures\n", nb);
+        printf("sign per-call loop:   %.1f ops/s\n", nb / loop_s);
+        printf("sign batch:           %.1f ops/s (x%.2f)\n", nb / batch_s, loop_s / batch_s);
+        printf("verify per-call loop: %.1f ops/s\n", nb / ver_loop_s);
+        printf("verify batch:         %.1f ops/s (x%.2f)\n", nb / ver_batch_s,
+               ver_loop_s / ver_batch_s);
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_signature_verification_service(sig_ver_hdl);
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Signature latency of a transmit path signing one message per period,
+ * without and with a pool of prepared signature values (hsm_set_sign_pool()).
+ * The pool only exists on the non PSA API, PSA builds only report it: on
+ * the simulator, build with SIM_NO_PSA=1.
+ * Also checks that the pool of a service left open goes with its session
+ * when the session is closed while the pool is refilled, and that the
+ * pools of the next sessions are still refilled.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef PSA_COMPLIANT
+
+#define NB_SIGNATURES   100
+#define PERIOD_US       5000
+#define POOL_DEPTH      8
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+static double latencies[NB_SIGNATURES];
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Sign one digest per period, print the latencies. */
+static void transmit(const char *name, hsm_hdl_t sig_gen_hdl, uint32_t key_id)
+{
+    op_generate_sign_args_t args = {0};
+    uint8_t digest[32], signature[SIGNATURE_SIZE];
+    double sum = 0.0, start;
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < NB_SIGNATURES; i++) {
+        usleep(PERIOD_US);
+        memset(digest, i, sizeof(digest));
+        args.key_identifier = key_id;
+        args.message = digest;
+        args.signature = signature;
+        args.signature_size = SIGNATURE_SIZE;
+        args.message_size = sizeof(digest);
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+        args.flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+        start = perf_now_s();
+        err = hsm_generate_signature(sig_gen_hdl, &args);
+        latencies[i] = (perf_now_s() - start) * 1e6;
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        sum += latencies[i];
+    }
+    qsort(latencies, NB_SIGNATURES, sizeof(latencies[0]), cmp_double);
+    printf("%-10s avg %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name,
+           sum / NB_SIGNATURES, latencies[NB_SIGNATURES / 2],
+           latencies[(NB_SIGNATURES * 99) / 100], latencies[NB_SIGNATURES - 1]);
+}
+
+/*
+ * Wait up to one second for the pool to be refilled, or until it is being
+ * refilled if full is false. Return 1 once it is.
+ */
+static int wait_pool(hsm_hdl_t sig_gen_hdl, int full)
+{
+    hsm_sign_pool_stats_t stats = {0};
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < 10000; i++) {
+        err = hsm_get_sign_pool_stats(sig_gen_hdl, HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256, &stats);
+        if (err != HSM_NO_ERROR) {
+            return 0;
+        }
+        if (full ? (stats.ready == stats.depth)
+                 : ((stats.prepared > 0u) && (stats.ready < stats.depth))) {
+            return 1;
+        }
+        usleep(100);
+    }
+
+    return 0;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    hsm_sign_pool_stats_t stats = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t sig_gen_hdl;
+    uint8_t pub_key[64];
+    uint32_t key_id = 0;
+    hsm_err_t err;
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_p256_key(hsm.key_mgmt, 1, &key_id, pub_key);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d signatures, one per %d us\n", NB_SIGNATURES, PERIOD_US);
+        transmit("no pool", sig_gen_hdl, key_id);
+
+        err = hsm_set_sign_pool(sig_gen_hdl, HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256,
+                                HSM_OP_PREPARE_SIGN_INPUT_DIGEST, POOL_DEPTH);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        transmit("pool", sig_gen_hdl, key_id);
+
+        err = hsm_get_sign_pool_stats(sig_gen_hdl, HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256, &stats);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        (void)PERF_CHECK(stats.hits + stats.misses == NB_SIGNATURES);
+        printf("pool depth %u: %lu hits, %lu misses, %lu prepared, %u ready\n", stats.depth,
+               (unsigned long)stats.hits, (unsigned long)stats.misses,
+               (unsigned long)stats.prepared, stats.ready);
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+
+        /* A pool of a service left open is dropped with its session. */
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        err = hsm_set_sign_pool(sig_gen_hdl, HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256,
+                                HSM_OP_PREPARE_SIGN_INPUT_DIGEST, POOL_DEPTH);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        (void)PERF_CHECK(wait_pool(sig_gen_hdl, 0));
+        perf_hsm_close(&hsm);
+        err = hsm_get_sign_pool_stats(sig_gen_hdl, HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256, &stats);
+        (void)PERF_CHECK(err == HSM_UNKNOWN_ID);
+
+        /* The worker goes on with the pools of the next session. */
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        err = hsm_set_sign_pool(sig_gen_hdl, HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256,
+                                HSM_OP_PREPARE_SIGN_INPUT_DIGEST, POOL_DEPTH);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        (void)PERF_CHECK(wait_pool(sig_gen_hdl, 1));
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+    printf("Prepared signature pools are not available with the PSA API.\n");
+    return 0;
+}
+
+#endif
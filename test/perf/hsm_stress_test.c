@@ -0,0 +1,282 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+/*
+ * Several threads sharing a single session: each thread loops on
+ * signature generation + verification and on cipher encrypt + decrypt,
+ * using the same service handles. Throughput is reported for an
+ * increasing number of threads. The MU serves one command at a time
+ * (SIM_SE_MU_DEPTH=1), so threads cannot add throughput, but sharing the
+ * session must not lower it. Each run is paired with a single thread run
+ * doing the same number of operations, and the best of NB_RUNS pairs must
+ * keep MIN_SHARED_PCT % of the single thread throughput. The margin covers
+ * the measurement noise and, on a single CPU, the thread switches with the
+ * simulator, which spins on the end of each service time.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_THREADS     8
+#define NB_LOOPS        50
+#define NB_RUNS         3
+#define MIN_SHARED_PCT  85
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+typedef struct {
+    hsm_hdl_t sig_gen_serv;
+    hsm_hdl_t sig_ver_serv;
+    hsm_hdl_t cipher_serv;
+    uint32_t sig_key_id;
+    uint32_t sym_key_id;
+    uint8_t *pub_key;
+    int nb_loops;
+    int success;
+    int failed;
+} stress_thread_args_t;
+
+static uint8_t hash_data[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+    0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F };
+
+static uint8_t iv_data[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+static bool sign_and_verify(stress_thread_args_t *args, uint8_t *message)
+{
+    op_generate_sign_args_t sig_gen_args;
+    op_verify_sign_args_t sig_ver_args;
+    hsm_verification_status_t status = 0;
+    uint8_t signature[SIGNATURE_SIZE];
+    hsm_err_t err;
+
+    memset(&sig_gen_args, 0, sizeof(sig_gen_args));
+    sig_gen_args.key_identifier = args->sig_key_id;
+    sig_gen_args.message = message;
+    sig_gen_args.signature = signature;
+    sig_gen_args.message_size = sizeof(hash_data);
+    sig_gen_args.signature_size = sizeof(signature);
+#ifdef PSA_COMPLIANT
+    sig_gen_args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+    sig_gen_args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+    sig_gen_args.flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+    err = hsm_generate_signature(args->sig_gen_serv, &sig_gen_args);
+    if (err != HSM_NO_ERROR) {
+        return false;
+    }
+
+    memset(&sig_ver_args, 0, sizeof(sig_ver_args));
+    sig_ver_args.key = args->pub_key;
+    sig_ver_args.message = message;
+    sig_ver_args.signature = signature;
+    sig_ver_args.key_size = 64;
+    sig_ver_args.signature_size = sizeof(signature);
+    sig_ver_args.message_size = sizeof(hash_data);
+#ifdef PSA_COMPLIANT
+    sig_ver_args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+    sig_ver_args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+    sig_ver_args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+    sig_ver_args.flags = HSM_OP_VERIFY_SIGN_FLAGS_INPUT_DIGEST;
+    err = hsm_verify_signature(args->sig_ver_serv, &sig_ver_args, &status);
+
+    return (err == HSM_NO_ERROR) && (status == HSM_VERIFICATION_STATUS_SUCCESS);
+}
+
+static hsm_err_t cipher_one_go(stress_thread_args_t *args, uint8_t *input,
+                               uint8_t *output, hsm_op_cipher_one_go_flags_t flags)
+{
+    op_cipher_one_go_args_t cipher_args;
+
+    memset(&cipher_args, 0, sizeof(cipher_args));
+    cipher_args.key_identifier = args->sym_key_id;
+    cipher_args.iv = iv_data;
+    cipher_args.iv_size = sizeof(iv_data);
+#ifdef PSA_COMPLIANT
+    cipher_args.cipher_algo = HSM_CIPHER_ONE_GO_ALGO_CBC;
+#else
+    cipher_args.cipher_algo = HSM_CIPHER_ONE_GO_ALGO_AES_CBC;
+#endif
+    cipher_args.flags = flags;
+    cipher_args.input = input;
+    cipher_args.output = output;
+    cipher_args.input_size = sizeof(hash_data);
+    cipher_args.output_size = sizeof(hash_data);
+
+    return hsm_cipher_one_go(args->cipher_serv, &cipher_args);
+}
+
+static bool encrypt_and_decrypt(stress_thread_args_t *args, uint8_t *message)
+{
+    uint8_t ciphered[sizeof(hash_data)];
+    uint8_t deciphered[sizeof(hash_data)];
+
+    if (cipher_one_go(args, message, ciphered,
+                      HSM_CIPHER_ONE_GO_FLAGS_ENCRYPT) != HSM_NO_ERROR) {
+        return false;
+    }
+    if (cipher_one_go(args, ciphered, deciphered,
+                      HSM_CIPHER_ONE_GO_FLAGS_DECRYPT) != HSM_NO_ERROR) {
+        return false;
+    }
+
+    return memcmp(message, deciphered, sizeof(hash_data)) == 0;
+}
+
+static void *stress_loop_thread(void *arg)
+{
+    stress_thread_args_t *args = (stress_thread_args_t *)arg;
+    uint8_t message[sizeof(hash_data)];
+    int i;
+
+    if (!args)
+        return NULL;
+
+    /* Each thread works on its own message. */
+    memcpy(message, hash_data, sizeof(message));
+    message[0] = (uint8_t)(uintptr_t)args;
+
+    for (i = 0; i < args->nb_loops; i++) {
+        message[1] = (uint8_t)i;
+        if (sign_and_verify(args, message)) {
+            args->success++;
+        } else {
+            args->failed++;
+        }
+        if (encrypt_and_decrypt(args, message)) {
+            args->success++;
+        } else {
+            args->failed++;
+        }
+    }
+
+    return NULL;
+}
+
+/* Run nb_threads workers of nb_loops on the same services, return the ops/s. */
+static double run_stress(stress_thread_args_t *tmpl, int nb_threads, int nb_loops)
+{
+    pthread_t tid[MAX_THREADS];
+    stress_thread_args_t args[MAX_THREADS];
+    int i, success = 0, failed = 0;
+    double start, duration, ops;
+
+    start = perf_now_s();
+    for (i = 0; i < nb_threads; i++) {
+        args[i] = *tmpl;
+        args[i].nb_loops = nb_loops;
+        (void)pthread_create(&tid[i], NULL, stress_loop_thread, &args[i]);
+    }
+    for (i = 0; i < nb_threads; i++) {
+        (void)pthread_join(tid[i], NULL);
+        success += args[i].success;
+        failed += args[i].failed;
+    }
+    duration = perf_now_s() - start;
+    /* Each check is two operations: sign + verify or encrypt + decrypt. */
+    ops = (duration > 0.0) ? 2.0 * (success + failed) / duration : 0.0;
+    printf("%d thread(s): success: %d / failures: %d, %.3f s, %.1f ops/s\n",
+           nb_threads, success, failed, duration, ops);
+
+    (void)PERF_CHECK(failed == 0);
+
+    return ops;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    open_svc_sign_ver_args_t open_sig_ver_args = {0};
+    open_svc_cipher_args_t open_cipher_args = {0};
+    stress_thread_args_t tmpl = {0};
+    struct perf_hsm hsm;
+    uint8_t pub_key[64];
+    hsm_err_t err;
+    int nb_threads;
+    double ops, single_ops, ratio, best;
+    int run;
+
+    tmpl.nb_loops = NB_LOOPS;
+    if (argc > 1)
+        tmpl.nb_loops = atoi(argv[1]);
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = perf_gen_p256_key(hsm.key_mgmt, 1, &tmpl.sig_key_id, pub_key);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        err = perf_gen_aes256_key(hsm.key_mgmt, 1001, &tmpl.sym_key_id);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args,
+                                                    &tmpl.sig_gen_serv);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        err = hsm_open_signature_verification_service(hsm.session, &open_sig_ver_args,
+                                                      &tmpl.sig_ver_serv);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        err = hsm_open_cipher_service(hsm.key_store, &open_cipher_args,
+                                      &tmpl.cipher_serv);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        tmpl.pub_key = pub_key;
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d loops per thread, all threads on session 0x%x\n",
+               tmpl.nb_loops, hsm.session);
+        printf("---------------------------------------------------\n");
+        for (nb_threads = 2; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+            best = 0.0;
+            for (run = 0; run < NB_RUNS; run++) {
+                single_ops = run_stress(&tmpl, 1, tmpl.nb_loops * nb_threads);
+                ops = run_stress(&tmpl, nb_threads, tmpl.nb_loops);
+                ratio = (single_ops > 0.0) ? ops / single_ops : 0.0;
+                if (ratio > best) {
+                    best = ratio;
+                }
+            }
+            printf("%d thread(s): %.2f of the single thread throughput\n",
+                   nb_threads, best);
+            (void)PERF_CHECK(best * 100.0 >= MIN_SHARED_PCT);
+        }
+
+        (void)hsm_close_cipher_service(tmpl.cipher_serv);
+        (void)hsm_close_signature_verification_service(tmpl.sig_ver_serv);
+        (void)hsm_close_signature_generation_service(tmpl.sig_gen_serv);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
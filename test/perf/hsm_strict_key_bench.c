@@ -0,0 +1,107 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Latency of STRICT persistent key generations: each one returns once the
+ * key group chunk and the master blob are written in NVM by the storage
+ * manager. Non-STRICT generations are measured for reference.
+ * On the simulator, SIM_SE_NVM_DIR sets where the blobs are written.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_KEYS        1000
+#define NB_GROUPS       8
+
+static double latencies[MAX_KEYS];
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/* Generate nb persistent keys. */
+static void gen_keys(hsm_hdl_t key_mgmt_hdl, int nb, bool strict, const char *name)
+{
+    op_generate_key_args_t args;
+    uint8_t pub_key[64];
+    uint32_t key_id;
+    double start, total = 0;
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        memset(&args, 0, sizeof(args));
+        key_id = 0;
+        args.key_identifier = &key_id;
+        args.out_size = sizeof(pub_key);
+        args.out_key = pub_key;
+        args.key_group = 10 + (i % NB_GROUPS);
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.flags = strict ? HSM_OP_KEY_GENERATION_FLAGS_STRICT_OPERATION : 0;
+#ifdef PSA_COMPLIANT
+        args.key_lifetime = HSM_KEY_LIFE_PERSISTENT;
+        args.key_usage = HSM_KEY_USAGE_SIGN_HASH | HSM_KEY_USAGE_VERIFY_HASH;
+        args.permitted_algo = PERMITTED_ALGO_ECDSA_SHA256;
+#else
+        args.flags |= HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+        args.key_info = HSM_KEY_INFO_PERSISTENT;
+#endif
+        start = perf_now_s();
+        err = hsm_generate_key(key_mgmt_hdl, &args);
+        latencies[i] = (perf_now_s() - start) * 1e6;
+        total += latencies[i];
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+
+    qsort(latencies, nb, sizeof(latencies[0]), cmp_double);
+    printf("%-10s mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name,
+           total / nb, latencies[nb / 2], latencies[(nb * 99) / 100], latencies[nb - 1]);
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    struct perf_hsm hsm;
+    int nb = 200;
+
+    if (argc > 1)
+        nb = atoi(argv[1]);
+    if ((nb <= 0) || (nb > MAX_KEYS))
+        nb = 200;
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    if (perf_hsm_open(&hsm) == 0) {
+        printf("\n---------------------------------------------------\n");
+        printf("%d persistent key generations\n", nb);
+        gen_keys(hsm.key_mgmt, nb, true, "STRICT");
+        gen_keys(hsm.key_mgmt, nb, false, "non-STRICT");
+        printf("---------------------------------------------------\n");
+
+        perf_hsm_close(&hsm);
+    }
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Heap calls made by the storage manager thread and latency spread of the
+ * requests it serves once running: chunk gets (signatures reloading their
+ * key group, from the chunk cache or from storage) and chunk and master
+ * exports (STRICT key generations).
+ * The heap functions are wrapped to count the calls of that thread. On the
+ * simulator they include the ones of the simulated MU, which allocates
+ * each message it carries.
+ * SIM_SE_RESIDENT_GROUPS is set to 1 unless given, so that every signature
+ * evicts the group used before.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_GROUPS_CACHED    8
+#define NB_GROUPS           40
+#define FIRST_GROUP         100
+#define MAX_OPS             2000
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread bool storage_thread;
+static volatile bool counting;
+static volatile unsigned long heap_calls;
+
+static uint32_t key_ids[NB_GROUPS];
+static double latencies[MAX_OPS];
+static uint32_t nvm_status;
+
+static void count(void)
+{
+    if (storage_thread && counting) {
+        heap_calls++;
+    }
+}
+
+void *malloc(size_t size)
+{
+    count();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    count();
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count();
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL) {
+        count();
+    }
+    __libc_free(ptr);
+}
+
+/* Not perf_nvm_start(): the heap calls of this thread are the ones counted. */
+static void *hsm_storage_thread(void *arg)
+{
+    storage_thread = true;
+    nvm_manager(NVM_FLAGS_HSM, &nvm_status);
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void report(const char *name, int nb, unsigned long calls)
+{
+    qsort(latencies, nb, sizeof(latencies[0]), cmp_double);
+    printf("%-20s p50 %7.1f us  p99 %7.1f us  max %7.1f us  %5.2f heap calls/op\n", name,
+           latencies[nb / 2], latencies[(nb * 99) / 100], latencies[nb - 1],
+           (double)calls / nb);
+}
+
+/* STRICT persistent keys, group after group from first_group. */
+static int gen_keys(hsm_hdl_t key_mgmt_hdl, int first_group, int nb, uint32_t *ids)
+{
+    op_generate_key_args_t args;
+    uint8_t pub_key[64];
+    uint32_t key_id;
+    double start;
+    int i, failed = 0;
+
+    for (i = 0; i < nb; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = (ids != NULL) ? &ids[i] : &key_id;
+        args.out_size = sizeof(pub_key);
+        args.out_key = pub_key;
+        args.key_group = first_group + (i % NB_GROUPS);
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.flags = HSM_OP_KEY_GENERATION_FLAGS_STRICT_OPERATION;
+#ifdef PSA_COMPLIANT
+        args.key_lifetime = HSM_KEY_LIFE_PERSISTENT;
+        args.key_usage = HSM_KEY_USAGE_SIGN_HASH | HSM_KEY_USAGE_VERIFY_HASH;
+        args.permitted_algo = PERMITTED_ALGO_ECDSA_SHA256;
+#else
+        args.flags |= HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+        args.key_info = HSM_KEY_INFO_PERSISTENT;
+#endif
+        start = perf_now_s();
+        if (hsm_generate_key(key_mgmt_hdl, &args) != HSM_NO_ERROR) {
+            failed++;
+        }
+        latencies[i] = (perf_now_s() - start) * 1e6;
+    }
+
+    return failed;
+}
+
+/* Sign nb times with the keys of nb_groups groups in turn. */
+static int sign_loop(hsm_hdl_t sig_gen_hdl, int nb_groups, int nb)
+{
+    op_generate_sign_args_t args;
+    uint8_t digest[32];
+    uint8_t signature[SIGNATURE_SIZE];
+    double start;
+    int i, failed = 0;
+
+    memset(digest, 0x5A, sizeof(digest));
+    for (i = 0; i < nb; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = key_ids[i % nb_groups];
+        args.message = digest;
+        args.signature = signature;
+        args.message_size = sizeof(digest);
+        args.signature_size = sizeof(signature);
+#ifdef PSA_COMPLIANT
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+        args.flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+        start = perf_now_s();
+        if (hsm_generate_signature(sig_gen_hdl, &args) != HSM_NO_ERROR) {
+            failed++;
+        }
+        latencies[i] = (perf_now_s() - start) * 1e6;
+    }
+
+    return failed;
+}
+
+/* Run one phase with the heap calls of the storage thread counted. */
+#define PHASE(name, nb, call)                       \
+    do {                                            \
+        heap_calls = 0;                             \
+        counting = true;                            \
+        (void)PERF_CHECK((call) == 0);              \
+        counting = false;                           \
+        report((name), (nb), heap_calls);           \
+    } while (0)
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t sig_gen_hdl;
+    pthread_t tid;
+    hsm_err_t err;
+    int nb = 400;
+
+    if (argc > 1)
+        nb = atoi(argv[1]);
+    if ((nb <= 0) || (nb > MAX_OPS))
+        nb = 400;
+
+    /* Only one key group resident in the simulated enclave. */
+    (void)setenv("SIM_SE_RESIDENT_GROUPS", "1", 0);
+
+    nvm_status = NVM_STATUS_UNDEF;
+    (void)pthread_create(&tid, NULL, hsm_storage_thread, NULL);
+    if (nvm_wait_ready(5000u) != NVM_STATUS_RUNNING) {
+        printf("nvm manager failed to start\n");
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        /* Warm up: one key per group, each group in NVM. */
+        (void)PERF_CHECK(gen_keys(hsm.key_mgmt, FIRST_GROUP, NB_GROUPS, key_ids) == 0);
+        (void)PERF_CHECK(sign_loop(sig_gen_hdl, NB_GROUPS, NB_GROUPS) == 0);
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d operations per phase\n", nb);
+        PHASE("get, cached", nb, sign_loop(sig_gen_hdl, NB_GROUPS_CACHED, nb));
+        PHASE("get, from storage", nb, sign_loop(sig_gen_hdl, NB_GROUPS, nb));
+        PHASE("STRICT export", nb, gen_keys(hsm.key_mgmt, FIRST_GROUP, nb, NULL));
+        printf("---------------------------------------------------\n");
+
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    (void)pthread_cancel(tid);
+    (void)pthread_join(tid, NULL);
+    nvm_close_session();
+
+    return perf_exit_code();
+}
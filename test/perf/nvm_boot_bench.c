@@ -0,0 +1,243 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Start up of the storage manager: time until it is ready, waited for with
+ * nvm_wait_ready(), and latency of the first signature with each of the
+ * persistent keys created by a previous start, each in its own key group.
+ * The storage files are evicted from the page cache before each start,
+ * made once as usual and once with NVM_FLAGS_PREFETCH.
+ * On the simulator, SIM_SE_RESIDENT_GROUPS is set to 1 unless given, so
+ * that every first use reloads the key group from storage, and
+ * SIM_SE_STORAGE_NS to 300 us unless given, a random read of flash storage.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* As many groups as the chunk cache holds. */
+#define NB_GROUPS       16
+#define FIRST_GROUP     300
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+static uint32_t key_ids[NB_GROUPS];
+
+static void evict_file(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd >= 0) {
+        (void)fdatasync(fd);
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        (void)close(fd);
+    }
+}
+
+/* Drop the master and the chunks of the simulator storage from the page cache. */
+static void evict_storage(void)
+{
+    const char *dir = getenv("SIM_SE_NVM_DIR");
+    char path[512];
+    struct dirent *de;
+    DIR *d;
+
+    if ((dir == NULL) || (*dir == '\0')) {
+        dir = "/tmp/sim_hsm";
+    }
+    (void)snprintf(path, sizeof(path), "%s/hsm_nvm_master", dir);
+    evict_file(path);
+    (void)snprintf(path, sizeof(path), "%s/hsm", dir);
+    d = opendir(path);
+    if (d != NULL) {
+        while ((de = readdir(d)) != NULL) {
+            if (de->d_name[0] != '.') {
+                (void)snprintf(path, sizeof(path), "%s/hsm/%s", dir, de->d_name);
+                evict_file(path);
+            }
+        }
+        (void)closedir(d);
+    }
+}
+
+/* Open the key store created by the first start, without creating it. */
+static int open_key_store(hsm_hdl_t *session_hdl, hsm_hdl_t *key_store_hdl)
+{
+    open_session_args_t open_session_args = {0};
+    open_svc_key_store_args_t open_svc_key_store_args = {0};
+    hsm_err_t err;
+
+    err = hsm_open_session(&open_session_args, session_hdl);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        return 1;
+    }
+
+    open_svc_key_store_args.key_store_identifier = 0xABCD;
+    open_svc_key_store_args.authentication_nonce = 0x1234;
+    open_svc_key_store_args.max_updates_number   = 100;
+    err = hsm_open_key_store_service(*session_hdl, &open_svc_key_store_args, key_store_hdl);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        (void)hsm_close_session(*session_hdl);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* One STRICT persistent key per group, so that each group is in NVM. */
+static void gen_keys(hsm_hdl_t key_mgmt_hdl)
+{
+    op_generate_key_args_t args;
+    uint8_t pub_key[64];
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < NB_GROUPS; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = &key_ids[i];
+        args.out_size = sizeof(pub_key);
+        args.out_key = pub_key;
+        args.key_group = FIRST_GROUP + i;
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.flags = HSM_OP_KEY_GENERATION_FLAGS_STRICT_OPERATION;
+#ifdef PSA_COMPLIANT
+        args.key_lifetime = HSM_KEY_LIFE_PERSISTENT;
+        args.key_usage = HSM_KEY_USAGE_SIGN_HASH | HSM_KEY_USAGE_VERIFY_HASH;
+        args.permitted_algo = PERMITTED_ALGO_ECDSA_SHA256;
+#else
+        args.flags |= HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+        args.key_info = HSM_KEY_INFO_PERSISTENT;
+#endif
+        err = hsm_generate_key(key_mgmt_hdl, &args);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+}
+
+/* First signature with each key, its group being loaded from storage. */
+static void first_use(hsm_hdl_t key_store_hdl, double *mean_us, double *max_us)
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    op_generate_sign_args_t args;
+    hsm_hdl_t sig_gen_hdl;
+    uint8_t digest[32];
+    uint8_t signature[SIGNATURE_SIZE];
+    double start, elapsed, total = 0.0;
+    hsm_err_t err;
+    int i;
+
+    err = hsm_open_signature_generation_service(key_store_hdl, &open_sig_gen_args, &sig_gen_hdl);
+    if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+        return;
+    }
+
+    memset(digest, 0x5A, sizeof(digest));
+    *max_us = 0.0;
+    for (i = 0; i < NB_GROUPS; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = key_ids[i];
+        args.message = digest;
+        args.signature = signature;
+        args.message_size = sizeof(digest);
+        args.signature_size = sizeof(signature);
+#ifdef PSA_COMPLIANT
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+        args.flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+        start = perf_now_s();
+        err = hsm_generate_signature(sig_gen_hdl, &args);
+        elapsed = (perf_now_s() - start) * 1e6;
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+        total += elapsed;
+        if (elapsed > *max_us) {
+            *max_us = elapsed;
+        }
+    }
+    *mean_us = total / NB_GROUPS;
+    (void)hsm_close_signature_generation_service(sig_gen_hdl);
+}
+
+/* Boot with flags and use each key once. */
+static void boot(uint8_t flags, const char *name)
+{
+    hsm_hdl_t session_hdl, key_store_hdl;
+    double t0, ready_us, done_us, mean_us = 0.0, max_us = 0.0;
+
+    evict_storage();
+    t0 = perf_now_s();
+    if (!PERF_CHECK(perf_nvm_start(flags) == 0)) {
+        return;
+    }
+    ready_us = (perf_now_s() - t0) * 1e6;
+
+    if (open_key_store(&session_hdl, &key_store_hdl) == 0) {
+        first_use(key_store_hdl, &mean_us, &max_us);
+        done_us = (perf_now_s() - t0) * 1e6;
+        (void)hsm_close_key_store_service(key_store_hdl);
+        (void)hsm_close_session(session_hdl);
+
+        printf("%-10s ready %8.1f us  first use mean %8.1f us  max %8.1f us  all keys used %9.1f us\n",
+               name, ready_us, mean_us, max_us, done_us);
+    }
+    perf_nvm_stop();
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    struct perf_hsm hsm;
+    int i, nb = 3;
+
+    if (argc > 1)
+        nb = atoi(argv[1]);
+    if (nb <= 0)
+        nb = 3;
+
+    /* Only one key group resident in the simulated enclave. */
+    (void)setenv("SIM_SE_RESIDENT_GROUPS", "1", 0);
+    (void)setenv("SIM_SE_STORAGE_NS", "300000", 0);
+
+    /* Keys written to storage by a first start. */
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+    if (perf_hsm_open(&hsm) == 0) {
+        gen_keys(hsm.key_mgmt);
+        perf_hsm_close(&hsm);
+    }
+    perf_nvm_stop();
+
+    if (perf_failures == 0) {
+        printf("\n---------------------------------------------------\n");
+        printf("%d starts per mode, %d key groups loaded on first use\n", nb, NB_GROUPS);
+        for (i = 0; i < nb; i++) {
+            boot(NVM_FLAGS_HSM, "default");
+            boot(NVM_FLAGS_HSM | NVM_FLAGS_PREFETCH, "prefetch");
+        }
+        printf("---------------------------------------------------\n");
+    }
+
+    return perf_exit_code();
+}
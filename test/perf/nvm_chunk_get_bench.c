@@ -0,0 +1,217 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Latency of signatures that need their key group to be reloaded by the
+ * enclave, through a chunk get served by the storage manager. Keys are
+ * used round-robin over a number of groups that fits in the chunk cache of
+ * the manager, then over more groups than it holds.
+ * On the simulator, SIM_SE_RESIDENT_GROUPS is set to 1 unless given, so
+ * that every signature evicts the group used before. SIM_SE_TIME_SCALE=0
+ * leaves out the simulated enclave processing time.
+ * Then the chunk files are stripped of their marker, as written by older
+ * versions of the manager: they must still be served, and left as they are.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Groups reloaded from the cache, then beyond its size. */
+#define NB_GROUPS_CACHED    8
+#define NB_GROUPS           40
+#define FIRST_GROUP         100
+
+#ifdef CONFIG_COMPRESSED_ECC_POINT
+#define SIGNATURE_SIZE  65
+#else
+#define SIGNATURE_SIZE  64
+#endif
+
+/* Written by the storage manager after the chunk blobs, "NCK2". */
+#define CHUNK_MARK          0x324b434eu
+
+static uint32_t key_ids[NB_GROUPS];
+
+/* One STRICT persistent key per group, so that each group is in NVM. */
+static void gen_keys(hsm_hdl_t key_mgmt_hdl)
+{
+    op_generate_key_args_t args;
+    uint8_t pub_key[64];
+    hsm_err_t err;
+    int i;
+
+    for (i = 0; i < NB_GROUPS; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = &key_ids[i];
+        args.out_size = sizeof(pub_key);
+        args.out_key = pub_key;
+        args.key_group = FIRST_GROUP + i;
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.flags = HSM_OP_KEY_GENERATION_FLAGS_STRICT_OPERATION;
+#ifdef PSA_COMPLIANT
+        args.key_lifetime = HSM_KEY_LIFE_PERSISTENT;
+        args.key_usage = HSM_KEY_USAGE_SIGN_HASH | HSM_KEY_USAGE_VERIFY_HASH;
+        args.permitted_algo = PERMITTED_ALGO_ECDSA_SHA256;
+#else
+        args.flags |= HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+        args.key_info = HSM_KEY_INFO_PERSISTENT;
+#endif
+        err = hsm_generate_key(key_mgmt_hdl, &args);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+}
+
+/* Sign nb times with the keys of nb_groups groups in turn. */
+static void sign_loop(hsm_hdl_t sig_gen_hdl, int nb_groups, int nb, const char *name)
+{
+    op_generate_sign_args_t args;
+    uint8_t digest[32];
+    uint8_t signature[SIGNATURE_SIZE];
+    double start, elapsed;
+    hsm_err_t err;
+    int i;
+
+    memset(digest, 0x5A, sizeof(digest));
+    start = perf_now_s();
+    for (i = 0; i < nb; i++) {
+        memset(&args, 0, sizeof(args));
+        args.key_identifier = key_ids[i % nb_groups];
+        args.message = digest;
+        args.signature = signature;
+        args.message_size = sizeof(digest);
+        args.signature_size = sizeof(signature);
+#ifdef PSA_COMPLIANT
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_SHA256;
+#else
+        args.scheme_id = HSM_SIGNATURE_SCHEME_ECDSA_NIST_P256_SHA_256;
+#endif
+        args.flags = HSM_OP_GENERATE_SIGN_FLAGS_INPUT_DIGEST;
+        err = hsm_generate_signature(sig_gen_hdl, &args);
+        (void)PERF_CHECK(err == HSM_NO_ERROR);
+    }
+    elapsed = (perf_now_s() - start) * 1e6;
+
+    printf("%-22s %2d groups  mean %8.1f us\n", name, nb_groups, elapsed / nb);
+}
+
+/*
+ * Count the chunk files of the simulator storage that end with the marker,
+ * and remove it if strip is set. None with NVM_CHUNK_LOG.
+ */
+static int chunk_marks(bool strip)
+{
+    const char *dir = getenv("SIM_SE_NVM_DIR");
+    char path[512];
+    struct dirent *de;
+    uint32_t mark;
+    off_t size;
+    int fd, nb = 0;
+    DIR *d;
+
+    if ((dir == NULL) || (*dir == '\0')) {
+        dir = "/tmp/sim_hsm";
+    }
+    (void)snprintf(path, sizeof(path), "%s/hsm", dir);
+    d = opendir(path);
+    if (d == NULL) {
+        return 0;
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (strlen(de->d_name) != 16u) {
+            continue;
+        }
+        (void)snprintf(path, sizeof(path), "%s/hsm/%s", dir, de->d_name);
+        fd = open(path, strip ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        size = lseek(fd, 0, SEEK_END);
+        if ((size > (off_t)sizeof(mark))
+            && (pread(fd, &mark, sizeof(mark), size - (off_t)sizeof(mark)) == (ssize_t)sizeof(mark))
+            && (mark == CHUNK_MARK)) {
+            nb++;
+            if (strip) {
+                (void)PERF_CHECK(ftruncate(fd, size - (off_t)sizeof(mark)) == 0);
+            }
+        }
+        (void)close(fd);
+    }
+    (void)closedir(d);
+
+    return nb;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    open_svc_sign_gen_args_t open_sig_gen_args = {0};
+    struct perf_hsm hsm;
+    hsm_hdl_t sig_gen_hdl;
+    hsm_err_t err;
+    int nb = 400;
+    int nb_legacy;
+
+    if (argc > 1)
+        nb = atoi(argv[1]);
+    if (nb <= 0)
+        nb = 400;
+
+    /* Only one key group resident in the simulated enclave. */
+    (void)setenv("SIM_SE_RESIDENT_GROUPS", "1", 0);
+
+    if (perf_nvm_start(NVM_FLAGS_HSM) != 0) {
+        return 1;
+    }
+
+    do {
+        if (perf_hsm_open(&hsm) != 0) {
+            break;
+        }
+
+        err = hsm_open_signature_generation_service(hsm.key_store, &open_sig_gen_args, &sig_gen_hdl);
+        if (!PERF_CHECK(err == HSM_NO_ERROR)) {
+            perf_hsm_close(&hsm);
+            break;
+        }
+
+        gen_keys(hsm.key_mgmt);
+
+        printf("\n---------------------------------------------------\n");
+        printf("%d signatures, key group reloaded for each\n", nb);
+        sign_loop(sig_gen_hdl, NB_GROUPS_CACHED, nb, "within chunk cache");
+        sign_loop(sig_gen_hdl, NB_GROUPS, nb, "beyond chunk cache");
+        printf("---------------------------------------------------\n");
+
+        /* Chunks of older versions are only read, whatever the enclave says. */
+        nb_legacy = chunk_marks(true);
+        if (nb_legacy > 0) {
+            sign_loop(sig_gen_hdl, NB_GROUPS, 2 * NB_GROUPS, "unmarked chunks");
+            (void)PERF_CHECK(chunk_marks(false) == 0);
+        }
+
+        (void)hsm_close_signature_generation_service(sig_gen_hdl);
+        perf_hsm_close(&hsm);
+    } while (0);
+
+    perf_nvm_stop();
+
+    return perf_exit_code();
+}
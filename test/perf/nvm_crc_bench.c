@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * CRC of the NVM blobs: crc32_update() against zlib and the table-driven
+ * fallback, for blob sizes from 1 KiB to 16 KiB. All the implementations
+ * are first checked against zlib on random sizes and alignments.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+#include "crc32.h"
+#include "perf_common.h"
+
+#define MAX_SIZE        (16 * 1024)
+#define BYTES_PER_SIZE  (256u * 1024u * 1024u)
+
+static uint8_t blob[MAX_SIZE + 64];
+static volatile uint32_t sink;
+
+/* CRC of the blobs as computed before, with zlib. */
+static uint32_t crc_zlib(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    return (uint32_t)crc32(crc ^ 0xFFFFFFFFu, data, size) ^ 0xFFFFFFFFu;
+}
+
+static int check(void)
+{
+    uint32_t i, off, size, ref;
+    int failed = 0;
+
+    for (i = 0; i < 20000u; i++) {
+        off = (uint32_t)rand() % 64u;
+        size = (i < 1024u) ? i : (uint32_t)rand() % (MAX_SIZE + 1);
+        ref = crc_zlib(i, blob + off, size);
+        if ((crc32_update(i, blob + off, size) != ref)
+            || (crc32_update_sw(i, blob + off, size) != ref)) {
+            printf("CRC mismatch: offset %u size %u\n", off, size);
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+static double bench(uint32_t (*fn)(uint32_t, const uint8_t *, uint32_t), uint32_t size)
+{
+    uint32_t i, n = BYTES_PER_SIZE / size;
+    uint32_t crc = 0;
+    double start;
+
+    start = perf_now_s();
+    for (i = 0; i < n; i++) {
+        crc ^= fn(0, blob, size);
+    }
+    sink = crc;
+
+    return (double)n * size / (perf_now_s() - start) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t size, i;
+    double zlib_mbs, sw_mbs, hw_mbs;
+    int failed;
+
+    srand(1);
+    for (i = 0; i < sizeof(blob); i++) {
+        blob[i] = (uint8_t)rand();
+    }
+
+    failed = check();
+
+    printf("\n---------------------------------------------------\n");
+    printf("crc32_update: %s, %d mismatches\n", crc32_impl_name(), failed);
+    printf("%8s %12s %12s %12s\n", "size", "zlib MB/s", "sw MB/s", "crc32 MB/s");
+    for (size = 1024; size <= MAX_SIZE; size *= 2) {
+        zlib_mbs = bench(crc_zlib, size);
+        sw_mbs = bench(crc32_update_sw, size);
+        hw_mbs = bench(crc32_update, size);
+        printf("%8u %12.0f %12.0f %12.0f (x%.2f)\n", size, zlib_mbs, sw_mbs,
+               hw_mbs, hw_mbs / zlib_mbs);
+    }
+    printf("---------------------------------------------------\n");
+
+    (void)PERF_CHECK(failed == 0);
+
+    return perf_exit_code();
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * Chunk writes made durable every write, as for STRICT operations, and
+ * every 16 writes: one file per chunk replaced through nvm_commit against
+ * the chunk log of nvm_log. The log is then checked after being reopened
+ * with a torn record at its end, and the migration of chunk files to it.
+ * A write not waited for that fails is reported to the next writer of its
+ * file only.
+ * Files are written in a new directory of the current one, or of the one
+ * given as argument.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "nvm_commit.h"
+#include "nvm_log.h"
+#include "perf_common.h"
+
+#define NB_CHUNKS       32
+#define CHUNK_SIZE      2048
+#define NB_WRITES       2048
+
+static uint8_t chunk[CHUNK_SIZE];
+static uint8_t rd[CHUNK_SIZE];
+/* Last write of each chunk. */
+static int last[NB_CHUNKS];
+
+static uint32_t chunk_size(int chunk_idx)
+{
+    return CHUNK_SIZE - (uint32_t)(chunk_idx * 8);
+}
+
+static void fill(int chunk_idx, int write_idx)
+{
+    uint32_t i;
+
+    for (i = 0; i < CHUNK_SIZE; i++) {
+        chunk[i] = (uint8_t)(i * 7u + (uint32_t)chunk_idx * 13u + (uint32_t)write_idx);
+    }
+}
+
+static void rm_dir(const char *dir)
+{
+    char path[1024];
+    struct dirent *de;
+    DIR *d = opendir(dir);
+
+    if (d == NULL) {
+        return;
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        (void)unlink(path);
+    }
+    closedir(d);
+    (void)rmdir(dir);
+}
+
+/* Write NB_WRITES chunks, durable every sync_every. Return us per write. */
+static double write_files(const char *dir, int sync_every)
+{
+    char path[1024];
+    double start = perf_now_s();
+    int i, c;
+
+    mkdir(dir, S_IRWXU);
+    for (i = 0; i < NB_WRITES; i++) {
+        c = i % NB_CHUNKS;
+        fill(c, i);
+        snprintf(path, sizeof(path), "%s/%016lx", dir, (unsigned long)c);
+        (void)nvm_commit_write(path, chunk, chunk_size(c), false);
+        if ((i + 1) % sync_every == 0) {
+            nvm_commit_flush();
+        }
+    }
+    nvm_commit_flush();
+
+    return (perf_now_s() - start) * 1e6 / NB_WRITES;
+}
+
+static double write_log(struct nvm_log *log, int sync_every)
+{
+    double start = perf_now_s();
+    int i, c;
+
+    for (i = 0; i < NB_WRITES; i++) {
+        c = i % NB_CHUNKS;
+        fill(c, i);
+        (void)PERF_CHECK(nvm_log_write(log, (uint64_t)c, chunk, chunk_size(c))
+                         == (int32_t)chunk_size(c));
+        last[c] = i;
+        if ((i + 1) % sync_every == 0) {
+            (void)nvm_log_sync_all();
+        }
+    }
+    (void)nvm_log_sync_all();
+
+    return (perf_now_s() - start) * 1e6 / NB_WRITES;
+}
+
+/*
+ * A chunk written without waiting in a directory that does not exist fails:
+ * the failure is reported to the next write of this chunk, not to the one of
+ * another file, and only once. Return the number of failed checks.
+ */
+static int check_deferred_error(const char *files_dir, const char *bad_dir)
+{
+    char good[1024], bad[1024];
+    int failed = 0;
+
+    snprintf(good, sizeof(good), "%s/%016lx", files_dir, 0ul);
+    snprintf(bad, sizeof(bad), "%s/%016lx", bad_dir, 0ul);
+    fill(0, 0);
+    (void)rmdir(bad_dir);
+
+    (void)nvm_commit_write(bad, chunk, 16u, false);
+    nvm_commit_flush();
+    if (nvm_commit_write(good, chunk, 16u, true) != 16) {
+        printf("failure of another file reported\n");
+        failed++;
+    }
+    mkdir(bad_dir, S_IRWXU);
+    if (nvm_commit_write(bad, chunk, 16u, false) != -1) {
+        printf("failure not reported to the next write of its file\n");
+        failed++;
+    }
+    nvm_commit_flush();
+    if (nvm_commit_write(bad, chunk, 16u, true) != 16) {
+        printf("failure reported twice\n");
+        failed++;
+    }
+
+    return failed;
+}
+
+/* Return the number of chunks not read back as last written. */
+static int check_log(struct nvm_log *log)
+{
+    int c, failed = 0;
+
+    for (c = 0; c < NB_CHUNKS; c++) {
+        fill(c, last[c]);
+        if ((nvm_log_read(log, (uint64_t)c, rd, sizeof(rd)) != (int32_t)chunk_size(c))
+            || (memcmp(rd, chunk, chunk_size(c)) != 0)) {
+            printf("chunk %d not read back\n", c);
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    char base[256], files_dir[512], log_dir[512], old_dir[512], bad_dir[512], path[1024];
+    struct nvm_log *log;
+    struct stat st;
+    double files_us[2], log_us[2];
+    int sync_every[2] = {1, 16};
+    int i, c, fd, failed = 0;
+
+    snprintf(base, sizeof(base), "%s/nvm_log_bench.XXXXXX", (argc > 1) ? argv[1] : ".");
+    if (mkdtemp(base) == NULL) {
+        printf("cannot create a directory in %s\n", (argc > 1) ? argv[1] : ".");
+        return 1;
+    }
+    snprintf(files_dir, sizeof(files_dir), "%s/files", base);
+    snprintf(log_dir, sizeof(log_dir), "%s/log", base);
+    snprintf(old_dir, sizeof(old_dir), "%s/old", base);
+    snprintf(bad_dir, sizeof(bad_dir), "%s/bad", base);
+
+    log = nvm_log_get(log_dir);
+    if (log == NULL) {
+        printf("nvm_log_get failed\n");
+        return 1;
+    }
+    for (i = 0; i < 2; i++) {
+        files_us[i] = write_files(files_dir, sync_every[i]);
+        log_us[i] = write_log(log, sync_every[i]);
+    }
+    failed += check_log(log);
+    failed += check_deferred_error(files_dir, bad_dir);
+
+    /* Reopen with a record torn by a crash: it is dropped. */
+    nvm_log_close(log);
+    snprintf(path, sizeof(path), "%s/chunks.log", log_dir);
+    fd = open(path, O_WRONLY|O_APPEND);
+    if ((fd < 0) || (write(fd, "NREC torn record", 16) != 16)) {
+        printf("cannot append to %s\n", path);
+        failed++;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    log = nvm_log_get(log_dir);
+    if (log == NULL) {
+        printf("nvm_log_get failed after reopen\n");
+        return 1;
+    }
+    failed += check_log(log);
+    fill(0, 0);
+    if (nvm_log_write(log, 0u, chunk, 16u) != 16) {
+        printf("nvm_log_write after reopen failed\n");
+        failed++;
+    }
+    last[0] = 0;
+    if ((nvm_log_read(log, 0u, rd, sizeof(rd)) != 16) || (memcmp(rd, chunk, 16u) != 0)) {
+        printf("chunk 0 not read back after reopen\n");
+        failed++;
+    }
+    /* Outdated records are dropped by the compactions. */
+    if ((stat(path, &st) != 0) || (st.st_size > (off_t)(NB_WRITES * CHUNK_SIZE))) {
+        printf("log not compacted\n");
+        failed++;
+    }
+    nvm_log_close(log);
+
+    /* Chunk files of the previous layout are moved to the log. */
+    mkdir(old_dir, S_IRWXU);
+    for (c = 0; c < NB_CHUNKS; c++) {
+        fill(c, c);
+        last[c] = c;
+        snprintf(path, sizeof(path), "%s/%016lx", old_dir, (unsigned long)c);
+        fd = open(path, O_CREAT|O_WRONLY|O_TRUNC, S_IRUSR|S_IWUSR);
+        if ((fd < 0) || (write(fd, chunk, chunk_size(c)) != (ssize_t)chunk_size(c))) {
+            failed++;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    log = nvm_log_get(old_dir);
+    if (log == NULL) {
+        printf("nvm_log_get failed on chunk files\n");
+        return 1;
+    }
+    failed += check_log(log);
+    snprintf(path, sizeof(path), "%s/%016lx", old_dir, 0ul);
+    if (access(path, F_OK) == 0) {
+        printf("chunk files not removed\n");
+        failed++;
+    }
+    nvm_log_close(log);
+
+    printf("\n---------------------------------------------------\n");
+    printf("%d chunk writes of about %d bytes, %d chunks\n", NB_WRITES, CHUNK_SIZE, NB_CHUNKS);
+    for (i = 0; i < 2; i++) {
+        printf("durable every %2d: files %8.1f us/write  log %8.1f us/write (x%.2f)\n",
+               sync_every[i], files_us[i], log_us[i], files_us[i] / log_us[i]);
+    }
+    printf("---------------------------------------------------\n");
+
+    rm_dir(files_dir);
+    rm_dir(log_dir);
+    rm_dir(old_dir);
+    rm_dir(bad_dir);
+    rmdir(base);
+
+    (void)PERF_CHECK(failed == 0);
+
+    return perf_exit_code();
+}
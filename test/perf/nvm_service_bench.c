@@ -0,0 +1,249 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+/*
+ * One nvm_service() thread serving the platform and V2X HSM storage
+ * channels. STRICT persistent keys are generated in both domains at the
+ * same time, then the service is stopped, started again and the key
+ * stores must be found in the imported master blobs.
+ * On the simulator, SIM_SE_NVM_DIR sets where the blobs are written.
+ */
+
+#include "hsm_api.h"
+#include "perf_common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_KEYS        500
+#define NB_GROUPS       8
+
+struct domain {
+    const char *name;
+    uint32_t key_store_id;
+    uint8_t session_priority;
+    uint8_t operating_mode;
+    int nb;
+    int failed;
+    double total_us;
+    double max_us;
+};
+
+static const uint8_t nvm_flags[] = {
+    NVM_FLAGS_HSM,
+    NVM_FLAGS_V2X | NVM_FLAGS_HSM,
+};
+
+/* The same channel twice: the second one cannot be opened. */
+static const uint8_t nvm_dup_flags[] = {
+    NVM_FLAGS_HSM,
+    NVM_FLAGS_HSM,
+};
+
+static void *nvm_service_thread(void *arg)
+{
+    nvm_service(arg, 2);
+    return NULL;
+}
+
+/* Open the session and key store of a domain, created if create is set. */
+static hsm_err_t open_key_store(struct domain *d, bool create,
+                                hsm_hdl_t *session_hdl, hsm_hdl_t *key_store_hdl)
+{
+    open_session_args_t open_session_args = {0};
+    open_svc_key_store_args_t key_store_args = {0};
+    hsm_err_t err;
+
+    open_session_args.session_priority = d->session_priority;
+    open_session_args.operating_mode = d->operating_mode;
+    err = hsm_open_session(&open_session_args, session_hdl);
+    if (err != HSM_NO_ERROR) {
+        return err;
+    }
+
+    key_store_args.key_store_identifier = d->key_store_id;
+    key_store_args.authentication_nonce = 0x1234;
+    key_store_args.max_updates_number   = 100;
+    key_store_args.flags = create ? HSM_SVC_KEY_STORE_FLAGS_CREATE : 0;
+    err = hsm_open_key_store_service(*session_hdl, &key_store_args, key_store_hdl);
+    if (err != HSM_NO_ERROR) {
+        (void)hsm_close_session(*session_hdl);
+    }
+
+    return err;
+}
+
+/* Generate STRICT persistent keys in the key store of a domain. */
+static void *gen_keys_thread(void *arg)
+{
+    struct domain *d = arg;
+    open_svc_key_management_args_t key_mgmt_args = {0};
+    op_generate_key_args_t args;
+    hsm_hdl_t session_hdl, key_store_hdl, key_mgmt_hdl;
+    uint8_t pub_key[64];
+    uint32_t key_id;
+    double start, lat;
+    hsm_err_t err;
+    int i;
+
+    err = open_key_store(d, true, &session_hdl, &key_store_hdl);
+    if (err != HSM_NO_ERROR) {
+        printf("%s: key store creation ret:0x%x\n", d->name, err);
+        d->failed = d->nb;
+        return NULL;
+    }
+    err = hsm_open_key_management_service(key_store_hdl, &key_mgmt_args, &key_mgmt_hdl);
+    if (err != HSM_NO_ERROR) {
+        printf("%s: hsm_open_key_management_service ret:0x%x\n", d->name, err);
+        d->failed = d->nb;
+    }
+
+    for (i = 0; (err == HSM_NO_ERROR) && (i < d->nb); i++) {
+        memset(&args, 0, sizeof(args));
+        key_id = 0;
+        args.key_identifier = &key_id;
+        args.out_size = sizeof(pub_key);
+        args.out_key = pub_key;
+        args.key_group = 10 + (i % NB_GROUPS);
+        args.key_type = HSM_KEY_TYPE_ECDSA_NIST_P256;
+        args.flags = HSM_OP_KEY_GENERATION_FLAGS_STRICT_OPERATION;
+#ifdef PSA_COMPLIANT
+        args.key_lifetime = HSM_KEY_LIFE_PERSISTENT;
+        args.key_usage = HSM_KEY_USAGE_SIGN_HASH | HSM_KEY_USAGE_VERIFY_HASH;
+        args.permitted_algo = PERMITTED_ALGO_ECDSA_SHA256;
+#else
+        args.flags |= HSM_OP_KEY_GENERATION_FLAGS_CREATE;
+        args.key_info = HSM_KEY_INFO_PERSISTENT;
+#endif
+        start = perf_now_s();
+        if (hsm_generate_key(key_mgmt_hdl, &args) != HSM_NO_ERROR) {
+            d->failed++;
+        }
+        lat = (perf_now_s() - start) * 1e6;
+        d->total_us += lat;
+        if (lat > d->max_us) {
+            d->max_us = lat;
+        }
+    }
+
+    if (err == HSM_NO_ERROR) {
+        (void)hsm_close_key_management_service(key_mgmt_hdl);
+    }
+    (void)hsm_close_key_store_service(key_store_hdl);
+    (void)hsm_close_session(session_hdl);
+
+    return NULL;
+}
+
+/* Start the service thread, return the time to get ready in us, < 0 on failure. */
+static double start_service(pthread_t *tid)
+{
+    double start = perf_now_s();
+    uint32_t status;
+
+    (void)pthread_create(tid, NULL, nvm_service_thread, (void *)nvm_flags);
+    status = nvm_wait_ready(5000);
+    if (status != NVM_STATUS_RUNNING) {
+        printf("nvm service failed to start, status %u\n", status);
+        nvm_service_stop();
+        (void)pthread_join(*tid, NULL);
+        return -1.0;
+    }
+
+    return (perf_now_s() - start) * 1e6;
+}
+
+/* Stop the service thread, return the time it took in us. */
+static double stop_service(pthread_t tid)
+{
+    double start = perf_now_s();
+
+    nvm_service_stop();
+    (void)pthread_join(tid, NULL);
+
+    return (perf_now_s() - start) * 1e6;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    struct domain domains[2] = {
+        { "platform", 0xABCD, HSM_OPEN_SESSION_PRIORITY_LOW, 0 },
+        { "v2x", 0x5678, HSM_OPEN_SESSION_PRIORITY_LOW, HSM_OPEN_SESSION_LOW_LATENCY_MASK },
+    };
+    hsm_hdl_t session_hdl, key_store_hdl;
+    pthread_t tid, gen_tid[2];
+    hsm_err_t err;
+    double start, elapsed, ready_us, stop_us;
+    int i, nb = 100;
+
+    if (argc > 1)
+        nb = atoi(argv[1]);
+    if ((nb <= 0) || (nb > MAX_KEYS))
+        nb = 100;
+
+    do {
+        ready_us = start_service(&tid);
+        if (!PERF_CHECK(ready_us >= 0)) {
+            break;
+        }
+
+        start = perf_now_s();
+        for (i = 0; i < 2; i++) {
+            domains[i].nb = nb;
+            (void)pthread_create(&gen_tid[i], NULL, gen_keys_thread, &domains[i]);
+        }
+        for (i = 0; i < 2; i++) {
+            (void)pthread_join(gen_tid[i], NULL);
+            (void)PERF_CHECK(domains[i].failed == 0);
+        }
+        elapsed = perf_now_s() - start;
+        stop_us = stop_service(tid);
+
+        printf("\n---------------------------------------------------\n");
+        printf("2 channels served by one thread, ready in %.1f us\n", ready_us);
+        for (i = 0; i < 2; i++) {
+            printf("%-9s %d STRICT keys, mean %8.1f us  max %8.1f us  %d failures\n",
+                   domains[i].name, nb, domains[i].total_us / nb, domains[i].max_us,
+                   domains[i].failed);
+        }
+        printf("both      %.1f keys/s\n", 2 * nb / elapsed);
+        printf("stopped in %.1f us\n", stop_us);
+
+        /* The key stores come back with the master blobs. */
+        ready_us = start_service(&tid);
+        if (!PERF_CHECK(ready_us >= 0)) {
+            break;
+        }
+        for (i = 0; i < 2; i++) {
+            err = open_key_store(&domains[i], false, &session_hdl, &key_store_hdl);
+            if (PERF_CHECK(err == HSM_NO_ERROR)) {
+                (void)hsm_close_key_store_service(key_store_hdl);
+                (void)hsm_close_session(session_hdl);
+            }
+        }
+        (void)stop_service(tid);
+        printf("restarted in %.1f us, key stores restored\n", ready_us);
+
+        /* A channel given twice: the start fails. */
+        (void)pthread_create(&tid, NULL, nvm_service_thread, (void *)nvm_dup_flags);
+        (void)PERF_CHECK(nvm_wait_ready(5000) == NVM_STATUS_STOPPED);
+        nvm_service_stop();
+        (void)pthread_join(tid, NULL);
+        printf("---------------------------------------------------\n");
+    } while (0);
+
+    return perf_exit_code();
+}
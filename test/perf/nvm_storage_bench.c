@@ -0,0 +1,307 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * NXP Confidential.
+ * This software is owned or controlled by NXP and may only be used strictly
+ * in accordance with the applicable license terms.  By expressly accepting
+ * such terms or by downloading, installing, activating and/or otherwise using
+ * the software, you are agreeing that you have read, and that you agree to
+ * comply with and are bound by, such license terms.  If you do not agree to be
+ * bound by the applicable license terms, then you may not retain, install,
+ * activate or otherwise use the software.
+ */
+
+
+
+/*
+ * Export and get patterns of the NVM manager run against each storage
+ * backend through nvm_storage_ops: exports of a few chunks followed by the
+ * master, as for the key updates, then random chunk gets. The raw backend
+ * uses a file standing for the partition. The content is checked after the
+ * gets and, for the durable backends, after the storage is reopened.
+ * The file backend also reads a chunk directory written in the layout used
+ * before the backends.
+ * Files are written in a new directory of the current one, or of the one
+ * given as argument.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "nvm_storage.h"
+#include "perf_common.h"
+
+#define NB_CHUNKS           64
+#define CHUNK_MAX_SIZE      4096
+#define MASTER_SIZE         1024
+/* Chunks written by an export before the master. */
+#define CHUNKS_PER_EXPORT   4
+#define NB_EXPORTS          256
+#define NB_GETS             4096
+/* Size of the file standing for the raw partition. */
+#define RAW_DEV_SIZE        (4 * 1024 * 1024)
+
+static uint8_t blob[CHUNK_MAX_SIZE];
+static uint8_t rd[CHUNK_MAX_SIZE];
+/* Last export of each chunk, -1 if not written. */
+static int last[NB_CHUNKS];
+static int last_master;
+
+static uint32_t chunk_size(int chunk_idx)
+{
+    return 512u + (uint32_t)((chunk_idx * 56) % (CHUNK_MAX_SIZE - 512));
+}
+
+static void fill(uint64_t blob_id, int export_idx)
+{
+    uint32_t i;
+
+    for (i = 0; i < CHUNK_MAX_SIZE; i++) {
+        blob[i] = (uint8_t)(i * 7u + (uint32_t)blob_id * 13u + (uint32_t)export_idx);
+    }
+}
+
+static void rm_dir(const char *dir)
+{
+    char path[1024];
+    struct dirent *de;
+    DIR *d = opendir(dir);
+
+    if (d == NULL) {
+        return;
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        (void)unlink(path);
+    }
+    closedir(d);
+    (void)rmdir(dir);
+}
+
+/* Run the exports. Return the number of failures, set us per export. */
+static int run_exports(struct nvm_storage *st, double *us)
+{
+    double start = perf_now_s();
+    int i, j, c, failed = 0;
+
+    for (i = 0; i < NB_EXPORTS; i++) {
+        for (j = 0; j < CHUNKS_PER_EXPORT; j++) {
+            c = rand() % NB_CHUNKS;
+            fill((uint64_t)c, i);
+            if (st->ops->write_blob(st, (uint64_t)c, blob, chunk_size(c)) != (int32_t)chunk_size(c)) {
+                failed++;
+            }
+            last[c] = i;
+        }
+        fill(NVM_STORAGE_MASTER_ID, i);
+        if (st->ops->write_blob(st, NVM_STORAGE_MASTER_ID, blob, MASTER_SIZE) != MASTER_SIZE) {
+            failed++;
+        }
+        last_master = i;
+    }
+    *us = (perf_now_s() - start) * 1e6 / NB_EXPORTS;
+
+    return failed;
+}
+
+/* Check a blob against its last write. Return 1 if it differs. */
+static int check_blob(struct nvm_storage *st, uint64_t blob_id, int export_idx, uint32_t size)
+{
+    fill(blob_id, export_idx);
+    if ((st->ops->read_blob(st, blob_id, rd, sizeof(rd)) != (int32_t)size)
+        || (memcmp(rd, blob, size) != 0)) {
+        printf("%s: blob %lx not read back\n", st->ops->name, (unsigned long)blob_id);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Run the gets. Return the number of failures, set us per get. */
+static int run_gets(struct nvm_storage *st, double *us)
+{
+    double start = perf_now_s();
+    int i, c, failed = 0;
+
+    for (i = 0; i < NB_GETS; i++) {
+        c = rand() % NB_CHUNKS;
+        if (last[c] < 0) {
+            continue;
+        }
+        failed += check_blob(st, (uint64_t)c, last[c], chunk_size(c));
+    }
+    *us = (perf_now_s() - start) * 1e6 / NB_GETS;
+
+    return failed;
+}
+
+/* Check all the blobs and the listing of the chunks. */
+static int check_all(struct nvm_storage *st)
+{
+    uint64_t ids[NB_CHUNKS + 1];
+    uint32_t nb, expected = 0u;
+    int c, failed = 0;
+
+    for (c = 0; c < NB_CHUNKS; c++) {
+        if (last[c] >= 0) {
+            failed += check_blob(st, (uint64_t)c, last[c], chunk_size(c));
+            expected++;
+        }
+    }
+    failed += check_blob(st, NVM_STORAGE_MASTER_ID, last_master, MASTER_SIZE);
+
+    nb = st->ops->enumerate(st, ids, NB_CHUNKS + 1);
+    if (nb != expected) {
+        printf("%s: %u chunks listed, %u expected\n", st->ops->name, nb, expected);
+        failed++;
+    }
+
+    return failed;
+}
+
+/* Write a file with plain writes. Return 1 on failure. */
+static int write_file(const char *path, uint32_t size)
+{
+    int fd = open(path, O_CREAT|O_TRUNC|O_WRONLY, S_IRUSR|S_IWUSR);
+    int failed = 0;
+
+    if ((fd < 0) || (write(fd, blob, size) != (ssize_t)size)) {
+        printf("cannot write %s\n", path);
+        failed = 1;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return failed;
+}
+
+/*
+ * Write the master and some chunks in the layout used before the backends,
+ * one file per chunk named after its blob id, then check that the file
+ * backend reads and lists them. Return the number of failures.
+ */
+static int check_old_layout(struct nvm_storage_cfg *cfg)
+{
+    const struct nvm_storage_ops *ops = nvm_storage_backend("file");
+    struct nvm_storage *st;
+    char path[1024];
+    int c, failed = 0;
+
+    (void)mkdir(cfg->chunk_dir, S_IRWXU);
+    for (c = 0; c < NB_CHUNKS; c++) {
+        last[c] = -1;
+        if ((c % 3) != 0) {
+            fill((uint64_t)c, c);
+            snprintf(path, sizeof(path), "%s%016lx", cfg->chunk_dir, (unsigned long)c);
+            failed += write_file(path, chunk_size(c));
+            last[c] = c;
+        }
+    }
+    last_master = NB_EXPORTS;
+    fill(NVM_STORAGE_MASTER_ID, last_master);
+    failed += write_file(cfg->master_path, MASTER_SIZE);
+
+    st = ops->open(cfg);
+    if (st == NULL) {
+        printf("file: open of the old layout failed\n");
+        return failed + 1;
+    }
+    failed += check_all(st);
+    ops->close(st);
+
+    return failed;
+}
+
+/* Test entry function. */
+int main(int argc, char *argv[])
+{
+    static const char *const names[] = {"file", "raw", "ram"};
+    char base[256], master[512], chunk_dir[512], dev[512], path[1024];
+    struct nvm_storage_cfg cfg = {master, chunk_dir, dev, false};
+    const struct nvm_storage_ops *ops;
+    struct nvm_storage *st;
+    double export_us[3], get_us[3];
+    int i, c, fd, failed = 0;
+
+    snprintf(base, sizeof(base), "%s/nvm_storage_bench.XXXXXX", (argc > 1) ? argv[1] : ".");
+    if (mkdtemp(base) == NULL) {
+        printf("cannot create a directory in %s\n", (argc > 1) ? argv[1] : ".");
+        return 1;
+    }
+    snprintf(master, sizeof(master), "%s/nvm_master", base);
+    snprintf(chunk_dir, sizeof(chunk_dir), "%s/chunks/", base);
+    snprintf(dev, sizeof(dev), "%s/nvm.raw", base);
+
+    fd = open(dev, O_CREAT|O_RDWR, S_IRUSR|S_IWUSR);
+    if ((fd < 0) || (ftruncate(fd, RAW_DEV_SIZE) != 0)) {
+        printf("cannot create %s\n", dev);
+        return 1;
+    }
+    close(fd);
+
+    for (i = 0; i < 3; i++) {
+        ops = nvm_storage_backend(names[i]);
+        st = (ops != NULL) ? ops->open(&cfg) : NULL;
+        if (st == NULL) {
+            printf("%s: open failed\n", names[i]);
+            return 1;
+        }
+        srand(1);
+        for (c = 0; c < NB_CHUNKS; c++) {
+            last[c] = -1;
+        }
+
+        failed += run_exports(st, &export_us[i]);
+        failed += run_gets(st, &get_us[i]);
+        failed += check_all(st);
+
+        /* The blobs written are found after a restart. */
+        if (strcmp(names[i], "ram") != 0) {
+            ops->close(st);
+            st = ops->open(&cfg);
+            if (st == NULL) {
+                printf("%s: reopen failed\n", names[i]);
+                return 1;
+            }
+            failed += check_all(st);
+        }
+        ops->close(st);
+    }
+
+    printf("\n---------------------------------------------------\n");
+    printf("%d exports of %d chunks of 512 to %d bytes and a %d bytes master, %d chunks\n",
+           NB_EXPORTS, CHUNKS_PER_EXPORT, CHUNK_MAX_SIZE, MASTER_SIZE, NB_CHUNKS);
+    for (i = 0; i < 3; i++) {
+        printf("%-4s: export %8.1f us  get %6.1f us\n", names[i], export_us[i], get_us[i]);
+    }
+    printf("---------------------------------------------------\n");
+
+    rm_dir(chunk_dir);
+    (void)unlink(master);
+    /* Kept by nvm_commit for the next write. */
+    snprintf(path, sizeof(path), "%s.tmp", master);
+    (void)unlink(path);
+    (void)unlink(dev);
+
+    /* Another directory, the chunk log of the first one stays open. */
+    snprintf(master, sizeof(master), "%s/old_master", base);
+    snprintf(chunk_dir, sizeof(chunk_dir), "%s/old_chunks/", base);
+    failed += check_old_layout(&cfg);
+    rm_dir(chunk_dir);
+    (void)unlink(master);
+    rmdir(base);
+
+    (void)PERF_CHECK(failed == 0);
+
+    return perf_exit_code();
+}